@@ -0,0 +1,72 @@
+/** @file
+  GUID and data structures for the GUID HOB that caches the contents of the
+  "opt/" fw_cfg files, as consumed by QemuFwCfgSimpleParserLib.
+
+  The cache is an open addressing hash table with linear probing, keyed by the
+  fw_cfg file name. It is built once in PEI and handed off to DXE in a GUID
+  HOB; every "opt/" fw_cfg file is represented, so a lookup miss for an "opt/"
+  name is authoritative.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef QEMU_FW_CFG_KNOB_CACHE_H_
+#define QEMU_FW_CFG_KNOB_CACHE_H_
+
+#include <IndustryStandard/QemuFwCfg.h>
+
+#define QEMU_FW_CFG_KNOB_CACHE_GUID \
+  {0xfbd82625, 0xb927, 0x42b2, {0x94, 0xe2, 0xc8, 0x71, 0x39, 0xe8, 0xd9, 0x0c}}
+
+//
+// Only fw_cfg files whose names start with this prefix are cached.
+//
+#define QEMU_FW_CFG_KNOB_NAME_PREFIX  "opt/"
+
+//
+// fw_cfg files up to this size have their contents cached. Larger files are
+// recorded with their size only; they cannot be parsed as scalars anyway.
+//
+#define QEMU_FW_CFG_KNOB_VALUE_MAX_SIZE  24
+
+//
+// Upper bound on the hash table size, which keeps the GUID HOB well below the
+// 64KB HOB length limit.
+//
+#define QEMU_FW_CFG_KNOB_CACHE_MAX_BUCKETS  512
+
+typedef struct {
+  //
+  // FNV-1a hash of Name. Meaningless if Name[0] is NUL (empty bucket).
+  //
+  UINT32    NameHash;
+  //
+  // Size of the fw_cfg file, in bytes. Value is only populated if Size does
+  // not exceed QEMU_FW_CFG_KNOB_VALUE_MAX_SIZE.
+  //
+  UINT32    Size;
+  UINT16    Select;
+  CHAR8     Name[QEMU_FW_CFG_FNAME_SIZE];
+  CHAR8     Value[QEMU_FW_CFG_KNOB_VALUE_MAX_SIZE];
+} QEMU_FW_CFG_KNOB;
+
+typedef struct {
+  //
+  // Number of QEMU_FW_CFG_KNOB buckets that immediately follow this header;
+  // always a power of two.
+  //
+  UINT32    BucketCount;
+  //
+  // Number of occupied buckets.
+  //
+  UINT32    KnobCount;
+} QEMU_FW_CFG_KNOB_CACHE;
+
+#define QEMU_FW_CFG_KNOB_CACHE_BUCKETS(Cache) \
+  ((QEMU_FW_CFG_KNOB *)((QEMU_FW_CFG_KNOB_CACHE *)(Cache) + 1))
+
+extern EFI_GUID  gQemuFwCfgKnobCacheGuid;
+
+#endif
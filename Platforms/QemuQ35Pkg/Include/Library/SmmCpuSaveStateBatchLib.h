@@ -0,0 +1,84 @@
+/** @file
+  Read many SMM save state registers, for one or all CPUs, in a single call.
+
+  SmmCpuFeaturesReadSaveStateRegister() resolves the register, checks the save
+  state revision and copies one register per call. SMI handlers that inspect
+  several registers across all CPUs can instead describe the registers once and
+  have them copied in one pass over the save state maps.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef SMM_CPU_SAVE_STATE_BATCH_LIB_H_
+#define SMM_CPU_SAVE_STATE_BATCH_LIB_H_
+
+#include <PiSmm.h>
+
+//
+// Pass as CpuIndex to SmmCpuFeaturesReadSaveStateRegisters() to read the
+// registers of CPUs 0 through (gMmst->NumberOfCpus - 1).
+//
+#define SMM_CPU_SAVE_STATE_ALL_CPUS  MAX_UINTN
+
+//
+// Upper limit on the number of registers in one request.
+//
+#define SMM_CPU_SAVE_STATE_BATCH_MAX_REGISTERS  64
+
+typedef struct {
+  EFI_SMM_SAVE_STATE_REGISTER    Register;
+  UINTN                          Width;
+} SMM_CPU_SAVE_STATE_REGISTER_REQUEST;
+
+/**
+  Read a set of SMM save state registers for one CPU or for all CPUs.
+
+  The registers are stored back to back in Buffer, in the order of Requests,
+  each taking Requests[Index].Width bytes. When CpuIndex is
+  SMM_CPU_SAVE_STATE_ALL_CPUS, the per-CPU blocks follow each other in CPU
+  index order.
+
+  EFI_SMM_SAVE_STATE_REGISTER_LMA and all registers that
+  SmmCpuFeaturesReadSaveStateRegister() reads from the save state map are
+  supported. Other registers (such as EFI_SMM_SAVE_STATE_REGISTER_PROCESSOR_ID)
+  are rejected with EFI_UNSUPPORTED; read those one by one through
+  EFI_MM_CPU_PROTOCOL.
+
+  @param[in]      CpuIndex       The index of the CPU to read, or
+                                 SMM_CPU_SAVE_STATE_ALL_CPUS.
+  @param[in]      RequestCount   The number of elements in Requests.
+  @param[in]      Requests       The registers to read, with their widths.
+  @param[in, out] BufferSize     On input, the size of Buffer in bytes. On
+                                 output, the number of bytes required or
+                                 written.
+  @param[out]     Buffer         Receives the register values.
+  @param[out]     FailedRequest  Optional. Receives the index in Requests of
+                                 the register that caused EFI_NOT_FOUND,
+                                 EFI_UNSUPPORTED or EFI_INVALID_PARAMETER for
+                                 a bad Width. Not modified otherwise.
+
+  @retval EFI_SUCCESS            All registers have been read.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL or out of range, or a
+                                 Width is not valid for the register in the
+                                 CPU mode of a save state map.
+  @retval EFI_BUFFER_TOO_SMALL   Buffer is too small; BufferSize has been
+                                 updated.
+  @retval EFI_NOT_FOUND          A register is not defined for the save state
+                                 of a processor.
+  @retval EFI_UNSUPPORTED        A register is not supported by the batch
+                                 interface.
+**/
+EFI_STATUS
+EFIAPI
+SmmCpuFeaturesReadSaveStateRegisters (
+  IN     UINTN                                      CpuIndex,
+  IN     UINTN                                      RequestCount,
+  IN     CONST SMM_CPU_SAVE_STATE_REGISTER_REQUEST  *Requests,
+  IN OUT UINTN                                      *BufferSize,
+  OUT    VOID                                       *Buffer,
+  OUT    UINTN                                      *FailedRequest OPTIONAL
+  );
+
+#endif
@@ -0,0 +1,49 @@
+/** @file
+  Protocol that gives read-only access to the resident fw_cfg blobs (kernel,
+  initrd, command line) held by QemuKernelLoaderFsDxe, so that consumers can
+  use them in place instead of reading copies through the file system.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef QEMU_KERNEL_LOADER_BLOB_H_
+#define QEMU_KERNEL_LOADER_BLOB_H_
+
+#define QEMU_KERNEL_LOADER_BLOB_PROTOCOL_GUID \
+  {0xfa42a865, 0x6d20, 0x4439, {0x96, 0xc5, 0xbd, 0x12, 0xcc, 0x2b, 0x84, 0x08}}
+
+typedef struct _QEMU_KERNEL_LOADER_BLOB_PROTOCOL QEMU_KERNEL_LOADER_BLOB_PROTOCOL;
+
+/**
+  Look up a resident blob by the name under which it is exposed in the QEMU
+  kernel loader file system.
+
+  @param[in]  This      The QEMU_KERNEL_LOADER_BLOB_PROTOCOL instance.
+  @param[in]  FileName  Name of the blob: L"kernel", L"initrd" or L"cmdline".
+  @param[out] Data      On success, points to the blob contents. The buffer is
+                        owned by the producer and must not be modified or
+                        freed.
+  @param[out] Size      On success, the size of the blob in bytes.
+
+  @retval EFI_SUCCESS            The blob has been located.
+  @retval EFI_INVALID_PARAMETER  FileName, Data or Size is NULL.
+  @retval EFI_NOT_FOUND          No blob by that name, or the blob is empty.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *QEMU_KERNEL_LOADER_GET_BLOB)(
+  IN  QEMU_KERNEL_LOADER_BLOB_PROTOCOL  *This,
+  IN  CONST CHAR16                      *FileName,
+  OUT CONST VOID                        **Data,
+  OUT UINTN                             *Size
+  );
+
+struct _QEMU_KERNEL_LOADER_BLOB_PROTOCOL {
+  QEMU_KERNEL_LOADER_GET_BLOB    GetBlob;
+};
+
+extern EFI_GUID  gQemuKernelLoaderBlobProtocolGuid;
+
+#endif
@@ -0,0 +1,51 @@
+/** @file
+  Protocol installed by QemuRamfbDxe next to its Graphics Output Protocol.
+
+  QemuRamfbDxe serves Blt() from a shadow buffer, and Blt() reads
+  (EfiBltVideoToBltBuffer, EfiBltVideoToVideo) return what is in the shadow
+  buffer. Callers that draw into Mode->FrameBufferBase directly and then read
+  the screen back through Blt() use this protocol to copy their pixels into
+  the shadow buffer first.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef QEMU_RAMFB_SHADOW_H_
+#define QEMU_RAMFB_SHADOW_H_
+
+#define QEMU_RAMFB_SHADOW_PROTOCOL_GUID \
+  {0x04a4832d, 0xcc2a, 0x4422, {0x9c, 0x5e, 0xd8, 0xec, 0x7c, 0x54, 0x9b, 0xe5}}
+
+typedef struct _QEMU_RAMFB_SHADOW_PROTOCOL QEMU_RAMFB_SHADOW_PROTOCOL;
+
+/**
+  Copy scan lines of the framebuffer into the shadow buffer, after flushing
+  everything drawn through Blt() so far.
+
+  The framebuffer is mapped write-combining, so the copy reads uncached
+  memory. Limit the range to the scan lines that were drawn directly.
+
+  @param[in] This    The QEMU_RAMFB_SHADOW_PROTOCOL instance.
+  @param[in] Y       The top scan line to copy.
+  @param[in] Height  The number of scan lines to copy.
+
+  @retval EFI_SUCCESS            The scan lines have been copied.
+  @retval EFI_INVALID_PARAMETER  The range is outside of the current mode.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *QEMU_RAMFB_SHADOW_SYNC)(
+  IN QEMU_RAMFB_SHADOW_PROTOCOL  *This,
+  IN UINTN                       Y,
+  IN UINTN                       Height
+  );
+
+struct _QEMU_RAMFB_SHADOW_PROTOCOL {
+  QEMU_RAMFB_SHADOW_SYNC    Sync;
+};
+
+extern EFI_GUID  gQemuRamfbShadowProtocolGuid;
+
+#endif
@@ -0,0 +1,572 @@
+/** @file
+  This contains the installation function for the driver.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "IoApic.h"
+
+//
+// Global for the Legacy 8259 Protocol that is produced by this driver
+//
+EFI_LEGACY_8259_PROTOCOL  mInterruptIoApic = {
+  InterruptIoApicSetVectorBase,
+  InterruptIoApicGetMask,
+  InterruptIoApicSetMask,
+  InterruptIoApicSetMode,
+  InterruptIoApicGetVector,
+  InterruptIoApicEnableIrq,
+  InterruptIoApicDisableIrq,
+  InterruptIoApicGetInterruptLine,
+  InterruptIoApicEndOfInterrupt
+};
+
+//
+// Global for the handle that the Legacy 8259 Protocol is installed
+//
+EFI_HANDLE  mIoApicHandle = NULL;
+
+UINT8          mMasterBase             = PROTECTED_MODE_BASE_VECTOR_MASTER;
+UINT8          mSlaveBase              = PROTECTED_MODE_BASE_VECTOR_SLAVE;
+UINT16         mProtectedModeMask      = 0xffff;
+UINT16         mLegacyModeMask         = 0xffff;
+UINT16         mProtectedModeEdgeLevel = 0x0000;
+UINT16         mLegacyModeEdgeLevel    = 0x0000;
+
+//
+// Worker Functions
+//
+
+/**
+  Map an ISA IRQ to the I/O APIC pin it is connected to.
+
+  @param[in]  Irq  IRQ0-IRQ15.
+
+  @return  The I/O APIC redirection table entry of Irq.
+**/
+STATIC
+UINTN
+InterruptIoApicPin (
+  IN EFI_8259_IRQ  Irq
+  )
+{
+  if (Irq == Efi8259Irq0) {
+    return IO_APIC_ISA_IRQ0_PIN;
+  }
+
+  return Irq;
+}
+
+/**
+  Program the redirection table entry of an IRQ from the protected mode mask,
+  edge/level and vector base settings.
+
+  ISA interrupts are active high. The entry is left masked until the
+  configuration is complete.
+
+  @param[in]  Irq  IRQ0-IRQ15.
+**/
+STATIC
+VOID
+InterruptIoApicProgramIrq (
+  IN EFI_8259_IRQ  Irq
+  )
+{
+  UINT8  Vector;
+
+  //
+  // IRQ2 is the cascade input of the 8259 pair and has no I/O APIC pin of
+  // its own; pin 2 carries IRQ0.
+  //
+  if (Irq == Efi8259Irq2) {
+    return;
+  }
+
+  if ((mProtectedModeMask & (1 << Irq)) != 0) {
+    IoApicEnableInterrupt (InterruptIoApicPin (Irq), FALSE);
+    return;
+  }
+
+  InterruptIoApicGetVector (&mInterruptIoApic, Irq, &Vector);
+  IoApicConfigureInterrupt (
+    InterruptIoApicPin (Irq),
+    Vector,
+    IO_APIC_DELIVERY_MODE_FIXED,
+    (BOOLEAN)((mProtectedModeEdgeLevel & (1 << Irq)) != 0),
+    TRUE
+    );
+  IoApicEnableInterrupt (InterruptIoApicPin (Irq), TRUE);
+}
+
+/**
+  Switch an application processor to x2APIC mode.
+
+  @param[in,out]  Buffer  Unused.
+**/
+STATIC
+VOID
+EFIAPI
+InterruptIoApicEnableX2ApicOnAp (
+  IN OUT VOID  *Buffer
+  )
+{
+  SetApicMode (LOCAL_APIC_MODE_X2APIC);
+}
+
+/**
+  Switch all processors to x2APIC mode if the processor supports it, so that
+  the EOI of every interrupt is an MSR write rather than an MMIO write to the
+  APIC page.
+
+  The application processors are switched first, as MpInitLib does it, so
+  that the BSP never runs in a different mode from the rest while sending
+  IPIs.
+**/
+STATIC
+VOID
+InterruptIoApicEnableX2Apic (
+  VOID
+  )
+{
+  CPUID_VERSION_INFO_ECX    VersionEcx;
+  EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  EFI_STATUS                Status;
+
+  if (GetApicMode () == LOCAL_APIC_MODE_X2APIC) {
+    return;
+  }
+
+  AsmCpuid (CPUID_VERSION_INFO, NULL, NULL, &VersionEcx.Uint32, NULL);
+  if (VersionEcx.Bits.x2APIC == 0) {
+    DEBUG ((DEBUG_INFO, "%a: x2APIC not supported, EOI through the APIC page\n", __FUNCTION__));
+    return;
+  }
+
+  Status = gBS->LocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **)&MpServices);
+  ASSERT_EFI_ERROR (Status);
+
+  Status = MpServices->StartupAllAPs (
+                         MpServices,
+                         InterruptIoApicEnableX2ApicOnAp,
+                         FALSE,
+                         NULL,
+                         0,
+                         NULL,
+                         NULL
+                         );
+  //
+  // EFI_NOT_STARTED means there are no enabled APs.
+  //
+  if (EFI_ERROR (Status) && (Status != EFI_NOT_STARTED)) {
+    DEBUG ((DEBUG_ERROR, "%a: failed to switch the APs to x2APIC: %r\n", __FUNCTION__, Status));
+    return;
+  }
+
+  SetApicMode (LOCAL_APIC_MODE_X2APIC);
+}
+
+//
+// Legacy 8259 Protocol Interface Functions
+//
+
+/**
+  Sets the vector bases for IRQ0-IRQ7 and IRQ8-IRQ15.
+
+  @param[in]  This        Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  MasterBase  Interrupt vectors for IRQ0-IRQ7.
+  @param[in]  SlaveBase   Interrupt vectors for IRQ8-IRQ15.
+
+  @retval  EFI_SUCCESS  The I/O APIC was programmed successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicSetVectorBase (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN UINT8                     MasterBase,
+  IN UINT8                     SlaveBase
+  )
+{
+  EFI_8259_IRQ  Irq;
+  EFI_TPL       OriginalTpl;
+
+  if ((MasterBase == mMasterBase) && (SlaveBase == mSlaveBase)) {
+    return EFI_SUCCESS;
+  }
+
+  OriginalTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  mMasterBase = MasterBase;
+  mSlaveBase  = SlaveBase;
+
+  //
+  // Only the enabled IRQs carry a vector.
+  //
+  for (Irq = Efi8259Irq0; Irq <= Efi8259Irq15; Irq++) {
+    if ((mProtectedModeMask & (1 << Irq)) == 0) {
+      InterruptIoApicProgramIrq (Irq);
+    }
+  }
+
+  gBS->RestoreTPL (OriginalTpl);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Gets the current 16-bit real mode and 32-bit protected-mode IRQ masks.
+
+  @param[in]   This                Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[out]  LegacyMask          16-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[out]  LegacyEdgeLevel     16-bit mode edge/level mask for IRQ-IRQ15.
+  @param[out]  ProtectedMask       32-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[out]  ProtectedEdgeLevel  32-bit mode edge/level mask for IRQ0-IRQ15.
+
+  @retval  EFI_SUCCESS  The masks were returned.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicGetMask (
+  IN  EFI_LEGACY_8259_PROTOCOL  *This,
+  OUT UINT16                    *LegacyMask  OPTIONAL,
+  OUT UINT16                    *LegacyEdgeLevel  OPTIONAL,
+  OUT UINT16                    *ProtectedMask  OPTIONAL,
+  OUT UINT16                    *ProtectedEdgeLevel OPTIONAL
+  )
+{
+  if (LegacyMask != NULL) {
+    *LegacyMask = mLegacyModeMask;
+  }
+
+  if (LegacyEdgeLevel != NULL) {
+    *LegacyEdgeLevel = mLegacyModeEdgeLevel;
+  }
+
+  if (ProtectedMask != NULL) {
+    *ProtectedMask = mProtectedModeMask;
+  }
+
+  if (ProtectedEdgeLevel != NULL) {
+    *ProtectedEdgeLevel = mProtectedModeEdgeLevel;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Sets the current 16-bit real mode and 32-bit protected-mode IRQ masks.
+
+  As in the 8259 driver, the masks are only recorded; the hardware follows
+  EnableIrq() and DisableIrq().
+
+  @param[in]  This                Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  LegacyMask          16-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[in]  LegacyEdgeLevel     16-bit mode edge/level mask for IRQ-IRQ15.
+  @param[in]  ProtectedMask       32-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[in]  ProtectedEdgeLevel  32-bit mode edge/level mask for IRQ0-IRQ15.
+
+  @retval  EFI_SUCCESS  The masks were saved.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicSetMask (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN UINT16                    *LegacyMask  OPTIONAL,
+  IN UINT16                    *LegacyEdgeLevel  OPTIONAL,
+  IN UINT16                    *ProtectedMask  OPTIONAL,
+  IN UINT16                    *ProtectedEdgeLevel OPTIONAL
+  )
+{
+  if (LegacyMask != NULL) {
+    mLegacyModeMask = *LegacyMask;
+  }
+
+  if (LegacyEdgeLevel != NULL) {
+    mLegacyModeEdgeLevel = *LegacyEdgeLevel;
+  }
+
+  if (ProtectedMask != NULL) {
+    mProtectedModeMask = *ProtectedMask;
+  }
+
+  if (ProtectedEdgeLevel != NULL) {
+    mProtectedModeEdgeLevel = *ProtectedEdgeLevel;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Sets the mode of the interrupt controller.
+
+  Only protected mode is supported. Real mode code (a CSM) expects the 8259
+  PICs, and platforms that need it have to use the 8259 driver.
+
+  @param[in]  This       Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Mode       16-bit real or 32-bit protected mode.
+  @param[in]  Mask       The value with which to set the interrupt mask.
+  @param[in]  EdgeLevel  The value with which to set the edge/level mask.
+
+  @retval  EFI_SUCCESS            The mode was set successfully.
+  @retval  EFI_INVALID_PARAMETER  The mode was not set.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicSetMode (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_MODE             Mode,
+  IN UINT16                    *Mask  OPTIONAL,
+  IN UINT16                    *EdgeLevel OPTIONAL
+  )
+{
+  if (Mode != Efi8259ProtectedMode) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Translates the IRQ into a vector.
+
+  @param[in]   This    Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]   Irq     IRQ0-IRQ15.
+  @param[out]  Vector  The vector that is assigned to the IRQ.
+
+  @retval  EFI_SUCCESS            The Vector that matches Irq was returned.
+  @retval  EFI_INVALID_PARAMETER  Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicGetVector (
+  IN  EFI_LEGACY_8259_PROTOCOL  *This,
+  IN  EFI_8259_IRQ              Irq,
+  OUT UINT8                     *Vector
+  )
+{
+  if ((UINT32)Irq > Efi8259Irq15) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Irq <= Efi8259Irq7) {
+    *Vector = (UINT8)(mMasterBase + Irq);
+  } else {
+    *Vector = (UINT8)(mSlaveBase + (Irq - Efi8259Irq8));
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Enables the specified IRQ.
+
+  @param[in]  This            Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Irq             IRQ0-IRQ15.
+  @param[in]  LevelTriggered  0 = Edge triggered; 1 = Level triggered.
+
+  @retval  EFI_SUCCESS            The Irq was enabled on the I/O APIC.
+  @retval  EFI_INVALID_PARAMETER  The Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicEnableIrq (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_IRQ              Irq,
+  IN BOOLEAN                   LevelTriggered
+  )
+{
+  UINT16  Mask;
+  UINT16  EdgeLevel;
+
+  if ((UINT32)Irq > Efi8259Irq15) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Mask = (UINT16)(mProtectedModeMask & ~(1 << Irq));
+  if (LevelTriggered) {
+    EdgeLevel = (UINT16)(mProtectedModeEdgeLevel | (1 << Irq));
+  } else {
+    EdgeLevel = (UINT16)(mProtectedModeEdgeLevel & ~(1 << Irq));
+  }
+
+  //
+  // The timer driver enables IRQ0 again on every period change; leave the
+  // redirection entry alone if nothing changes.
+  //
+  if ((Mask == mProtectedModeMask) && (EdgeLevel == mProtectedModeEdgeLevel)) {
+    return EFI_SUCCESS;
+  }
+
+  mProtectedModeMask      = Mask;
+  mProtectedModeEdgeLevel = EdgeLevel;
+  InterruptIoApicProgramIrq (Irq);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Disables the specified IRQ.
+
+  @param[in]  This  Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Irq   IRQ0-IRQ15.
+
+  @retval  EFI_SUCCESS            The Irq was disabled on the I/O APIC.
+  @retval  EFI_INVALID_PARAMETER  The Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicDisableIrq (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_IRQ              Irq
+  )
+{
+  if ((UINT32)Irq > Efi8259Irq15) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  mProtectedModeMask = (UINT16)(mProtectedModeMask | (1 << Irq));
+
+  mProtectedModeEdgeLevel = (UINT16)(mProtectedModeEdgeLevel & ~(1 << Irq));
+
+  InterruptIoApicProgramIrq (Irq);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads the PCI configuration space to get the interrupt number that is assigned to the card.
+
+  @param[in]   This       Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]   PciHandle  PCI function for which to return the vector.
+  @param[out]  Vector     IRQ number that corresponds to the interrupt line.
+
+  @retval  EFI_SUCCESS  The interrupt line value was read successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicGetInterruptLine (
+  IN  EFI_LEGACY_8259_PROTOCOL  *This,
+  IN  EFI_HANDLE                PciHandle,
+  OUT UINT8                     *Vector
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT8                InterruptLine;
+  EFI_STATUS           Status;
+
+  Status = gBS->HandleProtocol (
+                  PciHandle,
+                  &gEfiPciIoProtocolGuid,
+                  (VOID **)&PciIo
+                  );
+  if (EFI_ERROR (Status)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  PciIo->Pci.Read (
+               PciIo,
+               EfiPciIoWidthUint8,
+               PCI_INT_LINE_OFFSET,
+               1,
+               &InterruptLine
+               );
+  //
+  // Interrupt line is same location for standard PCI cards, standard
+  // bridge and CardBus bridge.
+  //
+  *Vector = InterruptLine;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Issues the End of Interrupt (EOI) command to the local APIC.
+
+  Level triggered entries are deasserted by the EOI broadcast that the local
+  APIC sends to the I/O APIC, so no I/O APIC access is needed here.
+
+  @param[in]  This  Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Irq   The interrupt for which to issue the EOI command.
+
+  @retval  EFI_SUCCESS            The EOI command was issued.
+  @retval  EFI_INVALID_PARAMETER  The Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicEndOfInterrupt (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_IRQ              Irq
+  )
+{
+  if ((UINT32)Irq > Efi8259Irq15) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SendApicEoi ();
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Driver Entry point.
+
+  @param[in]  ImageHandle  ImageHandle of the loaded driver.
+  @param[in]  SystemTable  Pointer to the EFI System Table.
+
+  @retval  EFI_SUCCESS  One or more of the drivers returned a success code.
+  @retval  !EFI_SUCCESS  Error installing Legacy 8259 Protocol.
+
+**/
+EFI_STATUS
+EFIAPI
+InstallIoApic (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_8259_IRQ  Irq;
+
+  //
+  // Mask the 8259 PICs for good; the local APIC keeps LINT0 in virtual wire
+  // mode, which then never delivers anything.
+  //
+  IoWrite8 (LEGACY_8259_MASK_REGISTER_MASTER, 0xff);
+  IoWrite8 (LEGACY_8259_MASK_REGISTER_SLAVE, 0xff);
+
+  //
+  // Set all ISA interrupts to edge triggered and disabled
+  //
+  for (Irq = Efi8259Irq0; Irq <= Efi8259Irq15; Irq++) {
+    InterruptIoApicProgramIrq (Irq);
+  }
+
+  InitializeLocalApicSoftwareEnable (TRUE);
+  InterruptIoApicEnableX2Apic ();
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: ISA IRQs routed through the I/O APIC, local APIC in %a mode\n",
+    __FUNCTION__,
+    GetApicMode () == LOCAL_APIC_MODE_X2APIC ? "x2APIC" : "xAPIC"
+    ));
+
+  //
+  // Install Legacy 8259 Protocol onto a new handle
+  //
+  return gBS->InstallProtocolInterface (
+                &mIoApicHandle,
+                &gEfiLegacy8259ProtocolGuid,
+                EFI_NATIVE_INTERFACE,
+                &mInterruptIoApic
+                );
+}
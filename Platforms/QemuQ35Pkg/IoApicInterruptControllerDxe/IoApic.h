@@ -0,0 +1,226 @@
+/** @file
+  Driver implementing the Tiano Legacy 8259 Protocol with the I/O APIC and the
+  local APIC.
+
+  On Q35 every access to the 8259 PICs is a trapped port I/O write, and the
+  8254 timer driver issues an EOI to the PIC on every tick. Routing the ISA
+  IRQs through the I/O APIC instead leaves the per-interrupt work to a local
+  APIC EOI, which is a WRMSR in x2APIC mode that KVM does not have to exit
+  for when APIC virtualization is available.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _IO_APIC_INTERRUPT_CONTROLLER_H_
+#define _IO_APIC_INTERRUPT_CONTROLLER_H_
+
+#include <Protocol/Legacy8259.h>
+#include <Protocol/MpService.h>
+#include <Protocol/PciIo.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoApicLib.h>
+#include <Library/IoLib.h>
+#include <Library/BaseLib.h>
+#include <Library/LocalApicLib.h>
+#include <IndustryStandard/Pci.h>
+#include <Register/Intel/Cpuid.h>
+#include <Register/IoApic.h>
+
+//
+// Vector bases, the same as the ones the 8259 driver uses in protected mode.
+//
+#define PROTECTED_MODE_BASE_VECTOR_MASTER  0x68
+#define PROTECTED_MODE_BASE_VECTOR_SLAVE   0x70
+
+//
+// 8259 hardware definitions, used to mask the PICs.
+//
+#define LEGACY_8259_MASK_REGISTER_MASTER  0x21
+#define LEGACY_8259_MASK_REGISTER_SLAVE   0xA1
+
+//
+// QEMU's MADT carries an interrupt source override that connects ISA IRQ0 to
+// I/O APIC pin 2; the other ISA IRQs are identity mapped.
+//
+#define IO_APIC_ISA_IRQ0_PIN  2
+
+//
+// Protocol Function Prototypes
+//
+
+/**
+  Sets the vector bases for IRQ0-IRQ7 and IRQ8-IRQ15.
+
+  @param[in]  This        Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  MasterBase  Interrupt vectors for IRQ0-IRQ7.
+  @param[in]  SlaveBase   Interrupt vectors for IRQ8-IRQ15.
+
+  @retval  EFI_SUCCESS  The I/O APIC was programmed successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicSetVectorBase (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN UINT8                     MasterBase,
+  IN UINT8                     SlaveBase
+  );
+
+/**
+  Gets the current 16-bit real mode and 32-bit protected-mode IRQ masks.
+
+  @param[in]   This                Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[out]  LegacyMask          16-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[out]  LegacyEdgeLevel     16-bit mode edge/level mask for IRQ-IRQ15.
+  @param[out]  ProtectedMask       32-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[out]  ProtectedEdgeLevel  32-bit mode edge/level mask for IRQ0-IRQ15.
+
+  @retval  EFI_SUCCESS  The masks were returned.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicGetMask (
+  IN  EFI_LEGACY_8259_PROTOCOL  *This,
+  OUT UINT16                    *LegacyMask  OPTIONAL,
+  OUT UINT16                    *LegacyEdgeLevel  OPTIONAL,
+  OUT UINT16                    *ProtectedMask  OPTIONAL,
+  OUT UINT16                    *ProtectedEdgeLevel OPTIONAL
+  );
+
+/**
+  Sets the current 16-bit real mode and 32-bit protected-mode IRQ masks.
+
+  @param[in]  This                Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  LegacyMask          16-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[in]  LegacyEdgeLevel     16-bit mode edge/level mask for IRQ-IRQ15.
+  @param[in]  ProtectedMask       32-bit mode interrupt mask for IRQ0-IRQ15.
+  @param[in]  ProtectedEdgeLevel  32-bit mode edge/level mask for IRQ0-IRQ15.
+
+  @retval  EFI_SUCCESS  The masks were saved.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicSetMask (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN UINT16                    *LegacyMask  OPTIONAL,
+  IN UINT16                    *LegacyEdgeLevel  OPTIONAL,
+  IN UINT16                    *ProtectedMask  OPTIONAL,
+  IN UINT16                    *ProtectedEdgeLevel OPTIONAL
+  );
+
+/**
+  Sets the mode of the interrupt controller.
+
+  @param[in]  This       Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Mode       16-bit real or 32-bit protected mode.
+  @param[in]  Mask       The value with which to set the interrupt mask.
+  @param[in]  EdgeLevel  The value with which to set the edge/level mask.
+
+  @retval  EFI_SUCCESS            The mode was set successfully.
+  @retval  EFI_INVALID_PARAMETER  The mode was not set.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicSetMode (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_MODE             Mode,
+  IN UINT16                    *Mask  OPTIONAL,
+  IN UINT16                    *EdgeLevel OPTIONAL
+  );
+
+/**
+  Translates the IRQ into a vector.
+
+  @param[in]   This    Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]   Irq     IRQ0-IRQ15.
+  @param[out]  Vector  The vector that is assigned to the IRQ.
+
+  @retval  EFI_SUCCESS            The Vector that matches Irq was returned.
+  @retval  EFI_INVALID_PARAMETER  Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicGetVector (
+  IN  EFI_LEGACY_8259_PROTOCOL  *This,
+  IN  EFI_8259_IRQ              Irq,
+  OUT UINT8                     *Vector
+  );
+
+/**
+  Enables the specified IRQ.
+
+  @param[in]  This            Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Irq             IRQ0-IRQ15.
+  @param[in]  LevelTriggered  0 = Edge triggered; 1 = Level triggered.
+
+  @retval  EFI_SUCCESS            The Irq was enabled on the I/O APIC.
+  @retval  EFI_INVALID_PARAMETER  The Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicEnableIrq (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_IRQ              Irq,
+  IN BOOLEAN                   LevelTriggered
+  );
+
+/**
+  Disables the specified IRQ.
+
+  @param[in]  This  Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Irq   IRQ0-IRQ15.
+
+  @retval  EFI_SUCCESS            The Irq was disabled on the I/O APIC.
+  @retval  EFI_INVALID_PARAMETER  The Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicDisableIrq (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_IRQ              Irq
+  );
+
+/**
+  Reads the PCI configuration space to get the interrupt number that is assigned to the card.
+
+  @param[in]   This       Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]   PciHandle  PCI function for which to return the vector.
+  @param[out]  Vector     IRQ number that corresponds to the interrupt line.
+
+  @retval  EFI_SUCCESS  The interrupt line value was read successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicGetInterruptLine (
+  IN  EFI_LEGACY_8259_PROTOCOL  *This,
+  IN  EFI_HANDLE                PciHandle,
+  OUT UINT8                     *Vector
+  );
+
+/**
+  Issues the End of Interrupt (EOI) command to the local APIC.
+
+  @param[in]  This  Indicates the EFI_LEGACY_8259_PROTOCOL instance.
+  @param[in]  Irq   The interrupt for which to issue the EOI command.
+
+  @retval  EFI_SUCCESS            The EOI command was issued.
+  @retval  EFI_INVALID_PARAMETER  The Irq is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+InterruptIoApicEndOfInterrupt (
+  IN EFI_LEGACY_8259_PROTOCOL  *This,
+  IN EFI_8259_IRQ              Irq
+  );
+
+#endif
@@ -314,56 +314,20 @@ Failed:
 }
 
 /**
-  Completes the Map() operation and releases any corresponding resources.
-
-  This is an internal worker function that only extends the Map() API with
-  the MemoryMapLocked parameter.
-
-  @param  This                  The protocol instance pointer.
-  @param  Mapping               The mapping value returned from Map().
-  @param  MemoryMapLocked       The function is executing on the stack of
-                                gBS->ExitBootServices(); changes to the UEFI
-                                memory map are forbidden.
+  First step of tearing down a mapping: save the data that the bus master may
+  have produced in the plaintext area, before the area is re-encrypted.
 
-  @retval EFI_SUCCESS           The range was unmapped.
-  @retval EFI_INVALID_PARAMETER Mapping is not a value that was returned by
-                                Map().
-  @retval EFI_DEVICE_ERROR      The data was not committed to the target system
-                                memory.
+  @param  MapInfo               The mapping to tear down.
 **/
 STATIC
-EFI_STATUS
-EFIAPI
-IoMmuUnmapWorker (
-  IN  EDKII_IOMMU_PROTOCOL  *This,
-  IN  VOID                  *Mapping,
-  IN  BOOLEAN               MemoryMapLocked
+VOID
+UnmapSavePlainText (
+  IN MAP_INFO  *MapInfo
   )
 {
-  MAP_INFO              *MapInfo;
-  EFI_STATUS            Status;
   COMMON_BUFFER_HEADER  *CommonBufferHeader;
   VOID                  *EncryptionTarget;
 
-  DEBUG ((
-    DEBUG_VERBOSE,
-    "%a: Mapping=0x%p MemoryMapLocked=%d\n",
-    __FUNCTION__,
-    Mapping,
-    MemoryMapLocked
-    ));
-
-  if (Mapping == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  MapInfo = (MAP_INFO *)Mapping;
-
-  //
-  // set CommonBufferHeader to suppress incorrect compiler/analyzer warnings
-  //
-  CommonBufferHeader = NULL;
-
   //
   // For BusMasterWrite[64] operations and BusMasterCommonBuffer[64] operations
   // we have to encrypt the results, ultimately to the original place (i.e.,
@@ -403,20 +367,53 @@ IoMmuUnmapWorker (
       //
       break;
   }
+}
+
+/**
+  Restore the memory encryption mask on a range of pages that held plaintext.
+  Failure is fatal, as the range would otherwise remain shared with the
+  hypervisor.
+
+  @param  PlainTextAddress      The first page of the range.
+  @param  NumberOfPages         The number of pages in the range.
+**/
+STATIC
+VOID
+UnmapEncryptPages (
+  IN EFI_PHYSICAL_ADDRESS  PlainTextAddress,
+  IN UINTN                 NumberOfPages
+  )
+{
+  EFI_STATUS  Status;
 
-  //
-  // Restore the memory encryption mask on the area we used to hold the
-  // plaintext.
-  //
   Status = MemEncryptSevSetPageEncMask (
              0,
-             MapInfo->PlainTextAddress,
-             MapInfo->NumberOfPages
+             PlainTextAddress,
+             NumberOfPages
              );
   ASSERT_EFI_ERROR (Status);
   if (EFI_ERROR (Status)) {
     CpuDeadLoop ();
   }
+}
+
+/**
+  Last step of tearing down a mapping, once the plaintext area has been
+  re-encrypted: restore or scrub the data, and forget the mapping.
+
+  @param  MapInfo               The mapping to tear down.
+  @param  MemoryMapLocked       The function is executing on the stack of
+                                gBS->ExitBootServices(); changes to the UEFI
+                                memory map are forbidden.
+**/
+STATIC
+VOID
+UnmapRestoreAndRelease (
+  IN MAP_INFO  *MapInfo,
+  IN BOOLEAN   MemoryMapLocked
+  )
+{
+  COMMON_BUFFER_HEADER  *CommonBufferHeader;
 
   //
   // For BusMasterCommonBuffer[64] operations, copy the stashed data to the
@@ -429,6 +426,9 @@ IoMmuUnmapWorker (
   if ((MapInfo->Operation == EdkiiIoMmuOperationBusMasterCommonBuffer) ||
       (MapInfo->Operation == EdkiiIoMmuOperationBusMasterCommonBuffer64))
   {
+    CommonBufferHeader = (COMMON_BUFFER_HEADER *)(
+                                                  (UINTN)MapInfo->PlainTextAddress - EFI_PAGE_SIZE
+                                                  );
     CopyMem (
       (VOID *)(UINTN)MapInfo->CryptedAddress,
       CommonBufferHeader->StashBuffer,
@@ -452,7 +452,60 @@ IoMmuUnmapWorker (
   if (!MemoryMapLocked) {
     FreePool (MapInfo);
   }
+}
+
+/**
+  Completes the Map() operation and releases any corresponding resources.
+
+  This is an internal worker function that only extends the Map() API with
+  the MemoryMapLocked parameter.
 
+  @param  This                  The protocol instance pointer.
+  @param  Mapping               The mapping value returned from Map().
+  @param  MemoryMapLocked       The function is executing on the stack of
+                                gBS->ExitBootServices(); changes to the UEFI
+                                memory map are forbidden.
+
+  @retval EFI_SUCCESS           The range was unmapped.
+  @retval EFI_INVALID_PARAMETER Mapping is not a value that was returned by
+                                Map().
+  @retval EFI_DEVICE_ERROR      The data was not committed to the target system
+                                memory.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+IoMmuUnmapWorker (
+  IN  EDKII_IOMMU_PROTOCOL  *This,
+  IN  VOID                  *Mapping,
+  IN  BOOLEAN               MemoryMapLocked
+  )
+{
+  MAP_INFO  *MapInfo;
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "%a: Mapping=0x%p MemoryMapLocked=%d\n",
+    __FUNCTION__,
+    Mapping,
+    MemoryMapLocked
+    ));
+
+  if (Mapping == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  MapInfo = (MAP_INFO *)Mapping;
+
+  UnmapSavePlainText (MapInfo);
+
+  //
+  // Restore the memory encryption mask on the area we used to hold the
+  // plaintext.
+  //
+  UnmapEncryptPages (MapInfo->PlainTextAddress, MapInfo->NumberOfPages);
+
+  UnmapRestoreAndRelease (MapInfo, MemoryMapLocked);
   return EFI_SUCCESS;
 }
 
@@ -828,25 +881,131 @@ AmdSevUnmapAllMappings (
   IN VOID       *Context
   )
 {
-  LIST_ENTRY  *Node;
-  LIST_ENTRY  *NextNode;
-  MAP_INFO    *MapInfo;
+  LIST_ENTRY            Sorted;
+  LIST_ENTRY            *Node;
+  LIST_ENTRY            *NextNode;
+  LIST_ENTRY            *Position;
+  MAP_INFO              *MapInfo;
+  MAP_INFO              *Neighbor;
+  EFI_PHYSICAL_ADDRESS  RunStart;
+  EFI_PHYSICAL_ADDRESS  RunEnd;
+  EFI_PHYSICAL_ADDRESS  MapEnd;
+  UINTN                 MappingCount;
+  UINTN                 RangeCount;
+  UINT64                StartTick;
+  UINT64                EndTick;
 
   DEBUG ((DEBUG_VERBOSE, "%a\n", __FUNCTION__));
 
+  if (IsListEmpty (&mMapInfos)) {
+    return;
+  }
+
+  StartTick = GetPerformanceCounter ();
+
   //
   // All drivers that had set up IOMMU mappings have halted their respective
   // controllers by now; tear down the mappings.
   //
+  // Re-encrypting each mapping separately would walk the page tables and
+  // flush the TLB once per mapping. Instead, order the mappings by plaintext
+  // address (moving the nodes, as the UEFI memory map is locked), and
+  // re-encrypt every run of adjacent plaintext areas in one call.
+  //
+  InitializeListHead (&Sorted);
+  while (!IsListEmpty (&mMapInfos)) {
+    Node    = GetFirstNode (&mMapInfos);
+    MapInfo = CR (Node, MAP_INFO, Link, MAP_INFO_SIG);
+    RemoveEntryList (Node);
+
+    for (Position = GetFirstNode (&Sorted);
+         Position != &Sorted;
+         Position = GetNextNode (&Sorted, Position))
+    {
+      Neighbor = CR (Position, MAP_INFO, Link, MAP_INFO_SIG);
+      if (Neighbor->PlainTextAddress > MapInfo->PlainTextAddress) {
+        break;
+      }
+    }
+
+    //
+    // Inserting at the tail of the list rooted at Position places the node
+    // immediately before Position.
+    //
+    InsertTailList (Position, Node);
+  }
+
+  //
+  // Move the sorted list back under mMapInfos, which UnmapRestoreAndRelease()
+  // removes the nodes from.
+  //
+  InsertTailList (&Sorted, &mMapInfos);
+  RemoveEntryList (&Sorted);
+
+  //
+  // Capture the data produced by the bus masters while every plaintext area
+  // is still decrypted.
+  //
+  MappingCount = 0;
+  for (Node = GetFirstNode (&mMapInfos);
+       Node != &mMapInfos;
+       Node = GetNextNode (&mMapInfos, Node))
+  {
+    MapInfo = CR (Node, MAP_INFO, Link, MAP_INFO_SIG);
+    UnmapSavePlainText (MapInfo);
+    MappingCount++;
+  }
+
+  //
+  // Re-encrypt the plaintext areas, coalescing adjacent (or overlapping)
+  // ones.
+  //
+  RangeCount = 0;
+  RunStart   = 0;
+  RunEnd     = 0;
+  for (Node = GetFirstNode (&mMapInfos);
+       Node != &mMapInfos;
+       Node = GetNextNode (&mMapInfos, Node))
+  {
+    MapInfo = CR (Node, MAP_INFO, Link, MAP_INFO_SIG);
+    MapEnd  = MapInfo->PlainTextAddress +
+              EFI_PAGES_TO_SIZE (MapInfo->NumberOfPages);
+
+    if ((RunEnd != RunStart) && (MapInfo->PlainTextAddress <= RunEnd)) {
+      RunEnd = MAX (RunEnd, MapEnd);
+      continue;
+    }
+
+    if (RunEnd != RunStart) {
+      UnmapEncryptPages (RunStart, EFI_SIZE_TO_PAGES (RunEnd - RunStart));
+      RangeCount++;
+    }
+
+    RunStart = MapInfo->PlainTextAddress;
+    RunEnd   = MapEnd;
+  }
+
+  UnmapEncryptPages (RunStart, EFI_SIZE_TO_PAGES (RunEnd - RunStart));
+  RangeCount++;
+
   for (Node = GetFirstNode (&mMapInfos); Node != &mMapInfos; Node = NextNode) {
     NextNode = GetNextNode (&mMapInfos, Node);
     MapInfo  = CR (Node, MAP_INFO, Link, MAP_INFO_SIG);
-    IoMmuUnmapWorker (
-      &mAmdSev, // This
-      MapInfo,  // Mapping
-      TRUE      // MemoryMapLocked
+    UnmapRestoreAndRelease (
+      MapInfo,
+      TRUE // MemoryMapLocked
       );
   }
+
+  EndTick = GetPerformanceCounter ();
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: unmapped %Lu mappings in %Lu ranges in %Lu us\n",
+    __FUNCTION__,
+    (UINT64)MappingCount,
+    (UINT64)RangeCount,
+    DivU64x32 (GetTimeInNanoSecond (EndTick - StartTick), 1000)
+    ));
 }
 
 /**
@@ -0,0 +1,90 @@
+/** @file LazyMemoryDxe.c
+    DXE driver that hands the untested system memory to the OS
+
+    PlatformPei publishes the RAM beyond the boot working set without the
+    TESTED resource attribute. The DXE core keeps such memory out of the UEFI
+    memory map until an allocation needs it, which keeps the cost of tracking
+    and zeroing it out of the boot path. An OS however sees untested memory as
+    reserved, so all of it is promoted to conventional memory at ReadyToBoot,
+    through the generic memory test protocol.
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Uefi.h>
+#include <Library/UefiLib.h>
+#include <Library/DebugLib.h>
+#include <Library/UefiDriverEntryPoint.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/GenericMemoryTest.h>
+
+/**
+  Promote all untested system memory to conventional memory.
+
+  @param[in] Event    The ReadyToBoot event.
+  @param[in] Context  Unused.
+**/
+STATIC
+VOID
+EFIAPI
+PromoteUntestedMemory (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_STATUS                        Status;
+  EFI_GENERIC_MEMORY_TEST_PROTOCOL  *MemoryTest;
+  BOOLEAN                           RequireSoftEccInit;
+
+  gBS->CloseEvent (Event);
+
+  Status = gBS->LocateProtocol (
+                  &gEfiGenericMemTestProtocolGuid,
+                  NULL,
+                  (VOID **)&MemoryTest
+                  );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: no memory test protocol, untested memory stays reserved: %r\n",
+      __FUNCTION__,
+      Status
+      ));
+    return;
+  }
+
+  //
+  // The memory is not touched; the implementation merely re-adds the untested
+  // GCD ranges as tested system memory, which places them in the UEFI memory
+  // map as conventional memory.
+  //
+  Status = MemoryTest->MemoryTestInit (MemoryTest, IGNORE, &RequireSoftEccInit);
+  DEBUG ((DEBUG_INFO, "%a: %r\n", __FUNCTION__, Status));
+}
+
+/**
+  Entry point of LazyMemoryDxe.
+
+  @param[in] ImageHandle  The image handle of this driver.
+  @param[in] SystemTable  A pointer to the EFI system table.
+
+  @retval EFI_SUCCESS  The ReadyToBoot callback has been registered.
+  @return              Error codes from EfiCreateEventReadyToBootEx().
+**/
+EFI_STATUS
+EFIAPI
+LazyMemoryDxeEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_EVENT  Event;
+
+  return EfiCreateEventReadyToBootEx (
+           TPL_CALLBACK,
+           PromoteUntestedMemory,
+           NULL,
+           &Event
+           );
+}
@@ -0,0 +1,107 @@
+/** @file
+  Advanced Logger hardware port instance for the DXE core that hands log
+  output to a virtio-console log sink once VirtioConsoleDxe has started one.
+
+  Until then, and once the sink stops accepting data at ExitBootServices(),
+  output goes to the serial port as with the default instance.
+
+  The sink is found by scanning the system configuration table, which needs
+  no locks; the DXE core logs at arbitrary TPLs and with the protocol database
+  lock held, where protocols cannot be looked up. The table is scanned on
+  every write rather than cached: the driver withdraws the entry before it
+  frees the sink on Stop(), and a sink started later replaces it.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include <Protocol/VirtioConsoleLog.h>
+
+#include <Library/AdvancedLoggerHdwPortLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/PcdLib.h>
+#include <Library/SerialPortLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+/**
+  Find the virtio-console log sink, if one has been published.
+
+  @return  The log sink, or NULL.
+**/
+STATIC
+QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL *
+GetVirtioConsoleLog (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  //
+  // gST is only set once the DXE core has run the library constructors.
+  //
+  if (gST == NULL) {
+    return NULL;
+  }
+
+  for (Index = 0; Index < gST->NumberOfTableEntries; Index++) {
+    if (CompareGuid (&gST->ConfigurationTable[Index].VendorGuid, &gQemuVirtioConsoleLogProtocolGuid)) {
+      return gST->ConfigurationTable[Index].VendorTable;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Initialize the hardware port.
+
+  @return  The status of the serial port initialization.
+**/
+EFI_STATUS
+EFIAPI
+AdvancedLoggerHdwPortInitialize (
+  VOID
+  )
+{
+  return SerialPortInitialize ();
+}
+
+/**
+  Write data to the virtio-console log sink, or to the serial port.
+
+  @param[in] DebugLevel     The debug level of the message.
+  @param[in] Buffer         The message data.
+  @param[in] NumberOfBytes  The number of bytes in Buffer.
+
+  @return  The number of bytes written.
+**/
+UINTN
+EFIAPI
+AdvancedLoggerHdwPortWrite (
+  IN UINTN  DebugLevel,
+  IN UINT8  *Buffer,
+  IN UINTN  NumberOfBytes
+  )
+{
+  QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL  *Log;
+  UINTN                             Written;
+
+  if ((DebugLevel & PcdGet32 (PcdAdvancedLoggerHdwPortDebugPrintErrorLevel)) == 0) {
+    return NumberOfBytes;
+  }
+
+  Written = 0;
+  Log     = GetVirtioConsoleLog ();
+  if (Log != NULL) {
+    Written = Log->Write (Log, Buffer, NumberOfBytes);
+  }
+
+  if (Written < NumberOfBytes) {
+    Written += SerialPortWrite (Buffer + Written, NumberOfBytes - Written);
+  }
+
+  return Written;
+}
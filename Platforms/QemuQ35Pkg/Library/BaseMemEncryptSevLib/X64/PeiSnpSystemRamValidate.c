@@ -10,6 +10,7 @@
 
 #include <Uefi/UefiBaseType.h>
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/PcdLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemEncryptSevLib.h>
@@ -17,12 +18,7 @@
 #include "SnpPageStateChange.h"
 #include "VirtualMemory.h"
 
-typedef struct {
-  UINT64    StartAddress;
-  UINT64    EndAddress;
-} SNP_PRE_VALIDATED_RANGE;
-
-STATIC SNP_PRE_VALIDATED_RANGE  mPreValidatedRange[] = {
+STATIC SNP_PAGE_STATE_RANGE  mPreValidatedRange[] = {
   // The below address range was part of the SEV OVMF metadata, and range
   // should be pre-validated by the Hypervisor.
   {
@@ -39,9 +35,9 @@ STATIC SNP_PRE_VALIDATED_RANGE  mPreValidatedRange[] = {
 STATIC
 BOOLEAN
 DetectPreValidatedOverLap (
-  IN    PHYSICAL_ADDRESS         StartAddress,
-  IN    PHYSICAL_ADDRESS         EndAddress,
-  OUT   SNP_PRE_VALIDATED_RANGE  *OverlapRange
+  IN    PHYSICAL_ADDRESS      StartAddress,
+  IN    PHYSICAL_ADDRESS      EndAddress,
+  OUT   SNP_PAGE_STATE_RANGE  *OverlapRange
   )
 {
   UINTN  i;
@@ -76,9 +72,12 @@ MemEncryptSevSnpPreValidateSystemRam (
   IN UINTN             NumPages
   )
 {
-  PHYSICAL_ADDRESS         EndAddress;
-  SNP_PRE_VALIDATED_RANGE  OverlapRange;
-  EFI_STATUS               Status;
+  PHYSICAL_ADDRESS      EndAddress;
+  SNP_PAGE_STATE_RANGE  OverlapRange;
+  SNP_PAGE_STATE_RANGE  Ranges[ARRAY_SIZE (mPreValidatedRange) + 1];
+  UINTN                 RangeCount;
+  SNP_PAGE_STATE_STATS  Stats;
+  EFI_STATUS            Status;
 
   if (!MemEncryptSevSnpIsEnabled ()) {
     return;
@@ -104,6 +103,11 @@ MemEncryptSevSnpPreValidateSystemRam (
     }
   }
 
+  //
+  // Collect the parts of the range that are not pre-validated, and validate
+  // them in one batch, so that they share page state change requests.
+  //
+  RangeCount = 0;
   while (BaseAddress < EndAddress) {
     //
     // Check if the range overlaps with the pre-validated ranges.
@@ -111,9 +115,10 @@ MemEncryptSevSnpPreValidateSystemRam (
     if (DetectPreValidatedOverLap (BaseAddress, EndAddress, &OverlapRange)) {
       // Validate the non-overlap regions.
       if (BaseAddress < OverlapRange.StartAddress) {
-        NumPages = EFI_SIZE_TO_PAGES (OverlapRange.StartAddress - BaseAddress);
-
-        InternalSetPageState (BaseAddress, NumPages, SevSnpPagePrivate, TRUE);
+        ASSERT (RangeCount < ARRAY_SIZE (Ranges));
+        Ranges[RangeCount].StartAddress = BaseAddress;
+        Ranges[RangeCount].EndAddress   = OverlapRange.StartAddress;
+        RangeCount++;
       }
 
       BaseAddress = OverlapRange.EndAddress;
@@ -121,8 +126,14 @@ MemEncryptSevSnpPreValidateSystemRam (
     }
 
     // Validate the remaining pages.
-    NumPages = EFI_SIZE_TO_PAGES (EndAddress - BaseAddress);
-    InternalSetPageState (BaseAddress, NumPages, SevSnpPagePrivate, TRUE);
+    ASSERT (RangeCount < ARRAY_SIZE (Ranges));
+    Ranges[RangeCount].StartAddress = BaseAddress;
+    Ranges[RangeCount].EndAddress   = EndAddress;
+    RangeCount++;
     BaseAddress = EndAddress;
   }
+
+  ZeroMem (&Stats, sizeof (Stats));
+  InternalSetPageStateRanges (Ranges, RangeCount, SevSnpPagePrivate, TRUE, &Stats);
+  InternalLogPageStateStats (__FUNCTION__, &Stats);
 }
@@ -10,6 +10,7 @@
 
 #include <Uefi/UefiBaseType.h>
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/MemEncryptSevLib.h>
 
 #include "SnpPageStateChange.h"
@@ -65,6 +66,9 @@ MemEncryptSevSnpPreValidateSystemRam (
   IN UINTN             NumPages
   )
 {
+  SNP_PAGE_STATE_RANGE  Range;
+  SNP_PAGE_STATE_STATS  Stats;
+
   if (!MemEncryptSevSnpIsEnabled ()) {
     return;
   }
@@ -78,5 +82,10 @@ MemEncryptSevSnpPreValidateSystemRam (
     SnpPageStateFailureTerminate ();
   }
 
-  InternalSetPageState (BaseAddress, NumPages, SevSnpPagePrivate, TRUE);
+  Range.StartAddress = BaseAddress;
+  Range.EndAddress   = BaseAddress + EFI_PAGES_TO_SIZE (NumPages);
+
+  ZeroMem (&Stats, sizeof (Stats));
+  InternalSetPageStateRanges (&Range, 1, SevSnpPagePrivate, TRUE, &Stats);
+  InternalLogPageStateStats (__FUNCTION__, &Stats);
 }
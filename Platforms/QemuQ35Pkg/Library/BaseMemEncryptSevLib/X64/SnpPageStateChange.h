@@ -19,6 +19,25 @@ typedef enum {
   SevSnpPageShared,
 } SEV_SNP_PAGE_STATE;
 
+//
+// A range of guest physical addresses, [StartAddress, EndAddress).
+//
+typedef struct {
+  EFI_PHYSICAL_ADDRESS    StartAddress;
+  EFI_PHYSICAL_ADDRESS    EndAddress;
+} SNP_PAGE_STATE_RANGE;
+
+//
+// Work done by InternalSetPageStateRanges(), accumulated across calls.
+//
+typedef struct {
+  UINT64    Pages;        // 4KB pages whose state was changed
+  UINTN     VmgExits;     // page state change requests sent to the hypervisor
+  UINTN     LargeEntries; // 2MB entries
+  UINTN     SmallEntries; // 4KB entries
+  UINTN     LargeRetries; // 2MB entries validated as 512 4KB pages (RMP size mismatch)
+} SNP_PAGE_STATE_STATS;
+
 VOID
 InternalSetPageState (
   IN EFI_PHYSICAL_ADDRESS  BaseAddress,
@@ -27,6 +46,21 @@ InternalSetPageState (
   IN BOOLEAN               UseLargeEntry
   );
 
+VOID
+InternalSetPageStateRanges (
+  IN     CONST SNP_PAGE_STATE_RANGE  *Ranges,
+  IN     UINTN                       RangeCount,
+  IN     SEV_SNP_PAGE_STATE          State,
+  IN     BOOLEAN                     UseLargeEntry,
+  IN OUT SNP_PAGE_STATE_STATS        *Stats OPTIONAL
+  );
+
+VOID
+InternalLogPageStateStats (
+  IN CONST CHAR8                 *Caller,
+  IN CONST SNP_PAGE_STATE_STATS  *Stats
+  );
+
 VOID
 SnpPageStateFailureTerminate (
   VOID
@@ -72,10 +72,11 @@ SnpPageStateFailureTerminate (
 STATIC
 VOID
 PvalidateRange (
-  IN  SNP_PAGE_STATE_CHANGE_INFO  *Info,
-  IN  UINTN                       StartIndex,
-  IN  UINTN                       EndIndex,
-  IN  BOOLEAN                     Validate
+  IN     SNP_PAGE_STATE_CHANGE_INFO  *Info,
+  IN     UINTN                       StartIndex,
+  IN     UINTN                       EndIndex,
+  IN     BOOLEAN                     Validate,
+  IN OUT SNP_PAGE_STATE_STATS        *Stats OPTIONAL
   )
 {
   UINTN  Address, RmpPageSize, Ret, i;
@@ -95,6 +96,10 @@ PvalidateRange (
     // the RMP entry is 4K and we are validating it as a 2MB.
     //
     if ((Ret == PVALIDATE_RET_SIZE_MISMATCH) && (RmpPageSize == PvalidatePageSize2MB)) {
+      if (Stats != NULL) {
+        Stats->LargeRetries++;
+      }
+
       for (i = 0; i < PAGES_PER_LARGE_ENTRY; i++) {
         Ret = AsmPvalidate (PvalidatePageSize4K, Validate, Address);
         if (Ret) {
@@ -123,60 +128,107 @@ PvalidateRange (
   }
 }
 
+/**
+ Fill the page state change structure with as many entries as it holds, taking
+ them from the ranges in order. Entries of consecutive ranges share the
+ structure, so that small ranges do not cost a VMGEXIT each.
+
+ @param[in]      Ranges         The ranges to change.
+ @param[in]      RangeCount     Number of entries in Ranges.
+ @param[in,out]  RangeIndex     The range to continue from; advanced past the
+                                ranges that have been consumed.
+ @param[in,out]  BaseAddress    The address to continue from, in
+                                Ranges[*RangeIndex].
+ @param[in]      State          The new page state.
+ @param[in]      UseLargeEntry  Use 2MB entries for aligned 2MB chunks.
+ @param[out]     Info           The page state change structure.
+ @param[in,out]  Stats          Optional counters.
+
+ @return  The number of entries filled in.
+ */
 STATIC
-EFI_PHYSICAL_ADDRESS
+UINTN
 BuildPageStateBuffer (
-  IN EFI_PHYSICAL_ADDRESS        BaseAddress,
-  IN EFI_PHYSICAL_ADDRESS        EndAddress,
-  IN SEV_SNP_PAGE_STATE          State,
-  IN BOOLEAN                     UseLargeEntry,
-  IN SNP_PAGE_STATE_CHANGE_INFO  *Info
+  IN     CONST SNP_PAGE_STATE_RANGE  *Ranges,
+  IN     UINTN                       RangeCount,
+  IN OUT UINTN                       *RangeIndex,
+  IN OUT EFI_PHYSICAL_ADDRESS        *BaseAddress,
+  IN     SEV_SNP_PAGE_STATE          State,
+  IN     BOOLEAN                     UseLargeEntry,
+  OUT    SNP_PAGE_STATE_CHANGE_INFO  *Info,
+  IN OUT SNP_PAGE_STATE_STATS        *Stats OPTIONAL
   )
 {
-  EFI_PHYSICAL_ADDRESS  NextAddress;
+  EFI_PHYSICAL_ADDRESS  Address;
+  EFI_PHYSICAL_ADDRESS  EndAddress;
   UINTN                 i, RmpPageSize;
 
   // Clear the page state structure
   SetMem (Info, sizeof (*Info), 0);
 
-  i           = 0;
-  NextAddress = EndAddress;
+  i       = 0;
+  Address = *BaseAddress;
 
   //
   // Populate the page state entry structure
   //
-  while ((BaseAddress < EndAddress) && (i < SNP_PAGE_STATE_MAX_ENTRY)) {
+  while ((*RangeIndex < RangeCount) && (i < SNP_PAGE_STATE_MAX_ENTRY)) {
+    EndAddress = Ranges[*RangeIndex].EndAddress;
+    if (Address >= EndAddress) {
+      (*RangeIndex)++;
+      if (*RangeIndex < RangeCount) {
+        Address = Ranges[*RangeIndex].StartAddress;
+      }
+
+      continue;
+    }
+
     //
     // Is this a 2MB aligned page? Check if we can use the Large RMP entry.
     //
-    if (UseLargeEntry && IS_ALIGNED (BaseAddress, SIZE_2MB) &&
-        ((EndAddress - BaseAddress) >= SIZE_2MB))
+    if (UseLargeEntry && IS_ALIGNED (Address, SIZE_2MB) &&
+        ((EndAddress - Address) >= SIZE_2MB))
     {
       RmpPageSize = PvalidatePageSize2MB;
-      NextAddress = BaseAddress + SIZE_2MB;
     } else {
       RmpPageSize = PvalidatePageSize4K;
-      NextAddress = BaseAddress + EFI_PAGE_SIZE;
     }
 
-    Info->Entry[i].GuestFrameNumber = BaseAddress >> EFI_PAGE_SHIFT;
+    Info->Entry[i].GuestFrameNumber = Address >> EFI_PAGE_SHIFT;
     Info->Entry[i].PageSize         = RmpPageSize;
     Info->Entry[i].Operation        = MemoryStateToGhcbOp (State);
     Info->Entry[i].CurrentPage      = 0;
     Info->Header.EndEntry           = (UINT16)i;
 
-    BaseAddress = NextAddress;
+    if (RmpPageSize == PvalidatePageSize2MB) {
+      Address += SIZE_2MB;
+    } else {
+      Address += EFI_PAGE_SIZE;
+    }
+
+    if (Stats != NULL) {
+      if (RmpPageSize == PvalidatePageSize2MB) {
+        Stats->LargeEntries++;
+        Stats->Pages += PAGES_PER_LARGE_ENTRY;
+      } else {
+        Stats->SmallEntries++;
+        Stats->Pages++;
+      }
+    }
+
     i++;
   }
 
-  return NextAddress;
+  *BaseAddress = Address;
+  return i;
 }
 
 STATIC
 VOID
 PageStateChangeVmgExit (
-  IN GHCB                        *Ghcb,
-  IN SNP_PAGE_STATE_CHANGE_INFO  *Info
+  IN     GHCB                        *Ghcb,
+  IN     SNP_PAGE_STATE_CHANGE_INFO  *Info,
+  IN OUT SNP_PAGE_STATE_STATS        *Stats OPTIONAL
   )
 {
   EFI_STATUS  Status;
@@ -195,6 +247,9 @@ PageStateChangeVmgExit (
     CcExitVmgSetOffsetValid (Ghcb, GhcbSwScratch);
 
     Status = CcExitVmgExit (Ghcb, SVM_EXIT_SNP_PAGE_STATE_CHANGE, 0, 0);
+    if (Stats != NULL) {
+      Stats->VmgExits++;
+    }
 
     //
     // The Page State Change VMGEXIT can pass the failure through the
@@ -211,40 +266,54 @@ PageStateChangeVmgExit (
  transition consist of changing the page ownership in the RMP table, and using the
  PVALIDATE instruction to update the Validated bit in RMP table.
 
+ The ranges are packed into the GHCB shared buffer back to back, so that every
+ page state change VMGEXIT except the last one carries SNP_PAGE_STATE_MAX_ENTRY
+ entries.
+
  When the UseLargeEntry is set to TRUE, then function will try to use the large RMP
  entry (whevever possible).
  */
 VOID
-InternalSetPageState (
-  IN EFI_PHYSICAL_ADDRESS  BaseAddress,
-  IN UINTN                 NumPages,
-  IN SEV_SNP_PAGE_STATE    State,
-  IN BOOLEAN               UseLargeEntry
+InternalSetPageStateRanges (
+  IN     CONST SNP_PAGE_STATE_RANGE  *Ranges,
+  IN     UINTN                       RangeCount,
+  IN     SEV_SNP_PAGE_STATE          State,
+  IN     BOOLEAN                     UseLargeEntry,
+  IN OUT SNP_PAGE_STATE_STATS        *Stats OPTIONAL
   )
 {
   GHCB                        *Ghcb;
-  EFI_PHYSICAL_ADDRESS        NextAddress, EndAddress;
+  EFI_PHYSICAL_ADDRESS        BaseAddress;
   MSR_SEV_ES_GHCB_REGISTER    Msr;
   BOOLEAN                     InterruptState;
   SNP_PAGE_STATE_CHANGE_INFO  *Info;
+  UINTN                       RangeIndex;
+  UINTN                       EntryCount;
+
+  if (RangeCount == 0) {
+    return;
+  }
 
   Msr.GhcbPhysicalAddress = AsmReadMsr64 (MSR_SEV_ES_GHCB);
   Ghcb                    = Msr.Ghcb;
 
-  EndAddress = BaseAddress + EFI_PAGES_TO_SIZE (NumPages);
+  for (RangeIndex = 0; RangeIndex < RangeCount; RangeIndex++) {
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "%a:%a Address 0x%Lx - 0x%Lx State = %a LargeEntry = %d\n",
+      gEfiCallerBaseName,
+      __FUNCTION__,
+      Ranges[RangeIndex].StartAddress,
+      Ranges[RangeIndex].EndAddress,
+      State == SevSnpPageShared ? "Shared" : "Private",
+      UseLargeEntry
+      ));
+  }
 
-  DEBUG ((
-    DEBUG_VERBOSE,
-    "%a:%a Address 0x%Lx - 0x%Lx State = %a LargeEntry = %d\n",
-    gEfiCallerBaseName,
-    __FUNCTION__,
-    BaseAddress,
-    EndAddress,
-    State == SevSnpPageShared ? "Shared" : "Private",
-    UseLargeEntry
-    ));
+  RangeIndex  = 0;
+  BaseAddress = Ranges[0].StartAddress;
 
-  while (BaseAddress < EndAddress) {
+  for ( ; ;) {
     UINTN  CurrentEntry, EndEntry;
 
     //
@@ -255,14 +324,21 @@ InternalSetPageState (
     //
     // Build the page state structure
     //
-    Info        = (SNP_PAGE_STATE_CHANGE_INFO *)Ghcb->SharedBuffer;
-    NextAddress = BuildPageStateBuffer (
-                    BaseAddress,
-                    EndAddress,
-                    State,
-                    UseLargeEntry,
-                    Info
-                    );
+    Info       = (SNP_PAGE_STATE_CHANGE_INFO *)Ghcb->SharedBuffer;
+    EntryCount = BuildPageStateBuffer (
+                   Ranges,
+                   RangeCount,
+                   &RangeIndex,
+                   &BaseAddress,
+                   State,
+                   UseLargeEntry,
+                   Info,
+                   Stats
+                   );
+    if (EntryCount == 0) {
+      CcExitVmgDone (Ghcb, InterruptState);
+      break;
+    }
 
     //
     // Save the current and end entry from the page state structure. We need
@@ -276,24 +352,67 @@ InternalSetPageState (
     // invalidate the pages before making the page shared in the RMP table.
     //
     if (State == SevSnpPageShared) {
-      PvalidateRange (Info, CurrentEntry, EndEntry, FALSE);
+      PvalidateRange (Info, CurrentEntry, EndEntry, FALSE, Stats);
     }
 
     //
     // Invoke the page state change VMGEXIT.
     //
-    PageStateChangeVmgExit (Ghcb, Info);
+    PageStateChangeVmgExit (Ghcb, Info, Stats);
 
     //
     // If the caller requested to change the page state to private then
     // validate the pages after it has been added in the RMP table.
     //
     if (State == SevSnpPagePrivate) {
-      PvalidateRange (Info, CurrentEntry, EndEntry, TRUE);
+      PvalidateRange (Info, CurrentEntry, EndEntry, TRUE, Stats);
     }
 
     CcExitVmgDone (Ghcb, InterruptState);
-
-    BaseAddress = NextAddress;
   }
 }
+
+/**
+ The function is used to set the page state of a single range when SEV-SNP is
+ active. See InternalSetPageStateRanges().
+ */
+VOID
+InternalSetPageState (
+  IN EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN UINTN                 NumPages,
+  IN SEV_SNP_PAGE_STATE    State,
+  IN BOOLEAN               UseLargeEntry
+  )
+{
+  SNP_PAGE_STATE_RANGE  Range;
+
+  Range.StartAddress = BaseAddress;
+  Range.EndAddress   = BaseAddress + EFI_PAGES_TO_SIZE (NumPages);
+
+  InternalSetPageStateRanges (&Range, 1, State, UseLargeEntry, NULL);
+}
+
+/**
+ Log the work done by InternalSetPageStateRanges().
+
+ @param[in]  Caller  Name of the function that requested the page state change.
+ @param[in]  Stats   The counters to log.
+ */
+VOID
+InternalLogPageStateStats (
+  IN CONST CHAR8                 *Caller,
+  IN CONST SNP_PAGE_STATE_STATS  *Stats
+  )
+{
+  DEBUG ((
+    DEBUG_INFO,
+    "%a:%a: %Lu MB in %Lu VMGEXITs, %Lu 2MB and %Lu 4KB entries, %Lu 2MB entries split\n",
+    gEfiCallerBaseName,
+    Caller,
+    RShiftU64 (Stats->Pages, 20 - EFI_PAGE_SHIFT),
+    (UINT64)Stats->VmgExits,
+    (UINT64)Stats->LargeEntries,
+    (UINT64)Stats->SmallEntries,
+    (UINT64)Stats->LargeRetries
+    ));
+}
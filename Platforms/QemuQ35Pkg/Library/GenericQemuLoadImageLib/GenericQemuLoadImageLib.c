@@ -18,6 +18,7 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/LoadedImage.h>
+#include <Protocol/QemuKernelLoaderBlob.h>
 #include <Protocol/SimpleFileSystem.h>
 
 #pragma pack (1)
@@ -139,6 +140,57 @@ CloseFile:
   return Status;
 }
 
+/**
+  Locate the kernel blob that QemuKernelLoaderFsDxe keeps resident after
+  fetching it from fw_cfg.
+
+  Passing that buffer to LoadImage() as SourceBuffer saves the DXE core from
+  reading the whole kernel into yet another buffer through the file system
+  before relocating it.
+
+  @param[out] Data  On success, the resident kernel blob. Owned by
+                    QemuKernelLoaderFsDxe.
+  @param[out] Size  On success, the size of the kernel blob in bytes.
+
+  @retval EFI_SUCCESS  The kernel blob has been located.
+
+  @return              Error codes from LocateDevicePath(), HandleProtocol()
+                       and QEMU_KERNEL_LOADER_BLOB_PROTOCOL.GetBlob().
+**/
+STATIC
+EFI_STATUS
+GetResidentKernelBlob (
+  OUT CONST VOID  **Data,
+  OUT UINTN       *Size
+  )
+{
+  EFI_STATUS                        Status;
+  EFI_DEVICE_PATH_PROTOCOL          *DevicePathNode;
+  EFI_HANDLE                        FsVolumeHandle;
+  QEMU_KERNEL_LOADER_BLOB_PROTOCOL  *KernelLoaderBlob;
+
+  DevicePathNode = (EFI_DEVICE_PATH_PROTOCOL *)&mQemuKernelLoaderFsDevicePath;
+  Status         = gBS->LocateDevicePath (
+                          &gQemuKernelLoaderBlobProtocolGuid,
+                          &DevicePathNode,
+                          &FsVolumeHandle
+                          );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (
+                  FsVolumeHandle,
+                  &gQemuKernelLoaderBlobProtocolGuid,
+                  (VOID **)&KernelLoaderBlob
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return KernelLoaderBlob->GetBlob (KernelLoaderBlob, L"kernel", Data, Size);
+}
+
 /**
   Download the kernel, the initial ramdisk, and the kernel command line from
   QEMU's fw_cfg. The kernel will be instructed via its command line to load
@@ -174,16 +226,36 @@ QemuLoadKernelImage (
   UINTN                            CommandLineSize;
   CHAR8                            *CommandLine;
   UINTN                            InitrdSize;
+  CONST VOID                       *KernelBlob;
+  UINTN                            KernelBlobSize;
+
+  //
+  // Prefer loading the image straight from the resident fw_cfg blob. If that
+  // is not available, fall back to passing no SourceBuffer, which makes
+  // LoadImage() call back into the QEMU EFI loader file system.
+  //
+  Status = GetResidentKernelBlob (&KernelBlob, &KernelBlobSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "%a: resident kernel blob unavailable: %r\n",
+      __FUNCTION__,
+      Status
+      ));
+    KernelBlob     = NULL;
+    KernelBlobSize = 0;
+  }
 
   //
-  // Load the image. This should call back into the QEMU EFI loader file system.
+  // Load the image. The device path is passed in either case, so that the
+  // loaded image protocol instance refers to the kernel file.
   //
   Status = gBS->LoadImage (
                   FALSE,                    // BootPolicy: exact match required
                   gImageHandle,             // ParentImageHandle
                   (EFI_DEVICE_PATH_PROTOCOL *)&mKernelDevicePath,
-                  NULL,                     // SourceBuffer
-                  0,                        // SourceSize
+                  (VOID *)KernelBlob,       // SourceBuffer
+                  KernelBlobSize,           // SourceSize
                   &KernelImageHandle
                   );
   switch (Status) {
@@ -0,0 +1,442 @@
+/** @file
+  SHA-256 hash instance for HashLibBaseCryptoRouter that uses the SHA
+  extensions of the processor when they are available.
+
+  The TPM measurements of firmware volumes in PEI and of images in DXE hash
+  several megabytes per boot. On processors that implement the SHA extensions
+  (Intel since Goldmont and Ice Lake, AMD since Zen) the block transform runs
+  in Sha256NiTransform(); everywhere else the instance falls back to the
+  BaseCryptLib implementation that HashInstanceLibSha256 uses.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <PiPei.h>
+#include <Register/Intel/Cpuid.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/Tpm2CommandLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BaseCryptLib.h>
+#include <Library/HashLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+
+#define SHA256_BLOCK_SIZE  64
+
+//
+// CR4.OSFXSR; the SSE instructions fault while it is clear.
+//
+#define CR4_OSFXSR  BIT9
+
+typedef struct {
+  //
+  // Chaining state A..H and the partial block of the SHA extensions path.
+  //
+  UINT32     State[8];
+  UINT8      Block[SHA256_BLOCK_SIZE];
+  UINTN      BlockUsed;
+  UINT64     Length;
+  BOOLEAN    UseShaNi;
+  //
+  // BaseCryptLib context. Used instead of the above when the processor lacks
+  // the SHA extensions, and alongside it when PcdSha256NiBenchmark is set.
+  //
+  VOID       *GenericContext;
+  UINT64     ShaNiTicks;
+  UINT64     GenericTicks;
+} SHA256_NI_CONTEXT;
+
+STATIC CONST UINT32  mSha256InitialState[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/**
+  Run the SHA-256 block transform over whole blocks with the SHA extensions.
+
+  @param[in,out] State       Chaining state A..H.
+  @param[in]     Data        The blocks to process.
+  @param[in]     BlockCount  Number of SHA256_BLOCK_SIZE byte blocks in Data.
+**/
+VOID
+EFIAPI
+Sha256NiTransform (
+  IN OUT UINT32       *State,
+  IN     CONST UINT8  *Data,
+  IN     UINTN        BlockCount
+  );
+
+/**
+  Report whether the processor implements the SHA extensions, and the SSSE3
+  and SSE4.1 instructions that Sha256NiTransform() uses alongside them, and
+  whether SSE has been enabled.
+
+  The result is not cached: PEIMs may execute in place, where global
+  variables are read-only. One CPUID sequence per hash is negligible.
+
+  @retval TRUE   Sha256NiTransform() can be used.
+  @retval FALSE  The BaseCryptLib implementation has to be used.
+**/
+STATIC
+BOOLEAN
+Sha256NiSupported (
+  VOID
+  )
+{
+  UINT32                                       MaxLeaf;
+  CPUID_VERSION_INFO_ECX                       VersionEcx;
+  CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS_EBX  ExtendedEbx;
+
+  if ((AsmReadCr4 () & CR4_OSFXSR) == 0) {
+    return FALSE;
+  }
+
+  AsmCpuid (CPUID_SIGNATURE, &MaxLeaf, NULL, NULL, NULL);
+  if (MaxLeaf < CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS) {
+    return FALSE;
+  }
+
+  AsmCpuid (CPUID_VERSION_INFO, NULL, NULL, &VersionEcx.Uint32, NULL);
+  AsmCpuidEx (
+    CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS,
+    CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS_SUB_LEAF_INFO,
+    NULL,
+    &ExtendedEbx.Uint32,
+    NULL,
+    NULL
+    );
+
+  return (BOOLEAN)(VersionEcx.Bits.SSSE3 != 0 &&
+                   VersionEcx.Bits.SSE4_1 != 0 &&
+                   ExtendedEbx.Bits.SHA != 0);
+}
+
+/**
+  Feed data into the SHA extensions path.
+
+  @param[in,out] Context  The hash context.
+  @param[in]     Data     The data to hash.
+  @param[in]     Length   Size of Data in bytes.
+**/
+STATIC
+VOID
+Sha256NiUpdate (
+  IN OUT SHA256_NI_CONTEXT  *Context,
+  IN     CONST UINT8        *Data,
+  IN     UINTN              Length
+  )
+{
+  UINTN  Chunk;
+
+  Context->Length += Length;
+
+  if (Context->BlockUsed > 0) {
+    Chunk = MIN (Length, SHA256_BLOCK_SIZE - Context->BlockUsed);
+    CopyMem (Context->Block + Context->BlockUsed, Data, Chunk);
+    Context->BlockUsed += Chunk;
+    Data               += Chunk;
+    Length             -= Chunk;
+    if (Context->BlockUsed < SHA256_BLOCK_SIZE) {
+      return;
+    }
+
+    Sha256NiTransform (Context->State, Context->Block, 1);
+    Context->BlockUsed = 0;
+  }
+
+  //
+  // Whole blocks are transformed in place, without copying.
+  //
+  if (Length >= SHA256_BLOCK_SIZE) {
+    Sha256NiTransform (Context->State, Data, Length / SHA256_BLOCK_SIZE);
+    Data   += Length & ~(UINTN)(SHA256_BLOCK_SIZE - 1);
+    Length &= SHA256_BLOCK_SIZE - 1;
+  }
+
+  CopyMem (Context->Block, Data, Length);
+  Context->BlockUsed = Length;
+}
+
+/**
+  Pad the message and produce the digest of the SHA extensions path.
+
+  @param[in,out] Context  The hash context.
+  @param[out]    Digest   The SHA-256 digest.
+**/
+STATIC
+VOID
+Sha256NiFinal (
+  IN OUT SHA256_NI_CONTEXT  *Context,
+  OUT    UINT8              *Digest
+  )
+{
+  UINT64  BitLength;
+  UINTN   Index;
+
+  BitLength = LShiftU64 (Context->Length, 3);
+
+  Context->Block[Context->BlockUsed++] = 0x80;
+  if (Context->BlockUsed > SHA256_BLOCK_SIZE - sizeof (BitLength)) {
+    ZeroMem (Context->Block + Context->BlockUsed, SHA256_BLOCK_SIZE - Context->BlockUsed);
+    Sha256NiTransform (Context->State, Context->Block, 1);
+    Context->BlockUsed = 0;
+  }
+
+  ZeroMem (
+    Context->Block + Context->BlockUsed,
+    SHA256_BLOCK_SIZE - sizeof (BitLength) - Context->BlockUsed
+    );
+  WriteUnaligned64 (
+    (UINT64 *)(Context->Block + SHA256_BLOCK_SIZE - sizeof (BitLength)),
+    SwapBytes64 (BitLength)
+    );
+  Sha256NiTransform (Context->State, Context->Block, 1);
+
+  for (Index = 0; Index < ARRAY_SIZE (Context->State); Index++) {
+    WriteUnaligned32 ((UINT32 *)(Digest + Index * sizeof (UINT32)), SwapBytes32 (Context->State[Index]));
+  }
+}
+
+/**
+  Log the throughput of both paths over one hash, and check that they agree.
+
+  @param[in] Context       The hash context.
+  @param[in] ShaNiDigest   Digest of the SHA extensions path.
+  @param[in] GenericDigest Digest of the BaseCryptLib path.
+**/
+STATIC
+VOID
+Sha256NiReportBenchmark (
+  IN CONST SHA256_NI_CONTEXT  *Context,
+  IN CONST UINT8              *ShaNiDigest,
+  IN CONST UINT8              *GenericDigest
+  )
+{
+  UINT64  ShaNiNs;
+  UINT64  GenericNs;
+
+  if (CompareMem (ShaNiDigest, GenericDigest, SHA256_DIGEST_SIZE) != 0) {
+    DEBUG ((DEBUG_ERROR, "%a: SHA-NI digest mismatch over %Lu bytes\n", __FUNCTION__, Context->Length));
+    ASSERT (FALSE);
+    return;
+  }
+
+  //
+  // Digests of small inputs, such as event data, are not worth reporting.
+  //
+  if (Context->Length < SIZE_64KB) {
+    return;
+  }
+
+  ShaNiNs   = MAX (GetTimeInNanoSecond (Context->ShaNiTicks), 1);
+  GenericNs = MAX (GetTimeInNanoSecond (Context->GenericTicks), 1);
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: %Lu bytes, SHA-NI %Lu MB/s, generic %Lu MB/s\n",
+    __FUNCTION__,
+    Context->Length,
+    DivU64x64Remainder (MultU64x32 (Context->Length, 1000), ShaNiNs, NULL),
+    DivU64x64Remainder (MultU64x32 (Context->Length, 1000), GenericNs, NULL)
+    ));
+}
+
+/**
+  The function set SHA256 to digest list.
+
+  @param DigestList   digest list
+  @param Sha256Digest SHA256 digest
+**/
+STATIC
+VOID
+Tpm2SetSha256ToDigestList (
+  IN TPML_DIGEST_VALUES  *DigestList,
+  IN UINT8               *Sha256Digest
+  )
+{
+  DigestList->count              = 1;
+  DigestList->digests[0].hashAlg = TPM_ALG_SHA256;
+  CopyMem (
+    DigestList->digests[0].digest.sha256,
+    Sha256Digest,
+    SHA256_DIGEST_SIZE
+    );
+}
+
+/**
+  Free a hash context.
+
+  @param Context  The hash context.
+**/
+STATIC
+VOID
+Sha256NiFreeContext (
+  IN SHA256_NI_CONTEXT  *Context
+  )
+{
+  if (Context->GenericContext != NULL) {
+    FreePool (Context->GenericContext);
+  }
+
+  FreePool (Context);
+}
+
+/**
+  Start hash sequence.
+
+  @param HashHandle Hash handle.
+
+  @retval EFI_SUCCESS          Hash sequence start and HandleHandle returned.
+  @retval EFI_OUT_OF_RESOURCES No enough resource to start hash.
+**/
+EFI_STATUS
+EFIAPI
+Sha256NiHashInit (
+  OUT HASH_HANDLE  *HashHandle
+  )
+{
+  SHA256_NI_CONTEXT  *Context;
+
+  Context = AllocateZeroPool (sizeof (*Context));
+  if (Context == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Context->UseShaNi = Sha256NiSupported ();
+  CopyMem (Context->State, mSha256InitialState, sizeof (Context->State));
+
+  if (!Context->UseShaNi || FeaturePcdGet (PcdSha256NiBenchmark)) {
+    Context->GenericContext = AllocatePool (Sha256GetContextSize ());
+    if (Context->GenericContext == NULL) {
+      Sha256NiFreeContext (Context);
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Sha256Init (Context->GenericContext);
+  }
+
+  *HashHandle = (HASH_HANDLE)Context;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Update hash sequence data.
+
+  @param HashHandle    Hash handle.
+  @param DataToHash    Data to be hashed.
+  @param DataToHashLen Data size.
+
+  @retval EFI_SUCCESS     Hash sequence updated.
+**/
+EFI_STATUS
+EFIAPI
+Sha256NiHashUpdate (
+  IN HASH_HANDLE  HashHandle,
+  IN VOID         *DataToHash,
+  IN UINTN        DataToHashLen
+  )
+{
+  SHA256_NI_CONTEXT  *Context;
+  UINT64             Start;
+
+  Context = (SHA256_NI_CONTEXT *)HashHandle;
+
+  if (!FeaturePcdGet (PcdSha256NiBenchmark)) {
+    if (Context->UseShaNi) {
+      Sha256NiUpdate (Context, DataToHash, DataToHashLen);
+    } else {
+      Sha256Update (Context->GenericContext, DataToHash, DataToHashLen);
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  if (Context->UseShaNi) {
+    Start = GetPerformanceCounter ();
+    Sha256NiUpdate (Context, DataToHash, DataToHashLen);
+    Context->ShaNiTicks += GetPerformanceCounter () - Start;
+  }
+
+  if (Context->GenericContext != NULL) {
+    Start = GetPerformanceCounter ();
+    Sha256Update (Context->GenericContext, DataToHash, DataToHashLen);
+    Context->GenericTicks += GetPerformanceCounter () - Start;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Complete hash sequence complete.
+
+  @param HashHandle    Hash handle.
+  @param DigestList    Digest list.
+
+  @retval EFI_SUCCESS     Hash sequence complete and DigestList is returned.
+**/
+EFI_STATUS
+EFIAPI
+Sha256NiHashFinal (
+  IN HASH_HANDLE          HashHandle,
+  OUT TPML_DIGEST_VALUES  *DigestList
+  )
+{
+  SHA256_NI_CONTEXT  *Context;
+  UINT8              Digest[SHA256_DIGEST_SIZE];
+  UINT8              GenericDigest[SHA256_DIGEST_SIZE];
+
+  Context = (SHA256_NI_CONTEXT *)HashHandle;
+
+  if (Context->GenericContext != NULL) {
+    Sha256Final (Context->GenericContext, GenericDigest);
+  }
+
+  if (Context->UseShaNi) {
+    Sha256NiFinal (Context, Digest);
+    if (Context->GenericContext != NULL) {
+      Sha256NiReportBenchmark (Context, Digest, GenericDigest);
+    }
+  } else {
+    CopyMem (Digest, GenericDigest, sizeof (Digest));
+  }
+
+  Sha256NiFreeContext (Context);
+
+  Tpm2SetSha256ToDigestList (DigestList, Digest);
+
+  return EFI_SUCCESS;
+}
+
+HASH_INTERFACE  mSha256NiHashInstance = {
+  HASH_ALGORITHM_SHA256_GUID,
+  Sha256NiHashInit,
+  Sha256NiHashUpdate,
+  Sha256NiHashFinal,
+};
+
+/**
+  The function register SHA256 instance.
+
+  @retval EFI_SUCCESS   SHA256 instance is registered, or system does not support register SHA256 instance
+**/
+EFI_STATUS
+EFIAPI
+HashInstanceLibSha256NiConstructor (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = RegisterHashInterfaceLib (&mSha256NiHashInstance);
+  if ((Status == EFI_SUCCESS) || (Status == EFI_UNSUPPORTED)) {
+    //
+    // Unsupported means platform policy does not need this instance enabled.
+    //
+    return EFI_SUCCESS;
+  }
+
+  return Status;
+}
@@ -0,0 +1,666 @@
+/** @file
+  Host based unit tests of HashInstanceLibSha256Ni.
+
+  The hash interface is checked against the NIST SHA-256 example messages and
+  against messages whose lengths sit on the padding boundaries, with the data
+  fed in pieces of various sizes so that the partial block carried between
+  HashUpdate calls is exercised. The SHA extensions path runs when the host
+  processor implements them; the BaseCryptLib path runs everywhere, by hiding
+  the SHA extensions from the instance.
+
+  A benchmark logs the throughput of both paths over a large buffer.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Uefi.h>
+#include <Register/Intel/Cpuid.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BaseCryptLib.h>
+#include <Library/HashLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/UnitTestHostBaseLib.h>
+
+#if defined (_MSC_VER)
+  #include <intrin.h>
+#else
+  #include <cpuid.h>
+  #include <x86intrin.h>
+#endif
+
+#define UNIT_TEST_NAME     "HashInstanceLibSha256Ni Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// CR4.OSFXSR; the instance only uses the SHA extensions while it is set.
+//
+#define CR4_OSFXSR  BIT9
+
+#define SHA256_NI_BENCHMARK_SIZE  SIZE_16MB
+
+typedef struct {
+  CONST CHAR8    *Description;
+  //
+  // The message text. If NULL, the message is Length bytes of Fill, or of
+  // the byte offset modulo 256 if Fill is zero.
+  //
+  CONST CHAR8    *Message;
+  UINT8          Fill;
+  UINTN          Length;
+  UINT8          Digest[SHA256_DIGEST_SIZE];
+} SHA256_NI_TEST_VECTOR;
+
+//
+// Example messages from the NIST Cryptographic Standards and Guidelines
+// SHA-256 examples.
+//
+STATIC CONST SHA256_NI_TEST_VECTOR  mNistVectors[] = {
+  {
+    "empty message",
+    "",
+    0,
+    0,
+    {
+      0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+      0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55
+    }
+  },
+  {
+    "\"abc\"",
+    "abc",
+    0,
+    3,
+    {
+      0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+      0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+    }
+  },
+  {
+    "448 bit message",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    0,
+    56,
+    {
+      0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+      0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1
+    }
+  },
+  {
+    "896 bit message",
+    "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+    "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+    0,
+    112,
+    {
+      0xcf, 0x5b, 0x16, 0xa7, 0x78, 0xaf, 0x83, 0x80, 0x03, 0x6c, 0xe5, 0x9e, 0x7b, 0x04, 0x92, 0x37,
+      0x0b, 0x24, 0x9b, 0x11, 0xe8, 0xf0, 0x7a, 0x51, 0xaf, 0xac, 0x45, 0x03, 0x7a, 0xfe, 0xe9, 0xd1
+    }
+  },
+  {
+    "one million 'a'",
+    NULL,
+    'a',
+    1000000,
+    {
+      0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+      0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0
+    }
+  },
+};
+
+//
+// Messages around the padding boundaries: 55 bytes is the longest message
+// whose padding fits its last block, 56 to 63 bytes need an extra block for
+// the length, 64 bytes is a whole block, and 119 bytes is the longest two
+// block message that pads in place.
+//
+STATIC CONST SHA256_NI_TEST_VECTOR  mBoundaryVectors[] = {
+  {
+    "55 bytes",
+    NULL,
+    0,
+    55,
+    {
+      0x46, 0x3e, 0xb2, 0x8e, 0x72, 0xf8, 0x2e, 0x0a, 0x96, 0xc0, 0xa4, 0xcc, 0x53, 0x69, 0x0c, 0x57,
+      0x12, 0x81, 0x13, 0x1f, 0x67, 0x2a, 0xa2, 0x29, 0xe0, 0xd4, 0x5a, 0xe5, 0x9b, 0x59, 0x8b, 0x59
+    }
+  },
+  {
+    "56 bytes",
+    NULL,
+    0,
+    56,
+    {
+      0xda, 0x2a, 0xe4, 0xd6, 0xb3, 0x67, 0x48, 0xf2, 0xa3, 0x18, 0xf2, 0x3e, 0x7a, 0xb1, 0xdf, 0xdf,
+      0x45, 0xac, 0xdc, 0x9d, 0x04, 0x9b, 0xd8, 0x0e, 0x59, 0xde, 0x82, 0xa6, 0x08, 0x95, 0xf5, 0x62
+    }
+  },
+  {
+    "63 bytes",
+    NULL,
+    0,
+    63,
+    {
+      0x29, 0xaf, 0x26, 0x86, 0xfd, 0x53, 0x37, 0x4a, 0x36, 0xb0, 0x84, 0x66, 0x94, 0xcc, 0x34, 0x21,
+      0x77, 0xe4, 0x28, 0xd1, 0x64, 0x75, 0x15, 0xf0, 0x78, 0x78, 0x4d, 0x69, 0xcd, 0xb9, 0xe4, 0x88
+    }
+  },
+  {
+    "64 bytes",
+    NULL,
+    0,
+    64,
+    {
+      0xfd, 0xea, 0xb9, 0xac, 0xf3, 0x71, 0x03, 0x62, 0xbd, 0x26, 0x58, 0xcd, 0xc9, 0xa2, 0x9e, 0x8f,
+      0x9c, 0x75, 0x7f, 0xcf, 0x98, 0x11, 0x60, 0x3a, 0x8c, 0x44, 0x7c, 0xd1, 0xd9, 0x15, 0x11, 0x08
+    }
+  },
+  {
+    "119 bytes",
+    NULL,
+    0,
+    119,
+    {
+      0xda, 0x18, 0x79, 0x7e, 0xd7, 0xc3, 0xa7, 0x77, 0xf0, 0x84, 0x7f, 0x42, 0x97, 0x24, 0xa2, 0xd8,
+      0xcd, 0x51, 0x38, 0xe6, 0xed, 0x28, 0x95, 0xc3, 0xfa, 0x1a, 0x6d, 0x39, 0xd1, 0x8f, 0x7e, 0xc6
+    }
+  },
+};
+
+//
+// Sizes of the pieces passed to each HashUpdate call. Zero passes the whole
+// message in one call.
+//
+STATIC CONST UINTN  mUpdateSizes[] = { 0, 1, 3, 55, 63, 64, 65 };
+
+//
+// The path under test. The value is passed as the test context.
+//
+STATIC BOOLEAN  mShaNiPath   = TRUE;
+STATIC BOOLEAN  mGenericPath = FALSE;
+
+//
+// Clear the SHA feature bit in the CPUID results seen by the instance.
+//
+STATIC BOOLEAN  mHideShaExtensions;
+
+//
+// The hash interface of the instance under test.
+//
+EFI_STATUS
+EFIAPI
+Sha256NiHashInit (
+  OUT HASH_HANDLE  *HashHandle
+  );
+
+EFI_STATUS
+EFIAPI
+Sha256NiHashUpdate (
+  IN HASH_HANDLE  HashHandle,
+  IN VOID         *DataToHash,
+  IN UINTN        DataToHashLen
+  );
+
+EFI_STATUS
+EFIAPI
+Sha256NiHashFinal (
+  IN HASH_HANDLE          HashHandle,
+  OUT TPML_DIGEST_VALUES  *DigestList
+  );
+
+/**
+  Stand in for HashLibBaseCryptoRouter. The tests call the hash interface
+  directly, so registration is not under test.
+
+  @param HashInterface  Unused.
+
+  @retval EFI_SUCCESS  Always.
+**/
+EFI_STATUS
+EFIAPI
+RegisterHashInterfaceLib (
+  IN HASH_INTERFACE  *HashInterface
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Execute CPUID on the host processor, on behalf of the instance under test.
+
+  @param[in]  Index     The 32-bit value to load into EAX.
+  @param[in]  SubIndex  The 32-bit value to load into ECX.
+  @param[out] Eax       The EAX result, if not NULL.
+  @param[out] Ebx       The EBX result, if not NULL.
+  @param[out] Ecx       The ECX result, if not NULL.
+  @param[out] Edx       The EDX result, if not NULL.
+
+  @return Index.
+**/
+STATIC
+UINT32
+EFIAPI
+HostAsmCpuidEx (
+  IN  UINT32  Index,
+  IN  UINT32  SubIndex,
+  OUT UINT32  *Eax  OPTIONAL,
+  OUT UINT32  *Ebx  OPTIONAL,
+  OUT UINT32  *Ecx  OPTIONAL,
+  OUT UINT32  *Edx  OPTIONAL
+  )
+{
+  UINT32                                       Registers[4];
+  CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS_EBX  ExtendedEbx;
+
+ #if defined (_MSC_VER)
+  __cpuidex ((INT32 *)Registers, (INT32)Index, (INT32)SubIndex);
+ #else
+  __cpuid_count (Index, SubIndex, Registers[0], Registers[1], Registers[2], Registers[3]);
+ #endif
+
+  if (mHideShaExtensions && (Index == CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS)) {
+    ExtendedEbx.Uint32   = Registers[1];
+    ExtendedEbx.Bits.SHA = 0;
+    Registers[1]         = ExtendedEbx.Uint32;
+  }
+
+  if (Eax != NULL) {
+    *Eax = Registers[0];
+  }
+
+  if (Ebx != NULL) {
+    *Ebx = Registers[1];
+  }
+
+  if (Ecx != NULL) {
+    *Ecx = Registers[2];
+  }
+
+  if (Edx != NULL) {
+    *Edx = Registers[3];
+  }
+
+  return Index;
+}
+
+/**
+  Execute CPUID on the host processor, on behalf of the instance under test.
+
+  @param[in]  Index  The 32-bit value to load into EAX.
+  @param[out] Eax    The EAX result, if not NULL.
+  @param[out] Ebx    The EBX result, if not NULL.
+  @param[out] Ecx    The ECX result, if not NULL.
+  @param[out] Edx    The EDX result, if not NULL.
+
+  @return Index.
+**/
+STATIC
+UINT32
+EFIAPI
+HostAsmCpuid (
+  IN  UINT32  Index,
+  OUT UINT32  *Eax  OPTIONAL,
+  OUT UINT32  *Ebx  OPTIONAL,
+  OUT UINT32  *Ecx  OPTIONAL,
+  OUT UINT32  *Edx  OPTIONAL
+  )
+{
+  return HostAsmCpuidEx (Index, 0, Eax, Ebx, Ecx, Edx);
+}
+
+/**
+  Report whether the host processor implements the instructions that the SHA
+  extensions path of the instance uses.
+
+  @retval TRUE   The SHA extensions path can run on this host.
+  @retval FALSE  Only the BaseCryptLib path can run on this host.
+**/
+STATIC
+BOOLEAN
+HostSupportsShaExtensions (
+  VOID
+  )
+{
+  UINT32                                       MaxLeaf;
+  CPUID_VERSION_INFO_ECX                       VersionEcx;
+  CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS_EBX  ExtendedEbx;
+
+  HostAsmCpuid (CPUID_SIGNATURE, &MaxLeaf, NULL, NULL, NULL);
+  if (MaxLeaf < CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS) {
+    return FALSE;
+  }
+
+  HostAsmCpuid (CPUID_VERSION_INFO, NULL, NULL, &VersionEcx.Uint32, NULL);
+  HostAsmCpuidEx (
+    CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS,
+    CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS_SUB_LEAF_INFO,
+    NULL,
+    &ExtendedEbx.Uint32,
+    NULL,
+    NULL
+    );
+
+  return (BOOLEAN)(VersionEcx.Bits.SSSE3 != 0 &&
+                   VersionEcx.Bits.SSE4_1 != 0 &&
+                   ExtendedEbx.Bits.SHA != 0);
+}
+
+/**
+  Select the path that the following hashes take.
+
+  @param[in] UseShaNi  TRUE for the SHA extensions path, FALSE for the
+                       BaseCryptLib path.
+
+  @retval TRUE   The path was selected.
+  @retval FALSE  The host processor lacks the SHA extensions.
+**/
+STATIC
+BOOLEAN
+SelectSha256Path (
+  IN BOOLEAN  UseShaNi
+  )
+{
+  mHideShaExtensions = FALSE;
+  if (UseShaNi && !HostSupportsShaExtensions ()) {
+    return FALSE;
+  }
+
+  mHideShaExtensions = !UseShaNi;
+  return TRUE;
+}
+
+/**
+  Hash a message through the hash interface of the instance.
+
+  @param[in]  Message     The message.
+  @param[in]  Length      Size of Message in bytes.
+  @param[in]  UpdateSize  Size of the pieces passed to each HashUpdate call,
+                          or zero to pass the whole message in one call.
+  @param[out] Digest      The SHA-256 digest.
+
+  @retval EFI_SUCCESS  The message was hashed.
+  @return              Errors from the hash interface.
+**/
+STATIC
+EFI_STATUS
+HashMessage (
+  IN  CONST UINT8  *Message,
+  IN  UINTN        Length,
+  IN  UINTN        UpdateSize,
+  OUT UINT8        *Digest
+  )
+{
+  HASH_HANDLE         HashHandle;
+  TPML_DIGEST_VALUES  DigestList;
+  EFI_STATUS          Status;
+  UINTN               Offset;
+  UINTN               Piece;
+
+  Status = Sha256NiHashInit (&HashHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (UpdateSize == 0) {
+    UpdateSize = MAX (Length, 1);
+  }
+
+  for (Offset = 0; Offset < Length; Offset += Piece) {
+    Piece  = MIN (UpdateSize, Length - Offset);
+    Status = Sha256NiHashUpdate (HashHandle, (VOID *)(Message + Offset), Piece);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  ZeroMem (&DigestList, sizeof (DigestList));
+  Status = Sha256NiHashFinal (HashHandle, &DigestList);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((DigestList.count != 1) || (DigestList.digests[0].hashAlg != TPM_ALG_SHA256)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  CopyMem (Digest, DigestList.digests[0].digest.sha256, SHA256_DIGEST_SIZE);
+  return EFI_SUCCESS;
+}
+
+/**
+  Check the digests of a set of messages, for every piece size.
+
+  @param[in] Context      The path under test; see SelectSha256Path().
+  @param[in] Vectors      The messages and their digests.
+  @param[in] VectorCount  The number of entries in Vectors.
+
+  @retval UNIT_TEST_PASSED  Every digest matched.
+  @retval UNIT_TEST_SKIPPED The host processor lacks the SHA extensions.
+  @return                   A failure of the first mismatch.
+**/
+STATIC
+UNIT_TEST_STATUS
+CheckVectors (
+  IN UNIT_TEST_CONTEXT            Context,
+  IN CONST SHA256_NI_TEST_VECTOR  *Vectors,
+  IN UINTN                        VectorCount
+  )
+{
+  UINT8       *Message;
+  UINT8       Digest[SHA256_DIGEST_SIZE];
+  UINTN       VectorIndex;
+  UINTN       SizeIndex;
+  UINTN       Index;
+  EFI_STATUS  Status;
+
+  if (!SelectSha256Path (*(BOOLEAN *)Context)) {
+    UT_LOG_WARNING ("The host processor lacks the SHA extensions\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  for (VectorIndex = 0; VectorIndex < VectorCount; VectorIndex++) {
+    Message = AllocatePool (MAX (Vectors[VectorIndex].Length, 1));
+    UT_ASSERT_NOT_NULL (Message);
+
+    if (Vectors[VectorIndex].Message != NULL) {
+      CopyMem (Message, Vectors[VectorIndex].Message, Vectors[VectorIndex].Length);
+    } else if (Vectors[VectorIndex].Fill != 0) {
+      SetMem (Message, Vectors[VectorIndex].Length, Vectors[VectorIndex].Fill);
+    } else {
+      for (Index = 0; Index < Vectors[VectorIndex].Length; Index++) {
+        Message[Index] = (UINT8)Index;
+      }
+    }
+
+    for (SizeIndex = 0; SizeIndex < ARRAY_SIZE (mUpdateSizes); SizeIndex++) {
+      UT_LOG_INFO (
+        "%a, %Lu byte updates\n",
+        Vectors[VectorIndex].Description,
+        (UINT64)mUpdateSizes[SizeIndex]
+        );
+      Status = HashMessage (Message, Vectors[VectorIndex].Length, mUpdateSizes[SizeIndex], Digest);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_MEM_EQUAL (Digest, Vectors[VectorIndex].Digest, SHA256_DIGEST_SIZE);
+    }
+
+    FreePool (Message);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Check the NIST example messages.
+
+  @param[in] Context  The path under test.
+
+  @return The result of CheckVectors().
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+NistVectorsTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  return CheckVectors (Context, mNistVectors, ARRAY_SIZE (mNistVectors));
+}
+
+/**
+  Check messages whose lengths sit on the padding boundaries.
+
+  @param[in] Context  The path under test.
+
+  @return The result of CheckVectors().
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PaddingBoundariesTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  return CheckVectors (Context, mBoundaryVectors, ARRAY_SIZE (mBoundaryVectors));
+}
+
+/**
+  Hash a large buffer through both paths, check that the digests agree, and
+  log the throughput of each path in processor cycles per byte.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The digests matched.
+  @retval UNIT_TEST_SKIPPED The host processor lacks the SHA extensions.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8       *Buffer;
+  UINT8       ShaNiDigest[SHA256_DIGEST_SIZE];
+  UINT8       GenericDigest[SHA256_DIGEST_SIZE];
+  UINT64      Start;
+  UINT64      ShaNiCycles;
+  UINT64      GenericCycles;
+  UINTN       Index;
+  EFI_STATUS  Status;
+
+  if (!SelectSha256Path (TRUE)) {
+    UT_LOG_WARNING ("The host processor lacks the SHA extensions\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  Buffer = AllocatePool (SHA256_NI_BENCHMARK_SIZE);
+  UT_ASSERT_NOT_NULL (Buffer);
+  for (Index = 0; Index < SHA256_NI_BENCHMARK_SIZE; Index++) {
+    Buffer[Index] = (UINT8)(Index * 31);
+  }
+
+  Start       = __rdtsc ();
+  Status      = HashMessage (Buffer, SHA256_NI_BENCHMARK_SIZE, 0, ShaNiDigest);
+  ShaNiCycles = __rdtsc () - Start;
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  SelectSha256Path (FALSE);
+  Start         = __rdtsc ();
+  Status        = HashMessage (Buffer, SHA256_NI_BENCHMARK_SIZE, 0, GenericDigest);
+  GenericCycles = __rdtsc () - Start;
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  FreePool (Buffer);
+
+  UT_ASSERT_MEM_EQUAL (ShaNiDigest, GenericDigest, SHA256_DIGEST_SIZE);
+
+  //
+  // Cycles per byte, in hundredths.
+  //
+  UT_LOG_INFO (
+    "%Lu MB: SHA-NI %Lu.%02Lu cycles/byte, generic %Lu.%02Lu cycles/byte\n",
+    (UINT64)(SHA256_NI_BENCHMARK_SIZE / SIZE_1MB),
+    DivU64x32 (ShaNiCycles, SHA256_NI_BENCHMARK_SIZE),
+    DivU64x32 (MultU64x32 (ShaNiCycles, 100), SHA256_NI_BENCHMARK_SIZE) % 100,
+    DivU64x32 (GenericCycles, SHA256_NI_BENCHMARK_SIZE),
+    DivU64x32 (MultU64x32 (GenericCycles, 100), SHA256_NI_BENCHMARK_SIZE) % 100
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for
+  HashInstanceLibSha256Ni, and run them.
+
+  @retval EFI_SUCCESS           All test cases were dispatched.
+  @retval EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                initialize the unit tests.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Sha256NiTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // The instance reads CR4 and CPUID to pick its path. Let it see the host
+  // processor, with SSE enabled.
+  //
+  gUnitTestHostBaseLib.X86->AsmCpuid   = HostAsmCpuid;
+  gUnitTestHostBaseLib.X86->AsmCpuidEx = HostAsmCpuidEx;
+  AsmWriteCr4 (AsmReadCr4 () | CR4_OSFXSR);
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Sha256NiTests, Framework, "SHA-256 Hash Instance Tests", "Sha256Ni", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for SHA-256 Hash Instance Tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Sha256NiTests, "NIST example messages, SHA extensions", "NistShaNi", NistVectorsTest, NULL, NULL, &mShaNiPath);
+  AddTestCase (Sha256NiTests, "NIST example messages, BaseCryptLib", "NistGeneric", NistVectorsTest, NULL, NULL, &mGenericPath);
+  AddTestCase (Sha256NiTests, "Padding boundaries, SHA extensions", "PaddingShaNi", PaddingBoundariesTest, NULL, NULL, &mShaNiPath);
+  AddTestCase (Sha256NiTests, "Padding boundaries, BaseCryptLib", "PaddingGeneric", PaddingBoundariesTest, NULL, NULL, &mGenericPath);
+  AddTestCase (Sha256NiTests, "Throughput of both paths", "Benchmark", BenchmarkTest, NULL, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
@@ -0,0 +1,249 @@
+/** @file
+  Build and search the hashed cache of "opt/" fw_cfg files.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/QemuFwCfgLib.h>
+
+#include "QemuFwCfgSimpleParserInternal.h"
+
+//
+// The smallest hash table that the cache uses, even if there are no knobs.
+//
+#define KNOB_CACHE_MIN_BUCKETS  4
+
+#define FNV1A_32_OFFSET_BASIS  0x811C9DC5
+#define FNV1A_32_PRIME         0x01000193
+
+/**
+  Calculate the FNV-1a hash of a NUL-terminated ASCII string.
+
+  @param[in] String  The string to hash.
+
+  @return  The 32-bit hash of String.
+**/
+STATIC
+UINT32
+HashKnobName (
+  IN CONST CHAR8  *String
+  )
+{
+  UINT32  Hash;
+
+  Hash = FNV1A_32_OFFSET_BASIS;
+  while (*String != '\0') {
+    Hash ^= (UINT8)*String;
+    Hash *= FNV1A_32_PRIME;
+    String++;
+  }
+
+  return Hash;
+}
+
+/**
+  Read the next entry from the fw_cfg file directory. The directory must have
+  been selected, and its entry count read, by the caller.
+
+  @param[out] FileSize    The size of the fw_cfg file, in host byte order.
+
+  @param[out] FileSelect  The selector key of the fw_cfg file, in host byte
+                          order.
+
+  @param[out] FileName    The NUL-terminated name of the fw_cfg file.
+**/
+STATIC
+VOID
+ReadFileDirEntry (
+  OUT UINT32  *FileSize,
+  OUT UINT16  *FileSelect,
+  OUT CHAR8   FileName[QEMU_FW_CFG_FNAME_SIZE]
+  )
+{
+  UINT16  FileReserved;
+
+  *FileSize    = SwapBytes32 (QemuFwCfgRead32 ());
+  *FileSelect  = SwapBytes16 (QemuFwCfgRead16 ());
+  FileReserved = QemuFwCfgRead16 ();
+  (VOID)FileReserved;  /* Force a do-nothing reference. */
+  QemuFwCfgReadBytes (QEMU_FW_CFG_FNAME_SIZE, FileName);
+  FileName[QEMU_FW_CFG_FNAME_SIZE - 1] = '\0';
+}
+
+RETURN_STATUS
+QemuFwCfgGetKnobCacheSize (
+  OUT UINTN  *CacheSize
+  )
+{
+  UINT32  Count;
+  UINT32  Idx;
+  UINT32  KnobCount;
+  UINT32  BucketCount;
+  UINT32  FileSize;
+  UINT16  FileSelect;
+  CHAR8   FileName[QEMU_FW_CFG_FNAME_SIZE];
+
+  if (!QemuFwCfgIsAvailable ()) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  QemuFwCfgSelectItem (QemuFwCfgItemFileDir);
+  Count = SwapBytes32 (QemuFwCfgRead32 ());
+
+  KnobCount = 0;
+  for (Idx = 0; Idx < Count; ++Idx) {
+    ReadFileDirEntry (&FileSize, &FileSelect, FileName);
+    if (QemuFwCfgIsKnobName (FileName)) {
+      KnobCount++;
+    }
+  }
+
+  //
+  // Keep the load factor at or below one half.
+  //
+  BucketCount = KNOB_CACHE_MIN_BUCKETS;
+  while (BucketCount < KnobCount * 2) {
+    if (BucketCount >= QEMU_FW_CFG_KNOB_CACHE_MAX_BUCKETS) {
+      DEBUG ((
+        DEBUG_WARN,
+        "%a: too many \"%a\" fw_cfg files (%u) to cache\n",
+        __FUNCTION__,
+        QEMU_FW_CFG_KNOB_NAME_PREFIX,
+        KnobCount
+        ));
+      return RETURN_OUT_OF_RESOURCES;
+    }
+
+    BucketCount *= 2;
+  }
+
+  *CacheSize = sizeof (QEMU_FW_CFG_KNOB_CACHE) +
+               BucketCount * sizeof (QEMU_FW_CFG_KNOB);
+  return RETURN_SUCCESS;
+}
+
+VOID
+QemuFwCfgPopulateKnobCache (
+  OUT QEMU_FW_CFG_KNOB_CACHE  *Cache,
+  IN  UINTN                   CacheSize
+  )
+{
+  QEMU_FW_CFG_KNOB  *Buckets;
+  QEMU_FW_CFG_KNOB  *Knob;
+  UINT32            Count;
+  UINT32            Idx;
+  UINT32            Hash;
+  UINT32            FileSize;
+  UINT16            FileSelect;
+  CHAR8             FileName[QEMU_FW_CFG_FNAME_SIZE];
+
+  ZeroMem (Cache, CacheSize);
+  Cache->BucketCount = (UINT32)((CacheSize - sizeof (QEMU_FW_CFG_KNOB_CACHE)) /
+                                sizeof (QEMU_FW_CFG_KNOB));
+  ASSERT (Cache->BucketCount >= KNOB_CACHE_MIN_BUCKETS);
+  ASSERT ((Cache->BucketCount & (Cache->BucketCount - 1)) == 0);
+  Buckets = QEMU_FW_CFG_KNOB_CACHE_BUCKETS (Cache);
+
+  //
+  // Insert the names, sizes and selector keys in one pass over the directory.
+  //
+  QemuFwCfgSelectItem (QemuFwCfgItemFileDir);
+  Count = SwapBytes32 (QemuFwCfgRead32 ());
+
+  for (Idx = 0; Idx < Count; ++Idx) {
+    ReadFileDirEntry (&FileSize, &FileSelect, FileName);
+    if (!QemuFwCfgIsKnobName (FileName)) {
+      continue;
+    }
+
+    //
+    // QemuFwCfgGetKnobCacheSize() sized the table for at most a half load, so
+    // an empty bucket always exists.
+    //
+    ASSERT (Cache->KnobCount < Cache->BucketCount / 2);
+    Hash = HashKnobName (FileName);
+    Knob = &Buckets[Hash & (Cache->BucketCount - 1)];
+    while (Knob->Name[0] != '\0') {
+      Knob++;
+      if (Knob == Buckets + Cache->BucketCount) {
+        Knob = Buckets;
+      }
+    }
+
+    Knob->NameHash = Hash;
+    Knob->Size     = FileSize;
+    Knob->Select   = FileSelect;
+    CopyMem (Knob->Name, FileName, sizeof Knob->Name);
+    Cache->KnobCount++;
+  }
+
+  //
+  // Selecting a file resets the directory read position, so fetch the
+  // contents only after the directory pass has completed.
+  //
+  for (Idx = 0; Idx < Cache->BucketCount; ++Idx) {
+    Knob = &Buckets[Idx];
+    if ((Knob->Name[0] != '\0') && (Knob->Size <= sizeof Knob->Value)) {
+      QemuFwCfgSelectItem (Knob->Select);
+      QemuFwCfgReadBytes (Knob->Size, Knob->Value);
+    }
+  }
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "%a: cached %u \"%a\" fw_cfg files in %u buckets\n",
+    __FUNCTION__,
+    Cache->KnobCount,
+    QEMU_FW_CFG_KNOB_NAME_PREFIX,
+    Cache->BucketCount
+    ));
+}
+
+BOOLEAN
+QemuFwCfgIsKnobName (
+  IN CONST CHAR8  *FileName
+  )
+{
+  return (BOOLEAN)(AsciiStrnCmp (
+                     FileName,
+                     QEMU_FW_CFG_KNOB_NAME_PREFIX,
+                     sizeof QEMU_FW_CFG_KNOB_NAME_PREFIX - 1
+                     ) == 0);
+}
+
+CONST QEMU_FW_CFG_KNOB *
+QemuFwCfgLookupKnob (
+  IN CONST QEMU_FW_CFG_KNOB_CACHE  *Cache,
+  IN CONST CHAR8                   *FileName
+  )
+{
+  CONST QEMU_FW_CFG_KNOB  *Buckets;
+  CONST QEMU_FW_CFG_KNOB  *Knob;
+  UINT32                  Hash;
+
+  Buckets = QEMU_FW_CFG_KNOB_CACHE_BUCKETS (Cache);
+  Hash    = HashKnobName (FileName);
+  Knob    = &Buckets[Hash & (Cache->BucketCount - 1)];
+
+  //
+  // The table is never more than half full, so the probe sequence always
+  // terminates at an empty bucket.
+  //
+  while (Knob->Name[0] != '\0') {
+    if ((Knob->NameHash == Hash) && (AsciiStrCmp (Knob->Name, FileName) == 0)) {
+      return Knob;
+    }
+
+    Knob++;
+    if (Knob == Buckets + Cache->BucketCount) {
+      Knob = Buckets;
+    }
+  }
+
+  return NULL;
+}
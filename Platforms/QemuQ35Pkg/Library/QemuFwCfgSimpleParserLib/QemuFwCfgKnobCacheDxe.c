@@ -0,0 +1,52 @@
+/** @file
+  DXE phase knob cache for QemuFwCfgSimpleParserLib.
+
+  The cache built in PEI is consumed from its GUID HOB. If PEI did not build
+  one, the module builds its own copy in pool memory on first use.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/HobLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "QemuFwCfgSimpleParserInternal.h"
+
+STATIC CONST QEMU_FW_CFG_KNOB_CACHE  *mKnobCache;
+
+CONST QEMU_FW_CFG_KNOB_CACHE *
+QemuFwCfgGetKnobCache (
+  VOID
+  )
+{
+  EFI_HOB_GUID_TYPE       *GuidHob;
+  QEMU_FW_CFG_KNOB_CACHE  *Cache;
+  UINTN                   CacheSize;
+  RETURN_STATUS           Status;
+
+  if (mKnobCache != NULL) {
+    return mKnobCache;
+  }
+
+  GuidHob = GetFirstGuidHob (&gQemuFwCfgKnobCacheGuid);
+  if (GuidHob != NULL) {
+    mKnobCache = GET_GUID_HOB_DATA (GuidHob);
+    return mKnobCache;
+  }
+
+  Status = QemuFwCfgGetKnobCacheSize (&CacheSize);
+  if (RETURN_ERROR (Status)) {
+    return NULL;
+  }
+
+  Cache = AllocatePool (CacheSize);
+  if (Cache == NULL) {
+    return NULL;
+  }
+
+  QemuFwCfgPopulateKnobCache (Cache, CacheSize);
+  mKnobCache = Cache;
+  return mKnobCache;
+}
@@ -0,0 +1,43 @@
+/** @file
+  PEI phase knob cache for QemuFwCfgSimpleParserLib.
+
+  The cache lives in a GUID HOB, which needs no writable global variables and
+  is handed off to the DXE phase unchanged.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/HobLib.h>
+
+#include "QemuFwCfgSimpleParserInternal.h"
+
+CONST QEMU_FW_CFG_KNOB_CACHE *
+QemuFwCfgGetKnobCache (
+  VOID
+  )
+{
+  EFI_HOB_GUID_TYPE       *GuidHob;
+  QEMU_FW_CFG_KNOB_CACHE  *Cache;
+  UINTN                   CacheSize;
+  RETURN_STATUS           Status;
+
+  GuidHob = GetFirstGuidHob (&gQemuFwCfgKnobCacheGuid);
+  if (GuidHob != NULL) {
+    return GET_GUID_HOB_DATA (GuidHob);
+  }
+
+  Status = QemuFwCfgGetKnobCacheSize (&CacheSize);
+  if (RETURN_ERROR (Status)) {
+    return NULL;
+  }
+
+  Cache = BuildGuidHob (&gQemuFwCfgKnobCacheGuid, CacheSize);
+  if (Cache == NULL) {
+    return NULL;
+  }
+
+  QemuFwCfgPopulateKnobCache (Cache, CacheSize);
+  return Cache;
+}
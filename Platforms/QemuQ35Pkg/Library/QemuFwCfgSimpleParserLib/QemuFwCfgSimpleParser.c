@@ -7,9 +7,12 @@
 **/
 
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/QemuFwCfgLib.h>
 #include <Library/QemuFwCfgSimpleParserLib.h>
 
+#include "QemuFwCfgSimpleParserInternal.h"
+
 //
 // Size of the longest valid UINT64 string, including the terminating NUL.
 //
@@ -27,6 +30,19 @@
 //
 #define CRLF_LENGTH  (sizeof "\r\n" - 1)
 
+//
+// Every buffer passed to QemuFwCfgGetAsString() must be servable from the knob
+// cache.
+//
+STATIC_ASSERT (
+  UINT64_STRING_MAX_SIZE + CRLF_LENGTH <= QEMU_FW_CFG_KNOB_VALUE_MAX_SIZE,
+  "QEMU_FW_CFG_KNOB_VALUE_MAX_SIZE too small for UINT64 strings"
+  );
+STATIC_ASSERT (
+  BOOL_STRING_MAX_SIZE + CRLF_LENGTH <= QEMU_FW_CFG_KNOB_VALUE_MAX_SIZE,
+  "QEMU_FW_CFG_KNOB_VALUE_MAX_SIZE too small for BOOL strings"
+  );
+
 //
 // Words recognized as representing TRUE or FALSE.
 //
@@ -42,8 +58,9 @@ STATIC CONST CHAR8 *CONST  mFalseString[] = {
 //
 
 /**
-  Look up FileName with QemuFwCfgFindFile() from QemuFwCfgLib. Read the fw_cfg
-  file into the caller-provided CHAR8 array. NUL-terminate the array.
+  Look up FileName in the knob cache, or, for names that the cache does not
+  cover, with QemuFwCfgFindFile() from QemuFwCfgLib. Copy the fw_cfg file
+  contents into the caller-provided CHAR8 array. NUL-terminate the array.
 
   @param[in] FileName        The name of the fw_cfg file to look up and read.
 
@@ -90,25 +107,49 @@ QemuFwCfgGetAsString (
   OUT    CHAR8        *Buffer
   )
 {
-  RETURN_STATUS         Status;
-  FIRMWARE_CONFIG_ITEM  FwCfgItem;
-  UINTN                 FwCfgSize;
+  RETURN_STATUS                 Status;
+  FIRMWARE_CONFIG_ITEM          FwCfgItem;
+  UINTN                         FwCfgSize;
+  CONST QEMU_FW_CFG_KNOB_CACHE  *Cache;
+  CONST QEMU_FW_CFG_KNOB        *Knob;
 
   if (!QemuFwCfgIsAvailable ()) {
     return RETURN_UNSUPPORTED;
   }
 
-  Status = QemuFwCfgFindFile (FileName, &FwCfgItem, &FwCfgSize);
-  if (RETURN_ERROR (Status)) {
-    return Status;
+  Cache = NULL;
+  if (QemuFwCfgIsKnobName (FileName)) {
+    Cache = QemuFwCfgGetKnobCache ();
   }
 
-  if (FwCfgSize > *BufferSize) {
-    return RETURN_PROTOCOL_ERROR;
-  }
+  if (Cache != NULL) {
+    //
+    // The cache covers every "opt/" fw_cfg file, so a miss is final.
+    //
+    Knob = QemuFwCfgLookupKnob (Cache, FileName);
+    if (Knob == NULL) {
+      return RETURN_NOT_FOUND;
+    }
 
-  QemuFwCfgSelectItem (FwCfgItem);
-  QemuFwCfgReadBytes (FwCfgSize, Buffer);
+    FwCfgSize = Knob->Size;
+    if (FwCfgSize > *BufferSize) {
+      return RETURN_PROTOCOL_ERROR;
+    }
+
+    CopyMem (Buffer, Knob->Value, FwCfgSize);
+  } else {
+    Status = QemuFwCfgFindFile (FileName, &FwCfgItem, &FwCfgSize);
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+
+    if (FwCfgSize > *BufferSize) {
+      return RETURN_PROTOCOL_ERROR;
+    }
+
+    QemuFwCfgSelectItem (FwCfgItem);
+    QemuFwCfgReadBytes (FwCfgSize, Buffer);
+  }
 
   //
   // If Buffer is already NUL-terminated due to fw_cfg contents, we're done.
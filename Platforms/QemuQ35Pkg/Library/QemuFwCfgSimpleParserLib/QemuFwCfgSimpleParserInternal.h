@@ -0,0 +1,92 @@
+/** @file
+  Internal declarations shared by the phase-specific instances of
+  QemuFwCfgSimpleParserLib.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef QEMU_FW_CFG_SIMPLE_PARSER_INTERNAL_H_
+#define QEMU_FW_CFG_SIMPLE_PARSER_INTERNAL_H_
+
+#include <Guid/QemuFwCfgKnobCache.h>
+
+/**
+  Return the "opt/" fw_cfg knob cache of the current phase, building it on
+  first use if necessary.
+
+  Implemented separately for each phase.
+
+  @return  The knob cache, or NULL if it is unavailable. The caller should then
+           fall back to looking up fw_cfg files directly.
+**/
+CONST QEMU_FW_CFG_KNOB_CACHE *
+QemuFwCfgGetKnobCache (
+  VOID
+  );
+
+/**
+  Count the fw_cfg files that QemuFwCfgPopulateKnobCache() would cache, and
+  calculate the size of the knob cache that holds them.
+
+  @param[out] CacheSize  On success, the number of bytes to allocate for the
+                         knob cache.
+
+  @retval RETURN_SUCCESS           CacheSize has been set.
+
+  @retval RETURN_UNSUPPORTED       Firmware configuration is unavailable.
+
+  @retval RETURN_OUT_OF_RESOURCES  There are too many "opt/" fw_cfg files to
+                                   cache.
+**/
+RETURN_STATUS
+QemuFwCfgGetKnobCacheSize (
+  OUT UINTN  *CacheSize
+  );
+
+/**
+  Populate a knob cache from the fw_cfg file directory.
+
+  @param[out] Cache      The buffer to populate, of the size reported by
+                         QemuFwCfgGetKnobCacheSize().
+
+  @param[in]  CacheSize  The size of Cache in bytes.
+**/
+VOID
+QemuFwCfgPopulateKnobCache (
+  OUT QEMU_FW_CFG_KNOB_CACHE  *Cache,
+  IN  UINTN                   CacheSize
+  );
+
+/**
+  Check whether a fw_cfg file name is covered by the knob cache.
+
+  @param[in] FileName  The fw_cfg file name to check.
+
+  @retval TRUE   FileName starts with QEMU_FW_CFG_KNOB_NAME_PREFIX.
+  @retval FALSE  Otherwise.
+**/
+BOOLEAN
+QemuFwCfgIsKnobName (
+  IN CONST CHAR8  *FileName
+  );
+
+/**
+  Look up an "opt/" fw_cfg file in a knob cache.
+
+  @param[in] Cache     The knob cache to search.
+
+  @param[in] FileName  The name of the fw_cfg file to look up.
+
+  @return  The cached knob, or NULL if no fw_cfg file called FileName exists.
+           The result is only authoritative if QemuFwCfgIsKnobName() returns
+           TRUE for FileName.
+**/
+CONST QEMU_FW_CFG_KNOB *
+QemuFwCfgLookupKnob (
+  IN CONST QEMU_FW_CFG_KNOB_CACHE  *Cache,
+  IN CONST CHAR8                   *FileName
+  );
+
+#endif
@@ -15,6 +15,7 @@
 #include <Library/PcdLib.h>
 #include <Library/SafeIntLib.h>
 #include <Library/SmmCpuFeaturesLib.h>
+#include <Library/SmmCpuSaveStateBatchLib.h>
 #include <Library/MmServicesTableLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <PiSmm.h>
@@ -838,8 +839,7 @@ GetRegisterIndex (
   This function supports reading a CPU Save State register in SMBase relocation
   handler.
 
-  @param[in]  CpuIndex       Specifies the zero-based index of the CPU save
-                             state.
+  @param[in]  CpuSaveState   The save state map of the target processor.
   @param[in]  RegisterIndex  Index into mSmmCpuWidthOffset[] look up table.
   @param[in]  Width          The number of bytes to read from the CPU save
                              state.
@@ -855,16 +855,12 @@ GetRegisterIndex (
 STATIC
 EFI_STATUS
 ReadSaveStateRegisterByIndex (
-  IN UINTN  CpuIndex,
-  IN UINTN  RegisterIndex,
-  IN UINTN  Width,
-  OUT VOID  *Buffer
+  IN CONST QEMU_SMRAM_SAVE_STATE_MAP  *CpuSaveState,
+  IN UINTN                            RegisterIndex,
+  IN UINTN                            Width,
+  OUT VOID                            *Buffer
   )
 {
-  QEMU_SMRAM_SAVE_STATE_MAP  *CpuSaveState;
-
-  CpuSaveState = (QEMU_SMRAM_SAVE_STATE_MAP *)gMmst->CpuSaveState[CpuIndex];
-
   if ((CpuSaveState->x86.SMMRevId & 0xFFFF) == 0) {
     //
     // If 32-bit mode width is zero, then the specified register can not be
@@ -1005,7 +1001,277 @@ SmmCpuFeaturesReadSaveStateRegister (
             EFI_UNSUPPORTED);
   }
 
-  return ReadSaveStateRegisterByIndex (CpuIndex, RegisterIndex, Width, Buffer);
+  return ReadSaveStateRegisterByIndex (
+           (QEMU_SMRAM_SAVE_STATE_MAP *)gMmst->CpuSaveState[CpuIndex],
+           RegisterIndex,
+           Width,
+           Buffer
+           );
+}
+
+///
+/// How SmmCpuFeaturesReadSaveStateRegisters() copies one requested register
+/// out of a save state map of a given layout: LoWidth bytes at OffsetLo,
+/// followed by HiWidth bytes at OffsetHi. OffsetLo is
+/// SMM_SAVE_STATE_BATCH_LMA for EFI_SMM_SAVE_STATE_REGISTER_LMA, whose value
+/// follows from the layout itself.
+///
+typedef struct {
+  UINT16    OffsetLo;
+  UINT16    OffsetHi;
+  UINT8     LoWidth;
+  UINT8     HiWidth;
+} SMM_SAVE_STATE_BATCH_FIELD;
+
+#define SMM_SAVE_STATE_BATCH_LMA  MAX_UINT16
+
+//
+// Save state map layouts, as told apart by the SMMRevId field.
+//
+#define SMM_SAVE_STATE_LAYOUT_32  0
+#define SMM_SAVE_STATE_LAYOUT_64  1
+
+/**
+  Work out how a batch request is copied out of save state maps of one
+  layout, with the checks that ReadSaveStateRegisterByIndex() makes for each
+  single read.
+
+  @param[in]  RegisterIndex  Index into mSmmCpuWidthOffset[] look up table,
+                             or zero for EFI_SMM_SAVE_STATE_REGISTER_LMA.
+  @param[in]  Width          The number of bytes requested.
+  @param[in]  Layout         SMM_SAVE_STATE_LAYOUT_32 or _64.
+  @param[out] Field          How the register is copied.
+
+  @retval EFI_SUCCESS            Field has been set.
+  @retval EFI_NOT_FOUND          The register is not defined for the layout.
+  @retval EFI_INVALID_PARAMETER  Width is too large for the register in the
+                                 layout.
+**/
+STATIC
+EFI_STATUS
+ResolveSaveStateBatchField (
+  IN  UINTN                       RegisterIndex,
+  IN  UINTN                       Width,
+  IN  UINTN                       Layout,
+  OUT SMM_SAVE_STATE_BATCH_FIELD  *Field
+  )
+{
+  CONST CPU_SMM_SAVE_STATE_LOOKUP_ENTRY  *Entry;
+
+  ZeroMem (Field, sizeof *Field);
+
+  if (RegisterIndex == 0) {
+    Field->OffsetLo = SMM_SAVE_STATE_BATCH_LMA;
+    return EFI_SUCCESS;
+  }
+
+  Entry = &mSmmCpuWidthOffset[RegisterIndex];
+  if (Layout == SMM_SAVE_STATE_LAYOUT_32) {
+    if (Entry->Width32 == 0) {
+      return EFI_NOT_FOUND;
+    }
+
+    if (Width > Entry->Width32) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Field->OffsetLo = Entry->Offset32;
+    Field->LoWidth  = (UINT8)Width;
+  } else {
+    if (Entry->Width64 == 0) {
+      return EFI_NOT_FOUND;
+    }
+
+    if (Width > Entry->Width64) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Field->OffsetLo = Entry->Offset64Lo;
+    Field->LoWidth  = (UINT8)MIN (4, Width);
+    Field->OffsetHi = Entry->Offset64Hi;
+    Field->HiWidth  = (UINT8)(Width - Field->LoWidth);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Read a set of SMM save state registers for one CPU or for all CPUs.
+
+  The registers are stored back to back in Buffer, in the order of Requests,
+  each taking Requests[Index].Width bytes. When CpuIndex is
+  SMM_CPU_SAVE_STATE_ALL_CPUS, the per-CPU blocks follow each other in CPU
+  index order.
+
+  Every request is resolved to save state offsets for both the 32-bit and the
+  64-bit layout before the save state maps are visited. The layout of each
+  map is then checked once, and the registers are copied without further
+  lookups.
+
+  @param[in]      CpuIndex       The index of the CPU to read, or
+                                 SMM_CPU_SAVE_STATE_ALL_CPUS.
+  @param[in]      RequestCount   The number of elements in Requests.
+  @param[in]      Requests       The registers to read, with their widths.
+  @param[in, out] BufferSize     On input, the size of Buffer in bytes. On
+                                 output, the number of bytes required or
+                                 written.
+  @param[out]     Buffer         Receives the register values.
+  @param[out]     FailedRequest  Optional. Receives the index in Requests of
+                                 the register that caused EFI_NOT_FOUND,
+                                 EFI_UNSUPPORTED or EFI_INVALID_PARAMETER for
+                                 a bad Width. Not modified otherwise.
+
+  @retval EFI_SUCCESS            All registers have been read.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL or out of range, or a
+                                 Width is not valid for the register in the
+                                 CPU mode of a save state map.
+  @retval EFI_BUFFER_TOO_SMALL   Buffer is too small; BufferSize has been
+                                 updated.
+  @retval EFI_NOT_FOUND          A register is not defined for the save state
+                                 of a processor.
+  @retval EFI_UNSUPPORTED        A register is not supported by the batch
+                                 interface.
+**/
+EFI_STATUS
+EFIAPI
+SmmCpuFeaturesReadSaveStateRegisters (
+  IN     UINTN                                      CpuIndex,
+  IN     UINTN                                      RequestCount,
+  IN     CONST SMM_CPU_SAVE_STATE_REGISTER_REQUEST  *Requests,
+  IN OUT UINTN                                      *BufferSize,
+  OUT    VOID                                       *Buffer,
+  OUT    UINTN                                      *FailedRequest OPTIONAL
+  )
+{
+  SMM_SAVE_STATE_BATCH_FIELD        Fields[2][SMM_CPU_SAVE_STATE_BATCH_MAX_REGISTERS];
+  EFI_STATUS                        LayoutStatus[2];
+  UINTN                             LayoutFailedRequest[2];
+  UINTN                             Layout;
+  UINTN                             RegisterIndex;
+  UINTN                             Request;
+  UINTN                             CpuBlockSize;
+  UINTN                             FirstCpu;
+  UINTN                             CpuCount;
+  UINTN                             RequiredSize;
+  UINTN                             Cpu;
+  UINT8                             *Output;
+  QEMU_SMRAM_SAVE_STATE_MAP         *CpuSaveState;
+  CONST SMM_SAVE_STATE_BATCH_FIELD  *Field;
+  EFI_STATUS                        Status;
+
+  if ((Requests == NULL) || (BufferSize == NULL) || (RequestCount == 0) ||
+      (RequestCount > SMM_CPU_SAVE_STATE_BATCH_MAX_REGISTERS))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (CpuIndex == SMM_CPU_SAVE_STATE_ALL_CPUS) {
+    FirstCpu = 0;
+    CpuCount = gMmst->NumberOfCpus;
+  } else if (CpuIndex < gMmst->NumberOfCpus) {
+    FirstCpu = CpuIndex;
+    CpuCount = 1;
+  } else {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Resolve all requests up front, for both layouts. A request that one
+  // layout cannot satisfy only fails the call if a CPU uses that layout.
+  //
+  LayoutStatus[SMM_SAVE_STATE_LAYOUT_32]        = EFI_SUCCESS;
+  LayoutStatus[SMM_SAVE_STATE_LAYOUT_64]        = EFI_SUCCESS;
+  LayoutFailedRequest[SMM_SAVE_STATE_LAYOUT_32] = 0;
+  LayoutFailedRequest[SMM_SAVE_STATE_LAYOUT_64] = 0;
+  CpuBlockSize                                  = 0;
+  for (Request = 0; Request < RequestCount; Request++) {
+    if (Requests[Request].Register == EFI_SMM_SAVE_STATE_REGISTER_LMA) {
+      if (Requests[Request].Width != 1) {
+        Status = EFI_INVALID_PARAMETER;
+        goto RequestFailed;
+      }
+
+      RegisterIndex = 0;
+    } else {
+      RegisterIndex = GetRegisterIndex (Requests[Request].Register);
+      if (RegisterIndex == 0) {
+        Status = (Requests[Request].Register < EFI_SMM_SAVE_STATE_REGISTER_IO ?
+                  EFI_NOT_FOUND :
+                  EFI_UNSUPPORTED);
+        goto RequestFailed;
+      }
+
+      if ((Requests[Request].Width == 0) || (Requests[Request].Width > 8)) {
+        Status = EFI_INVALID_PARAMETER;
+        goto RequestFailed;
+      }
+    }
+
+    for (Layout = SMM_SAVE_STATE_LAYOUT_32; Layout <= SMM_SAVE_STATE_LAYOUT_64; Layout++) {
+      if (EFI_ERROR (LayoutStatus[Layout])) {
+        continue;
+      }
+
+      LayoutStatus[Layout] = ResolveSaveStateBatchField (
+                               RegisterIndex,
+                               Requests[Request].Width,
+                               Layout,
+                               &Fields[Layout][Request]
+                               );
+      LayoutFailedRequest[Layout] = Request;
+    }
+
+    CpuBlockSize += Requests[Request].Width;
+  }
+
+  Status = SafeUintnMult (CpuBlockSize, CpuCount, &RequiredSize);
+  if (EFI_ERROR (Status)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Buffer == NULL) || (*BufferSize < RequiredSize)) {
+    *BufferSize = RequiredSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Output = Buffer;
+  for (Cpu = FirstCpu; Cpu < FirstCpu + CpuCount; Cpu++) {
+    CpuSaveState = (QEMU_SMRAM_SAVE_STATE_MAP *)gMmst->CpuSaveState[Cpu];
+    ASSERT (CpuSaveState != NULL);
+
+    Layout = ((CpuSaveState->x86.SMMRevId & 0xFFFF) == 0) ?
+             SMM_SAVE_STATE_LAYOUT_32 :
+             SMM_SAVE_STATE_LAYOUT_64;
+    if (EFI_ERROR (LayoutStatus[Layout])) {
+      Status  = LayoutStatus[Layout];
+      Request = LayoutFailedRequest[Layout];
+      goto RequestFailed;
+    }
+
+    for (Request = 0; Request < RequestCount; Request++) {
+      Field = &Fields[Layout][Request];
+      if (Field->OffsetLo == SMM_SAVE_STATE_BATCH_LMA) {
+        *Output = (Layout == SMM_SAVE_STATE_LAYOUT_32) ? 32 : 64;
+      } else {
+        CopyMem (Output, (UINT8 *)CpuSaveState + Field->OffsetLo, Field->LoWidth);
+        if (Field->HiWidth != 0) {
+          CopyMem (Output + 4, (UINT8 *)CpuSaveState + Field->OffsetHi, Field->HiWidth);
+        }
+      }
+
+      Output += Requests[Request].Width;
+    }
+  }
+
+  *BufferSize = RequiredSize;
+  return EFI_SUCCESS;
+
+RequestFailed:
+  if (FailedRequest != NULL) {
+    *FailedRequest = Request;
+  }
+
+  return Status;
 }
 
 /**
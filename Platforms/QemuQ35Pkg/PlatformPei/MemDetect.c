@@ -42,6 +42,8 @@ Module Name:
 
 UINT8  mPhysMemAddressWidth;
 
+STATIC BOOLEAN  mPage1GSupport;
+
 STATIC UINT32  mS3AcpiReservedMemoryBase;
 STATIC UINT32  mS3AcpiReservedMemorySize;
 
@@ -51,6 +53,13 @@ BOOLEAN  mQ35SmramAtDefaultSmbase;
 
 UINT32  mQemuUc32Base;
 
+//
+// The amount of >=4GB RAM that is still published as tested system memory.
+// RAM beyond it is published as untested, and is brought into the UEFI memory
+// map by the DXE core on demand. MAX_UINT64 means no limit.
+//
+STATIC UINT64  mTestedHighMemoryBudget = MAX_UINT64;
+
 VOID
 Q35TsegMbytesInitialization (
   VOID
@@ -194,6 +203,45 @@ QemuUc32BaseInitialization (
   }
 }
 
+/**
+  Produce memory resource descriptor HOBs for a >=4GB RAM range, honoring the
+  boot working set.
+
+  The head of the range is published as tested memory for as long as
+  mTestedHighMemoryBudget lasts; the rest is published as untested memory.
+
+  @param[in] Base  The inclusive start of the range.
+  @param[in] End   The exclusive end of the range.
+**/
+STATIC
+VOID
+AddHighMemoryRangeHob (
+  IN EFI_PHYSICAL_ADDRESS  Base,
+  IN EFI_PHYSICAL_ADDRESS  End
+  )
+{
+  UINT64  TestedSize;
+
+  TestedSize = MIN (End - Base, mTestedHighMemoryBudget);
+  if (TestedSize > 0) {
+    AddMemoryRangeHob (Base, Base + TestedSize);
+    if (mTestedHighMemoryBudget != MAX_UINT64) {
+      mTestedHighMemoryBudget -= TestedSize;
+    }
+  }
+
+  if (Base + TestedSize < End) {
+    AddUntestedMemoryRangeHob (Base + TestedSize, End);
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "%a: untested [0x%Lx, 0x%Lx)\n",
+      __FUNCTION__,
+      Base + TestedSize,
+      End
+      ));
+  }
+}
+
 /**
   Iterate over the RAM entries in QEMU's fw_cfg E820 RAM map that start outside
   of the 32-bit address range.
@@ -274,10 +322,10 @@ ScanOrAdd64BitE820Ram (
         End  = (E820Entry.BaseAddr + E820Entry.Length) &
                ~(UINT64)EFI_PAGE_MASK;
         if (Base < End) {
-          AddMemoryRangeHob (Base, End);
+          AddHighMemoryRangeHob (Base, End);
           DEBUG ((
             DEBUG_VERBOSE,
-            "%a: AddMemoryRangeHob [0x%Lx, 0x%Lx)\n",
+            "%a: AddHighMemoryRangeHob [0x%Lx, 0x%Lx)\n",
             __FUNCTION__,
             Base,
             End
@@ -542,6 +590,70 @@ GetFirstNonAddress (
   return FirstNonAddress;
 }
 
+/**
+  Determine whether the DXE IPL should map memory with 1GB pages, and set
+  PcdUse1GPageTable accordingly.
+
+  1GB pages are used if the platform DSC enables them, or, under KVM, if the
+  virtual CPU supports them. With 1GB pages, the identity mapping of a 48-bit
+  address space needs at most 513 pages of page tables rather than 0x40201.
+**/
+STATIC
+VOID
+Page1GSupportInitialization (
+  VOID
+  )
+{
+  UINT32         RegEax;
+  UINT32         RegEbx;
+  UINT32         RegEcx;
+  UINT32         RegEdx;
+  BOOLEAN        CpuSupport;
+  BOOLEAN        Kvm;
+  RETURN_STATUS  PcdStatus;
+
+  CpuSupport = FALSE;
+  AsmCpuid (0x80000000, &RegEax, NULL, NULL, NULL);
+  if (RegEax >= 0x80000001) {
+    AsmCpuid (0x80000001, NULL, NULL, NULL, &RegEdx);
+    if ((RegEdx & BIT26) != 0) {
+      CpuSupport = TRUE;
+    }
+  }
+
+  //
+  // The hypervisor CPUID leaves are only valid when CPUID.1:ECX[31] is set.
+  // KVM identifies itself with the "KVMKVMKVM\0\0\0" signature.
+  //
+  Kvm = FALSE;
+  AsmCpuid (0x1, NULL, NULL, &RegEcx, NULL);
+  if ((RegEcx & BIT31) != 0) {
+    AsmCpuid (0x40000000, NULL, &RegEbx, &RegEcx, &RegEdx);
+    if ((RegEbx == SIGNATURE_32 ('K', 'V', 'M', 'K')) &&
+        (RegEcx == SIGNATURE_32 ('V', 'M', 'K', 'V')) &&
+        (RegEdx == SIGNATURE_32 ('M', 0, 0, 0)))
+    {
+      Kvm = TRUE;
+    }
+  }
+
+  mPage1GSupport = CpuSupport && (Kvm || PcdGetBool (PcdUse1GPageTable));
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: CpuSupport=%d Kvm=%d Use1GPageTable=%d\n",
+    __FUNCTION__,
+    CpuSupport,
+    Kvm,
+    mPage1GSupport
+    ));
+
+  if (mPage1GSupport != PcdGetBool (PcdUse1GPageTable)) {
+    PcdStatus = PcdSetBoolS (PcdUse1GPageTable, mPage1GSupport);
+    ASSERT_RETURN_ERROR (PcdStatus);
+  }
+}
+
 /**
   Initialize the mPhysMemAddressWidth variable, based on guest RAM size.
 **/
@@ -580,6 +692,8 @@ AddressWidthInitialization (
   }
 
   ASSERT (mPhysMemAddressWidth <= 48);
+
+  Page1GSupportInitialization ();
 }
 
 /**
@@ -591,12 +705,9 @@ GetPeiMemoryCap (
   VOID
   )
 {
-  BOOLEAN  Page1GSupport;
-  UINT32   RegEax;
-  UINT32   RegEdx;
-  UINT32   Pml4Entries;
-  UINT32   PdpEntries;
-  UINTN    TotalPages;
+  UINT32  Pml4Entries;
+  UINT32  PdpEntries;
+  UINTN   TotalPages;
 
   //
   // If DXE is 32-bit, then just return the traditional 64 MB cap.
@@ -612,19 +723,11 @@ GetPeiMemoryCap (
   // Dependent on physical address width, PEI memory allocations can be
   // dominated by the page tables built for 64-bit DXE. So we key the cap off
   // of those. The code below is based on CreateIdentityMappingPageTables() in
-  // "MdeModulePkg/Core/DxeIplPeim/X64/VirtualMemory.c".
+  // "MdeModulePkg/Core/DxeIplPeim/X64/VirtualMemory.c". The DXE IPL maps the
+  // entire address width from the CPU HOB; AddressWidthInitialization() keeps
+  // that width down to what the RAM, the memory hotplug area and the 64-bit
+  // PCI host aperture need.
   //
-  Page1GSupport = FALSE;
-  if (PcdGetBool (PcdUse1GPageTable)) {
-    AsmCpuid (0x80000000, &RegEax, NULL, NULL, NULL);
-    if (RegEax >= 0x80000001) {
-      AsmCpuid (0x80000001, NULL, NULL, NULL, &RegEdx);
-      if ((RegEdx & BIT26) != 0) {
-        Page1GSupport = TRUE;
-      }
-    }
-  }
-
   if (mPhysMemAddressWidth <= 39) {
     Pml4Entries = 1;
     PdpEntries  = 1 << (mPhysMemAddressWidth - 30);
@@ -635,10 +738,20 @@ GetPeiMemoryCap (
     PdpEntries = 512;
   }
 
-  TotalPages = Page1GSupport ? Pml4Entries + 1 :
+  TotalPages = mPage1GSupport ? Pml4Entries + 1 :
                (PdpEntries + 1) * Pml4Entries + 1;
   ASSERT (TotalPages <= 0x40201);
 
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: identity mapping of %d bits with %a pages needs %Lu page table pages (%Lu KB)\n",
+    __FUNCTION__,
+    mPhysMemAddressWidth,
+    mPage1GSupport ? "1GB" : "2MB",
+    (UINT64)TotalPages,
+    (UINT64)EFI_PAGES_TO_SIZE (TotalPages) >> 10
+    ));
+
   //
   // Add 64 MB for miscellaneous allocations. Note that for
   // mPhysMemAddressWidth values close to 36, the cap will actually be
@@ -762,6 +875,85 @@ QemuInitializeRamBelow1gb (
   }
 }
 
+/**
+  Determine how much >=4GB RAM to publish as tested memory.
+
+  The boot working set is the total amount of RAM the firmware makes available
+  to itself during boot; it is taken from the "opt/org.tianocore/BootWorkingSetMb"
+  fw_cfg file if present, and from PcdBootWorkingSetMb otherwise. Zero means
+  that all RAM is published as tested memory.
+
+  The RAM below 4GB always counts as tested, so the budget left for the RAM
+  above 4GB is the working set minus LowerMemorySize.
+
+  @param[in] LowerMemorySize  The size of the RAM below 4GB.
+**/
+STATIC
+VOID
+InitializeTestedHighMemoryBudget (
+  IN UINT64  LowerMemorySize
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      WorkingSetMb;
+  UINT64      WorkingSet;
+
+  Status = QemuFwCfgParseUint32 (
+             "opt/org.tianocore/BootWorkingSetMb",
+             FALSE,
+             &WorkingSetMb
+             );
+  switch (Status) {
+    case EFI_UNSUPPORTED:
+    case EFI_NOT_FOUND:
+      WorkingSetMb = PcdGet32 (PcdBootWorkingSetMb);
+      break;
+    case EFI_SUCCESS:
+      break;
+    default:
+      DEBUG ((
+        DEBUG_WARN,
+        "%a: ignoring malformed boot working set size from fw_cfg\n",
+        __FUNCTION__
+        ));
+      WorkingSetMb = PcdGet32 (PcdBootWorkingSetMb);
+      break;
+  }
+
+  if (WorkingSetMb == 0) {
+    return;
+  }
+
+  //
+  // Under SEV, all system memory has to be accepted / validated by the
+  // firmware before the OS may use it, which the DXE core's on-demand
+  // promotion does not do.
+  //
+  if (MemEncryptSevIsEnabled ()) {
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: SEV is active, ignoring the boot working set\n",
+      __FUNCTION__
+      ));
+    return;
+  }
+
+  WorkingSet = LShiftU64 (WorkingSetMb, 20);
+  if (WorkingSet > LowerMemorySize) {
+    mTestedHighMemoryBudget = WorkingSet - LowerMemorySize;
+  } else {
+    mTestedHighMemoryBudget = 0;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: boot working set %u MB, tested >=4GB RAM limited to 0x%Lx\n",
+    __FUNCTION__,
+    WorkingSetMb,
+    mTestedHighMemoryBudget
+    ));
+}
+
 /**
   Peform Memory Detection for QEMU / KVM
 
@@ -829,13 +1021,15 @@ QemuInitializeRam (
     //
     // If QEMU presents an E820 map, then create memory HOBs for the >=4GB RAM
     // entries. Otherwise, create a single memory HOB with the flat >=4GB
-    // memory size read from the CMOS.
+    // memory size read from the CMOS. RAM beyond the boot working set is
+    // published as untested memory.
     //
+    InitializeTestedHighMemoryBudget (LowerMemorySize);
     Status = ScanOrAdd64BitE820Ram (TRUE, NULL, NULL);
     if (EFI_ERROR (Status)) {
       UpperMemorySize = GetSystemMemorySizeAbove4gb ();
       if (UpperMemorySize != 0) {
-        AddMemoryBaseSizeHob (BASE_4GB, UpperMemorySize);
+        AddHighMemoryRangeHob (BASE_4GB, BASE_4GB + UpperMemorySize);
       }
     }
   }
@@ -12,6 +12,8 @@ import datetime
 import re
 import io
 import shutil
+import subprocess
+import time
 from pathlib import Path
 from edk2toolext.environment.plugintypes import uefi_helper_plugin
 from edk2toollib import utility_functions
@@ -46,12 +48,38 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
         return ver_str.split('.')
 
 
+    @staticmethod
+    # start virtiofsd to serve a host directory to the guest over a vhost-user socket
+    def StartVirtiofsd(exec, shared_dir, socket_path):
+        if os.path.exists(socket_path):
+            os.remove(socket_path)
+
+        cmd = [exec, f"--socket-path={socket_path}", f"--shared-dir={shared_dir}", "--cache=auto"]
+        if os.geteuid() != 0:
+            # the default namespace sandbox needs privileges
+            cmd.append("--sandbox=none")
+
+        logging.log(logging.INFO, f"Sharing {shared_dir} through virtiofsd.")
+        proc = subprocess.Popen(cmd)
+
+        # QEMU refuses to start if the socket does not exist yet
+        for _ in range(50):
+            if os.path.exists(socket_path):
+                return proc
+            if proc.poll() is not None:
+                break
+            time.sleep(0.1)
+
+        proc.kill()
+        raise Exception(f"virtiofsd failed to create {socket_path}")
+
     @staticmethod
     def Runner(env):
         ''' Runs QEMU '''
         VirtualDrive = env.GetValue("VIRTUAL_DRIVE_PATH")
         OutputPath_FV = os.path.join(env.GetValue("BUILD_OUTPUT_BASE"), "FV")
         repo_version = env.GetValue("VERSION", "Unknown")
+        virtiofs_shares = []  # (host directory, tag) pairs served through virtiofsd
 
         # Use a provided QEMU path. Otherwise use what is provided through the extdep
         executable = env.GetValue("QEMU_PATH", None)
@@ -92,7 +120,7 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
         path_to_os = env.GetValue("PATH_TO_OS")
         if path_to_os is not None:
             # Potentially dealing with big daddy, give it more juice...
-            args += " -m 8192"
+            mem_size = 8192
 
             file_extension = Path(path_to_os).suffix.lower().replace('"', '')
 
@@ -111,7 +139,8 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
                 args += f" -drive file=\"{path_to_os}\",format={storage_format},if=none,id=os_nvme"
                 args += " -device nvme,serial=nvme-1,drive=os_nvme"
         else:
-            args += " -m 2048"
+            mem_size = 2048
+        args += f" -m {mem_size}"
 
         cpu_model = env.GetValue("CPU_MODEL")
         if cpu_model is None:
@@ -142,17 +171,41 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
             use_this_varstore = orig_var_store
         args += " -drive if=pflash,format=raw,unit=1,file=" + use_this_varstore
 
-        # Add XHCI USB controller and mouse
-        args += " -device qemu-xhci,id=usb"
-        args += " -device usb-tablet,id=input0,bus=usb.0,port=1"  # add a usb mouse
-        #args += " -device usb-kbd,id=input1,bus=usb.0,port=2"    # add a usb keyboard
-
         dfci_files = env.GetValue("DFCI_FILES")
+        install_files = env.GetValue("INSTALL_FILES")
+
+        # Host directories are shared through virtiofsd when it is available,
+        # and emulated as FAT disks by QEMU otherwise
+        virtiofsd_path = env.GetValue("VIRTIOFSD_PATH")
+        if os.name == 'nt':
+            virtiofsd_path = None
+
+        if dfci_files is not None and virtiofsd_path is not None and os.path.isdir(dfci_files):
+            virtiofs_shares.append((dfci_files, "DfciFiles"))
+            dfci_files = None
+
+        if install_files is not None and virtiofsd_path is not None and os.path.isdir(install_files):
+            virtiofs_shares.append((install_files, "InstallFiles"))
+            install_files = None
+
+        input_devices = env.GetValue("QEMU_INPUT", "USB").upper()
+        if input_devices == "VIRTIO":
+            # virtio-input devices are only serviced when the firmware reads input,
+            # unlike USB and PS/2 controllers, which the firmware polls on a timer
+            args += " -device virtio-keyboard-pci"
+            args += " -device virtio-tablet-pci"
+            if dfci_files is not None or install_files is not None:
+                args += " -device qemu-xhci,id=usb"  # for the usb-storage devices below
+        else:
+            # Add XHCI USB controller and mouse
+            args += " -device qemu-xhci,id=usb"
+            args += " -device usb-tablet,id=input0,bus=usb.0,port=1"  # add a usb mouse
+            #args += " -device usb-kbd,id=input1,bus=usb.0,port=2"    # add a usb keyboard
+
         if dfci_files is not None:
             args += f" -drive file=fat:rw:{dfci_files},format=raw,media=disk,if=none,id=dfci_disk"
             args += " -device usb-storage,bus=usb.0,drive=dfci_disk"
 
-        install_files = env.GetValue("INSTALL_FILES")
         if install_files is not None:
             args += f" -drive file={install_files},format=raw,media=disk,if=none,id=install_disk"
             args += " -device usb-storage,bus=usb.0,drive=install_disk"
@@ -175,7 +228,10 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
             if os.path.isfile(VirtualDrive):
                 args += f" -drive file={VirtualDrive},if=virtio"
             elif os.path.isdir(VirtualDrive):
-                args += f" -drive file=fat:rw:{VirtualDrive},format=raw,media=disk"
+                if virtiofsd_path is not None:
+                    virtiofs_shares.append((VirtualDrive, "VirtualDrive"))
+                else:
+                    args += f" -drive file=fat:rw:{VirtualDrive},format=raw,media=disk"
             else:
                 logging.critical("Virtual Drive Path Invalid")
 
@@ -226,6 +282,15 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
         if serial_port != None:
             args += " -serial tcp:127.0.0.1:" + serial_port + ",server,nowait"
 
+        # write DXE log output to a host file or named pipe through a virtio-console device
+        virtio_console_log = env.GetValue("VIRTIO_CONSOLE_LOG")
+        if virtio_console_log is not None:
+            if (env.GetBuildValue("VIRTIO_CONSOLE_LOG_ENABLE") or "FALSE").upper() != "TRUE":
+                logging.warning("VIRTIO_CONSOLE_LOG is set, but the firmware was not built with VIRTIO_CONSOLE_LOG_ENABLE=TRUE.")
+            args += f" -chardev file,id=vcon0,path=\"{virtio_console_log}\""
+            args += " -device virtio-serial-pci,id=vser0"
+            args += " -device virtconsole,bus=vser0.0,nr=0,chardev=vcon0"
+
         # Connect the debug monitor to a telnet localhost port
         monitor_port = env.GetValue("MONITOR_PORT")
         if monitor_port is not None:
@@ -240,8 +305,24 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
             except Exception:
                 std_handle = None
 
-        # Run QEMU
-        ret = utility_functions.RunCmd(executable, args)
+        # Run QEMU. The virtiofsd daemons are started last, so that nothing but
+        # QEMU itself runs between starting and stopping them.
+        virtiofsd = []
+        try:
+            if len(virtiofs_shares) > 0:
+                # vhost-user devices need guest RAM that the daemons can map
+                args += f" -object memory-backend-memfd,id=mem,size={mem_size}M,share=on -numa node,memdev=mem"
+            for index, (shared_dir, tag) in enumerate(virtiofs_shares):
+                socket_path = os.path.join(env.GetValue("BUILD_OUTPUT_BASE"), f"virtiofsd-{tag}.sock")
+                virtiofsd.append(QemuRunner.StartVirtiofsd(virtiofsd_path, shared_dir, socket_path))
+                args += f" -chardev socket,id=vfs{index},path={socket_path}"
+                args += f" -device vhost-user-fs-pci,chardev=vfs{index},tag={tag}"
+
+            ret = utility_functions.RunCmd(executable, args)
+        finally:
+            for daemon in virtiofsd:
+                daemon.terminate()
+                daemon.wait()
 
         ## TODO: restore the customized RunCmd once unit tests with asserts are figured out
         if ret == 0xc0000005:
@@ -26,6 +26,7 @@
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/LoadFile2.h>
+#include <Protocol/QemuKernelLoaderBlob.h>
 #include <Protocol/SimpleFileSystem.h>
 
 //
@@ -916,6 +917,58 @@ STATIC CONST EFI_LOAD_FILE2_PROTOCOL  mInitrdLoadFile2 = {
   InitrdLoadFile2,
 };
 
+/**
+  Look up a resident blob by the name under which it is exposed in the QEMU
+  kernel loader file system.
+
+  @param[in]  This      The QEMU_KERNEL_LOADER_BLOB_PROTOCOL instance.
+  @param[in]  FileName  Name of the blob: L"kernel", L"initrd" or L"cmdline".
+  @param[out] Data      On success, points to the blob contents in
+                        mKernelBlob.
+  @param[out] Size      On success, the size of the blob in bytes.
+
+  @retval EFI_SUCCESS            The blob has been located.
+  @retval EFI_INVALID_PARAMETER  FileName, Data or Size is NULL.
+  @retval EFI_NOT_FOUND          No blob by that name, or the blob is empty.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+KernelLoaderGetBlob (
+  IN  QEMU_KERNEL_LOADER_BLOB_PROTOCOL  *This,
+  IN  CONST CHAR16                      *FileName,
+  OUT CONST VOID                        **Data,
+  OUT UINTN                             *Size
+  )
+{
+  UINTN  BlobType;
+
+  if ((FileName == NULL) || (Data == NULL) || (Size == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (BlobType = 0; BlobType < KernelBlobTypeMax; ++BlobType) {
+    CONST KERNEL_BLOB  *Blob;
+
+    Blob = &mKernelBlob[BlobType];
+    if (StrCmp (FileName, Blob->Name) == 0) {
+      if (Blob->Size == 0) {
+        return EFI_NOT_FOUND;
+      }
+
+      *Data = Blob->Data;
+      *Size = Blob->Size;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+STATIC QEMU_KERNEL_LOADER_BLOB_PROTOCOL  mKernelLoaderBlob = {
+  KernelLoaderGetBlob,
+};
+
 //
 // Utility functions.
 //
@@ -1086,7 +1139,10 @@ QemuKernelLoaderFsDxeEntrypoint (
 
   //
   // Create a new handle with a single VenMedia() node device path protocol on
-  // it, plus a custom SimpleFileSystem protocol on it.
+  // it, plus a custom SimpleFileSystem protocol on it. The blob protocol lets
+  // QemuLoadImageLib hand the resident kernel to LoadImage() as SourceBuffer,
+  // rather than having the DXE core read another copy through the file
+  // system.
   //
   FileSystemHandle = NULL;
   Status           = gBS->InstallMultipleProtocolInterfaces (
@@ -1095,6 +1151,8 @@ QemuKernelLoaderFsDxeEntrypoint (
                             &mFileSystemDevicePath,
                             &gEfiSimpleFileSystemProtocolGuid,
                             &mFileSystem,
+                            &gQemuKernelLoaderBlobProtocolGuid,
+                            &mKernelLoaderBlob,
                             NULL
                             );
   if (EFI_ERROR (Status)) {
@@ -1137,6 +1195,8 @@ UninstallFileSystemHandle:
                   &mFileSystemDevicePath,
                   &gEfiSimpleFileSystemProtocolGuid,
                   &mFileSystem,
+                  &gQemuKernelLoaderBlobProtocolGuid,
+                  &mKernelLoaderBlob,
                   NULL
                   );
   ASSERT_EFI_ERROR (Status);
@@ -9,13 +9,16 @@
 **/
 
 #include <Protocol/GraphicsOutput.h>
+#include <Protocol/QemuRamfbShadow.h>
 
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/DevicePathLib.h>
+#include <Library/DxeServicesTableLib.h>
 #include <Library/FrameBufferBltLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/QemuFwCfgLib.h>
 
@@ -24,6 +27,32 @@
 #define RAMFB_FORMAT  0x34325258 /* DRM_FORMAT_XRGB8888 */
 #define RAMFB_BPP     4
 
+//
+// Blt() draws into a cacheable shadow buffer and records the damage; the
+// damage is copied to the framebuffer from a periodic timer, so that the many
+// small Blt() calls of a text console turn into a few row span copies. The
+// framebuffer itself is mapped write-combining, as it is only ever written.
+// Blt() reads (EfiBltVideoToBltBuffer, EfiBltVideoToVideo) are served from the
+// shadow buffer, that is, they return what was drawn through Blt(), and never
+// read the uncached framebuffer. Callers that draw into Mode->FrameBufferBase
+// directly ask for their scan lines to be copied into the shadow buffer with
+// QEMU_RAMFB_SHADOW_PROTOCOL.Sync().
+//
+#define RAMFB_FLUSH_PERIOD  EFI_TIMER_PERIOD_MILLISECONDS (20)
+
+#define RAMFB_CACHE_ATTRIBUTE_MASK \
+  (EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB | \
+   EFI_MEMORY_UCE)
+
+//
+// The damaged columns [Left, Right) of one scan line. Right == 0 means the
+// scan line is clean.
+//
+typedef struct {
+  UINT32    Left;
+  UINT32    Right;
+} RAMFB_DIRTY_SPAN;
+
 #pragma pack (1)
 typedef struct RAMFB_CONFIG {
   UINT64    Address;
@@ -40,6 +69,12 @@ STATIC EFI_HANDLE              mGopHandle;
 STATIC FRAME_BUFFER_CONFIGURE  *mQemuRamfbFrameBufferBltConfigure;
 STATIC UINTN                   mQemuRamfbFrameBufferBltConfigureSize;
 STATIC FIRMWARE_CONFIG_ITEM    mRamfbFwCfgItem;
+STATIC VOID                    *mQemuRamfbShadow;
+STATIC RAMFB_DIRTY_SPAN        *mQemuRamfbDirtySpans;
+STATIC UINT32                  mQemuRamfbDirtyTop;
+STATIC UINT32                  mQemuRamfbDirtyBottom;
+STATIC EFI_EVENT               mQemuRamfbFlushTimer;
+STATIC EFI_EVENT               mQemuRamfbExitBootServicesEvent;
 
 STATIC EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  mQemuRamfbModeInfo[] = {
   {
@@ -64,6 +99,234 @@ STATIC EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE  mQemuRamfbMode = {
   sizeof (EFI_GRAPHICS_OUTPUT_MODE_INFORMATION),  // SizeOfInfo
 };
 
+/**
+  Record that a rectangle of the shadow buffer differs from the framebuffer.
+
+  The caller is responsible for running at TPL_NOTIFY.
+
+  @param[in] X       The leftmost column of the rectangle.
+  @param[in] Y       The top scan line of the rectangle.
+  @param[in] Width   The width of the rectangle.
+  @param[in] Height  The height of the rectangle.
+**/
+STATIC
+VOID
+QemuRamfbMarkDirty (
+  IN UINTN  X,
+  IN UINTN  Y,
+  IN UINTN  Width,
+  IN UINTN  Height
+  )
+{
+  UINTN             Row;
+  RAMFB_DIRTY_SPAN  *Span;
+
+  if ((Width == 0) || (Height == 0)) {
+    return;
+  }
+
+  for (Row = Y; Row < Y + Height; Row++) {
+    Span = &mQemuRamfbDirtySpans[Row];
+    if (Span->Right == 0) {
+      Span->Left  = (UINT32)X;
+      Span->Right = (UINT32)(X + Width);
+    } else {
+      Span->Left  = MIN (Span->Left, (UINT32)X);
+      Span->Right = MAX (Span->Right, (UINT32)(X + Width));
+    }
+  }
+
+  if (mQemuRamfbDirtyTop >= mQemuRamfbDirtyBottom) {
+    mQemuRamfbDirtyTop    = (UINT32)Y;
+    mQemuRamfbDirtyBottom = (UINT32)(Y + Height);
+  } else {
+    mQemuRamfbDirtyTop    = MIN (mQemuRamfbDirtyTop, (UINT32)Y);
+    mQemuRamfbDirtyBottom = MAX (mQemuRamfbDirtyBottom, (UINT32)(Y + Height));
+  }
+}
+
+/**
+  Copy the damaged parts of the shadow buffer to the framebuffer.
+
+  Runs of consecutive scan lines that are damaged across the full width are
+  copied with a single CopyMem(), as the scan lines are contiguous in both
+  buffers. Other scan lines are copied span by span.
+
+  The caller is responsible for running at TPL_NOTIFY, except at
+  ExitBootServices().
+**/
+STATIC
+VOID
+QemuRamfbFlush (
+  VOID
+  )
+{
+  UINT32            Width;
+  UINT32            Row;
+  UINT32            RunEnd;
+  UINTN             Offset;
+  RAMFB_DIRTY_SPAN  *Span;
+
+  Width = mQemuRamfbMode.Info->HorizontalResolution;
+  Row   = mQemuRamfbDirtyTop;
+  while (Row < mQemuRamfbDirtyBottom) {
+    Span = &mQemuRamfbDirtySpans[Row];
+    if (Span->Right == 0) {
+      Row++;
+      continue;
+    }
+
+    Offset = ((UINTN)Row * Width + Span->Left) * RAMFB_BPP;
+    if ((Span->Left == 0) && (Span->Right == Width)) {
+      RunEnd = Row + 1;
+      while ((RunEnd < mQemuRamfbDirtyBottom) &&
+             (mQemuRamfbDirtySpans[RunEnd].Left == 0) &&
+             (mQemuRamfbDirtySpans[RunEnd].Right == Width))
+      {
+        mQemuRamfbDirtySpans[RunEnd].Right = 0;
+        RunEnd++;
+      }
+    } else {
+      RunEnd = Row + 1;
+    }
+
+    CopyMem (
+      (UINT8 *)(UINTN)mQemuRamfbMode.FrameBufferBase + Offset,
+      (UINT8 *)mQemuRamfbShadow + Offset,
+      (((UINTN)(RunEnd - Row - 1) * Width) + Span->Right - Span->Left) *
+      RAMFB_BPP
+      );
+    Span->Right = 0;
+    Row         = RunEnd;
+  }
+
+  mQemuRamfbDirtyTop    = 0;
+  mQemuRamfbDirtyBottom = 0;
+}
+
+/**
+  Copy scan lines of the framebuffer into the shadow buffer, for callers that
+  drew into Mode->FrameBufferBase directly. The outstanding damage is flushed
+  first, so that nothing drawn through Blt() is lost.
+
+  @param[in] This    The QEMU_RAMFB_SHADOW_PROTOCOL instance.
+  @param[in] Y       The top scan line to copy.
+  @param[in] Height  The number of scan lines to copy.
+
+  @retval EFI_SUCCESS            The scan lines have been copied.
+  @retval EFI_INVALID_PARAMETER  The range is outside of the current mode.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+QemuRamfbShadowSync (
+  IN QEMU_RAMFB_SHADOW_PROTOCOL  *This,
+  IN UINTN                       Y,
+  IN UINTN                       Height
+  )
+{
+  UINTN    Offset;
+  EFI_TPL  OldTpl;
+
+  if ((Y > mQemuRamfbMode.Info->VerticalResolution) ||
+      (Height > mQemuRamfbMode.Info->VerticalResolution - Y))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  QemuRamfbFlush ();
+
+  Offset = Y * mQemuRamfbMode.Info->HorizontalResolution * RAMFB_BPP;
+  CopyMem (
+    (UINT8 *)mQemuRamfbShadow + Offset,
+    (UINT8 *)(UINTN)mQemuRamfbMode.FrameBufferBase + Offset,
+    Height * mQemuRamfbMode.Info->HorizontalResolution * RAMFB_BPP
+    );
+
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+STATIC QEMU_RAMFB_SHADOW_PROTOCOL  mQemuRamfbShadowProtocol = {
+  QemuRamfbShadowSync
+};
+
+/**
+  Periodic timer callback that flushes the damage.
+
+  @param[in] Event    The flush timer.
+  @param[in] Context  Unused.
+**/
+STATIC
+VOID
+EFIAPI
+QemuRamfbFlushTimerNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  QemuRamfbFlush ();
+}
+
+/**
+  Flush the outstanding damage before the OS takes over the framebuffer.
+
+  @param[in] Event    The ExitBootServices event.
+  @param[in] Context  Unused.
+**/
+STATIC
+VOID
+EFIAPI
+QemuRamfbExitBootServicesNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  QemuRamfbFlush ();
+}
+
+/**
+  Change the cache attribute of a range of system memory in the GCD memory
+  space map, preserving the other attributes.
+
+  @param[in] Base           The base address of the range.
+  @param[in] Size           The size of the range.
+  @param[in] CacheAttribute The EFI_MEMORY_* cache attribute to set.
+
+  @retval EFI_UNSUPPORTED  The range does not support CacheAttribute.
+  @return                  Error codes from the GCD services.
+**/
+STATIC
+EFI_STATUS
+QemuRamfbSetCacheAttribute (
+  IN EFI_PHYSICAL_ADDRESS  Base,
+  IN UINT64                Size,
+  IN UINT64                CacheAttribute
+  )
+{
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR  Descriptor;
+  EFI_STATUS                       Status;
+
+  Status = gDS->GetMemorySpaceDescriptor (Base, &Descriptor);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((Descriptor.Capabilities & CacheAttribute) == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  return gDS->SetMemorySpaceAttributes (
+                Base,
+                Size,
+                (Descriptor.Attributes & ~RAMFB_CACHE_ATTRIBUTE_MASK) |
+                CacheAttribute
+                );
+}
+
 STATIC
 EFI_STATUS
 EFIAPI
@@ -109,6 +372,7 @@ QemuRamfbGraphicsOutputSetMode (
   RAMFB_CONFIG                          Config;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL         Black;
   RETURN_STATUS                         Status;
+  EFI_TPL                               OldTpl;
 
   if (ModeNumber >= mQemuRamfbMode.MaxMode) {
     return EFI_UNSUPPORTED;
@@ -131,8 +395,11 @@ QemuRamfbGraphicsOutputSetMode (
   Config.Height  = SwapBytes32 (ModeInfo->VerticalResolution);
   Config.Stride  = SwapBytes32 (ModeInfo->HorizontalResolution * RAMFB_BPP);
 
+  //
+  // FrameBufferBlt() operates on the shadow buffer; see QemuRamfbFlush().
+  //
   Status = FrameBufferBltConfigure (
-             (VOID *)(UINTN)mQemuRamfbMode.FrameBufferBase,
+             mQemuRamfbShadow,
              ModeInfo,
              mQemuRamfbFrameBufferBltConfigure,
              &mQemuRamfbFrameBufferBltConfigureSize
@@ -151,7 +418,7 @@ QemuRamfbGraphicsOutputSetMode (
     }
 
     Status = FrameBufferBltConfigure (
-               (VOID *)(UINTN)mQemuRamfbMode.FrameBufferBase,
+               mQemuRamfbShadow,
                ModeInfo,
                mQemuRamfbFrameBufferBltConfigure,
                &mQemuRamfbFrameBufferBltConfigureSize
@@ -163,8 +430,16 @@ QemuRamfbGraphicsOutputSetMode (
     return Status;
   }
 
-  mQemuRamfbMode.Mode = ModeNumber;
-  mQemuRamfbMode.Info = ModeInfo;
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  mQemuRamfbMode.Mode   = ModeNumber;
+  mQemuRamfbMode.Info   = ModeInfo;
+  mQemuRamfbDirtyTop    = 0;
+  mQemuRamfbDirtyBottom = 0;
+  ZeroMem (
+    mQemuRamfbDirtySpans,
+    ModeInfo->VerticalResolution * sizeof (RAMFB_DIRTY_SPAN)
+    );
 
   QemuFwCfgSelectItem (mRamfbFwCfgItem);
   QemuFwCfgWriteBytes (sizeof (Config), &Config);
@@ -194,6 +469,16 @@ QemuRamfbGraphicsOutputSetMode (
       ));
   }
 
+  QemuRamfbMarkDirty (
+    0,
+    0,
+    ModeInfo->HorizontalResolution,
+    ModeInfo->VerticalResolution
+    );
+  QemuRamfbFlush ();
+
+  gBS->RestoreTPL (OldTpl);
+
   return EFI_SUCCESS;
 }
 
@@ -213,18 +498,30 @@ QemuRamfbGraphicsOutputBlt (
   IN  UINTN                              Delta
   )
 {
-  return FrameBufferBlt (
-           mQemuRamfbFrameBufferBltConfigure,
-           BltBuffer,
-           BltOperation,
-           SourceX,
-           SourceY,
-           DestinationX,
-           DestinationY,
-           Width,
-           Height,
-           Delta
-           );
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  Status = FrameBufferBlt (
+             mQemuRamfbFrameBufferBltConfigure,
+             BltBuffer,
+             BltOperation,
+             SourceX,
+             SourceY,
+             DestinationX,
+             DestinationY,
+             Width,
+             Height,
+             Delta
+             );
+  if (!EFI_ERROR (Status) && (BltOperation != EfiBltVideoToBltBuffer)) {
+    QemuRamfbMarkDirty (DestinationX, DestinationY, Width, Height);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
 }
 
 STATIC EFI_GRAPHICS_OUTPUT_PROTOCOL  mQemuRamfbGraphicsOutput = {
@@ -234,6 +531,137 @@ STATIC EFI_GRAPHICS_OUTPUT_PROTOCOL  mQemuRamfbGraphicsOutput = {
   &mQemuRamfbMode,
 };
 
+/**
+  Measure the throughput of typical Blt() patterns in the current mode, and
+  log the results. Enabled with PcdQemuRamfbBltBenchmark.
+**/
+STATIC
+VOID
+QemuRamfbBltBenchmark (
+  VOID
+  )
+{
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  *ModeInfo;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL         Glyph[8 * 19];
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL         Fill;
+  UINTN                                 Index;
+  UINTN                                 Columns;
+  UINTN                                 Rows;
+  UINT64                                Start;
+  UINT64                                GlyphNs;
+  UINT64                                FillNs;
+  UINT64                                ScrollNs;
+  UINT64                                FlushNs;
+  UINT64                                ScreenBytes;
+  EFI_TPL                               OldTpl;
+
+  ModeInfo    = mQemuRamfbMode.Info;
+  Columns     = ModeInfo->HorizontalResolution / 8;
+  Rows        = ModeInfo->VerticalResolution / 19;
+  ScreenBytes = (UINT64)ModeInfo->HorizontalResolution *
+                ModeInfo->VerticalResolution * RAMFB_BPP;
+  SetMem (Glyph, sizeof (Glyph), 0xAA);
+  SetMem (&Fill, sizeof (Fill), 0x55);
+
+  //
+  // Keep the flush timer out of the measurements; flush explicitly instead.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  //
+  // One screenful of glyph sized BltBufferToVideo operations, as drawn by
+  // the graphics console.
+  //
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < Columns * Rows; Index++) {
+    QemuRamfbGraphicsOutputBlt (
+      &mQemuRamfbGraphicsOutput,
+      Glyph,
+      EfiBltBufferToVideo,
+      0,
+      0,
+      (Index % Columns) * 8,
+      (Index / Columns) * 19,
+      8,
+      19,
+      0
+      );
+  }
+
+  GlyphNs = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+
+  Start = GetPerformanceCounter ();
+  QemuRamfbFlush ();
+  FlushNs = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+
+  //
+  // Full screen fills and one-line scrolls.
+  //
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < 16; Index++) {
+    QemuRamfbGraphicsOutputBlt (
+      &mQemuRamfbGraphicsOutput,
+      &Fill,
+      EfiBltVideoFill,
+      0,
+      0,
+      0,
+      0,
+      ModeInfo->HorizontalResolution,
+      ModeInfo->VerticalResolution,
+      0
+      );
+    QemuRamfbFlush ();
+  }
+
+  FillNs = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < 16; Index++) {
+    QemuRamfbGraphicsOutputBlt (
+      &mQemuRamfbGraphicsOutput,
+      NULL,
+      EfiBltVideoToVideo,
+      0,
+      19,
+      0,
+      0,
+      ModeInfo->HorizontalResolution,
+      ModeInfo->VerticalResolution - 19,
+      0
+      );
+    QemuRamfbFlush ();
+  }
+
+  ScrollNs = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+
+  gBS->RestoreTPL (OldTpl);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "Ramfb: Blt benchmark %ux%u: %Lu glyphs in %Lu us, flush %Lu us\n",
+    ModeInfo->HorizontalResolution,
+    ModeInfo->VerticalResolution,
+    (UINT64)(Columns * Rows),
+    DivU64x32 (GlyphNs, 1000),
+    DivU64x32 (FlushNs, 1000)
+    ));
+  DEBUG ((
+    DEBUG_INFO,
+    "Ramfb: Blt benchmark fill %Lu MB/s, scroll %Lu MB/s\n",
+    DivU64x64Remainder (
+      MultU64x32 (ScreenBytes, 16 * 1000),
+      MAX (FillNs, 1),
+      NULL
+      ),
+    DivU64x64Remainder (
+      MultU64x32 (ScreenBytes, 16 * 1000),
+      MAX (ScrollNs, 1),
+      NULL
+      )
+    ));
+}
+
 EFI_STATUS
 EFIAPI
 InitializeQemuRamfb (
@@ -251,6 +679,7 @@ InitializeQemuRamfb (
   UINTN                     FbSize, MaxFbSize, Pages;
   UINTN                     FwCfgSize;
   UINTN                     Index;
+  UINT32                    MaxHeight;
 
   if (!QemuFwCfgIsAvailable ()) {
     DEBUG ((DEBUG_INFO, "Ramfb: no FwCfg\n"));
@@ -273,6 +702,7 @@ InitializeQemuRamfb (
   }
 
   MaxFbSize = 0;
+  MaxHeight = 0;
   for (Index = 0; Index < ARRAY_SIZE (mQemuRamfbModeInfo); Index++) {
     mQemuRamfbModeInfo[Index].PixelsPerScanLine =
       mQemuRamfbModeInfo[Index].HorizontalResolution;
@@ -285,6 +715,8 @@ InitializeQemuRamfb (
       MaxFbSize = FbSize;
     }
 
+    MaxHeight = MAX (MaxHeight, mQemuRamfbModeInfo[Index].VerticalResolution);
+
     DEBUG ((
       DEBUG_INFO,
       "Ramfb: Mode %lu: %ux%u, %lu kB\n",
@@ -313,11 +745,65 @@ InitializeQemuRamfb (
   mQemuRamfbMode.FrameBufferSize = MaxFbSize;
   mQemuRamfbMode.FrameBufferBase = FbBase;
 
+  Status = QemuRamfbSetCacheAttribute (FbBase, MaxFbSize, EFI_MEMORY_WC);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_WARN,
+      "Ramfb: failed to map the framebuffer write-combining: %r\n",
+      Status
+      ));
+  }
+
+  mQemuRamfbShadow     = AllocatePool (MaxFbSize);
+  mQemuRamfbDirtySpans = AllocateZeroPool (
+                           MaxHeight * sizeof (RAMFB_DIRTY_SPAN)
+                           );
+  if ((mQemuRamfbShadow == NULL) || (mQemuRamfbDirtySpans == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto FreeShadow;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_NOTIFY,
+                  QemuRamfbFlushTimerNotify,
+                  NULL,
+                  &mQemuRamfbFlushTimer
+                  );
+  if (EFI_ERROR (Status)) {
+    goto FreeShadow;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                  TPL_NOTIFY,
+                  QemuRamfbExitBootServicesNotify,
+                  NULL,
+                  &mQemuRamfbExitBootServicesEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseFlushTimer;
+  }
+
   //
   // 800 x 600
   //
   QemuRamfbGraphicsOutputSetMode (&mQemuRamfbGraphicsOutput, 1);
 
+  if (FeaturePcdGet (PcdQemuRamfbBltBenchmark)) {
+    QemuRamfbBltBenchmark ();
+    QemuRamfbGraphicsOutputSetMode (&mQemuRamfbGraphicsOutput, 1);
+  }
+
+  Status = gBS->SetTimer (
+                  mQemuRamfbFlushTimer,
+                  TimerPeriodic,
+                  RAMFB_FLUSH_PERIOD
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseExitBootServicesEvent;
+  }
+
   //
   // ramfb vendor devpath
   //
@@ -335,7 +821,7 @@ InitializeQemuRamfb (
                       );
   if (RamfbDevicePath == NULL) {
     Status = EFI_OUT_OF_RESOURCES;
-    goto FreeFramebuffer;
+    goto CancelFlushTimer;
   }
 
   Status = gBS->InstallMultipleProtocolInterfaces (
@@ -388,6 +874,8 @@ InitializeQemuRamfb (
                   GopDevicePath,
                   &gEfiGraphicsOutputProtocolGuid,
                   &mQemuRamfbGraphicsOutput,
+                  &gQemuRamfbShadowProtocolGuid,
+                  &mQemuRamfbShadowProtocol,
                   NULL
                   );
   if (EFI_ERROR (Status)) {
@@ -421,6 +909,8 @@ FreeGopHandle:
          GopDevicePath,
          &gEfiGraphicsOutputProtocolGuid,
          &mQemuRamfbGraphicsOutput,
+         &gQemuRamfbShadowProtocolGuid,
+         &mQemuRamfbShadowProtocol,
          NULL
          );
 FreeGopDevicePath:
@@ -434,7 +924,22 @@ FreeRamfbHandle:
          );
 FreeRamfbDevicePath:
   FreePool (RamfbDevicePath);
-FreeFramebuffer:
+CancelFlushTimer:
+  gBS->SetTimer (mQemuRamfbFlushTimer, TimerCancel, 0);
+CloseExitBootServicesEvent:
+  gBS->CloseEvent (mQemuRamfbExitBootServicesEvent);
+CloseFlushTimer:
+  gBS->CloseEvent (mQemuRamfbFlushTimer);
+FreeShadow:
+  if (mQemuRamfbDirtySpans != NULL) {
+    FreePool (mQemuRamfbDirtySpans);
+  }
+
+  if (mQemuRamfbShadow != NULL) {
+    FreePool (mQemuRamfbShadow);
+  }
+
+  QemuRamfbSetCacheAttribute (FbBase, MaxFbSize, EFI_MEMORY_WB);
   FreePages ((VOID *)(UINTN)mQemuRamfbMode.FrameBufferBase, Pages);
   return Status;
 }
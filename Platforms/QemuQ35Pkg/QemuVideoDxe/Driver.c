@@ -361,6 +361,8 @@ QemuVideoControllerDriverStart (
     goto UninstallGopDevicePath;
   }
 
+  QemuVideoMapFrameBufferWc (Private);
+
   //
   // Start the GOP software stack.
   //
@@ -408,6 +410,7 @@ DestructQemuVideoGraphics:
   QemuVideoGraphicsOutputDestructor (Private);
 
 FreeModeData:
+  QemuVideoUnmapFrameBufferWc (Private);
   FreePool (Private->ModeData);
 
 UninstallGopDevicePath:
@@ -523,6 +526,8 @@ QemuVideoControllerDriverStop (
     return Status;
   }
 
+  QemuVideoUnmapFrameBufferWc (Private);
+
   //
   // Restore original PCI attributes
   //
@@ -823,10 +828,110 @@ InitializeCirrusGraphicsMode (
   outw (Private, GRAPH_ADDRESS_REGISTER, 0x000b);
   outb (Private, DAC_PIXEL_MASK_REGISTER, 0xff);
 
-  SetDefaultPalette (Private);
+  //
+  // The palette is only consulted in indexed color modes.
+  //
+  if (ModeData->ColorDepth <= 8) {
+    SetDefaultPalette (Private);
+  }
+
   ClearScreen (Private);
 }
 
+/**
+  Remap the framebuffer BAR as write-combining in the GCD memory space map, so
+  that Blt stores into the framebuffer are not uncached one by one.
+
+  Failure is not fatal; the framebuffer keeps its original attributes.
+
+  @param  Private  The device private data.
+
+**/
+VOID
+QemuVideoMapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  )
+{
+  EFI_STATUS                         Status;
+  EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR  *FrameBufDesc;
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR    GcdDesc;
+  EFI_PHYSICAL_ADDRESS               Base;
+  UINT64                             Length;
+
+  Private->FrameBufferWcLength = 0;
+
+  Status = Private->PciIo->GetBarAttributes (
+                             Private->PciIo,
+                             Private->FrameBufferVramBarIndex,
+                             NULL,
+                             (VOID **)&FrameBufDesc
+                             );
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  Base   = FrameBufDesc->AddrRangeMin - FrameBufDesc->AddrTranslationOffset;
+  Length = FrameBufDesc->AddrLen;
+  FreePool (FrameBufDesc);
+
+  Status = gDS->GetMemorySpaceDescriptor (Base, &GcdDesc);
+  if (EFI_ERROR (Status) ||
+      (GcdDesc.GcdMemoryType != EfiGcdMemoryTypeMemoryMappedIo) ||
+      (Base + Length > GcdDesc.BaseAddress + GcdDesc.Length))
+  {
+    return;
+  }
+
+  if ((GcdDesc.Capabilities & EFI_MEMORY_WC) == 0) {
+    Status = gDS->SetMemorySpaceCapabilities (
+                    Base,
+                    Length,
+                    GcdDesc.Capabilities | EFI_MEMORY_WC
+                    );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "%a: SetMemorySpaceCapabilities: %r\n", __FUNCTION__, Status));
+      return;
+    }
+  }
+
+  Status = gDS->SetMemorySpaceAttributes (
+                  Base,
+                  Length,
+                  (GcdDesc.Attributes & ~QEMU_VIDEO_CACHE_ATTRIBUTE_MASK) | EFI_MEMORY_WC
+                  );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "%a: SetMemorySpaceAttributes: %r\n", __FUNCTION__, Status));
+    return;
+  }
+
+  Private->FrameBufferWcBase             = Base;
+  Private->FrameBufferWcLength           = Length;
+  Private->FrameBufferOriginalAttributes = GcdDesc.Attributes;
+}
+
+/**
+  Undo QemuVideoMapFrameBufferWc().
+
+  @param  Private  The device private data.
+
+**/
+VOID
+QemuVideoUnmapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  )
+{
+  if (Private->FrameBufferWcLength == 0) {
+    return;
+  }
+
+  gDS->SetMemorySpaceAttributes (
+         Private->FrameBufferWcBase,
+         Private->FrameBufferWcLength,
+         Private->FrameBufferOriginalAttributes
+         );
+  Private->FrameBufferWcLength = 0;
+}
+
 EFI_STATUS
 EFIAPI
 InitializeQemuVideo (
@@ -27,6 +27,7 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DevicePathLib.h>
+#include <Library/DxeServicesTableLib.h>
 #include <Library/TimerLib.h>
 #include <Library/FrameBufferBltLib.h>
 
@@ -113,6 +114,14 @@ typedef struct {
   UINTN                           FrameBufferBltConfigureSize;
   UINT8                           FrameBufferVramBarIndex;
 
+  //
+  // Framebuffer range remapped as write-combining, and its original GCD
+  // attributes; FrameBufferWcLength is zero if the remapping was not done
+  //
+  EFI_PHYSICAL_ADDRESS            FrameBufferWcBase;
+  UINT64                          FrameBufferWcLength;
+  UINT64                          FrameBufferOriginalAttributes;
+
   UINT8                           Edid[128];
 } QEMU_VIDEO_PRIVATE_DATA;
 
@@ -192,6 +201,9 @@ extern EFI_COMPONENT_NAME2_PROTOCOL  gQemuVideoComponentName2;
 #define VBE_DISPI_LFB_ENABLED  0x40
 #define VBE_DISPI_NOCLEARMEM   0x80
 
+#define QEMU_VIDEO_CACHE_ATTRIBUTE_MASK \
+  (EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB | EFI_MEMORY_UCE)
+
 //
 // Graphics Output Hardware abstraction internal worker functions
 //
@@ -417,6 +429,16 @@ SetDefaultPalette (
   QEMU_VIDEO_PRIVATE_DATA  *Private
   );
 
+VOID
+QemuVideoMapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  );
+
+VOID
+QemuVideoUnmapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  );
+
 VOID
 DrawLogo (
   QEMU_VIDEO_PRIVATE_DATA  *Private,
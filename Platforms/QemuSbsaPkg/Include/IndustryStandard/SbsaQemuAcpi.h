@@ -37,6 +37,31 @@
    SBSAQEMU_MADT_GICR_SIZE                   /* DiscoveryRangeLength */        \
    }
 
+// Macro for SRAT GICC Affinity Structure
+#define SBSAQEMU_ACPI_SRAT_GICC_AFFINITY_INIT()  {                             \
+   EFI_ACPI_6_3_GICC_AFFINITY,                   /* Type */                    \
+   sizeof (EFI_ACPI_6_3_GICC_AFFINITY_STRUCTURE), /* Length */                 \
+   0,                                            /* ProximityDomain */         \
+   0,                                            /* AcpiProcessorUid */        \
+   EFI_ACPI_6_3_GICC_ENABLED,                    /* Flags */                   \
+   0                                             /* ClockDomain */             \
+   }
+
+// Macro for SRAT Memory Affinity Structure
+#define SBSAQEMU_ACPI_SRAT_MEMORY_AFFINITY_INIT()  {                           \
+   EFI_ACPI_6_3_MEMORY_AFFINITY,                   /* Type */                  \
+   sizeof (EFI_ACPI_6_3_MEMORY_AFFINITY_STRUCTURE), /* Length */               \
+   0,                                              /* ProximityDomain */       \
+   EFI_ACPI_RESERVED_WORD,                         /* Reserved1 */             \
+   0,                                              /* AddressBaseLow */        \
+   0,                                              /* AddressBaseHigh */       \
+   0,                                              /* LengthLow */             \
+   0,                                              /* LengthHigh */            \
+   EFI_ACPI_RESERVED_DWORD,                        /* Reserved2 */             \
+   EFI_ACPI_6_3_MEMORY_ENABLED,                    /* Flags */                 \
+   EFI_ACPI_RESERVED_QWORD                         /* Reserved3 */             \
+   }
+
 #define SBSAQEMU_ACPI_SCOPE_OP_MAX_LENGTH  5
 
 #define SBSAQEMU_ACPI_SCOPE_NAME  { '_', 'S', 'B', '_' }
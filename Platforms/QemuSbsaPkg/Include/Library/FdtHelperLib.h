@@ -33,4 +33,68 @@ FdtHelperCountCpus (
   VOID
   );
 
+/**
+  Get the NUMA node of a given cpu from device tree passed by Qemu.
+
+  FdtHelperCountCpus () must have been called before.
+
+  @param [in]   CpuId    Index of cpu to retrieve the NUMA node for.
+
+  @retval                The "numa-node-id" of CPU at index <CpuId>, or 0 if
+                         the device tree does not describe NUMA topology.
+**/
+UINT32
+FdtHelperGetCpuNumaNodeId (
+  IN UINTN  CpuId
+  );
+
+/**
+  Get a memory node from device tree passed by Qemu.
+
+  @param [in]   Index    Index of the memory node to retrieve, in device tree
+                         order.
+  @param [out]  Base     Base address of the memory node.
+  @param [out]  Size     Size of the memory node.
+  @param [out]  NodeId   The "numa-node-id" of the memory node, or 0 if the
+                         device tree does not describe NUMA topology.
+
+  @retval EFI_SUCCESS    The memory node was found.
+  @retval EFI_NOT_FOUND  There are fewer than <Index> + 1 memory nodes.
+**/
+EFI_STATUS
+FdtHelperGetMemoryNode (
+  IN  UINTN   Index,
+  OUT UINT64  *Base,
+  OUT UINT64  *Size,
+  OUT UINT32  *NodeId
+  );
+
+/**
+  Check whether the device tree passed by Qemu describes NUMA topology.
+
+  @retval TRUE           Some node carries a "numa-node-id" property.
+  @retval FALSE          Otherwise.
+**/
+BOOLEAN
+FdtHelperHasNumaTopology (
+  VOID
+  );
+
+/**
+  Get the relative distance between two NUMA nodes from the /distance-map
+  node of the device tree passed by Qemu.
+
+  @param [in]   From     Initiating NUMA node.
+  @param [in]   To       Target NUMA node.
+
+  @retval                The distance from the "distance-matrix" property. If
+                         the pair is not described, 10 for a node to itself
+                         and 20 otherwise, as Qemu and Linux assume.
+**/
+UINT8
+FdtHelperGetNumaDistance (
+  IN UINT32  From,
+  IN UINT32  To
+  );
+
 #endif /* FDT_HELPER_LIB_ */
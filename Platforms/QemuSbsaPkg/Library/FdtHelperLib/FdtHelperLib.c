@@ -9,6 +9,7 @@
 **/
 
 #include <Uefi.h>
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/FdtHelperLib.h>
 #include <Library/PcdLib.h>
@@ -99,3 +100,193 @@ FdtHelperCountCpus (
 
   return CpuCount;
 }
+
+/**
+  Get the NUMA node of a given cpu from device tree passed by Qemu.
+
+  FdtHelperCountCpus () must have been called before.
+
+  @param [in]   CpuId    Index of cpu to retrieve the NUMA node for.
+
+  @retval                The "numa-node-id" of CPU at index <CpuId>, or 0 if
+                         the device tree does not describe NUMA topology.
+**/
+UINT32
+FdtHelperGetCpuNumaNodeId (
+  IN UINTN  CpuId
+  )
+{
+  VOID          *DeviceTreeBase;
+  CONST UINT32  *NodeIdVal;
+  INT32         Len;
+
+  DeviceTreeBase = (VOID *)(UINTN)PcdGet64 (PcdDeviceTreeInitialBaseAddress);
+  ASSERT (DeviceTreeBase != NULL);
+
+  NodeIdVal = fdt_getprop (
+                DeviceTreeBase,
+                mFdtFirstCpuOffset + (CpuId * mFdtCpuNodeSize),
+                "numa-node-id",
+                &Len
+                );
+  if ((NodeIdVal == NULL) || (Len != sizeof (UINT32))) {
+    return 0;
+  }
+
+  return fdt32_to_cpu (ReadUnaligned32 (NodeIdVal));
+}
+
+/**
+  Get a memory node from device tree passed by Qemu.
+
+  @param [in]   Index    Index of the memory node to retrieve, in device tree
+                         order.
+  @param [out]  Base     Base address of the memory node.
+  @param [out]  Size     Size of the memory node.
+  @param [out]  NodeId   The "numa-node-id" of the memory node, or 0 if the
+                         device tree does not describe NUMA topology.
+
+  @retval EFI_SUCCESS    The memory node was found.
+  @retval EFI_NOT_FOUND  There are fewer than <Index> + 1 memory nodes.
+**/
+EFI_STATUS
+FdtHelperGetMemoryNode (
+  IN  UINTN   Index,
+  OUT UINT64  *Base,
+  OUT UINT64  *Size,
+  OUT UINT32  *NodeId
+  )
+{
+  VOID          *DeviceTreeBase;
+  INT32         Node;
+  INT32         Prev;
+  CONST CHAR8   *Type;
+  CONST UINT64  *RegProp;
+  CONST UINT32  *NodeIdVal;
+  INT32         Len;
+
+  DeviceTreeBase = (VOID *)(UINTN)PcdGet64 (PcdDeviceTreeInitialBaseAddress);
+  ASSERT (DeviceTreeBase != NULL);
+
+  for (Prev = 0; ; Prev = Node) {
+    Node = fdt_next_node (DeviceTreeBase, Prev, NULL);
+    if (Node < 0) {
+      return EFI_NOT_FOUND;
+    }
+
+    Type = fdt_getprop (DeviceTreeBase, Node, "device_type", &Len);
+    if ((Type == NULL) || (AsciiStrnCmp (Type, "memory", Len) != 0)) {
+      continue;
+    }
+
+    // Qemu describes each memory node with two 8 byte quantities for base
+    // and size, respectively.
+    RegProp = fdt_getprop (DeviceTreeBase, Node, "reg", &Len);
+    if ((RegProp == NULL) || (Len != (2 * sizeof (UINT64)))) {
+      DEBUG ((DEBUG_ERROR, "Failed to parse FDT memory node\n"));
+      continue;
+    }
+
+    if (Index-- > 0) {
+      continue;
+    }
+
+    *Base = fdt64_to_cpu (ReadUnaligned64 (RegProp));
+    *Size = fdt64_to_cpu (ReadUnaligned64 (RegProp + 1));
+
+    NodeIdVal = fdt_getprop (DeviceTreeBase, Node, "numa-node-id", &Len);
+    if ((NodeIdVal != NULL) && (Len == sizeof (UINT32))) {
+      *NodeId = fdt32_to_cpu (ReadUnaligned32 (NodeIdVal));
+    } else {
+      *NodeId = 0;
+    }
+
+    return EFI_SUCCESS;
+  }
+}
+
+/**
+  Check whether the device tree passed by Qemu describes NUMA topology.
+
+  @retval TRUE           Some node carries a "numa-node-id" property.
+  @retval FALSE          Otherwise.
+**/
+BOOLEAN
+FdtHelperHasNumaTopology (
+  VOID
+  )
+{
+  VOID   *DeviceTreeBase;
+  INT32  Node;
+  INT32  Prev;
+
+  DeviceTreeBase = (VOID *)(UINTN)PcdGet64 (PcdDeviceTreeInitialBaseAddress);
+  ASSERT (DeviceTreeBase != NULL);
+
+  for (Prev = 0; ; Prev = Node) {
+    Node = fdt_next_node (DeviceTreeBase, Prev, NULL);
+    if (Node < 0) {
+      return FALSE;
+    }
+
+    if (fdt_getprop (DeviceTreeBase, Node, "numa-node-id", NULL) != NULL) {
+      return TRUE;
+    }
+  }
+}
+
+/**
+  Get the relative distance between two NUMA nodes from the /distance-map
+  node of the device tree passed by Qemu.
+
+  @param [in]   From     Initiating NUMA node.
+  @param [in]   To       Target NUMA node.
+
+  @retval                The distance from the "distance-matrix" property. If
+                         the pair is not described, 10 for a node to itself
+                         and 20 otherwise, as Qemu and Linux assume.
+**/
+UINT8
+FdtHelperGetNumaDistance (
+  IN UINT32  From,
+  IN UINT32  To
+  )
+{
+  VOID          *DeviceTreeBase;
+  INT32         Node;
+  CONST UINT32  *Matrix;
+  INT32         Len;
+  UINTN         Index;
+  UINT32        Distance;
+
+  DeviceTreeBase = (VOID *)(UINTN)PcdGet64 (PcdDeviceTreeInitialBaseAddress);
+  ASSERT (DeviceTreeBase != NULL);
+
+  Node = fdt_path_offset (DeviceTreeBase, "/distance-map");
+  if (Node >= 0) {
+    Matrix = fdt_getprop (DeviceTreeBase, Node, "distance-matrix", &Len);
+    if (Matrix != NULL) {
+      // Each entry is a <from to distance> triplet. The matrix need not be
+      // symmetric, and entries for the reverse direction may be omitted.
+      for (Index = 0; Index + 3 <= Len / sizeof (UINT32); Index += 3) {
+        if ((fdt32_to_cpu (ReadUnaligned32 (Matrix + Index)) == From) &&
+            (fdt32_to_cpu (ReadUnaligned32 (Matrix + Index + 1)) == To))
+        {
+          Distance = fdt32_to_cpu (ReadUnaligned32 (Matrix + Index + 2));
+          return (UINT8)MIN (Distance, MAX_UINT8);
+        }
+      }
+
+      for (Index = 0; Index + 3 <= Len / sizeof (UINT32); Index += 3) {
+        if ((fdt32_to_cpu (ReadUnaligned32 (Matrix + Index)) == To) &&
+            (fdt32_to_cpu (ReadUnaligned32 (Matrix + Index + 1)) == From))
+        {
+          Distance = fdt32_to_cpu (ReadUnaligned32 (Matrix + Index + 2));
+          return (UINT8)MIN (Distance, MAX_UINT8);
+        }
+      }
+    }
+  }
+
+  return (From == To) ? 10 : 20;
+}
@@ -9,7 +9,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Uefi.h>
 
 #include <IndustryStandard/Pci.h>
-#include <IndustryStandard/Virtio095.h>
+#include <IndustryStandard/Virtio10.h>
 
 #include <Guid/DebugAgentGuid.h>
 #include <Guid/SerialPortLibVendor.h>
@@ -474,6 +474,42 @@ PreparePciSerialDevicePath (
   return EFI_SUCCESS;
 }
 
+/**
+  Add a virtio-input device to ConIn.
+
+  Keyboards and tablets share the PCI device ID; only keyboards produce the
+  Simple Text Input protocol, so the ConIn entry of a tablet is inert.
+
+  @param[in] DeviceHandle  Handle of the virtio-input PCI device.
+
+  @retval EFI_SUCCESS  The virtio-input device has been added to ConIn.
+
+  @return              Error codes, due to EFI_DEVICE_PATH_PROTOCOL missing
+                       from DeviceHandle.
+**/
+EFI_STATUS
+PrepareVirtioInputDevicePath (
+  IN EFI_HANDLE  DeviceHandle
+  )
+{
+  EFI_STATUS                Status;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+
+  DevicePath = NULL;
+  Status     = gBS->HandleProtocol (
+                      DeviceHandle,
+                      &gEfiDevicePathProtocolGuid,
+                      (VOID *)&DevicePath
+                      );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  EfiBootManagerUpdateConsoleVariable (ConIn, DevicePath, NULL);
+
+  return EFI_SUCCESS;
+}
+
 STATIC
 EFI_STATUS
 VisitAllInstancesOfProtocol (
@@ -1094,6 +1130,20 @@ DetectAndPreparePlatformPciDevicePath (
     return EFI_SUCCESS;
   }
 
+  //
+  // Here we decide whether it is a virtio-input keyboard or tablet
+  //
+  if ((Pci->Hdr.VendorId == VIRTIO_VENDOR_ID) &&
+      (Pci->Hdr.DeviceId == 0x1040 + VIRTIO_SUBSYSTEM_INPUT))
+  {
+    //
+    // Add it to ConIn.
+    //
+    DEBUG ((DEBUG_INFO, "Found virtio-input device\n"));
+    PrepareVirtioInputDevicePath (Handle);
+    return EFI_SUCCESS;
+  }
+
   //
   // Here we decide which display device to enable in PCI bus
   //
@@ -12,6 +12,7 @@
 #include <Library/ArmLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/FdtHelperLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/PcdLib.h>
 #include <libfdt.h>
@@ -19,8 +20,32 @@
 #include <Guid/DxeMemoryProtectionSettings.h>
 #include <Guid/MmMemoryProtectionSettings.h>
 
+// Number of FDT memory nodes above the lowest one that are mapped
+#define MAX_EXTRA_MEMORY_NODES  16
+
 // Number of Virtual Memory Map Descriptors
-#define MAX_VIRTUAL_MEMORY_MAP_DESCRIPTORS  5
+#define MAX_VIRTUAL_MEMORY_MAP_DESCRIPTORS  (5 + MAX_EXTRA_MEMORY_NODES)
+
+// Number of NUMA nodes covered by the per-node memory report
+#define MAX_REPORTED_NUMA_NODES  16
+
+// Resource attributes of system memory, as MemoryInitPeiLib reports them
+#define SYSTEM_MEMORY_RESOURCE_ATTRIBUTES             \
+  (EFI_RESOURCE_ATTRIBUTE_PRESENT                 |   \
+   EFI_RESOURCE_ATTRIBUTE_INITIALIZED             |   \
+   EFI_RESOURCE_ATTRIBUTE_TESTED                  |   \
+   EFI_RESOURCE_ATTRIBUTE_UNCACHEABLE             |   \
+   EFI_RESOURCE_ATTRIBUTE_WRITE_COMBINEABLE       |   \
+   EFI_RESOURCE_ATTRIBUTE_WRITE_THROUGH_CACHEABLE |   \
+   EFI_RESOURCE_ATTRIBUTE_WRITE_BACK_CACHEABLE)
+
+// Block sizes that ArmMmuLib maps with, for the 4KB translation granule
+#define TT_L2_BLOCK_SIZE  SIZE_2MB
+#define TT_L1_BLOCK_SIZE  SIZE_1GB
+#define TT_L0_ENTRY_SIZE  SIZE_512GB
+
+// Each region contributes at most two unaligned boundaries per level
+#define MAX_TABLE_SLOTS  (2 * MAX_VIRTUAL_MEMORY_MAP_DESCRIPTORS)
 
 // MU_CHANGE START
 
@@ -58,6 +83,8 @@ SbsaQemuLibConstructor (
   CONST CHAR8                     *Type;
   INT32                           Len;
   CONST UINT64                    *RegProp;
+  CONST UINT32                    *NodeIdProp;
+  UINT32                          NodeId;
   RETURN_STATUS                   PcdStatus;
   DXE_MEMORY_PROTECTION_SETTINGS  DxeSettings;
   MM_MEMORY_PROTECTION_SETTINGS   MmSettings;
@@ -125,12 +152,22 @@ SbsaQemuLibConstructor (
         CurBase = fdt64_to_cpu (ReadUnaligned64 (RegProp));
         CurSize = fdt64_to_cpu (ReadUnaligned64 (RegProp + 1));
 
+        // Qemu tags every memory node with its NUMA node when NUMA topology
+        // is configured; SbsaQemuAcpiDxe describes the same nodes in SRAT.
+        NodeIdProp = fdt_getprop (DeviceTreeBase, Node, "numa-node-id", &Len);
+        if ((NodeIdProp != NULL) && (Len == sizeof (UINT32))) {
+          NodeId = fdt32_to_cpu (ReadUnaligned32 (NodeIdProp));
+        } else {
+          NodeId = 0;
+        }
+
         DEBUG ((
           DEBUG_INFO,
-          "%a: System RAM @ 0x%lx - 0x%lx\n",
+          "%a: System RAM @ 0x%lx - 0x%lx on NUMA node %u\n",
           __FUNCTION__,
           CurBase,
-          CurBase + CurSize - 1
+          CurBase + CurSize - 1,
+          NodeId
           ));
 
         if ((NewBase > CurBase) || (NewBase == 0)) {
@@ -161,12 +198,256 @@ SbsaQemuLibConstructor (
   // TODO: This is carved out by the BL31 during DT build up.
   PcdStatus = PcdSet64S (PcdSystemMemorySize, NewSize - PcdGet64 (PcdMmBufferSize));
   ASSERT_RETURN_ERROR (PcdStatus);
-  PcdStatus = PcdSet64S (PcdMmBufferBase, CurBase + NewSize - PcdGet64 (PcdMmBufferSize));
+  PcdStatus = PcdSet64S (PcdMmBufferBase, NewBase + NewSize - PcdGet64 (PcdMmBufferSize));
   ASSERT_RETURN_ERROR (PcdStatus);
 
   return RETURN_SUCCESS;
 }
 
+/**
+  Record Slot in a small set of translation table slots, unless already there.
+
+  @param[in,out] Slots      The set.
+  @param[in,out] SlotCount  The number of elements in Slots.
+  @param[in]     Slot       The slot to add.
+**/
+STATIC
+VOID
+AddTableSlot (
+  IN OUT UINT64  *Slots,
+  IN OUT UINTN   *SlotCount,
+  IN     UINT64  Slot
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < *SlotCount; Index++) {
+    if (Slots[Index] == Slot) {
+      return;
+    }
+  }
+
+  ASSERT (*SlotCount < MAX_TABLE_SLOTS);
+  Slots[(*SlotCount)++] = Slot;
+}
+
+/**
+  Estimate the number of translation table pages that ArmMmuLib consumes for a
+  virtual memory map, assuming 4KB granule tables with block mappings wherever
+  a region boundary permits them.
+
+  A level 1 table is needed per 512GB slot that any region touches. A level 2
+  (level 3) table is needed per 1GB (2MB) slot that contains a region boundary
+  which is not aligned to the 1GB (2MB) block size.
+
+  This is computed from the map alone; the tables that ArmConfigureMmu()
+  actually allocates are not inspected.
+
+  @param[in]  VirtualMemoryTable  The zero-terminated memory map.
+  @param[out] MappedSize          The total size of all regions in the map.
+
+  @return  The estimated number of 4KB translation table pages.
+**/
+STATIC
+UINTN
+EstimateTranslationTablePages (
+  IN  CONST ARM_MEMORY_REGION_DESCRIPTOR  *VirtualMemoryTable,
+  OUT UINT64                              *MappedSize
+  )
+{
+  UINT64  L1Slots[MAX_TABLE_SLOTS * 2];
+  UINT64  L2Slots[MAX_TABLE_SLOTS];
+  UINT64  L3Slots[MAX_TABLE_SLOTS];
+  UINTN   L1Count;
+  UINTN   L2Count;
+  UINTN   L3Count;
+  UINT64  Boundary[2];
+  UINT64  Slot;
+  UINTN   Index;
+
+  L1Count     = 0;
+  L2Count     = 0;
+  L3Count     = 0;
+  *MappedSize = 0;
+
+  for ( ; VirtualMemoryTable->Length != 0; VirtualMemoryTable++) {
+    *MappedSize += VirtualMemoryTable->Length;
+
+    Boundary[0] = VirtualMemoryTable->VirtualBase;
+    Boundary[1] = VirtualMemoryTable->VirtualBase + VirtualMemoryTable->Length;
+
+    for (Slot = Boundary[0] / TT_L0_ENTRY_SIZE;
+         Slot <= (Boundary[1] - 1) / TT_L0_ENTRY_SIZE;
+         Slot++)
+    {
+      if (L1Count < ARRAY_SIZE (L1Slots)) {
+        AddTableSlot (L1Slots, &L1Count, Slot);
+      }
+    }
+
+    for (Index = 0; Index < ARRAY_SIZE (Boundary); Index++) {
+      if ((Boundary[Index] % TT_L1_BLOCK_SIZE) != 0) {
+        AddTableSlot (L2Slots, &L2Count, Boundary[Index] / TT_L1_BLOCK_SIZE);
+      }
+
+      if ((Boundary[Index] % TT_L2_BLOCK_SIZE) != 0) {
+        AddTableSlot (L3Slots, &L3Count, Boundary[Index] / TT_L2_BLOCK_SIZE);
+      }
+    }
+  }
+
+  //
+  // One root (level 0) table, plus the lower level tables.
+  //
+  return 1 + L1Count + L2Count + L3Count;
+}
+
+/**
+  Return the NUMA node of the boot CPU, i.e. the first /cpus subnode.
+
+  @param[in] DeviceTreeBase  The device tree passed by Qemu.
+
+  @return  The "numa-node-id" of the boot CPU, or 0 if there is none.
+**/
+STATIC
+UINT32
+GetBootCpuNumaNodeId (
+  IN CONST VOID  *DeviceTreeBase
+  )
+{
+  INT32         CpuNode;
+  CONST UINT32  *NodeIdProp;
+  INT32         Len;
+
+  CpuNode = fdt_path_offset (DeviceTreeBase, "/cpus");
+  if (CpuNode >= 0) {
+    CpuNode = fdt_first_subnode (DeviceTreeBase, CpuNode);
+  }
+
+  if (CpuNode < 0) {
+    return 0;
+  }
+
+  NodeIdProp = fdt_getprop (DeviceTreeBase, CpuNode, "numa-node-id", &Len);
+  if ((NodeIdProp == NULL) || (Len != sizeof (UINT32))) {
+    return 0;
+  }
+
+  return fdt32_to_cpu (ReadUnaligned32 (NodeIdProp));
+}
+
+/**
+  Add the FDT memory nodes above the lowest one, which SbsaQemuLibConstructor
+  and MemoryInitPeiLib leave out, to the virtual memory map and report them to
+  DXE as system memory.
+
+  DXE core allocates pages top-down over all free memory, so remote nodes,
+  which Qemu places above the boot node, would otherwise end up holding page
+  tables, ACPI and SMBIOS tables and the boot services pools of the BSP. When
+  PcdNumaKeepFirmwareOnBootNode is set, memory on nodes other than the boot
+  CPU's is therefore handed to DXE as EfiBootServicesData, which keeps firmware
+  allocations on the boot node and becomes conventional memory for the OS at
+  ExitBootServices.
+
+  This is only called once, from MemoryInitPeim, which is what makes building
+  HOBs here safe.
+
+  @param[in,out] VirtualMemoryTable  The memory map. On output, the entries
+                                     from index FirstEntry on describe the
+                                     extra memory nodes.
+  @param[in]     FirstEntry          The first free entry of the memory map.
+
+  @return  The index of the first free entry after the extra memory nodes.
+**/
+STATIC
+UINTN
+AddExtraMemoryNodes (
+  IN OUT ARM_MEMORY_REGION_DESCRIPTOR  *VirtualMemoryTable,
+  IN     UINTN                         FirstEntry
+  )
+{
+  VOID     *DeviceTreeBase;
+  UINT32   BootNodeId;
+  UINTN    Index;
+  UINTN    Entry;
+  UINT64   Base;
+  UINT64   Size;
+  UINT32   NodeId;
+  BOOLEAN  HoldRemote;
+  UINT64   NodeMemory[MAX_REPORTED_NUMA_NODES];
+
+  DeviceTreeBase = (VOID *)(UINTN)PcdGet64 (PcdDeviceTreeInitialBaseAddress);
+  BootNodeId     = GetBootCpuNumaNodeId (DeviceTreeBase);
+  HoldRemote     = FeaturePcdGet (PcdNumaKeepFirmwareOnBootNode);
+  Entry          = FirstEntry;
+
+  ZeroMem (NodeMemory, sizeof (NodeMemory));
+
+  for (Index = 0; !EFI_ERROR (FdtHelperGetMemoryNode (Index, &Base, &Size, &NodeId)); Index++) {
+    if (NodeId < MAX_REPORTED_NUMA_NODES) {
+      NodeMemory[NodeId] += Size;
+    }
+
+    if (Base == PcdGet64 (PcdSystemMemoryBase)) {
+      // The lowest node holds PEI memory and is reported by MemoryInitPeiLib.
+      if (NodeId != BootNodeId) {
+        DEBUG ((
+          DEBUG_WARN,
+          "%a: boot CPU is on node %u but PEI memory is on node %u\n",
+          __FUNCTION__,
+          BootNodeId,
+          NodeId
+          ));
+      }
+
+      continue;
+    }
+
+    if (Entry - FirstEntry >= MAX_EXTRA_MEMORY_NODES) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "%a: ignoring memory @ 0x%lx - 0x%lx, too many memory nodes\n",
+        __FUNCTION__,
+        Base,
+        Base + Size - 1
+        ));
+      continue;
+    }
+
+    VirtualMemoryTable[Entry].PhysicalBase = Base;
+    VirtualMemoryTable[Entry].VirtualBase  = Base;
+    VirtualMemoryTable[Entry].Length       = Size;
+    VirtualMemoryTable[Entry].Attributes   = ARM_MEMORY_REGION_ATTRIBUTE_WRITE_BACK;
+    Entry++;
+
+    BuildResourceDescriptorHob (
+      EFI_RESOURCE_SYSTEM_MEMORY,
+      SYSTEM_MEMORY_RESOURCE_ATTRIBUTES,
+      Base,
+      Size
+      );
+
+    if (HoldRemote && (NodeId != BootNodeId)) {
+      BuildMemoryAllocationHob (Base, Size, EfiBootServicesData);
+    }
+  }
+
+  for (NodeId = 0; NodeId < MAX_REPORTED_NUMA_NODES; NodeId++) {
+    if (NodeMemory[NodeId] != 0) {
+      DEBUG ((
+        DEBUG_INFO,
+        "%a: NUMA node %u: %Lu MB%a\n",
+        __FUNCTION__,
+        NodeId,
+        NodeMemory[NodeId] / SIZE_1MB,
+        (NodeId == BootNodeId) ? " (boot node)" : (HoldRemote ? " (held until ExitBootServices)" : "")
+        ));
+    }
+  }
+
+  return Entry;
+}
+
 /**
   Return the Virtual Memory Map of your platform
 
@@ -186,6 +467,9 @@ ArmPlatformGetVirtualMemoryMap (
   )
 {
   ARM_MEMORY_REGION_DESCRIPTOR  *VirtualMemoryTable;
+  UINTN                         Index;
+  UINTN                         TablePages;
+  UINT64                        MappedSize;
 
   ASSERT (VirtualMemoryMap != NULL);
 
@@ -235,8 +519,29 @@ ArmPlatformGetVirtualMemoryMap (
   VirtualMemoryTable[3].Length       = PcdGet64 (PcdMmBufferSize);
   VirtualMemoryTable[3].Attributes   = ARM_MEMORY_REGION_ATTRIBUTE_UNCACHED_UNBUFFERED;
 
+  // DRAM of the other memory nodes
+  Index = AddExtraMemoryNodes (VirtualMemoryTable, 4);
+
   // End of Table
-  ZeroMem (&VirtualMemoryTable[4], sizeof (ARM_MEMORY_REGION_DESCRIPTOR));
+  ZeroMem (&VirtualMemoryTable[Index], sizeof (ARM_MEMORY_REGION_DESCRIPTOR));
+
+  //
+  // ArmMmuLib maps every region with the largest blocks that its alignment
+  // permits, so the translation table footprint depends on region boundaries
+  // rather than on the amount of RAM. Report an estimate of it, to catch
+  // layouts that force page granular mappings. The MMU is configured from this
+  // map in ArmPlatformPkg's MemoryInitPeiLib, so the tables it really uses
+  // cannot be measured here.
+  //
+  TablePages = EstimateTranslationTablePages (VirtualMemoryTable, &MappedSize);
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: estimated %Lu translation table pages for %Lu regions, %Lu MB in total\n",
+    __FUNCTION__,
+    (UINT64)TablePages,
+    (UINT64)Index,
+    MappedSize / SIZE_1MB
+    ));
 
   *VirtualMemoryMap = VirtualMemoryTable;
 }
@@ -11,6 +11,8 @@ import io
 import os
 import re
 import datetime
+import subprocess
+import time
 from pathlib import Path
 from edk2toolext.environment.plugintypes import uefi_helper_plugin
 from edk2toollib import utility_functions
@@ -43,12 +45,38 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
         return ver_str.split('.')
 
 
+    @staticmethod
+    # start virtiofsd to serve a host directory to the guest over a vhost-user socket
+    def StartVirtiofsd(exec, shared_dir, socket_path):
+        if os.path.exists(socket_path):
+            os.remove(socket_path)
+
+        cmd = [exec, f"--socket-path={socket_path}", f"--shared-dir={shared_dir}", "--cache=auto"]
+        if os.geteuid() != 0:
+            # the default namespace sandbox needs privileges
+            cmd.append("--sandbox=none")
+
+        logging.log(logging.INFO, f"Sharing {shared_dir} through virtiofsd.")
+        proc = subprocess.Popen(cmd)
+
+        # QEMU refuses to start if the socket does not exist yet
+        for _ in range(50):
+            if os.path.exists(socket_path):
+                return proc
+            if proc.poll() is not None:
+                break
+            time.sleep(0.1)
+
+        proc.kill()
+        raise Exception(f"virtiofsd failed to create {socket_path}")
+
     @staticmethod
     def Runner(env):
         ''' Runs QEMU '''
         VirtualDrive = env.GetValue("VIRTUAL_DRIVE_PATH")
         OutputPath_FV = os.path.join(env.GetValue("BUILD_OUTPUT_BASE"), "FV")
         repo_version = env.GetValue("VERSION", "Unknown")
+        virtiofs_shares = []  # (host directory, tag) pairs served through virtiofsd
 
         # Use a provided QEMU path. Otherwise use what is provided through the extdep
         executable = env.GetValue("QEMU_PATH", None)
@@ -67,6 +95,7 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
 
         # Mount disk with either startup.nsh or OS image
         path_to_os = env.GetValue("PATH_TO_OS")
+        mem_size = 8192 if path_to_os is not None else 2048
         if path_to_os is not None:
             file_extension = Path(path_to_os).suffix.lower().replace('"', '')
 
@@ -87,14 +116,15 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
         elif os.path.isfile(VirtualDrive):
             args += f" -drive file={VirtualDrive},if=virtio"
         elif os.path.isdir(VirtualDrive):
-            args += f" -drive file=fat:rw:{VirtualDrive},format=raw,media=disk"
+            virtiofsd_path = env.GetValue("VIRTIOFSD_PATH")
+            if virtiofsd_path is not None and os.name != 'nt':
+                virtiofs_shares.append((VirtualDrive, "VirtualDrive"))
+            else:
+                args += f" -drive file=fat:rw:{VirtualDrive},format=raw,media=disk"
         else:
             logging.critical("Virtual Drive Path Invalid")
 
-        if path_to_os is not None:
-            args += " -m 8192"
-        else:
-            args += " -m 2048"
+        args += f" -m {mem_size}"
 
         args += " -machine sbsa-ref" #,accel=(tcg|kvm)"
         args += " -cpu max"
@@ -108,10 +138,17 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
         args += " -drive if=pflash,format=raw,unit=1,file=" + \
                 code_fd + ",readonly=on"
 
-        # Add XHCI USB controller and mouse
-        args += " -device qemu-xhci,id=usb"
-        args += " -device usb-tablet,id=input0,bus=usb.0,port=1"  # add a usb mouse
-        args += " -device usb-kbd,id=input1,bus=usb.0,port=2"     # add a usb keyboard
+        input_devices = env.GetValue("QEMU_INPUT", "USB").upper()
+        if input_devices == "VIRTIO":
+            # virtio-input devices are only serviced when the firmware reads input,
+            # unlike USB controllers, which the firmware polls on a timer
+            args += " -device virtio-keyboard-pci"
+            args += " -device virtio-tablet-pci"
+        else:
+            # Add XHCI USB controller and mouse
+            args += " -device qemu-xhci,id=usb"
+            args += " -device usb-tablet,id=input0,bus=usb.0,port=1"  # add a usb mouse
+            args += " -device usb-kbd,id=input1,bus=usb.0,port=2"     # add a usb keyboard
 
         creation_time = Path(code_fd).stat().st_ctime
         creation_datetime = datetime.datetime.fromtimestamp(creation_time)
@@ -152,8 +189,24 @@ class QemuRunner(uefi_helper_plugin.IUefiHelperPlugin):
             except Exception:
                 std_handle = None
 
-        # Run QEMU
-        ret = utility_functions.RunCmd(executable, args)
+        # Run QEMU. The virtiofsd daemons are started last, so that nothing but
+        # QEMU itself runs between starting and stopping them.
+        virtiofsd = []
+        try:
+            if len(virtiofs_shares) > 0:
+                # vhost-user devices need guest RAM that the daemons can map
+                args += f" -object memory-backend-memfd,id=mem,size={mem_size}M,share=on -numa node,memdev=mem"
+            for index, (shared_dir, tag) in enumerate(virtiofs_shares):
+                socket_path = os.path.join(env.GetValue("BUILD_OUTPUT_BASE"), f"virtiofsd-{tag}.sock")
+                virtiofsd.append(QemuRunner.StartVirtiofsd(virtiofsd_path, shared_dir, socket_path))
+                args += f" -chardev socket,id=vfs{index},path={socket_path}"
+                args += f" -device vhost-user-fs-pci,chardev=vfs{index},tag={tag}"
+
+            ret = utility_functions.RunCmd(executable, args)
+        finally:
+            for daemon in virtiofsd:
+                daemon.terminate()
+                daemon.wait()
 
         ## TODO: restore the customized RunCmd once unit tests with asserts are figured out
         if ret == 0xc0000005:
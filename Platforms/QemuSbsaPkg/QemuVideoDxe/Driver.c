@@ -336,6 +336,14 @@ QemuVideoControllerDriverStart (
         "QemuVideo: Using mmio bar @ 0x%lx\n",
         MmioDesc->AddrRangeMin
         ));
+      //
+      // Access the registers directly rather than through PciIo; each access
+      // traps to the VMM either way. The variant is downgraded to port IO
+      // above when there is no MMIO BAR, so QEMU_VIDEO_BOCHS_MMIO always has
+      // a valid MmioBase.
+      //
+      Private->MmioBase = (UINTN)(MmioDesc->AddrRangeMin -
+                                  MmioDesc->AddrTranslationOffset);
     }
 
     if (!EFI_ERROR (Status)) {
@@ -419,6 +427,8 @@ QemuVideoControllerDriverStart (
     goto UninstallGopDevicePath;
   }
 
+  QemuVideoMapFrameBufferWc (Private);
+
   //
   // Start the GOP software stack.
   //
@@ -466,6 +476,7 @@ DestructQemuVideoGraphics:
   QemuVideoGraphicsOutputDestructor (Private);
 
 FreeModeData:
+  QemuVideoUnmapFrameBufferWc (Private);
   FreePool (Private->ModeData);
 
 UninstallGopDevicePath:
@@ -581,6 +592,8 @@ QemuVideoControllerDriverStop (
     return Status;
   }
 
+  QemuVideoUnmapFrameBufferWc (Private);
+
   //
   // Restore original PCI attributes
   //
@@ -830,18 +843,8 @@ BochsWrite (
   UINT16                   Data
   )
 {
-  EFI_STATUS  Status;
-
   if (Private->Variant == QEMU_VIDEO_BOCHS_MMIO) {
-    Status = Private->PciIo->Mem.Write (
-                                   Private->PciIo,
-                                   EfiPciIoWidthUint16,
-                                   PCI_BAR_IDX2,
-                                   0x500 + (Reg << 1),
-                                   1,
-                                   &Data
-                                   );
-    ASSERT_EFI_ERROR (Status);
+    MmioWrite16 (Private->MmioBase + QEMU_VIDEO_MMIO_DISPI_OFFSET + (Reg << 1), Data);
   } else {
     outw (Private, VBE_DISPI_IOPORT_INDEX, Reg);
     outw (Private, VBE_DISPI_IOPORT_DATA, Data);
@@ -854,19 +857,10 @@ BochsRead (
   UINT16                   Reg
   )
 {
-  EFI_STATUS  Status;
-  UINT16      Data;
+  UINT16  Data;
 
   if (Private->Variant == QEMU_VIDEO_BOCHS_MMIO) {
-    Status = Private->PciIo->Mem.Read (
-                                   Private->PciIo,
-                                   EfiPciIoWidthUint16,
-                                   PCI_BAR_IDX2,
-                                   0x500 + (Reg << 1),
-                                   1,
-                                   &Data
-                                   );
-    ASSERT_EFI_ERROR (Status);
+    Data = MmioRead16 (Private->MmioBase + QEMU_VIDEO_MMIO_DISPI_OFFSET + (Reg << 1));
   } else {
     outw (Private, VBE_DISPI_IOPORT_INDEX, Reg);
     Data = inw (Private, VBE_DISPI_IOPORT_DATA);
@@ -875,6 +869,30 @@ BochsRead (
   return Data;
 }
 
+/**
+  Write a run of consecutive DISPI registers.
+
+  @param  Private   The device private data.
+  @param  FirstReg  The index of the first register to write.
+  @param  Count     The number of registers to write.
+  @param  Data      The values to write, one per register.
+
+**/
+VOID
+BochsWriteBlock (
+  QEMU_VIDEO_PRIVATE_DATA  *Private,
+  UINT16                   FirstReg,
+  UINTN                    Count,
+  CONST UINT16             *Data
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Count; Index++) {
+    BochsWrite (Private, (UINT16)(FirstReg + Index), Data[Index]);
+  }
+}
+
 VOID
 VgaOutb (
   QEMU_VIDEO_PRIVATE_DATA  *Private,
@@ -882,18 +900,8 @@ VgaOutb (
   UINT8                    Data
   )
 {
-  EFI_STATUS  Status;
-
   if (Private->Variant == QEMU_VIDEO_BOCHS_MMIO) {
-    Status = Private->PciIo->Mem.Write (
-                                   Private->PciIo,
-                                   EfiPciIoWidthUint8,
-                                   PCI_BAR_IDX2,
-                                   0x400 - 0x3c0 + Reg,
-                                   1,
-                                   &Data
-                                   );
-    ASSERT_EFI_ERROR (Status);
+    MmioWrite8 (Private->MmioBase + QEMU_VIDEO_MMIO_VGA_OFFSET - 0x3c0 + Reg, Data);
   } else {
     outb (Private, Reg, Data);
   }
@@ -905,6 +913,9 @@ InitializeBochsGraphicsMode (
   QEMU_VIDEO_MODE_DATA     *ModeData
   )
 {
+  UINT16  Geometry[VBE_DISPI_INDEX_BPP - VBE_DISPI_INDEX_XRES + 1];
+  UINT16  Layout[VBE_DISPI_INDEX_Y_OFFSET - VBE_DISPI_INDEX_BANK + 1];
+
   DEBUG ((
     DEBUG_INFO,
     "InitializeBochsGraphicsMode: %dx%d @ %d\n",
@@ -917,15 +928,22 @@ InitializeBochsGraphicsMode (
   VgaOutb (Private, ATT_ADDRESS_REGISTER, 0x20);
 
   BochsWrite (Private, VBE_DISPI_INDEX_ENABLE, 0);
-  BochsWrite (Private, VBE_DISPI_INDEX_BANK, 0);
-  BochsWrite (Private, VBE_DISPI_INDEX_X_OFFSET, 0);
-  BochsWrite (Private, VBE_DISPI_INDEX_Y_OFFSET, 0);
 
-  BochsWrite (Private, VBE_DISPI_INDEX_BPP, (UINT16)ModeData->ColorDepth);
-  BochsWrite (Private, VBE_DISPI_INDEX_XRES, (UINT16)ModeData->HorizontalResolution);
-  BochsWrite (Private, VBE_DISPI_INDEX_VIRT_WIDTH, (UINT16)ModeData->HorizontalResolution);
-  BochsWrite (Private, VBE_DISPI_INDEX_YRES, (UINT16)ModeData->VerticalResolution);
-  BochsWrite (Private, VBE_DISPI_INDEX_VIRT_HEIGHT, (UINT16)ModeData->VerticalResolution);
+  //
+  // Program the geometry with the display disabled, in two runs of adjacent
+  // registers around VBE_DISPI_INDEX_ENABLE.
+  //
+  Geometry[0] = (UINT16)ModeData->HorizontalResolution;   // XRES
+  Geometry[1] = (UINT16)ModeData->VerticalResolution;     // YRES
+  Geometry[2] = (UINT16)ModeData->ColorDepth;             // BPP
+  BochsWriteBlock (Private, VBE_DISPI_INDEX_XRES, ARRAY_SIZE (Geometry), Geometry);
+
+  Layout[0] = 0;                                          // BANK
+  Layout[1] = (UINT16)ModeData->HorizontalResolution;     // VIRT_WIDTH
+  Layout[2] = (UINT16)ModeData->VerticalResolution;       // VIRT_HEIGHT
+  Layout[3] = 0;                                          // X_OFFSET
+  Layout[4] = 0;                                          // Y_OFFSET
+  BochsWriteBlock (Private, VBE_DISPI_INDEX_BANK, ARRAY_SIZE (Layout), Layout);
 
   BochsWrite (
     Private,
@@ -933,10 +951,110 @@ InitializeBochsGraphicsMode (
     VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED
     );
 
-  SetDefaultPalette (Private);
+  //
+  // The palette is only consulted in indexed color modes.
+  //
+  if (ModeData->ColorDepth <= 8) {
+    SetDefaultPalette (Private);
+  }
+
   ClearScreen (Private);
 }
 
+/**
+  Remap the framebuffer BAR as write-combining in the GCD memory space map, so
+  that Blt stores into the framebuffer are not uncached one by one.
+
+  Failure is not fatal; the framebuffer keeps its original attributes.
+
+  @param  Private  The device private data.
+
+**/
+VOID
+QemuVideoMapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  )
+{
+  EFI_STATUS                         Status;
+  EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR  *FrameBufDesc;
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR    GcdDesc;
+  EFI_PHYSICAL_ADDRESS               Base;
+  UINT64                             Length;
+
+  Private->FrameBufferWcLength = 0;
+
+  Status = Private->PciIo->GetBarAttributes (
+                             Private->PciIo,
+                             Private->FrameBufferVramBarIndex,
+                             NULL,
+                             (VOID **)&FrameBufDesc
+                             );
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  Base   = FrameBufDesc->AddrRangeMin - FrameBufDesc->AddrTranslationOffset;
+  Length = FrameBufDesc->AddrLen;
+  FreePool (FrameBufDesc);
+
+  Status = gDS->GetMemorySpaceDescriptor (Base, &GcdDesc);
+  if (EFI_ERROR (Status) ||
+      (GcdDesc.GcdMemoryType != EfiGcdMemoryTypeMemoryMappedIo) ||
+      (Base + Length > GcdDesc.BaseAddress + GcdDesc.Length))
+  {
+    return;
+  }
+
+  if ((GcdDesc.Capabilities & EFI_MEMORY_WC) == 0) {
+    Status = gDS->SetMemorySpaceCapabilities (
+                    Base,
+                    Length,
+                    GcdDesc.Capabilities | EFI_MEMORY_WC
+                    );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "%a: SetMemorySpaceCapabilities: %r\n", __FUNCTION__, Status));
+      return;
+    }
+  }
+
+  Status = gDS->SetMemorySpaceAttributes (
+                  Base,
+                  Length,
+                  (GcdDesc.Attributes & ~QEMU_VIDEO_CACHE_ATTRIBUTE_MASK) | EFI_MEMORY_WC
+                  );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "%a: SetMemorySpaceAttributes: %r\n", __FUNCTION__, Status));
+    return;
+  }
+
+  Private->FrameBufferWcBase             = Base;
+  Private->FrameBufferWcLength           = Length;
+  Private->FrameBufferOriginalAttributes = GcdDesc.Attributes;
+}
+
+/**
+  Undo QemuVideoMapFrameBufferWc().
+
+  @param  Private  The device private data.
+
+**/
+VOID
+QemuVideoUnmapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  )
+{
+  if (Private->FrameBufferWcLength == 0) {
+    return;
+  }
+
+  gDS->SetMemorySpaceAttributes (
+         Private->FrameBufferWcBase,
+         Private->FrameBufferWcLength,
+         Private->FrameBufferOriginalAttributes
+         );
+  Private->FrameBufferWcLength = 0;
+}
+
 EFI_STATUS
 EFIAPI
 InitializeQemuVideo (
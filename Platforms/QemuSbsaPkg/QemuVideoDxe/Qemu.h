@@ -27,6 +27,8 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DevicePathLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Library/IoLib.h>
 #include <Library/TimerLib.h>
 #include <Library/FrameBufferBltLib.h>
 
@@ -116,6 +118,20 @@ typedef struct {
   UINTN                           FrameBufferBltConfigureSize;
   UINT8                           FrameBufferVramBarIndex;
 
+  //
+  // Host address of the stdvga MMIO BAR; only valid for
+  // QEMU_VIDEO_BOCHS_MMIO, the port IO variants leave it zero
+  //
+  UINTN                           MmioBase;
+
+  //
+  // Framebuffer range remapped as write-combining, and its original GCD
+  // attributes; FrameBufferWcLength is zero if the remapping was not done
+  //
+  EFI_PHYSICAL_ADDRESS            FrameBufferWcBase;
+  UINT64                          FrameBufferWcLength;
+  UINT64                          FrameBufferOriginalAttributes;
+
   UINT8                           Edid[128];
 } QEMU_VIDEO_PRIVATE_DATA;
 
@@ -199,6 +215,15 @@ extern EFI_COMPONENT_NAME2_PROTOCOL  gQemuVideoComponentName2;
 #define VBE_DISPI_LFB_ENABLED  0x40
 #define VBE_DISPI_NOCLEARMEM   0x80
 
+//
+// Offsets of the register blocks in the stdvga MMIO BAR (qemu 1.3+)
+//
+#define QEMU_VIDEO_MMIO_VGA_OFFSET    0x400
+#define QEMU_VIDEO_MMIO_DISPI_OFFSET  0x500
+
+#define QEMU_VIDEO_CACHE_ATTRIBUTE_MASK \
+  (EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB | EFI_MEMORY_UCE)
+
 //
 // Graphics Output Hardware abstraction internal worker functions
 //
@@ -465,6 +490,14 @@ BochsWrite (
   UINT16                   Data
   );
 
+VOID
+BochsWriteBlock (
+  QEMU_VIDEO_PRIVATE_DATA  *Private,
+  UINT16                   FirstReg,
+  UINTN                    Count,
+  CONST UINT16             *Data
+  );
+
 UINT16
 BochsRead (
   QEMU_VIDEO_PRIVATE_DATA  *Private,
@@ -478,6 +511,16 @@ VgaOutb (
   UINT8                    Data
   );
 
+VOID
+QemuVideoMapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  );
+
+VOID
+QemuVideoUnmapFrameBufferWc (
+  QEMU_VIDEO_PRIVATE_DATA  *Private
+  );
+
 EFI_STATUS
 QemuVideoBochsModeSetup (
   QEMU_VIDEO_PRIVATE_DATA  *Private,
@@ -419,6 +419,220 @@ AddPpttTable (
   return Status;
 }
 
+/*
+ * A function that returns the number of NUMA nodes, as one more than the
+ * highest node referenced by a CPU or memory node of the device tree.
+ */
+STATIC
+UINT32
+CountNumaNodes (
+  VOID
+  )
+{
+  UINT32  NumNodes;
+  UINT32  NodeId;
+  UINT32  CpuId;
+  UINTN   Index;
+  UINT64  Base;
+  UINT64  Size;
+
+  NumNodes = 1;
+
+  for (CpuId = 0; CpuId < PcdGet32 (PcdCoreCount); CpuId++) {
+    NodeId   = FdtHelperGetCpuNumaNodeId (CpuId);
+    NumNodes = MAX (NumNodes, NodeId + 1);
+  }
+
+  for (Index = 0; !EFI_ERROR (FdtHelperGetMemoryNode (Index, &Base, &Size, &NodeId)); Index++) {
+    NumNodes = MAX (NumNodes, NodeId + 1);
+  }
+
+  return NumNodes;
+}
+
+/*
+ * A function that adds the SRAT ACPI table.
+ */
+EFI_STATUS
+AddSratTable (
+  IN EFI_ACPI_TABLE_PROTOCOL  *AcpiTable
+  )
+{
+  EFI_STATUS            Status;
+  UINTN                 TableHandle;
+  UINT32                TableSize;
+  EFI_PHYSICAL_ADDRESS  PageAddress;
+  UINT8                 *New;
+  UINT32                CpuId;
+  UINTN                 Index;
+  UINTN                 NumMemNodes;
+  UINT64                Base;
+  UINT64                Size;
+  UINT32                NodeId;
+  UINT32                NumCores = PcdGet32 (PcdCoreCount);
+
+  EFI_ACPI_6_3_SYSTEM_RESOURCE_AFFINITY_TABLE_HEADER  Header = {
+    SBSAQEMU_ACPI_HEADER (
+      EFI_ACPI_6_3_SYSTEM_RESOURCE_AFFINITY_TABLE_SIGNATURE,
+      EFI_ACPI_6_3_SYSTEM_RESOURCE_AFFINITY_TABLE_HEADER,
+      EFI_ACPI_6_3_SYSTEM_RESOURCE_AFFINITY_TABLE_REVISION
+      ),
+    1,  /* Reserved1, must be 1 for backward compatibility */
+    0   /* Reserved2 */
+  };
+
+  EFI_ACPI_6_3_GICC_AFFINITY_STRUCTURE    GiccAffinity = SBSAQEMU_ACPI_SRAT_GICC_AFFINITY_INIT ();
+  EFI_ACPI_6_3_MEMORY_AFFINITY_STRUCTURE  MemAffinity  = SBSAQEMU_ACPI_SRAT_MEMORY_AFFINITY_INIT ();
+
+  for (NumMemNodes = 0; !EFI_ERROR (FdtHelperGetMemoryNode (NumMemNodes, &Base, &Size, &NodeId)); NumMemNodes++) {
+  }
+
+  TableSize = sizeof (EFI_ACPI_6_3_SYSTEM_RESOURCE_AFFINITY_TABLE_HEADER) +
+              (sizeof (EFI_ACPI_6_3_GICC_AFFINITY_STRUCTURE) * NumCores) +
+              (sizeof (EFI_ACPI_6_3_MEMORY_AFFINITY_STRUCTURE) * NumMemNodes);
+
+  Status = gBS->AllocatePages (
+                  AllocateAnyPages,
+                  EfiACPIReclaimMemory,
+                  EFI_SIZE_TO_PAGES (TableSize),
+                  &PageAddress
+                  );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed to allocate pages for SRAT table\n"));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  New = (UINT8 *)(UINTN)PageAddress;
+  ZeroMem (New, TableSize);
+
+  // Add the ACPI Description table header
+  CopyMem (New, &Header, sizeof (EFI_ACPI_6_3_SYSTEM_RESOURCE_AFFINITY_TABLE_HEADER));
+  ((EFI_ACPI_DESCRIPTION_HEADER *)New)->Length = TableSize;
+  New                                         += sizeof (EFI_ACPI_6_3_SYSTEM_RESOURCE_AFFINITY_TABLE_HEADER);
+
+  // Add a GICC Affinity structure per core, matching the MADT AcpiProcessorUid
+  for (CpuId = 0; CpuId < NumCores; CpuId++) {
+    EFI_ACPI_6_3_GICC_AFFINITY_STRUCTURE  *GiccAffinityPtr;
+
+    CopyMem (New, &GiccAffinity, sizeof (EFI_ACPI_6_3_GICC_AFFINITY_STRUCTURE));
+    GiccAffinityPtr                   = (EFI_ACPI_6_3_GICC_AFFINITY_STRUCTURE *)New;
+    GiccAffinityPtr->ProximityDomain  = FdtHelperGetCpuNumaNodeId (CpuId);
+    GiccAffinityPtr->AcpiProcessorUid = CpuId;
+    New                              += sizeof (EFI_ACPI_6_3_GICC_AFFINITY_STRUCTURE);
+  }
+
+  // Add a Memory Affinity structure per memory node
+  for (Index = 0; Index < NumMemNodes; Index++) {
+    EFI_ACPI_6_3_MEMORY_AFFINITY_STRUCTURE  *MemAffinityPtr;
+
+    FdtHelperGetMemoryNode (Index, &Base, &Size, &NodeId);
+
+    DEBUG ((
+      DEBUG_INFO,
+      "SRAT: node %u memory @ 0x%lx - 0x%lx\n",
+      NodeId,
+      Base,
+      Base + Size - 1
+      ));
+
+    CopyMem (New, &MemAffinity, sizeof (EFI_ACPI_6_3_MEMORY_AFFINITY_STRUCTURE));
+    MemAffinityPtr                  = (EFI_ACPI_6_3_MEMORY_AFFINITY_STRUCTURE *)New;
+    MemAffinityPtr->ProximityDomain = NodeId;
+    MemAffinityPtr->AddressBaseLow  = (UINT32)Base;
+    MemAffinityPtr->AddressBaseHigh = (UINT32)RShiftU64 (Base, 32);
+    MemAffinityPtr->LengthLow       = (UINT32)Size;
+    MemAffinityPtr->LengthHigh      = (UINT32)RShiftU64 (Size, 32);
+    New                            += sizeof (EFI_ACPI_6_3_MEMORY_AFFINITY_STRUCTURE);
+  }
+
+  // Perform Checksum
+  AcpiPlatformChecksum ((UINT8 *)PageAddress, TableSize);
+
+  Status = AcpiTable->InstallAcpiTable (
+                        AcpiTable,
+                        (EFI_ACPI_COMMON_HEADER *)PageAddress,
+                        TableSize,
+                        &TableHandle
+                        );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed to install SRAT table\n"));
+  }
+
+  return Status;
+}
+
+/*
+ * A function that adds the SLIT ACPI table.
+ */
+EFI_STATUS
+AddSlitTable (
+  IN EFI_ACPI_TABLE_PROTOCOL  *AcpiTable,
+  IN UINT32                   NumNodes
+  )
+{
+  EFI_STATUS            Status;
+  UINTN                 TableHandle;
+  UINT32                TableSize;
+  EFI_PHYSICAL_ADDRESS  PageAddress;
+  UINT8                 *New;
+  UINT32                From;
+  UINT32                To;
+
+  EFI_ACPI_6_3_SYSTEM_LOCALITY_DISTANCE_INFORMATION_TABLE_HEADER  Header = {
+    SBSAQEMU_ACPI_HEADER (
+      EFI_ACPI_6_3_SYSTEM_LOCALITY_INFORMATION_TABLE_SIGNATURE,
+      EFI_ACPI_6_3_SYSTEM_LOCALITY_DISTANCE_INFORMATION_TABLE_HEADER,
+      EFI_ACPI_6_3_SYSTEM_LOCALITY_DISTANCE_INFORMATION_TABLE_REVISION
+      ),
+    0   /* NumberOfSystemLocalities */
+  };
+
+  TableSize = sizeof (EFI_ACPI_6_3_SYSTEM_LOCALITY_DISTANCE_INFORMATION_TABLE_HEADER) +
+              (NumNodes * NumNodes);
+
+  Status = gBS->AllocatePages (
+                  AllocateAnyPages,
+                  EfiACPIReclaimMemory,
+                  EFI_SIZE_TO_PAGES (TableSize),
+                  &PageAddress
+                  );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed to allocate pages for SLIT table\n"));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  New = (UINT8 *)(UINTN)PageAddress;
+  ZeroMem (New, TableSize);
+
+  // Add the ACPI Description table header
+  Header.NumberOfSystemLocalities = NumNodes;
+  CopyMem (New, &Header, sizeof (EFI_ACPI_6_3_SYSTEM_LOCALITY_DISTANCE_INFORMATION_TABLE_HEADER));
+  ((EFI_ACPI_DESCRIPTION_HEADER *)New)->Length = TableSize;
+  New                                         += sizeof (EFI_ACPI_6_3_SYSTEM_LOCALITY_DISTANCE_INFORMATION_TABLE_HEADER);
+
+  // Add the distance matrix, one row per initiating node
+  for (From = 0; From < NumNodes; From++) {
+    for (To = 0; To < NumNodes; To++) {
+      *New++ = FdtHelperGetNumaDistance (From, To);
+    }
+  }
+
+  // Perform Checksum
+  AcpiPlatformChecksum ((UINT8 *)PageAddress, TableSize);
+
+  Status = AcpiTable->InstallAcpiTable (
+                        AcpiTable,
+                        (EFI_ACPI_COMMON_HEADER *)PageAddress,
+                        TableSize,
+                        &TableHandle
+                        );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed to install SLIT table\n"));
+  }
+
+  return Status;
+}
+
 EFI_STATUS
 EFIAPI
 InitializeSbsaQemuAcpiDxe (
@@ -429,6 +643,7 @@ InitializeSbsaQemuAcpiDxe (
   EFI_STATUS               Status;
   EFI_ACPI_TABLE_PROTOCOL  *AcpiTable;
   UINT32                   NumCores;
+  UINT32                   NumNodes;
 
   // Parse the device tree and get the number of CPUs
   NumCores = FdtHelperCountCpus ();
@@ -460,5 +675,22 @@ InitializeSbsaQemuAcpiDxe (
     DEBUG ((DEBUG_ERROR, "Failed to add PPTT table\n"));
   }
 
+  // Only describe NUMA topology when Qemu was configured with NUMA nodes,
+  // so that a flat guest keeps booting without SRAT/SLIT.
+  if (FdtHelperHasNumaTopology ()) {
+    Status = AddSratTable (AcpiTable);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "Failed to add SRAT table\n"));
+    }
+
+    NumNodes = CountNumaNodes ();
+    if (NumNodes > 1) {
+      Status = AddSlitTable (AcpiTable, NumNodes);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "Failed to add SLIT table\n"));
+      }
+    }
+  }
+
   return EFI_SUCCESS;
 }
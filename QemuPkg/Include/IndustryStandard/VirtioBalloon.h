@@ -0,0 +1,53 @@
+/** @file
+  Virtio memory balloon device specific type and macro definitions.
+
+  The virtio-balloon device is defined in the VirtIo 1.2 specification, in the
+  "Traditional Memory Balloon Device" section.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_BALLOON_H_
+#define _VIRTIO_BALLOON_H_
+
+#include <IndustryStandard/Virtio.h>
+
+//
+// Device configuration layout.
+//
+#pragma pack (1)
+typedef struct {
+  UINT32    NumPages;
+  UINT32    Actual;
+  UINT32    FreePageHintCmdId;
+  UINT32    PoisonVal;
+} VIRTIO_BALLOON_CONFIG;
+#pragma pack ()
+
+//
+// Device feature bits.
+//
+#define VIRTIO_BALLOON_F_MUST_TELL_HOST  BIT0
+#define VIRTIO_BALLOON_F_STATS_VQ        BIT1
+#define VIRTIO_BALLOON_F_DEFLATE_ON_OOM  BIT2
+#define VIRTIO_BALLOON_F_FREE_PAGE_HINT  BIT3
+#define VIRTIO_BALLOON_F_PAGE_POISON     BIT4
+#define VIRTIO_BALLOON_F_PAGE_REPORTING  BIT5
+
+//
+// Queue numbers. The statistics, free page hint and page reporting queues
+// exist only if the corresponding feature is offered; a queue that does not
+// exist takes no number, so the number of each later queue shifts down.
+//
+#define VIRTIO_BALLOON_INFLATE_QUEUE  0
+#define VIRTIO_BALLOON_DEFLATE_QUEUE  1
+
+//
+// The page size that the inflate and deflate queues count in, independently
+// of the guest's page size.
+//
+#define VIRTIO_BALLOON_PAGE_SIZE  SIZE_4KB
+
+#endif // _VIRTIO_BALLOON_H_
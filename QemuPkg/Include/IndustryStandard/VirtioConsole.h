@@ -0,0 +1,45 @@
+/** @file
+  Virtio console device specific type and macro definitions.
+
+  The virtio-console device is defined in the VirtIo 1.1 specification, in the
+  "Console Device" section. Without the MULTIPORT feature, the device has a
+  single port, port 0, which is served by the first receive / transmit queue
+  pair.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_CONSOLE_H_
+#define _VIRTIO_CONSOLE_H_
+
+#include <IndustryStandard/Virtio.h>
+
+//
+// Queue numbers of port 0.
+//
+#define VIRTIO_CONSOLE_RECEIVE_QUEUE   0
+#define VIRTIO_CONSOLE_TRANSMIT_QUEUE  1
+
+//
+// Device-specific feature bits.
+//
+#define VIRTIO_CONSOLE_F_SIZE         BIT0
+#define VIRTIO_CONSOLE_F_MULTIPORT    BIT1
+#define VIRTIO_CONSOLE_F_EMERG_WRITE  BIT2
+
+//
+// Device configuration layout. The fields are only valid if the matching
+// feature has been negotiated.
+//
+#pragma pack (1)
+typedef struct {
+  UINT16    Cols;
+  UINT16    Rows;
+  UINT32    MaxNrPorts;
+  UINT32    EmergWrite;
+} VIRTIO_CONSOLE_CONFIG;
+#pragma pack ()
+
+#endif // _VIRTIO_CONSOLE_H_
@@ -0,0 +1,412 @@
+/** @file
+  Type and macro definitions specific to the Virtio Filesystem device, and the
+  subset of the FUSE wire protocol that the device transports.
+
+  At the time of this writing, the latest released Virtio specification (v1.1)
+  does not include the virtio-fs device. The development version of the
+  specification defines it however; see the "Virtio Filesystem device"
+  section. The FUSE message layouts correspond to FUSE ABI version 7.31 (Linux
+  kernel header "include/uapi/linux/fuse.h").
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_FS_H_
+#define _VIRTIO_FS_H_
+
+#include <IndustryStandard/Virtio.h>
+
+//
+// Lowest numbered queue for sending normal priority requests. The high
+// priority queue (#0) is not used by this firmware.
+//
+#define VIRTIO_FS_REQUEST_QUEUE  1
+
+//
+// Number of bytes in the VIRTIO_FS_CONFIG.Tag field.
+//
+#define VIRTIO_FS_TAG_BYTES  36
+
+//
+// Device configuration layout.
+//
+#pragma pack (1)
+typedef struct {
+  //
+  // The Tag field can be considered the filesystem label, or a mount point
+  // hint. It is UTF-8 encoded, and padded to full size with NUL bytes. If the
+  // encoded bytes take up the entire Tag field, then there is no NUL
+  // terminator.
+  //
+  UINT8     Tag[VIRTIO_FS_TAG_BYTES];
+  //
+  // The total number of request virtqueues exposed by the device (i.e.,
+  // excluding the "hiprio" queue).
+  //
+  UINT32    NumReqQueues;
+} VIRTIO_FS_CONFIG;
+#pragma pack ()
+
+//
+// FUSE-related definitions follow.
+//
+// The FUSE ABI version that this driver implements.
+//
+#define VIRTIO_FS_FUSE_MAJOR  7
+#define VIRTIO_FS_FUSE_MINOR  31
+
+//
+// The inode number of the root directory.
+//
+#define VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID  1
+
+//
+// Distinguished errno values.
+//
+#define VIRTIO_FS_FUSE_ERRNO_EPERM         1
+#define VIRTIO_FS_FUSE_ERRNO_ENOENT        2
+#define VIRTIO_FS_FUSE_ERRNO_EIO           5
+#define VIRTIO_FS_FUSE_ERRNO_EBADF         9
+#define VIRTIO_FS_FUSE_ERRNO_ENOMEM        12
+#define VIRTIO_FS_FUSE_ERRNO_EACCES        13
+#define VIRTIO_FS_FUSE_ERRNO_EBUSY         16
+#define VIRTIO_FS_FUSE_ERRNO_EEXIST        17
+#define VIRTIO_FS_FUSE_ERRNO_ENOTDIR       20
+#define VIRTIO_FS_FUSE_ERRNO_EISDIR        21
+#define VIRTIO_FS_FUSE_ERRNO_EINVAL        22
+#define VIRTIO_FS_FUSE_ERRNO_EFBIG         27
+#define VIRTIO_FS_FUSE_ERRNO_ENOSPC        28
+#define VIRTIO_FS_FUSE_ERRNO_EROFS         30
+#define VIRTIO_FS_FUSE_ERRNO_ENAMETOOLONG  36
+#define VIRTIO_FS_FUSE_ERRNO_ENOSYS        38
+#define VIRTIO_FS_FUSE_ERRNO_ENOTEMPTY     39
+#define VIRTIO_FS_FUSE_ERRNO_EDQUOT        122
+
+//
+// File mode bitmasks.
+//
+#define VIRTIO_FS_FUSE_MODE_TYPE_MASK  0170000u
+#define VIRTIO_FS_FUSE_MODE_TYPE_REG   0100000u
+#define VIRTIO_FS_FUSE_MODE_TYPE_DIR   0040000u
+#define VIRTIO_FS_FUSE_MODE_PERM_RWXU  0000700u
+#define VIRTIO_FS_FUSE_MODE_PERM_RUSR  0000400u
+#define VIRTIO_FS_FUSE_MODE_PERM_WUSR  0000200u
+#define VIRTIO_FS_FUSE_MODE_PERM_XUSR  0000100u
+#define VIRTIO_FS_FUSE_MODE_PERM_RGRP  0000040u
+#define VIRTIO_FS_FUSE_MODE_PERM_XGRP  0000010u
+#define VIRTIO_FS_FUSE_MODE_PERM_ROTH  0000004u
+#define VIRTIO_FS_FUSE_MODE_PERM_XOTH  0000001u
+
+//
+// Flags for VirtioFsFuseOpOpen and VirtioFsFuseOpCreate.
+//
+#define VIRTIO_FS_FUSE_OPEN_REQ_F_RDONLY  0
+#define VIRTIO_FS_FUSE_OPEN_REQ_F_RDWR    2
+#define VIRTIO_FS_FUSE_OPEN_REQ_F_CREAT   0100
+#define VIRTIO_FS_FUSE_OPEN_REQ_F_EXCL    0200
+
+//
+// Bits in VIRTIO_FS_FUSE_SETATTR_REQUEST.Valid.
+//
+#define VIRTIO_FS_FUSE_SETATTR_REQ_F_MODE   BIT0
+#define VIRTIO_FS_FUSE_SETATTR_REQ_F_SIZE   BIT3
+#define VIRTIO_FS_FUSE_SETATTR_REQ_F_ATIME  BIT4
+#define VIRTIO_FS_FUSE_SETATTR_REQ_F_MTIME  BIT5
+#define VIRTIO_FS_FUSE_SETATTR_REQ_F_FH     BIT6
+
+//
+// FUSE operation codes.
+//
+typedef enum {
+  VirtioFsFuseOpLookup      = 1,
+  VirtioFsFuseOpForget      = 2,
+  VirtioFsFuseOpGetAttr     = 3,
+  VirtioFsFuseOpSetAttr     = 4,
+  VirtioFsFuseOpMkDir       = 9,
+  VirtioFsFuseOpUnlink      = 10,
+  VirtioFsFuseOpRmDir       = 11,
+  VirtioFsFuseOpOpen        = 14,
+  VirtioFsFuseOpRead        = 15,
+  VirtioFsFuseOpWrite       = 16,
+  VirtioFsFuseOpStatFs      = 17,
+  VirtioFsFuseOpRelease     = 18,
+  VirtioFsFuseOpFsync       = 20,
+  VirtioFsFuseOpInit        = 26,
+  VirtioFsFuseOpOpenDir     = 27,
+  VirtioFsFuseOpReleaseDir  = 29,
+  VirtioFsFuseOpCreate      = 35,
+  VirtioFsFuseOpBatchForget = 42,
+  VirtioFsFuseOpReadDirPlus = 44,
+} VIRTIO_FS_FUSE_OPCODE;
+
+#pragma pack (1)
+//
+// Request-response headers common to all request types.
+//
+typedef struct {
+  UINT32    Len;
+  UINT32    Opcode;
+  UINT64    Unique;
+  UINT64    NodeId;
+  UINT32    Uid;
+  UINT32    Gid;
+  UINT32    Pid;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_REQUEST;
+
+typedef struct {
+  UINT32    Len;
+  INT32     Error;
+  UINT64    Unique;
+} VIRTIO_FS_FUSE_RESPONSE;
+
+//
+// Structure with which the Virtio Filesystem device reports a NodeId to the
+// FUSE client (i.e., to the Virtio Filesystem driver).
+//
+typedef struct {
+  UINT64    NodeId;
+  UINT64    Generation;
+  UINT64    EntryValid;
+  UINT64    AttrValid;
+  UINT32    EntryValidNsec;
+  UINT32    AttrValidNsec;
+} VIRTIO_FS_FUSE_NODE_RESPONSE;
+
+//
+// Structure describing the host-side attributes of an inode.
+//
+typedef struct {
+  UINT64    Ino;
+  UINT64    Size;
+  UINT64    Blocks;
+  UINT64    Atime;
+  UINT64    Mtime;
+  UINT64    Ctime;
+  UINT32    AtimeNsec;
+  UINT32    MtimeNsec;
+  UINT32    CtimeNsec;
+  UINT32    Mode;
+  UINT32    Nlink;
+  UINT32    Uid;
+  UINT32    Gid;
+  UINT32    Rdev;
+  UINT32    Blksize;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE;
+
+typedef struct {
+  VIRTIO_FS_FUSE_NODE_RESPONSE          Node;
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE    Attr;
+} VIRTIO_FS_FUSE_ENTRY_RESPONSE;
+
+//
+// Header for VirtioFsFuseOpGetAttr and VirtioFsFuseOpSetAttr responses.
+//
+typedef struct {
+  UINT64    AttrValid;
+  UINT32    AttrValidNsec;
+  UINT32    Dummy;
+} VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE_HEADER;
+
+typedef struct {
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE_HEADER    Header;
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE           Attr;
+} VIRTIO_FS_FUSE_GETATTR_RESPONSE;
+
+//
+// Body sent with VirtioFsFuseOpGetAttr.
+//
+typedef struct {
+  UINT32    GetAttrFlags;
+  UINT32    Dummy;
+  UINT64    FileHandle;
+} VIRTIO_FS_FUSE_GETATTR_REQUEST;
+
+//
+// Body sent with VirtioFsFuseOpSetAttr.
+//
+typedef struct {
+  UINT32    Valid;
+  UINT32    Padding;
+  UINT64    FileHandle;
+  UINT64    Size;
+  UINT64    LockOwner;
+  UINT64    Atime;
+  UINT64    Mtime;
+  UINT64    Ctime;
+  UINT32    AtimeNsec;
+  UINT32    MtimeNsec;
+  UINT32    CtimeNsec;
+  UINT32    Mode;
+  UINT32    Unused4;
+  UINT32    Uid;
+  UINT32    Gid;
+  UINT32    Unused5;
+} VIRTIO_FS_FUSE_SETATTR_REQUEST;
+
+//
+// Body sent with VirtioFsFuseOpBatchForget, followed by Count
+// VIRTIO_FS_FUSE_FORGET_ONE elements.
+//
+typedef struct {
+  UINT32    Count;
+  UINT32    Dummy;
+} VIRTIO_FS_FUSE_BATCH_FORGET_REQUEST;
+
+typedef struct {
+  UINT64    NodeId;
+  UINT64    NumberOfLookups;
+} VIRTIO_FS_FUSE_FORGET_ONE;
+
+//
+// Body sent with VirtioFsFuseOpMkDir, followed by the NUL-terminated name.
+//
+typedef struct {
+  UINT32    Mode;
+  UINT32    Umask;
+} VIRTIO_FS_FUSE_MKDIR_REQUEST;
+
+//
+// Body sent with VirtioFsFuseOpOpen and VirtioFsFuseOpOpenDir.
+//
+typedef struct {
+  UINT32    Flags;
+  UINT32    Unused;
+} VIRTIO_FS_FUSE_OPEN_REQUEST;
+
+typedef struct {
+  UINT64    FileHandle;
+  UINT32    OpenFlags;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_OPEN_RESPONSE;
+
+//
+// Body sent with VirtioFsFuseOpRead and VirtioFsFuseOpReadDirPlus. The
+// response is the raw file data, or a sequence of
+// VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE elements.
+//
+typedef struct {
+  UINT64    FileHandle;
+  UINT64    Offset;
+  UINT32    Size;
+  UINT32    ReadFlags;
+  UINT64    LockOwner;
+  UINT32    Flags;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_READ_REQUEST;
+
+//
+// Body sent with VirtioFsFuseOpWrite, followed by the raw data.
+//
+typedef struct {
+  UINT64    FileHandle;
+  UINT64    Offset;
+  UINT32    Size;
+  UINT32    WriteFlags;
+  UINT64    LockOwner;
+  UINT32    Flags;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_WRITE_REQUEST;
+
+typedef struct {
+  UINT32    Size;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_WRITE_RESPONSE;
+
+//
+// Response to VirtioFsFuseOpStatFs.
+//
+typedef struct {
+  UINT64    Blocks;
+  UINT64    Bfree;
+  UINT64    Bavail;
+  UINT64    Files;
+  UINT64    Ffree;
+  UINT32    Bsize;
+  UINT32    NameLen;
+  UINT32    Frsize;
+  UINT32    Padding;
+  UINT32    Spare[6];
+} VIRTIO_FS_FUSE_STATFS_RESPONSE;
+
+//
+// Body sent with VirtioFsFuseOpRelease and VirtioFsFuseOpReleaseDir.
+//
+typedef struct {
+  UINT64    FileHandle;
+  UINT32    Flags;
+  UINT32    ReleaseFlags;
+  UINT64    LockOwner;
+} VIRTIO_FS_FUSE_RELEASE_REQUEST;
+
+//
+// Body sent with VirtioFsFuseOpFsync.
+//
+typedef struct {
+  UINT64    FileHandle;
+  UINT32    FsyncFlags;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_FSYNC_REQUEST;
+
+//
+// Body sent with VirtioFsFuseOpInit.
+//
+typedef struct {
+  UINT32    Major;
+  UINT32    Minor;
+  UINT32    MaxReadahead;
+  UINT32    Flags;
+} VIRTIO_FS_FUSE_INIT_REQUEST;
+
+typedef struct {
+  UINT32    Major;
+  UINT32    Minor;
+  UINT32    MaxReadahead;
+  UINT32    Flags;
+  UINT16    MaxBackground;
+  UINT16    CongestionThreshold;
+  UINT32    MaxWrite;
+  UINT32    TimeGran;
+  UINT16    MaxPages;
+  UINT16    MapAlignment;
+  UINT32    Unused[8];
+} VIRTIO_FS_FUSE_INIT_RESPONSE;
+
+//
+// Body sent with VirtioFsFuseOpCreate, followed by the NUL-terminated name.
+// The response is a VIRTIO_FS_FUSE_ENTRY_RESPONSE followed by a
+// VIRTIO_FS_FUSE_OPEN_RESPONSE.
+//
+typedef struct {
+  UINT32    Flags;
+  UINT32    Mode;
+  UINT32    Umask;
+  UINT32    Padding;
+} VIRTIO_FS_FUSE_CREATE_REQUEST;
+
+//
+// Header of a directory entry in a VirtioFsFuseOpReadDirPlus response. The
+// NUL-less name of Namelen bytes follows the header, padded to a multiple of
+// 8 bytes in total.
+//
+typedef struct {
+  VIRTIO_FS_FUSE_NODE_RESPONSE          Node;
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE    Attr;
+  UINT64                                NodeIdDup;
+  UINT64                                CookieForNextEntry;
+  UINT32                                Namelen;
+  UINT32                                Type;
+} VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE;
+#pragma pack ()
+
+//
+// The total size of a VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE element, including
+// the name and the padding.
+//
+#define VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE_SIZE(Namelen) \
+  ALIGN_VALUE (sizeof (VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE) + (Namelen), 8)
+
+#endif // _VIRTIO_FS_H_
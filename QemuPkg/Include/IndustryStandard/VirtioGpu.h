@@ -0,0 +1,173 @@
+/** @file
+  Virtio GPU Device specific type and macro definitions.
+
+  The virtio-gpu device is defined in the VirtIo 1.2 specification, in the
+  "GPU Device" section. The device is modern-only. Only the 2D command subset
+  that a firmware framebuffer driver needs is declared here.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_GPU_H_
+#define _VIRTIO_GPU_H_
+
+#include <IndustryStandard/Virtio.h>
+
+//
+// Queue number of the control queue. The cursor queue is not used.
+//
+#define VIRTIO_GPU_CONTROL_QUEUE  0
+
+//
+// Device configuration layout.
+//
+#pragma pack (1)
+typedef struct {
+  UINT32    EventsRead;
+  UINT32    EventsClear;
+  UINT32    NumScanouts;
+  UINT32    Reserved;
+} VIRTIO_GPU_CONFIG;
+#pragma pack ()
+
+//
+// Control queue command and response types.
+//
+typedef enum {
+  //
+  // 2D commands
+  //
+  VirtioGpuCmdGetDisplayInfo        = 0x0100,
+  VirtioGpuCmdResourceCreate2d      = 0x0101,
+  VirtioGpuCmdResourceUnref         = 0x0102,
+  VirtioGpuCmdSetScanout            = 0x0103,
+  VirtioGpuCmdResourceFlush         = 0x0104,
+  VirtioGpuCmdTransferToHost2d      = 0x0105,
+  VirtioGpuCmdResourceAttachBacking = 0x0106,
+  VirtioGpuCmdResourceDetachBacking = 0x0107,
+
+  //
+  // Success responses
+  //
+  VirtioGpuRespOkNodata      = 0x1100,
+  VirtioGpuRespOkDisplayInfo = 0x1101,
+
+  //
+  // Error responses
+  //
+  VirtioGpuRespErrUnspec              = 0x1200,
+  VirtioGpuRespErrOutOfMemory         = 0x1201,
+  VirtioGpuRespErrInvalidScanoutId    = 0x1202,
+  VirtioGpuRespErrInvalidResourceId   = 0x1203,
+  VirtioGpuRespErrInvalidContextId    = 0x1204,
+  VirtioGpuRespErrInvalidParameter    = 0x1205,
+} VIRTIO_GPU_CONTROL_TYPE;
+
+//
+// Flags for VIRTIO_GPU_CONTROL_HEADER.Flags.
+//
+#define VIRTIO_GPU_FLAG_FENCE  BIT0
+
+//
+// The number of scanouts that VirtioGpuCmdGetDisplayInfo reports on.
+//
+#define VIRTIO_GPU_MAX_SCANOUTS  16
+
+//
+// Pixel formats for VirtioGpuCmdResourceCreate2d. B8G8R8X8 matches
+// PixelBlueGreenRedReserved8BitPerColor.
+//
+typedef enum {
+  VirtioGpuFormatB8G8R8A8Unorm = 1,
+  VirtioGpuFormatB8G8R8X8Unorm = 2,
+} VIRTIO_GPU_FORMATS;
+
+#pragma pack (1)
+//
+// Common header of all requests and responses.
+//
+typedef struct {
+  UINT32    Type;
+  UINT32    Flags;
+  UINT64    FenceId;
+  UINT32    CtxId;
+  UINT32    Padding;
+} VIRTIO_GPU_CONTROL_HEADER;
+
+typedef struct {
+  UINT32    X;
+  UINT32    Y;
+  UINT32    Width;
+  UINT32    Height;
+} VIRTIO_GPU_RECTANGLE;
+
+//
+// VirtioGpuCmdGetDisplayInfo uses a bare header as request.
+//
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  struct {
+    VIRTIO_GPU_RECTANGLE    Rectangle;
+    UINT32                  Enabled;
+    UINT32                  Flags;
+  } Pmodes[VIRTIO_GPU_MAX_SCANOUTS];
+} VIRTIO_GPU_RESP_DISPLAY_INFO;
+
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  UINT32                       ResourceId;
+  UINT32                       Format;
+  UINT32                       Width;
+  UINT32                       Height;
+} VIRTIO_GPU_RESOURCE_CREATE_2D;
+
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  UINT32                       ResourceId;
+  UINT32                       Padding;
+} VIRTIO_GPU_RESOURCE_UNREF;
+
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  VIRTIO_GPU_RECTANGLE         Rectangle;
+  UINT32                       ScanoutId;
+  UINT32                       ResourceId;
+} VIRTIO_GPU_SET_SCANOUT;
+
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  VIRTIO_GPU_RECTANGLE         Rectangle;
+  UINT32                       ResourceId;
+  UINT32                       Padding;
+} VIRTIO_GPU_RESOURCE_FLUSH;
+
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  VIRTIO_GPU_RECTANGLE         Rectangle;
+  UINT64                       Offset;
+  UINT32                       ResourceId;
+  UINT32                       Padding;
+} VIRTIO_GPU_TRANSFER_TO_HOST_2D;
+
+//
+// VirtioGpuCmdResourceAttachBacking with a single guest memory entry.
+//
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  UINT32                       ResourceId;
+  UINT32                       NumberOfEntries;
+  UINT64                       Address;
+  UINT32                       Length;
+  UINT32                       Padding;
+} VIRTIO_GPU_RESOURCE_ATTACH_BACKING;
+
+typedef struct {
+  VIRTIO_GPU_CONTROL_HEADER    Header;
+  UINT32                       ResourceId;
+  UINT32                       Padding;
+} VIRTIO_GPU_RESOURCE_DETACH_BACKING;
+#pragma pack ()
+
+#endif // _VIRTIO_GPU_H_
@@ -0,0 +1,132 @@
+/** @file
+  Virtio input device specific type and macro definitions.
+
+  The virtio-input device is defined in the VirtIo 1.1 specification, in the
+  "Input Device" section. The device is modern-only. It forwards Linux evdev
+  events; the event type and code values below are those of the Linux input
+  subsystem, which the specification refers to.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_INPUT_H_
+#define _VIRTIO_INPUT_H_
+
+#include <IndustryStandard/Virtio.h>
+
+//
+// Queue numbers. The status queue carries LED updates to the device, which
+// a firmware driver does not need.
+//
+#define VIRTIO_INPUT_EVENT_QUEUE   0
+#define VIRTIO_INPUT_STATUS_QUEUE  1
+
+//
+// Values of the Select field of the device configuration.
+//
+#define VIRTIO_INPUT_CFG_UNSET      0x00
+#define VIRTIO_INPUT_CFG_ID_NAME    0x01
+#define VIRTIO_INPUT_CFG_ID_SERIAL  0x02
+#define VIRTIO_INPUT_CFG_ID_DEVIDS  0x03
+#define VIRTIO_INPUT_CFG_PROP_BITS  0x10
+#define VIRTIO_INPUT_CFG_EV_BITS    0x11
+#define VIRTIO_INPUT_CFG_ABS_INFO   0x12
+
+//
+// Device configuration layout. The driver writes Select and Subsel, then
+// reads Size, and the first Size bytes of the union.
+//
+#pragma pack (1)
+typedef struct {
+  UINT32    Min;
+  UINT32    Max;
+  UINT32    Fuzz;
+  UINT32    Flat;
+  UINT32    Res;
+} VIRTIO_INPUT_ABSINFO;
+
+typedef struct {
+  UINT16    BusType;
+  UINT16    Vendor;
+  UINT16    Product;
+  UINT16    Version;
+} VIRTIO_INPUT_DEVIDS;
+
+typedef struct {
+  UINT8    Select;
+  UINT8    Subsel;
+  UINT8    Size;
+  UINT8    Reserved[5];
+  union {
+    CHAR8                   String[128];
+    UINT8                   Bitmap[128];
+    VIRTIO_INPUT_ABSINFO    Abs;
+    VIRTIO_INPUT_DEVIDS     Ids;
+  } u;
+} VIRTIO_INPUT_CONFIG;
+
+//
+// The buffers of the event queue each receive one event.
+//
+typedef struct {
+  UINT16    Type;
+  UINT16    Code;
+  UINT32    Value;
+} VIRTIO_INPUT_EVENT;
+#pragma pack ()
+
+//
+// Event types.
+//
+#define VIRTIO_INPUT_EV_SYN  0x00
+#define VIRTIO_INPUT_EV_KEY  0x01
+#define VIRTIO_INPUT_EV_REL  0x02
+#define VIRTIO_INPUT_EV_ABS  0x03
+
+//
+// Values of EV_KEY events.
+//
+#define VIRTIO_INPUT_KEY_RELEASED  0
+#define VIRTIO_INPUT_KEY_PRESSED   1
+#define VIRTIO_INPUT_KEY_REPEATED  2
+
+//
+// Codes of EV_ABS events.
+//
+#define VIRTIO_INPUT_ABS_X  0x00
+#define VIRTIO_INPUT_ABS_Y  0x01
+
+//
+// Codes of EV_KEY events for pointer buttons. Keyboard keys have codes below
+// VIRTIO_INPUT_BTN_MISC.
+//
+#define VIRTIO_INPUT_BTN_MISC    0x100
+#define VIRTIO_INPUT_BTN_LEFT    0x110
+#define VIRTIO_INPUT_BTN_RIGHT   0x111
+#define VIRTIO_INPUT_BTN_MIDDLE  0x112
+#define VIRTIO_INPUT_BTN_TOUCH   0x14A
+
+//
+// Codes of EV_KEY events for the keyboard keys that the driver handles
+// specially.
+//
+#define VIRTIO_INPUT_KEY_LEFTCTRL    29
+#define VIRTIO_INPUT_KEY_A           30
+#define VIRTIO_INPUT_KEY_LEFTSHIFT   42
+#define VIRTIO_INPUT_KEY_RIGHTSHIFT  54
+#define VIRTIO_INPUT_KEY_LEFTALT     56
+#define VIRTIO_INPUT_KEY_CAPSLOCK    58
+#define VIRTIO_INPUT_KEY_NUMLOCK     69
+#define VIRTIO_INPUT_KEY_SCROLLLOCK  70
+#define VIRTIO_INPUT_KEY_KP7         71
+#define VIRTIO_INPUT_KEY_KPDOT       83
+#define VIRTIO_INPUT_KEY_RIGHTCTRL   97
+#define VIRTIO_INPUT_KEY_SYSRQ       99
+#define VIRTIO_INPUT_KEY_RIGHTALT    100
+#define VIRTIO_INPUT_KEY_LEFTMETA    125
+#define VIRTIO_INPUT_KEY_RIGHTMETA   126
+#define VIRTIO_INPUT_KEY_COMPOSE     127
+
+#endif // _VIRTIO_INPUT_H_
@@ -0,0 +1,35 @@
+/** @file
+  Virtio persistent memory device specific type and macro definitions.
+
+  The virtio-pmem device is defined in the VirtIo 1.2 specification, in the
+  "PMEM Device" section. The device is modern-only.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_PMEM_H_
+#define _VIRTIO_PMEM_H_
+
+#include <IndustryStandard/Virtio.h>
+
+//
+// Device configuration layout. The persistent memory region is mapped by the
+// hypervisor at guest-physical address Start, outside of the guest RAM
+// reported to the firmware.
+//
+#pragma pack (1)
+typedef struct {
+  UINT64    Start;
+  UINT64    Size;
+} VIRTIO_PMEM_CONFIG;
+#pragma pack ()
+
+//
+// Queue number of the request queue. The request queue carries flush requests
+// only, which a firmware driver that does not write the region does not need.
+//
+#define VIRTIO_PMEM_REQUEST_QUEUE  0
+
+#endif // _VIRTIO_PMEM_H_
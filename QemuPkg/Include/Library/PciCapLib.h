@@ -201,11 +201,52 @@ PciCapListInit (
   OUT PCI_CAP_LIST  **CapList
   );
 
+/**
+  Parse the capabilities lists (both normal and extended, as applicable) from
+  an in-memory image of a PCI device's config space.
+
+  The image is parsed exactly as PciCapListInit() would parse the live config
+  space. This allows callers that already hold a copy of config space -- for
+  example, a recorded image -- to locate capabilities without any config space
+  access. If ConfigSpaceSize covers only normal config space, the image is
+  treated as having no extended capabilities.
+
+  @param[in] ConfigSpace      The config space image, starting at offset 0.
+
+  @param[in] ConfigSpaceSize  The size of ConfigSpace in bytes. Must be at
+                              least PCI_MAX_CONFIG_OFFSET, and at most
+                              PCI_EXP_MAX_CONFIG_OFFSET.
+
+  @param[out] CapList         Opaque data structure that holds an in-memory
+                              representation of the parsed capabilities lists.
+                              PCI_CAP objects located in CapList describe
+                              offsets within ConfigSpace; PciCapRead() and
+                              PciCapWrite() are not applicable to them.
+
+  @retval RETURN_SUCCESS            The capabilities lists have been parsed
+                                    from ConfigSpace.
+
+  @retval RETURN_INVALID_PARAMETER  ConfigSpaceSize is out of range.
+
+  @retval RETURN_OUT_OF_RESOURCES   Memory allocation failed.
+
+  @retval RETURN_DEVICE_ERROR       A loop or some other kind of invalid
+                                    pointer was detected in the capabilities
+                                    lists of ConfigSpace.
+**/
+RETURN_STATUS
+EFIAPI
+PciCapListInitFromSnapshot (
+  IN  CONST VOID    *ConfigSpace,
+  IN  UINT16        ConfigSpaceSize,
+  OUT PCI_CAP_LIST  **CapList
+  );
+
 /**
   Free the resources used by CapList.
 
   @param[in] CapList  The PCI_CAP_LIST object to free, originally produced by
-                      PciCapListInit().
+                      PciCapListInit() or PciCapListInitFromSnapshot().
 **/
 VOID
 EFIAPI
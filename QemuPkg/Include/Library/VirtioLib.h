@@ -210,6 +210,56 @@ VirtioFlush (
   OUT    UINT32                  *UsedLen    OPTIONAL
   );
 
+/**
+
+  Notify the host about several descriptor chains just built, and wait until
+  the host processes all of them.
+
+  The chains must have been built after a single VirtioPrepare() call, by
+  appending their descriptors back to back with VirtioAppendDesc(). The head
+  descriptor index of each chain is the value of Indices->NextDescIdx right
+  before the first VirtioAppendDesc() call for that chain. The caller is
+  responsible for ensuring that the ring has enough descriptors for all
+  chains.
+
+  The host may complete the chains in any order.
+
+  @param[in] VirtIo       The target virtio device to notify.
+
+  @param[in] VirtQueueId  Identifies the queue for the target device.
+
+  @param[in,out] Ring     The virtio ring with descriptors to submit.
+
+  @param[in] HeadDescIdx  Array of ChainCount elements, identifying the head
+                          descriptor of each descriptor chain.
+
+  @param[in] ChainCount   The number of descriptor chains to submit. Must be
+                          between 1 and Ring->QueueSize, inclusive.
+
+  @param[out] UsedLen     On success, array of ChainCount elements; each
+                          element receives the total number of bytes that the
+                          host wrote, consecutively across the buffers linked
+                          by the corresponding descriptor chain. May be NULL
+                          if the caller doesn't care, or can compute the same
+                          information from device-specific request structures
+                          linked by the descriptor chains.
+
+  @return              Error code from VirtIo->SetQueueNotify() if it fails.
+
+  @retval EFI_SUCCESS  Otherwise, the host processed all descriptors.
+
+**/
+EFI_STATUS
+EFIAPI
+VirtioFlushBatch (
+  IN     VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN     UINT16                  VirtQueueId,
+  IN OUT VRING                   *Ring,
+  IN     CONST UINT16            *HeadDescIdx,
+  IN     UINT16                  ChainCount,
+  OUT    UINT32                  *UsedLen    OPTIONAL
+  );
+
 /**
 
   Report the feature bits to the VirtIo 1.0 device that the VirtIo 1.0 driver
@@ -0,0 +1,65 @@
+/** @file
+  Log sink interface produced by VirtioConsoleDxe for virtio-console devices.
+
+  Log data written through this protocol is staged in a buffer that is shared
+  with the device and handed to the host in large batches, one notification
+  per batch, instead of one I/O port access per byte.
+
+  The interface is also published as a configuration table under the same
+  GUID, for callers that cannot look up protocols.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_CONSOLE_LOG_H_
+#define _VIRTIO_CONSOLE_LOG_H_
+
+#define QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL_GUID \
+  { 0x9a886c1e, 0x233b, 0x4276, { 0x9a, 0x79, 0x65, 0xc2, 0x48, 0xd3, 0xd2, 0xc8 } }
+
+typedef struct _QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL;
+
+/**
+  Queue log data for the host.
+
+  The data is copied, and handed to the host once a staging buffer fills up,
+  or at the latest when the sink is flushed. The function may be called at
+  any TPL, and does not produce debug output itself.
+
+  @param[in] This           The protocol instance.
+  @param[in] Buffer         The data to queue.
+  @param[in] NumberOfBytes  The number of bytes in Buffer.
+
+  @return  The number of bytes queued. Less than NumberOfBytes if the sink has
+           been shut down, for example at ExitBootServices(), or if the host
+           stopped consuming data.
+**/
+typedef
+UINTN
+(EFIAPI *QEMU_VIRTIO_CONSOLE_LOG_WRITE)(
+  IN QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL  *This,
+  IN CONST UINT8                       *Buffer,
+  IN UINTN                             NumberOfBytes
+  );
+
+/**
+  Hand all queued log data to the host.
+
+  @param[in] This  The protocol instance.
+**/
+typedef
+VOID
+(EFIAPI *QEMU_VIRTIO_CONSOLE_LOG_FLUSH)(
+  IN QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL  *This
+  );
+
+struct _QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL {
+  QEMU_VIRTIO_CONSOLE_LOG_WRITE    Write;
+  QEMU_VIRTIO_CONSOLE_LOG_FLUSH    Flush;
+};
+
+extern EFI_GUID  gQemuVirtioConsoleLogProtocolGuid;
+
+#endif // _VIRTIO_CONSOLE_LOG_H_
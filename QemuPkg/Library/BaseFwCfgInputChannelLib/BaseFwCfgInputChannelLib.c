@@ -15,6 +15,7 @@
 #include <Library/DebugLib.h>
 #include <Library/InputChannelLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Library/QemuFwCfgLib.h>
 
 /**
@@ -23,14 +24,18 @@
   This library instance returns a log from the QEMU FW CFG interface.
   https://www.qemu.org/docs/master/specs/fw_cfg.html
 
+  The size of the log is under host control. It is checked against
+  PcdFwCfgTpmReplayLogMaxSize before any memory is allocated for the log; the
+  default limit is far above the size of realistic replay logs.
+
   @param[out] ReplayEventLog            A pointer to a pointer to the buffer to hold the event log data.
   @param[out] ReplayEventLogSize        The size of the data placed in the buffer.
 
   @retval    EFI_SUCCESS            The TPM Replay event log was returned successfully.
   @retval    EFI_INVALID_PARAMETER  A pointer argument given is NULL.
-  @retval    EFI_UNSUPPORTED        The function is not implemented yet. The arguments are not used.
-  @retval    EFI_COMPROMISED_DATA   The event log data found is not valid.
-  @retval    EFI_NOT_FOUND          The event log data was not found.
+  @retval    EFI_UNSUPPORTED        The event log is larger than PcdFwCfgTpmReplayLogMaxSize.
+  @retval    EFI_NOT_FOUND          The event log data was not found, or is empty.
+  @retval    EFI_OUT_OF_RESOURCES   Memory for the event log could not be allocated.
 
 **/
 EFI_STATUS
@@ -58,6 +63,22 @@ GetReplayEventLogFromCustomInterface (
 
   DEBUG ((DEBUG_INFO, "[%a] - TPM Replay FW CFG log found. Item 0x%x of size 0x%x.\n", __func__, LogItem, LogSize));
 
+  if (LogSize == 0) {
+    DEBUG ((DEBUG_ERROR, "[%a] - TPM Replay FW CFG log is empty.\n", __func__));
+    return EFI_NOT_FOUND;
+  }
+
+  if (LogSize > FixedPcdGet32 (PcdFwCfgTpmReplayLogMaxSize)) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "[%a] - TPM Replay FW CFG log size 0x%x exceeds PcdFwCfgTpmReplayLogMaxSize (0x%x). Raise the PCD to replay this log.\n",
+      __func__,
+      LogSize,
+      FixedPcdGet32 (PcdFwCfgTpmReplayLogMaxSize)
+      ));
+    return EFI_UNSUPPORTED;
+  }
+
   LogPageCount = EFI_SIZE_TO_PAGES (LogSize);
   LogBase      = AllocatePages (LogPageCount);
   if (LogBase == NULL) {
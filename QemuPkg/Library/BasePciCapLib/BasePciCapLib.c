@@ -17,124 +17,26 @@
 
 #include "BasePciCapLib.h"
 
-/**
-  Compare a standalone PCI_CAP_KEY against a PCI_CAP containing an embedded
-  PCI_CAP_KEY.
-
-  @param[in] PciCapKey  Pointer to the bare PCI_CAP_KEY.
-
-  @param[in] PciCap     Pointer to the PCI_CAP with the embedded PCI_CAP_KEY.
-
-  @retval <0  If PciCapKey compares less than PciCap->Key.
-
-  @retval  0  If PciCapKey compares equal to PciCap->Key.
-
-  @retval >0  If PciCapKey compares greater than PciCap->Key.
-**/
-STATIC
-INTN
-EFIAPI
-ComparePciCapKey (
-  IN CONST VOID  *PciCapKey,
-  IN CONST VOID  *PciCap
-  )
-{
-  CONST PCI_CAP_KEY  *Key1;
-  CONST PCI_CAP_KEY  *Key2;
-
-  Key1 = PciCapKey;
-  Key2 = &((CONST PCI_CAP *)PciCap)->Key;
-
-  if (Key1->Domain < Key2->Domain) {
-    return -1;
-  }
-
-  if (Key1->Domain > Key2->Domain) {
-    return 1;
-  }
-
-  if (Key1->CapId < Key2->CapId) {
-    return -1;
-  }
-
-  if (Key1->CapId > Key2->CapId) {
-    return 1;
-  }
-
-  if (Key1->Instance < Key2->Instance) {
-    return -1;
-  }
-
-  if (Key1->Instance > Key2->Instance) {
-    return 1;
-  }
-
-  return 0;
-}
-
-/**
-  Compare two PCI_CAP objects based on PCI_CAP.Key.
-
-  @param[in] PciCap1  Pointer to the first PCI_CAP.
-
-  @param[in] PciCap2  Pointer to the second PCI_CAP.
-
-  @retval <0  If PciCap1 compares less than PciCap2.
-
-  @retval  0  If PciCap1 compares equal to PciCap2.
-
-  @retval >0  If PciCap1 compares greater than PciCap2.
-**/
-STATIC
-INTN
-EFIAPI
-ComparePciCap (
-  IN CONST VOID  *PciCap1,
-  IN CONST VOID  *PciCap2
-  )
-{
-  CONST PCI_CAP_KEY  *PciCap1Key;
-
-  PciCap1Key = &((CONST PCI_CAP *)PciCap1)->Key;
-  return ComparePciCapKey (PciCap1Key, PciCap2);
-}
-
-/**
-  Compare the standalone UINT16 config space offset of a capability header
-  against a PCI_CAP containing an embedded Offset.
-
-  @param[in] CapHdrOffset  Pointer to the bare UINT16 config space offset.
-
-  @param[in] PciCap        Pointer to the PCI_CAP with the embedded Offset.
-
-  @retval <0  If CapHdrOffset compares less than PciCap->Offset.
-
-  @retval  0  If CapHdrOffset compares equal to PciCap->Offset.
-
-  @retval >0  If CapHdrOffset compares greater than PciCap->Offset.
-**/
-STATIC
-INTN
-EFIAPI
-ComparePciCapOffsetKey (
-  IN CONST VOID  *CapHdrOffset,
-  IN CONST VOID  *PciCap
-  )
-{
-  UINT16  Offset1;
-  UINT16  Offset2;
-
-  Offset1 = *(CONST UINT16 *)CapHdrOffset;
-  Offset2 = ((CONST PCI_CAP *)PciCap)->Offset;
+//
+// Temporary state collected while traversing the capabilities lists.
+//
+typedef struct {
   //
-  // Note: both Offset1 and Offset2 are promoted to INT32 below, and the
-  // subtraction takes place between INT32 values.
+  // Capability headers in list traversal order. Key.Instance, NumInstances
+  // and MaxSizeHint are only assigned once traversal is complete.
   //
-  return Offset1 - Offset2;
-}
+  PCI_CAP    *Caps;
+  UINTN      NumCaps;
+  UINTN      MaxCaps;
+  //
+  // One bit per config space DWORD that hosts a capability header.
+  //
+  UINT8      HdrBitmap[PCI_CAP_HDR_BITMAP_BITS / 8];
+} PCI_CAP_SCRATCH;
 
 /**
-  Compare two PCI_CAP objects based on PCI_CAP.Offset.
+  Compare the (Domain, CapId) pairs of two PCI_CAP objects. Key.Instance is
+  ignored.
 
   @param[in] PciCap1  Pointer to the first PCI_CAP.
 
@@ -148,76 +50,62 @@ ComparePciCapOffsetKey (
 **/
 STATIC
 INTN
-EFIAPI
-ComparePciCapOffset (
-  IN CONST VOID  *PciCap1,
-  IN CONST VOID  *PciCap2
+ComparePciCapDomainAndId (
+  IN CONST PCI_CAP  *PciCap1,
+  IN CONST PCI_CAP  *PciCap2
   )
 {
-  UINT16  Offset1;
-  UINT16  Offset2;
+  if (PciCap1->Key.Domain != PciCap2->Key.Domain) {
+    return (PciCap1->Key.Domain < PciCap2->Key.Domain) ? -1 : 1;
+  }
 
-  Offset1 = ((CONST PCI_CAP *)PciCap1)->Offset;
-  Offset2 = ((CONST PCI_CAP *)PciCap2)->Offset;
   //
-  // Note: both Offset1 and Offset2 are promoted to INT32 below, and the
-  // subtraction takes place between INT32 values.
+  // Note: both CapId values are promoted to INT32 below, and the subtraction
+  // takes place between INT32 values.
   //
-  return Offset1 - Offset2;
+  return PciCap1->Key.CapId - PciCap2->Key.CapId;
 }
 
 /**
-  Insert a new instance of the PCI capability given by (Domain, CapId) in
-  CapList.
-
-  @param[in,out] CapList        The PCI_CAP_LIST into which the new PCI_CAP
-                                should be inserted. CapList will own the new
-                                PCI_CAP structure.
+  Record a capability header found during list traversal.
 
-  @param[in,out] CapHdrOffsets  Link the new PCI_CAP structure into the
-                                (non-owning) CapHdrOffsets collection as well.
-                                CapHdrOffsets orders the PCI_CAP structures
-                                based on the PCI_CAP.Offset member, and enables
-                                the calculation of PCI_CAP.MaxSizeHint.
+  @param[in,out] Scratch  The traversal state to append the capability to.
 
-  @param[in] Domain             Whether the capability is normal or extended.
+  @param[in] Domain       Whether the capability is normal or extended.
 
-  @param[in] CapId              Capability ID (specific to Domain).
+  @param[in] CapId        Capability ID (specific to Domain).
 
-  @param[in] Offset             Config space offset at which the standard
-                                header of the capability starts. The caller is
-                                responsible for ensuring that Offset be DWORD
-                                aligned. The caller is also responsible for
-                                ensuring that Offset be within the config space
-                                identified by Domain.
+  @param[in] Offset       Config space offset at which the standard header of
+                          the capability starts. The caller is responsible for
+                          ensuring that Offset be DWORD aligned. The caller is
+                          also responsible for ensuring that Offset be within
+                          the config space identified by Domain.
 
-  @param[in] Version            The version number of the capability. The
-                                caller is responsible for passing 0 as Version
-                                if Domain is PciCapNormal.
+  @param[in] Version      The version number of the capability. The caller is
+                          responsible for passing 0 as Version if Domain is
+                          PciCapNormal.
 
-  @retval RETURN_SUCCESS           Insertion successful.
+  @retval RETURN_SUCCESS           Capability recorded.
 
   @retval RETURN_OUT_OF_RESOURCES  Memory allocation failed.
 
-  @retval RETURN_DEVICE_ERROR      A PCI_CAP with Offset is already linked by
-                                   CapHdrOffsets. This indicates a loop in the
-                                   capabilities list being parsed.
+  @retval RETURN_DEVICE_ERROR      A capability header at Offset has been
+                                   recorded already. This indicates a loop in
+                                   the capabilities list being parsed.
 **/
 STATIC
 RETURN_STATUS
-InsertPciCap (
-  IN OUT PCI_CAP_LIST        *CapList,
-  IN OUT ORDERED_COLLECTION  *CapHdrOffsets,
-  IN     PCI_CAP_DOMAIN      Domain,
-  IN     UINT16              CapId,
-  IN     UINT16              Offset,
-  IN     UINT8               Version
+RecordPciCap (
+  IN OUT PCI_CAP_SCRATCH  *Scratch,
+  IN     PCI_CAP_DOMAIN   Domain,
+  IN     UINT16           CapId,
+  IN     UINT16           Offset,
+  IN     UINT8            Version
   )
 {
-  PCI_CAP                   *PciCap;
-  RETURN_STATUS             Status;
-  ORDERED_COLLECTION_ENTRY  *PciCapEntry;
-  PCI_CAP                   *InstanceZero;
+  UINTN    Dword;
+  UINT8    Mask;
+  PCI_CAP  *PciCap;
 
   ASSERT ((Offset & 0x3) == 0);
   ASSERT (
@@ -227,170 +115,92 @@ InsertPciCap (
   ASSERT (Domain == PciCapExtended || Version == 0);
 
   //
-  // Set InstanceZero to suppress incorrect compiler/analyzer warnings.
+  // Partial overlaps between capability headers are not possible: Offset is
+  // DWORD aligned, normal capability headers are 16-bit wide, and extended
+  // capability headers are 32-bit wide. Therefore any two capability headers
+  // either are distinct or start at the same offset (implying a loop in the
+  // respective capabilities list).
   //
-  InstanceZero = NULL;
-
-  //
-  // Allocate PciCap, and populate it assuming it is the first occurrence of
-  // (Domain, CapId). Note that PciCap->MaxSizeHint is not assigned the final
-  // value just yet.
-  //
-  PciCap = AllocatePool (sizeof *PciCap);
-  if (PciCap == NULL) {
-    return RETURN_OUT_OF_RESOURCES;
+  Dword = Offset >> 2;
+  Mask  = (UINT8)(1 << (Dword & 0x7));
+  if ((Scratch->HdrBitmap[Dword >> 3] & Mask) != 0) {
+    return RETURN_DEVICE_ERROR;
   }
 
-  PciCap->Key.Domain                     = Domain;
-  PciCap->Key.CapId                      = CapId;
-  PciCap->Key.Instance                   = 0;
-  PciCap->NumInstancesUnion.NumInstances = 1;
-  PciCap->Offset                         = Offset;
-  PciCap->MaxSizeHint                    = 0;
-  PciCap->Version                        = Version;
+  if (Scratch->NumCaps == Scratch->MaxCaps) {
+    UINTN  NewMaxCaps;
 
-  //
-  // Add PciCap to CapList.
-  //
-  Status = OrderedCollectionInsert (
-             CapList->Capabilities,
-             &PciCapEntry,
-             PciCap
-             );
-  if (RETURN_ERROR (Status)) {
-    if (Status == RETURN_OUT_OF_RESOURCES) {
-      goto FreePciCap;
-    }
-
-    ASSERT (Status == RETURN_ALREADY_STARTED);
-    //
-    // PciCap is not the first instance of (Domain, CapId). Add it as a new
-    // instance, taking the current instance count from Instance#0. Note that
-    // we don't bump the instance count maintained in Instance#0 just yet, to
-    // keep rollback on errors simple.
-    //
-    InstanceZero                           = OrderedCollectionUserStruct (PciCapEntry);
-    PciCap->Key.Instance                   = InstanceZero->NumInstancesUnion.NumInstances;
-    PciCap->NumInstancesUnion.InstanceZero = InstanceZero;
-
-    ASSERT (PciCap->Key.Instance > 0);
-    Status = OrderedCollectionInsert (
-               CapList->Capabilities,
-               &PciCapEntry,
-               PciCap
+    NewMaxCaps = (Scratch->MaxCaps == 0 ?
+                  PCI_CAP_SCRATCH_INITIAL_COUNT : Scratch->MaxCaps * 2);
+    PciCap = ReallocatePool (
+               Scratch->MaxCaps * sizeof *PciCap,
+               NewMaxCaps * sizeof *PciCap,
+               Scratch->Caps
                );
-    if (Status == RETURN_OUT_OF_RESOURCES) {
-      goto FreePciCap;
-    }
-  }
-
-  //
-  // At this point, PciCap has been inserted in CapList->Capabilities, either
-  // with Instance==0 or with Instance>0. PciCapEntry is the iterator that
-  // links PciCap.
-  //
-  ASSERT_RETURN_ERROR (Status);
-
-  //
-  // Link PciCap into CapHdrOffsets too, to order it globally based on config
-  // space offset. Note that partial overlaps between capability headers is not
-  // possible: Offset is DWORD aligned, normal capability headers are 16-bit
-  // wide, and extended capability headers are 32-bit wide. Therefore any two
-  // capability headers either are distinct or start at the same offset
-  // (implying a loop in the respective capabilities list).
-  //
-  Status = OrderedCollectionInsert (CapHdrOffsets, NULL, PciCap);
-  if (RETURN_ERROR (Status)) {
-    if (Status == RETURN_ALREADY_STARTED) {
-      //
-      // Loop found; map return status accordingly.
-      //
-      Status = RETURN_DEVICE_ERROR;
+    if (PciCap == NULL) {
+      return RETURN_OUT_OF_RESOURCES;
     }
 
-    goto DeletePciCapFromCapList;
+    Scratch->Caps    = PciCap;
+    Scratch->MaxCaps = NewMaxCaps;
   }
 
-  //
-  // Now we can bump the instance count maintained in Instance#0, if PciCap is
-  // not the first instance of (Domain, CapId).
-  //
-  if (PciCap->Key.Instance > 0) {
-    //
-    // Suppress invalid "nullptr dereference" compiler/analyzer warnings: the
-    // only way for "PciCap->Key.Instance" to be positive here is for it to
-    // have been assigned *from* dereferencing "InstanceZero" above.
-    //
-    ASSERT (InstanceZero != NULL);
-
-    InstanceZero->NumInstancesUnion.NumInstances++;
-  }
+  Scratch->HdrBitmap[Dword >> 3] |= Mask;
 
+  PciCap               = &Scratch->Caps[Scratch->NumCaps++];
+  PciCap->Key.Domain   = Domain;
+  PciCap->Key.CapId    = CapId;
+  PciCap->Key.Instance = 0;
+  PciCap->NumInstances = 0;
+  PciCap->Offset       = Offset;
+  PciCap->MaxSizeHint  = 0;
+  PciCap->Version      = Version;
   return RETURN_SUCCESS;
-
-DeletePciCapFromCapList:
-  OrderedCollectionDelete (CapList->Capabilities, PciCapEntry, NULL);
-
-FreePciCap:
-  FreePool (PciCap);
-
-  return Status;
 }
 
 /**
   Calculate the MaxSizeHint member for a PCI_CAP object.
 
   CalculatePciCapMaxSizeHint() may only be called once all capability instances
-  have been successfully processed by InsertPciCap().
+  have been successfully processed by RecordPciCap().
+
+  @param[in] Scratch     The traversal state whose header bitmap records the
+                         offsets of all capability headers.
 
   @param[in,out] PciCap  The PCI_CAP object for which to calculate the
-                         MaxSizeHint member. The caller is responsible for
-                         passing a PCI_CAP object that has been created by a
-                         successful invocation of InsertPciCap().
-
-  @param[in] NextPciCap  If NextPciCap is NULL, then the caller is responsible
-                         for PciCap to represent the capability instance with
-                         the highest header offset in all config space. If
-                         NextPciCap is not NULL, then the caller is responsible
-                         for (a) having created NextPciCap with a successful
-                         invocation of InsertPciCap(), and (b) NextPciCap being
-                         the direct successor of PciCap in config space offset
-                         order, as ordered by ComparePciCapOffset().
+                         MaxSizeHint member.
 **/
 STATIC
 VOID
 CalculatePciCapMaxSizeHint (
-  IN OUT PCI_CAP  *PciCap,
-  IN     PCI_CAP  *NextPciCap OPTIONAL
+  IN     CONST PCI_CAP_SCRATCH  *Scratch,
+  IN OUT PCI_CAP                *PciCap
   )
 {
-  UINT16  ConfigSpaceSize;
+  UINTN  ConfigSpaceSize;
+  UINTN  Dword;
 
   ConfigSpaceSize = (PciCap->Key.Domain == PciCapNormal ?
                      PCI_MAX_CONFIG_OFFSET : PCI_EXP_MAX_CONFIG_OFFSET);
   //
-  // The following is guaranteed by the interface contract on
-  // CalculatePciCapMaxSizeHint().
-  //
-  ASSERT (NextPciCap == NULL || PciCap->Offset < NextPciCap->Offset);
-  //
-  // The following is guaranteed by the interface contract on InsertPciCap().
+  // The following is guaranteed by the interface contract on RecordPciCap().
   //
   ASSERT (PciCap->Offset < ConfigSpaceSize);
+
   //
-  // Thus we can safely subtract PciCap->Offset from either of
-  // - ConfigSpaceSize
-  // - and NextPciCap->Offset (if NextPciCap is not NULL).
-  //
-  // PciCap extends from PciCap->Offset to NextPciCap->Offset (if any), except
-  // it cannot cross config space boundary.
+  // PciCap extends from PciCap->Offset to the next capability header in config
+  // space offset order (if any), except it cannot cross config space boundary.
   //
-  if ((NextPciCap == NULL) || (NextPciCap->Offset >= ConfigSpaceSize)) {
-    PciCap->MaxSizeHint = ConfigSpaceSize - PciCap->Offset;
-    return;
+  for (Dword = (PciCap->Offset >> 2) + 1;
+       Dword < (ConfigSpaceSize >> 2);
+       Dword++)
+  {
+    if ((Scratch->HdrBitmap[Dword >> 3] & (1 << (Dword & 0x7))) != 0) {
+      break;
+    }
   }
 
-  PciCap->MaxSizeHint = NextPciCap->Offset - PciCap->Offset;
+  PciCap->MaxSizeHint = (UINT16)((Dword << 2) - PciCap->Offset);
 }
 
 /**
@@ -406,18 +216,13 @@ DebugDumpPciCapList (
   )
 {
   DEBUG_CODE_BEGIN ();
-  ORDERED_COLLECTION_ENTRY  *PciCapEntry;
+  UINTN  Index;
 
-  for (PciCapEntry = OrderedCollectionMin (CapList->Capabilities);
-       PciCapEntry != NULL;
-       PciCapEntry = OrderedCollectionNext (PciCapEntry))
-  {
-    PCI_CAP        *PciCap;
+  for (Index = 0; Index < CapList->NumCaps; Index++) {
     RETURN_STATUS  Status;
     PCI_CAP_INFO   Info;
 
-    PciCap = OrderedCollectionUserStruct (PciCapEntry);
-    Status = PciCapGetInfo (PciCap, &Info);
+    Status = PciCapGetInfo (&CapList->Caps[Index], &Info);
     //
     // PciCapGetInfo() cannot fail in this library instance.
     //
@@ -442,42 +247,181 @@ DebugDumpPciCapList (
 }
 
 /**
-  Empty a collection of PCI_CAP structures, optionally releasing the referenced
-  PCI_CAP structures themselves. Release the collection at last.
+  Convert the capability headers collected during traversal into the flat,
+  sorted PCI_CAP_LIST representation.
+
+  @param[in,out] Scratch  The traversal state. The order of Scratch->Caps is
+                          modified.
+
+  @param[out] CapList     The PCI_CAP_LIST object built from Scratch.
 
-  @param[in,out] PciCapCollection  The collection to empty and release.
+  @retval RETURN_SUCCESS           CapList has been built.
 
-  @param[in] FreePciCap            TRUE if the PCI_CAP structures linked by
-                                   PciCapCollection should be released. When
-                                   FALSE, the caller is responsible for
-                                   retaining at least one reference to each
-                                   PCI_CAP structure originally linked by
-                                   PciCapCollection.
+  @retval RETURN_OUT_OF_RESOURCES  Memory allocation failed.
 **/
 STATIC
-VOID
-EmptyAndUninitPciCapCollection (
-  IN OUT ORDERED_COLLECTION  *PciCapCollection,
-  IN     BOOLEAN             FreePciCap
+RETURN_STATUS
+BuildPciCapList (
+  IN OUT PCI_CAP_SCRATCH  *Scratch,
+  OUT    PCI_CAP_LIST     **CapList
   )
 {
-  ORDERED_COLLECTION_ENTRY  *PciCapEntry;
-  ORDERED_COLLECTION_ENTRY  *NextEntry;
+  PCI_CAP_LIST  *OutCapList;
+  UINTN         Index;
+  UINTN         RunStart;
 
-  for (PciCapEntry = OrderedCollectionMin (PciCapCollection);
-       PciCapEntry != NULL;
-       PciCapEntry = NextEntry)
-  {
-    PCI_CAP  *PciCap;
+  //
+  // All headers are known now, so the MaxSizeHint members can be computed
+  // from the header bitmap, independently of the order of Scratch->Caps.
+  //
+  for (Index = 0; Index < Scratch->NumCaps; Index++) {
+    CalculatePciCapMaxSizeHint (Scratch, &Scratch->Caps[Index]);
+  }
 
-    NextEntry = OrderedCollectionNext (PciCapEntry);
-    OrderedCollectionDelete (PciCapCollection, PciCapEntry, (VOID **)&PciCap);
-    if (FreePciCap) {
-      FreePool (PciCap);
+  //
+  // Order the capabilities by (Domain, CapId). The insertion sort is stable,
+  // so instances of the same (Domain, CapId) remain in list traversal order.
+  // Capabilities lists are short, and typically close to sorted already.
+  //
+  for (Index = 1; Index < Scratch->NumCaps; Index++) {
+    PCI_CAP  Current;
+    UINTN    Position;
+
+    CopyMem (&Current, &Scratch->Caps[Index], sizeof Current);
+    for (Position = Index;
+         Position > 0 &&
+         ComparePciCapDomainAndId (&Scratch->Caps[Position - 1], &Current) > 0;
+         Position--)
+    {
+      CopyMem (
+        &Scratch->Caps[Position],
+        &Scratch->Caps[Position - 1],
+        sizeof Current
+        );
     }
+
+    CopyMem (&Scratch->Caps[Position], &Current, sizeof Current);
   }
 
-  OrderedCollectionUninit (PciCapCollection);
+  //
+  // Allocate the output structure together with the flat capability array.
+  //
+  OutCapList = AllocateZeroPool (
+                 sizeof *OutCapList +
+                 Scratch->NumCaps * sizeof *OutCapList->Caps
+                 );
+  if (OutCapList == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  OutCapList->NumCaps = (UINT16)Scratch->NumCaps;
+  OutCapList->Caps    = (PCI_CAP *)(OutCapList + 1);
+  CopyMem (
+    OutCapList->Caps,
+    Scratch->Caps,
+    Scratch->NumCaps * sizeof *OutCapList->Caps
+    );
+
+  //
+  // Number the instances within each run of equal (Domain, CapId), and index
+  // Instance#0 of each run for direct lookup.
+  //
+  RunStart = 0;
+  for (Index = 1; Index <= OutCapList->NumCaps; Index++) {
+    PCI_CAP  *RunCap;
+    UINTN    Instance;
+
+    if ((Index < OutCapList->NumCaps) &&
+        (ComparePciCapDomainAndId (
+           &OutCapList->Caps[RunStart],
+           &OutCapList->Caps[Index]
+           ) == 0))
+    {
+      continue;
+    }
+
+    RunCap = &OutCapList->Caps[RunStart];
+    for (Instance = 0; Instance < Index - RunStart; Instance++) {
+      RunCap[Instance].Key.Instance = (UINT16)Instance;
+      RunCap[Instance].NumInstances = (UINT16)(Index - RunStart);
+    }
+
+    if (RunCap->Key.CapId < PCI_CAP_FAST_ID_LIMIT) {
+      OutCapList->FirstInstance[RunCap->Key.Domain][RunCap->Key.CapId] =
+        (UINT16)(RunStart + 1);
+    }
+
+    RunStart = Index;
+  }
+
+  *CapList = OutCapList;
+  return RETURN_SUCCESS;
+}
+
+/**
+  Locate Instance#0 of the capability given by (Domain, CapId).
+
+  @param[in] CapList  The PCI_CAP_LIST object produced by PciCapListInit().
+
+  @param[in] Domain   Whether CapId is interpreted in normal or extended config
+                      space.
+
+  @param[in] CapId    Capability identifier to look up.
+
+  @return  Instance#0 of (Domain, CapId), or NULL if the capability is absent.
+**/
+STATIC
+PCI_CAP *
+FindPciCapInstanceZero (
+  IN PCI_CAP_LIST    *CapList,
+  IN PCI_CAP_DOMAIN  Domain,
+  IN UINT16          CapId
+  )
+{
+  PCI_CAP  Key;
+  UINTN    Low;
+  UINTN    High;
+
+  ASSERT (Domain == PciCapNormal || Domain == PciCapExtended);
+
+  //
+  // The common case: a direct table lookup.
+  //
+  if (CapId < PCI_CAP_FAST_ID_LIMIT) {
+    UINT16  First;
+
+    First = CapList->FirstInstance[Domain][CapId];
+    return (First == 0) ? NULL : &CapList->Caps[First - 1];
+  }
+
+  //
+  // Binary search for the lowest index whose (Domain, CapId) is not less than
+  // the key. Due to the stable ordering, that is Instance#0, if present.
+  //
+  Key.Key.Domain = Domain;
+  Key.Key.CapId  = CapId;
+
+  Low  = 0;
+  High = CapList->NumCaps;
+  while (Low < High) {
+    UINTN  Middle;
+
+    Middle = Low + (High - Low) / 2;
+    if (ComparePciCapDomainAndId (&CapList->Caps[Middle], &Key) < 0) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  if ((Low == CapList->NumCaps) ||
+      (ComparePciCapDomainAndId (&CapList->Caps[Low], &Key) != 0))
+  {
+    return NULL;
+  }
+
+  ASSERT (CapList->Caps[Low].Key.Instance == 0);
+  return &CapList->Caps[Low];
 }
 
 /**
@@ -519,46 +463,12 @@ PciCapListInit (
   OUT PCI_CAP_LIST  **CapList
   )
 {
-  PCI_CAP_LIST              *OutCapList;
-  RETURN_STATUS             Status;
-  ORDERED_COLLECTION        *CapHdrOffsets;
-  UINT16                    PciStatusReg;
-  BOOLEAN                   DeviceIsExpress;
-  ORDERED_COLLECTION_ENTRY  *OffsetEntry;
-
-  //
-  // Allocate the output structure.
-  //
-  OutCapList = AllocatePool (sizeof *OutCapList);
-  if (OutCapList == NULL) {
-    return RETURN_OUT_OF_RESOURCES;
-  }
+  PCI_CAP_SCRATCH  Scratch;
+  RETURN_STATUS    Status;
+  UINT16           PciStatusReg;
+  BOOLEAN          DeviceIsExpress;
 
-  //
-  // The OutCapList->Capabilities collection owns the PCI_CAP structures and
-  // orders them based on PCI_CAP.Key.
-  //
-  OutCapList->Capabilities = OrderedCollectionInit (
-                               ComparePciCap,
-                               ComparePciCapKey
-                               );
-  if (OutCapList->Capabilities == NULL) {
-    Status = RETURN_OUT_OF_RESOURCES;
-    goto FreeOutCapList;
-  }
-
-  //
-  // The (temporary) CapHdrOffsets collection only references PCI_CAP
-  // structures, and orders them based on PCI_CAP.Offset.
-  //
-  CapHdrOffsets = OrderedCollectionInit (
-                    ComparePciCapOffset,
-                    ComparePciCapOffsetKey
-                    );
-  if (CapHdrOffsets == NULL) {
-    Status = RETURN_OUT_OF_RESOURCES;
-    goto FreeCapabilities;
-  }
+  ZeroMem (&Scratch, sizeof Scratch);
 
   //
   // Whether the device is PCI Express depends on the normal capability with
@@ -568,7 +478,7 @@ PciCapListInit (
 
   //
   // Check whether a normal capabilities list is present. If there's none,
-  // that's not an error; we'll just return OutCapList->Capabilities empty.
+  // that's not an error; we'll just return an empty capabilities list.
   //
   Status = PciDevice->ReadConfig (
                         PciDevice,
@@ -577,7 +487,7 @@ PciCapListInit (
                         sizeof PciStatusReg
                         );
   if (RETURN_ERROR (Status)) {
-    goto FreeCapHdrOffsets;
+    goto FreeScratch;
   }
 
   if ((PciStatusReg & EFI_PCI_STATUS_CAPABILITY) != 0) {
@@ -593,7 +503,7 @@ PciCapListInit (
                           sizeof NormalCapHdrOffset
                           );
     if (RETURN_ERROR (Status)) {
-      goto FreeCapHdrOffsets;
+      goto FreeScratch;
     }
 
     //
@@ -610,19 +520,18 @@ PciCapListInit (
                             sizeof NormalCapHdr
                             );
       if (RETURN_ERROR (Status)) {
-        goto FreeCapHdrOffsets;
+        goto FreeScratch;
       }
 
-      Status = InsertPciCap (
-                 OutCapList,
-                 CapHdrOffsets,
+      Status = RecordPciCap (
+                 &Scratch,
                  PciCapNormal,
                  NormalCapHdr.CapabilityID,
                  NormalCapHdrOffset,
                  0
                  );
       if (RETURN_ERROR (Status)) {
-        goto FreeCapHdrOffsets;
+        goto FreeScratch;
       }
 
       if (NormalCapHdr.CapabilityID == EFI_PCI_CAPABILITY_ID_PCIEXP) {
@@ -664,19 +573,18 @@ PciCapListInit (
       }
 
       if (RETURN_ERROR (Status)) {
-        goto FreeCapHdrOffsets;
+        goto FreeScratch;
       }
 
-      Status = InsertPciCap (
-                 OutCapList,
-                 CapHdrOffsets,
+      Status = RecordPciCap (
+                 &Scratch,
                  PciCapExtended,
                  (UINT16)ExtendedCapHdr.CapabilityId,
                  ExtendedCapHdrOffset,
                  (UINT8)ExtendedCapHdr.CapabilityVersion
                  );
       if (RETURN_ERROR (Status)) {
-        goto FreeCapHdrOffsets;
+        goto FreeScratch;
       }
 
       ExtendedCapHdrOffset = ExtendedCapHdr.NextCapabilityOffset & 0xFFC;
@@ -687,66 +595,30 @@ PciCapListInit (
         // Invalid capability pointer.
         //
         Status = RETURN_DEVICE_ERROR;
-        goto FreeCapHdrOffsets;
+        goto FreeScratch;
       }
     }
   }
 
   //
-  // Both capabilities lists have been parsed; compute the PCI_CAP.MaxSizeHint
-  // members if at least one capability has been found. In parallel, evacuate
-  // the CapHdrOffsets collection.
+  // Both capabilities lists have been parsed; build the flat representation.
   //
-  // At first, set OffsetEntry to the iterator of the PCI_CAP object with the
-  // lowest Offset (if such exists).
-  //
-  OffsetEntry = OrderedCollectionMin (CapHdrOffsets);
-  if (OffsetEntry != NULL) {
-    ORDERED_COLLECTION_ENTRY  *NextOffsetEntry;
-    PCI_CAP                   *PciCap;
-
-    //
-    // Initialize NextOffsetEntry to the iterator of the PCI_CAP object with
-    // the second lowest Offset (if such exists).
-    //
-    NextOffsetEntry = OrderedCollectionNext (OffsetEntry);
-    //
-    // Calculate MaxSizeHint for all PCI_CAP objects except the one with the
-    // highest Offset.
-    //
-    while (NextOffsetEntry != NULL) {
-      PCI_CAP  *NextPciCap;
-
-      OrderedCollectionDelete (CapHdrOffsets, OffsetEntry, (VOID **)&PciCap);
-      NextPciCap = OrderedCollectionUserStruct (NextOffsetEntry);
-      CalculatePciCapMaxSizeHint (PciCap, NextPciCap);
-
-      OffsetEntry     = NextOffsetEntry;
-      NextOffsetEntry = OrderedCollectionNext (OffsetEntry);
-    }
-
-    //
-    // Calculate MaxSizeHint for the PCI_CAP object with the highest Offset.
-    //
-    OrderedCollectionDelete (CapHdrOffsets, OffsetEntry, (VOID **)&PciCap);
-    CalculatePciCapMaxSizeHint (PciCap, NULL);
+  Status = BuildPciCapList (&Scratch, CapList);
+  if (RETURN_ERROR (Status)) {
+    goto FreeScratch;
   }
 
-  ASSERT (OrderedCollectionIsEmpty (CapHdrOffsets));
-  OrderedCollectionUninit (CapHdrOffsets);
+  if (Scratch.Caps != NULL) {
+    FreePool (Scratch.Caps);
+  }
 
-  DebugDumpPciCapList (OutCapList);
-  *CapList = OutCapList;
+  DebugDumpPciCapList (*CapList);
   return RETURN_SUCCESS;
 
-FreeCapHdrOffsets:
-  EmptyAndUninitPciCapCollection (CapHdrOffsets, FALSE);
-
-FreeCapabilities:
-  EmptyAndUninitPciCapCollection (OutCapList->Capabilities, TRUE);
-
-FreeOutCapList:
-  FreePool (OutCapList);
+FreeScratch:
+  if (Scratch.Caps != NULL) {
+    FreePool (Scratch.Caps);
+  }
 
   ASSERT (RETURN_ERROR (Status));
   DEBUG ((
@@ -759,11 +631,128 @@ FreeOutCapList:
   return Status;
 }
 
+/**
+  Read from the in-memory config space image of a SNAPSHOT_DEV.
+
+  @param[in] PciDevice           The PCI_CAP_DEV embedded in a SNAPSHOT_DEV.
+
+  @param[in] SourceOffset        Source offset in the config space image to
+                                 start reading from.
+
+  @param[out] DestinationBuffer  Buffer to store the read data to.
+
+  @param[in] Size                The number of bytes to transfer.
+
+  @retval RETURN_SUCCESS      Size bytes have been transferred from the image
+                              to DestinationBuffer.
+
+  @retval RETURN_UNSUPPORTED  The requested range is not (entirely) covered by
+                              the image. No bytes have been read.
+**/
+STATIC
+RETURN_STATUS
+EFIAPI
+SnapshotDevReadConfig (
+  IN  PCI_CAP_DEV  *PciDevice,
+  IN  UINT16       SourceOffset,
+  OUT VOID         *DestinationBuffer,
+  IN  UINT16       Size
+  )
+{
+  SNAPSHOT_DEV  *SnapshotDev;
+
+  SnapshotDev = BASE_CR (PciDevice, SNAPSHOT_DEV, BaseDevice);
+  //
+  // Note: all UINT16 values are promoted to INT32 below, and addition and
+  // comparison take place between INT32 values.
+  //
+  if (SourceOffset + Size > SnapshotDev->ConfigSpaceSize) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  CopyMem (DestinationBuffer, SnapshotDev->ConfigSpace + SourceOffset, Size);
+  return RETURN_SUCCESS;
+}
+
+/**
+  Reject writes to the in-memory config space image of a SNAPSHOT_DEV.
+
+  @param[in] PciDevice          The PCI_CAP_DEV embedded in a SNAPSHOT_DEV.
+
+  @param[in] DestinationOffset  Ignored.
+
+  @param[in] SourceBuffer       Ignored.
+
+  @param[in] Size               Ignored.
+
+  @retval RETURN_WRITE_PROTECTED  Config space images are read-only.
+**/
+STATIC
+RETURN_STATUS
+EFIAPI
+SnapshotDevWriteConfig (
+  IN PCI_CAP_DEV  *PciDevice,
+  IN UINT16       DestinationOffset,
+  IN VOID         *SourceBuffer,
+  IN UINT16       Size
+  )
+{
+  return RETURN_WRITE_PROTECTED;
+}
+
+/**
+  Parse the capabilities lists (both normal and extended, as applicable) from
+  an in-memory image of a PCI device's config space.
+
+  The image is parsed exactly as PciCapListInit() would parse the live config
+  space. If ConfigSpaceSize covers only normal config space, the image is
+  treated as having no extended capabilities.
+
+  @param[in] ConfigSpace      The config space image, starting at offset 0.
+
+  @param[in] ConfigSpaceSize  The size of ConfigSpace in bytes. Must be at
+                              least PCI_MAX_CONFIG_OFFSET, and at most
+                              PCI_EXP_MAX_CONFIG_OFFSET.
+
+  @param[out] CapList         Opaque data structure that holds an in-memory
+                              representation of the parsed capabilities lists.
+
+  @retval RETURN_SUCCESS            The capabilities lists have been parsed
+                                    from ConfigSpace.
+
+  @retval RETURN_INVALID_PARAMETER  ConfigSpaceSize is out of range.
+
+  @return                           Error codes from PciCapListInit().
+**/
+RETURN_STATUS
+EFIAPI
+PciCapListInitFromSnapshot (
+  IN  CONST VOID    *ConfigSpace,
+  IN  UINT16        ConfigSpaceSize,
+  OUT PCI_CAP_LIST  **CapList
+  )
+{
+  SNAPSHOT_DEV  SnapshotDev;
+
+  if ((ConfigSpaceSize < PCI_MAX_CONFIG_OFFSET) ||
+      (ConfigSpaceSize > PCI_EXP_MAX_CONFIG_OFFSET))
+  {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  SnapshotDev.BaseDevice.ReadConfig  = SnapshotDevReadConfig;
+  SnapshotDev.BaseDevice.WriteConfig = SnapshotDevWriteConfig;
+  SnapshotDev.ConfigSpace            = ConfigSpace;
+  SnapshotDev.ConfigSpaceSize        = ConfigSpaceSize;
+
+  return PciCapListInit (&SnapshotDev.BaseDevice, CapList);
+}
+
 /**
   Free the resources used by CapList.
 
   @param[in] CapList  The PCI_CAP_LIST object to free, originally produced by
-                      PciCapListInit().
+                      PciCapListInit() or PciCapListInitFromSnapshot().
 **/
 VOID
 EFIAPI
@@ -771,7 +760,9 @@ PciCapListUninit (
   IN PCI_CAP_LIST  *CapList
   )
 {
-  EmptyAndUninitPciCapCollection (CapList->Capabilities, TRUE);
+  //
+  // The Caps array shares the allocation of CapList.
+  //
   FreePool (CapList);
 }
 
@@ -818,20 +809,15 @@ PciCapListFindCap (
   OUT PCI_CAP         **Cap    OPTIONAL
   )
 {
-  PCI_CAP_KEY               Key;
-  ORDERED_COLLECTION_ENTRY  *PciCapEntry;
-
-  Key.Domain   = Domain;
-  Key.CapId    = CapId;
-  Key.Instance = Instance;
+  PCI_CAP  *InstanceZero;
 
-  PciCapEntry = OrderedCollectionFind (CapList->Capabilities, &Key);
-  if (PciCapEntry == NULL) {
+  InstanceZero = FindPciCapInstanceZero (CapList, Domain, CapId);
+  if ((InstanceZero == NULL) || (Instance >= InstanceZero->NumInstances)) {
     return RETURN_NOT_FOUND;
   }
 
   if (Cap != NULL) {
-    *Cap = OrderedCollectionUserStruct (PciCapEntry);
+    *Cap = InstanceZero + Instance;
   }
 
   return RETURN_SUCCESS;
@@ -880,32 +866,22 @@ PciCapListFindCapVersion (
   OUT PCI_CAP         **Cap      OPTIONAL
   )
 {
-  PCI_CAP_KEY               Key;
-  ORDERED_COLLECTION_ENTRY  *PciCapEntry;
+  PCI_CAP  *InstanceZero;
+  UINTN    Instance;
+
+  InstanceZero = FindPciCapInstanceZero (CapList, Domain, CapId);
+  if (InstanceZero == NULL) {
+    return RETURN_NOT_FOUND;
+  }
 
   //
-  // Start the version checks at Instance#0 of (Domain, CapId).
+  // Instances of the same (Domain, CapId) are adjacent in CapList->Caps, in
+  // list traversal order.
   //
-  Key.Domain   = Domain;
-  Key.CapId    = CapId;
-  Key.Instance = 0;
-
-  for (PciCapEntry = OrderedCollectionFind (CapList->Capabilities, &Key);
-       PciCapEntry != NULL;
-       PciCapEntry = OrderedCollectionNext (PciCapEntry))
-  {
+  for (Instance = 0; Instance < InstanceZero->NumInstances; Instance++) {
     PCI_CAP  *PciCap;
 
-    PciCap = OrderedCollectionUserStruct (PciCapEntry);
-    //
-    // PCI_CAP.Key ordering keeps instances of the same (Domain, CapId)
-    // adjacent to each other, so stop searching if either Domain or CapId
-    // changes.
-    //
-    if ((PciCap->Key.Domain != Domain) || (PciCap->Key.CapId != CapId)) {
-      break;
-    }
-
+    PciCap = InstanceZero + Instance;
     if (PciCap->Version >= MinVersion) {
       //
       // Match found.
@@ -942,16 +918,11 @@ PciCapGetInfo (
   OUT PCI_CAP_INFO  *Info
   )
 {
-  PCI_CAP  *InstanceZero;
-
   ASSERT (Info != NULL);
 
-  InstanceZero = (Cap->Key.Instance == 0 ? Cap :
-                  Cap->NumInstancesUnion.InstanceZero);
-
   Info->Domain       = Cap->Key.Domain;
   Info->CapId        = Cap->Key.CapId;
-  Info->NumInstances = InstanceZero->NumInstancesUnion.NumInstances;
+  Info->NumInstances = Cap->NumInstances;
   Info->Instance     = Cap->Key.Instance;
   Info->Offset       = Cap->Offset;
   Info->MaxSizeHint  = Cap->MaxSizeHint;
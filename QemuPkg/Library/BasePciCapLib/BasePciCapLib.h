@@ -9,13 +9,31 @@
 #ifndef __BASE_PCI_CAP_LIB_H__
 #define __BASE_PCI_CAP_LIB_H__
 
-#include <Library/OrderedCollectionLib.h>
-
 #include <Library/PciCapLib.h>
 
+//
+// Every capability header starts at a DWORD aligned offset in config space,
+// so a bitmap with one bit per config space DWORD can record all header
+// offsets seen while traversing the capabilities lists.
+//
+#define PCI_CAP_HDR_BITMAP_BITS  (PCI_EXP_MAX_CONFIG_OFFSET / 4)
+
+//
+// Capability IDs below this limit (in either domain) are resolved through the
+// direct-indexed PCI_CAP_LIST.FirstInstance table. Extended capability IDs at
+// or above the limit fall back to a binary search.
+//
+#define PCI_CAP_FAST_ID_LIMIT  256
+
+//
+// Initial number of entries in the scratch array that collects capability
+// headers during traversal. The array grows by doubling.
+//
+#define PCI_CAP_SCRATCH_INITIAL_COUNT  32
+
 //
 // Structure that uniquely identifies a capability instance and serves as key
-// for insertion and lookup.
+// for ordering and lookup.
 //
 typedef struct {
   PCI_CAP_DOMAIN    Domain;
@@ -23,32 +41,42 @@ typedef struct {
   UINT16            Instance;
 } PCI_CAP_KEY;
 
-//
-// In Instance==0 PCI_CAP objects, store NumInstances directly. In Instance>0
-// PCI_CAP objects, link Instance#0 of the same (Domain, CapId). This way
-// NumInstances needs maintenance in one object only, per (Domain, CapId) pair.
-//
-typedef union {
-  UINT16     NumInstances;
-  PCI_CAP    *InstanceZero;
-} PCI_CAP_NUM_INSTANCES;
-
 //
 // Complete the incomplete PCI_CAP structure here.
 //
+// PCI_CAP objects live in the flat PCI_CAP_LIST.Caps array, sorted by Key.
+// Instances of the same (Domain, CapId) are adjacent, in list traversal order,
+// so Instance#0 of any PCI_CAP is located at (PciCap - PciCap->Key.Instance).
+//
 struct PCI_CAP {
-  PCI_CAP_KEY              Key;
-  PCI_CAP_NUM_INSTANCES    NumInstancesUnion;
-  UINT16                   Offset;
-  UINT16                   MaxSizeHint;
-  UINT8                    Version;
+  PCI_CAP_KEY    Key;
+  UINT16         NumInstances;
+  UINT16         Offset;
+  UINT16         MaxSizeHint;
+  UINT8          Version;
 };
 
 //
 // Complete the incomplete PCI_CAP_LIST structure here.
 //
+// The Caps array is allocated together with the PCI_CAP_LIST structure, and
+// FirstInstance maps (Domain, CapId) to (index of Instance#0 in Caps) + 1, or
+// to zero if the capability is absent.
+//
 struct PCI_CAP_LIST {
-  ORDERED_COLLECTION    *Capabilities;
+  UINT16     NumCaps;
+  PCI_CAP    *Caps;
+  UINT16     FirstInstance[PciCapExtended + 1][PCI_CAP_FAST_ID_LIMIT];
 };
 
+//
+// Config space accessor that serves PciCapListInitFromSnapshot() from an
+// in-memory image of config space.
+//
+typedef struct {
+  PCI_CAP_DEV    BaseDevice;
+  CONST UINT8    *ConfigSpace;
+  UINT16         ConfigSpaceSize;
+} SNAPSHOT_DEV;
+
 #endif // __BASE_PCI_CAP_LIB_H__
@@ -0,0 +1,725 @@
+/** @file
+  Host based unit tests of BasePciCapLib.
+
+  Config space images are parsed with PciCapListInitFromSnapshot(), and every
+  capability is looked up with PciCapListFindCap() and
+  PciCapListFindCapVersion(). The images follow the layout of the devices
+  that QEMU presents, as reported by lspci in a Q35 guest.
+
+  A benchmark logs the cost of parsing full 4 KiB images of a virtio 1.0
+  device and of a PCI Express root port, and of looking up their
+  capabilities.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/Pci.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PciCapLib.h>
+#include <Library/UnitTestLib.h>
+
+#if defined (_MSC_VER)
+  #include <intrin.h>
+#else
+  #include <x86intrin.h>
+#endif
+
+#define UNIT_TEST_NAME     "BasePciCapLib Unit Tests"
+#define UNIT_TEST_VERSION  "1.0"
+
+#define PCI_CAP_BENCHMARK_ITERATIONS  10000
+
+//
+// Bridge subsystem vendor ID capability, as placed by QEMU on PCI Express
+// root ports.
+//
+#define PCI_CAPABILITY_ID_SUBSYSTEM  0x0D
+
+//
+// One capability in a config space image.
+//
+typedef struct {
+  PCI_CAP_DOMAIN    Domain;
+  UINT16            CapId;
+  UINT16            Offset;
+  UINT8             Version;
+} PCI_CAP_TEST_CAP;
+
+//
+// A config space image. Caps lists the normal capabilities in list traversal
+// order, followed by the extended capabilities in list traversal order.
+// Extended capabilities are left out of the image when ConfigSpaceSize covers
+// only normal config space.
+//
+typedef struct {
+  CONST CHAR8               *Description;
+  UINT16                    ConfigSpaceSize;
+  CONST PCI_CAP_TEST_CAP    *Caps;
+  UINTN                     NumCaps;
+} PCI_CAP_TEST_IMAGE;
+
+//
+// virtio-net-pci, disable-legacy=on, on the root bus: a conventional PCI
+// device with five virtio vendor capabilities behind MSI-X.
+//
+STATIC CONST PCI_CAP_TEST_CAP  mVirtioNetCaps[] = {
+  { PciCapNormal, EFI_PCI_CAPABILITY_ID_MSIX,   0x98, 0 },
+  { PciCapNormal, EFI_PCI_CAPABILITY_ID_VENDOR, 0x84, 0 },
+  { PciCapNormal, EFI_PCI_CAPABILITY_ID_VENDOR, 0x70, 0 },
+  { PciCapNormal, EFI_PCI_CAPABILITY_ID_VENDOR, 0x60, 0 },
+  { PciCapNormal, EFI_PCI_CAPABILITY_ID_VENDOR, 0x50, 0 },
+  { PciCapNormal, EFI_PCI_CAPABILITY_ID_VENDOR, 0x40, 0 },
+};
+
+//
+// virtio-net-pci, disable-legacy=on, ats=on, behind a PCI Express root port.
+//
+STATIC CONST PCI_CAP_TEST_CAP  mVirtioNetExpressCaps[] = {
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_MSIX,                                 0xdc,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_VENDOR,                               0xc8,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_VENDOR,                               0xb4,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_VENDOR,                               0xa4,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_VENDOR,                               0x94,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_VENDOR,                               0x84,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_PMI,                                  0x7c,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_PCIEXP,                               0x40,  0 },
+  { PciCapExtended, PCI_EXPRESS_EXTENDED_CAPABILITY_ADVANCED_ERROR_REPORTING_ID, 0x100, 1 },
+  { PciCapExtended, PCI_EXPRESS_EXTENDED_CAPABILITY_ATS_ID,                     0x148, 1 },
+};
+
+//
+// pcie-root-port.
+//
+STATIC CONST PCI_CAP_TEST_CAP  mRootPortCaps[] = {
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_PCIEXP,                                  0x54,  0 },
+  { PciCapNormal,   EFI_PCI_CAPABILITY_ID_MSIX,                                    0x48,  0 },
+  { PciCapNormal,   PCI_CAPABILITY_ID_SUBSYSTEM,                                   0x40,  0 },
+  { PciCapExtended, PCI_EXPRESS_EXTENDED_CAPABILITY_ADVANCED_ERROR_REPORTING_ID,   0x100, 2 },
+  { PciCapExtended, PCI_EXPRESS_EXTENDED_CAPABILITY_ACCESS_CONTROL_SERVICES_ID,    0x148, 1 },
+};
+
+STATIC CONST PCI_CAP_TEST_IMAGE  mImages[] = {
+  {
+    "virtio-net-pci on the root bus",
+    PCI_MAX_CONFIG_OFFSET,
+    mVirtioNetCaps,
+    ARRAY_SIZE (mVirtioNetCaps)
+  },
+  {
+    "virtio-net-pci behind a root port",
+    PCI_EXP_MAX_CONFIG_OFFSET,
+    mVirtioNetExpressCaps,
+    ARRAY_SIZE (mVirtioNetExpressCaps)
+  },
+  {
+    "virtio-net-pci behind a root port, normal config space only",
+    PCI_MAX_CONFIG_OFFSET,
+    mVirtioNetExpressCaps,
+    ARRAY_SIZE (mVirtioNetExpressCaps)
+  },
+  {
+    "pcie-root-port",
+    PCI_EXP_MAX_CONFIG_OFFSET,
+    mRootPortCaps,
+    ARRAY_SIZE (mRootPortCaps)
+  },
+};
+
+//
+// One non-zero dword of a full config space image.
+//
+typedef struct {
+  UINT16    Offset;
+  UINT32    Value;
+} PCI_CAP_TEST_DWORD;
+
+//
+// A full config space image, and the capabilities that it holds, laid out as
+// in PCI_CAP_TEST_IMAGE.
+//
+typedef struct {
+  CONST CHAR8                 *Description;
+  CONST PCI_CAP_TEST_DWORD    *Dwords;
+  UINTN                       NumDwords;
+  CONST PCI_CAP_TEST_CAP      *Caps;
+  UINTN                       NumCaps;
+} PCI_CAP_TEST_FULL_IMAGE;
+
+//
+// The non-zero dwords of the 4 KiB config space of virtio-net-pci,
+// disable-legacy=on, aer=on, ats=on, behind a PCI Express root port, as in
+// mVirtioNetExpressCaps.
+//
+STATIC CONST PCI_CAP_TEST_DWORD  mVirtioNetExpressDwords[] = {
+  { 0x000, 0x10411af4 },  // virtio 1.0 network device
+  { 0x004, 0x00100507 },
+  { 0x008, 0x02000001 },
+  { 0x014, 0xc1840000 },  // BAR1, MSI-X table and PBA
+  { 0x020, 0x0000000c },  // BAR4, 64-bit prefetchable, virtio structures
+  { 0x024, 0x00000080 },
+  { 0x02c, 0x11001af4 },
+  { 0x034, 0x000000dc },
+  { 0x03c, 0x0000010b },
+  { 0x040, 0x00020010 },  // PCI Express, endpoint
+  { 0x044, 0x10008fc0 },
+  { 0x048, 0x00002810 },
+  { 0x04c, 0x00477d12 },
+  { 0x050, 0x11010040 },
+  { 0x064, 0x00010000 },
+  { 0x07c, 0x00034001 },  // Power Management
+  { 0x080, 0x00000008 },
+  { 0x084, 0x01107c09 },  // virtio common configuration
+  { 0x088, 0x00000004 },
+  { 0x090, 0x00001000 },
+  { 0x094, 0x03108409 },  // virtio ISR status
+  { 0x098, 0x00000004 },
+  { 0x09c, 0x00001000 },
+  { 0x0a0, 0x00001000 },
+  { 0x0a4, 0x04109409 },  // virtio device configuration
+  { 0x0a8, 0x00000004 },
+  { 0x0ac, 0x00002000 },
+  { 0x0b0, 0x00001000 },
+  { 0x0b4, 0x0214a409 },  // virtio notifications
+  { 0x0b8, 0x00000004 },
+  { 0x0bc, 0x00003000 },
+  { 0x0c0, 0x00001000 },
+  { 0x0c4, 0x00000004 },
+  { 0x0c8, 0x0514b409 },  // virtio PCI configuration access
+  { 0x0dc, 0x8003c811 },  // MSI-X, four vectors, enabled
+  { 0x0e0, 0x00000001 },
+  { 0x0e4, 0x00000801 },
+  { 0x100, 0x14810001 },  // Advanced Error Reporting, version 1
+  { 0x114, 0x00006000 },
+  { 0x118, 0x000000a0 },
+  { 0x148, 0x0001000f },  // Address Translation Services
+};
+
+//
+// The non-zero dwords of the 4 KiB config space of pcie-root-port, as in
+// mRootPortCaps.
+//
+STATIC CONST PCI_CAP_TEST_DWORD  mRootPortDwords[] = {
+  { 0x000, 0x000c1b36 },  // QEMU PCI Express root port
+  { 0x004, 0x00100507 },
+  { 0x008, 0x06040000 },
+  { 0x00c, 0x00810000 },
+  { 0x010, 0xc1a4a000 },  // BAR0, MSI-X table and PBA
+  { 0x018, 0x00010100 },
+  { 0x01c, 0x00001010 },
+  { 0x020, 0xc16fc160 },
+  { 0x024, 0x0001fff1 },
+  { 0x034, 0x00000054 },
+  { 0x03c, 0x0012010b },
+  { 0x040, 0x0000000d },  // Bridge subsystem vendor ID
+  { 0x044, 0x00001b36 },
+  { 0x048, 0x80004011 },  // MSI-X, one vector, enabled
+  { 0x050, 0x00000800 },
+  { 0x054, 0x01424810 },  // PCI Express, root port, slot implemented
+  { 0x058, 0x00008000 },
+  { 0x060, 0x0003ac12 },
+  { 0x064, 0x11010040 },
+  { 0x068, 0x0000007b },
+  { 0x06c, 0x00401000 },
+  { 0x078, 0x00000800 },
+  { 0x100, 0x14820001 },  // Advanced Error Reporting, version 2
+  { 0x114, 0x00006000 },
+  { 0x118, 0x000000a0 },
+  { 0x148, 0x0001000d },  // Access Control Services
+  { 0x14c, 0x0000001f },
+};
+
+STATIC CONST PCI_CAP_TEST_FULL_IMAGE  mFullImages[] = {
+  {
+    "virtio-net-pci behind a root port",
+    mVirtioNetExpressDwords,
+    ARRAY_SIZE (mVirtioNetExpressDwords),
+    mVirtioNetExpressCaps,
+    ARRAY_SIZE (mVirtioNetExpressCaps)
+  },
+  {
+    "pcie-root-port",
+    mRootPortDwords,
+    ARRAY_SIZE (mRootPortDwords),
+    mRootPortCaps,
+    ARRAY_SIZE (mRootPortCaps)
+  },
+};
+
+STATIC UINT8  mConfigSpace[PCI_EXP_MAX_CONFIG_OFFSET];
+
+/**
+  Fill mConfigSpace with an image that holds the given capabilities lists.
+
+  @param[in] Caps             The capabilities, laid out as in
+                              PCI_CAP_TEST_IMAGE.
+  @param[in] NumCaps          The number of entries in Caps.
+  @param[in] ConfigSpaceSize  The size of the image.
+**/
+STATIC
+VOID
+BuildConfigSpace (
+  IN CONST PCI_CAP_TEST_CAP  *Caps,
+  IN UINTN                   NumCaps,
+  IN UINT16                  ConfigSpaceSize
+  )
+{
+  UINTN   Index;
+  UINT16  Next;
+  UINT32  Header;
+
+  ZeroMem (mConfigSpace, sizeof (mConfigSpace));
+
+  for (Index = 0; Index < NumCaps; Index++) {
+    if ((Index + 1 < NumCaps) && (Caps[Index + 1].Domain == Caps[Index].Domain)) {
+      Next = Caps[Index + 1].Offset;
+    } else {
+      Next = 0;
+    }
+
+    if (Caps[Index].Domain == PciCapNormal) {
+      if ((Index == 0) || (Caps[Index - 1].Domain != PciCapNormal)) {
+        mConfigSpace[PCI_PRIMARY_STATUS_OFFSET] |= EFI_PCI_STATUS_CAPABILITY;
+        mConfigSpace[PCI_CAPBILITY_POINTER_OFFSET] = (UINT8)Caps[Index].Offset;
+      }
+
+      mConfigSpace[Caps[Index].Offset]     = (UINT8)Caps[Index].CapId;
+      mConfigSpace[Caps[Index].Offset + 1] = (UINT8)Next;
+    } else if (Caps[Index].Offset < ConfigSpaceSize) {
+      Header = Caps[Index].CapId | ((UINT32)Caps[Index].Version << 16) | ((UINT32)Next << 20);
+      WriteUnaligned32 ((UINT32 *)&mConfigSpace[Caps[Index].Offset], Header);
+    }
+  }
+}
+
+/**
+  Fill mConfigSpace from the non-zero dwords of a full image.
+
+  @param[in] Image  The image to expand.
+**/
+STATIC
+VOID
+ExpandConfigSpace (
+  IN CONST PCI_CAP_TEST_FULL_IMAGE  *Image
+  )
+{
+  UINTN  Index;
+
+  ZeroMem (mConfigSpace, sizeof (mConfigSpace));
+
+  for (Index = 0; Index < Image->NumDwords; Index++) {
+    WriteUnaligned32 ((UINT32 *)&mConfigSpace[Image->Dwords[Index].Offset], Image->Dwords[Index].Value);
+  }
+}
+
+/**
+  Return the instance number of a capability, that is, the number of
+  capabilities with the same domain and ID that precede it in Caps.
+
+  @param[in] Caps   The capabilities, laid out as in PCI_CAP_TEST_IMAGE.
+  @param[in] Index  The index of the capability in Caps.
+
+  @return The instance number of Caps[Index].
+**/
+STATIC
+UINT16
+CapInstance (
+  IN CONST PCI_CAP_TEST_CAP  *Caps,
+  IN UINTN                   Index
+  )
+{
+  UINTN   Other;
+  UINT16  Instance;
+
+  Instance = 0;
+  for (Other = 0; Other < Index; Other++) {
+    if ((Caps[Other].Domain == Caps[Index].Domain) && (Caps[Other].CapId == Caps[Index].CapId)) {
+      Instance++;
+    }
+  }
+
+  return Instance;
+}
+
+/**
+  Parse each image in mImages, and look up every capability in it.
+
+  Each capability instance has to be found at its offset, with its version
+  and instance number, and with the number of instances of its ID. Looking up
+  one instance past the last has to fail. PciCapListFindCapVersion() has to
+  locate the first instance that has at least the requested version.
+  Extended capabilities that are not in the image must not be found.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Every lookup returned the expected result.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+SnapshotFindCapTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST PCI_CAP_TEST_IMAGE  *Image;
+  CONST PCI_CAP_TEST_CAP    *Cap;
+  UINTN                     ImageIndex;
+  UINTN                     Index;
+  UINTN                     Other;
+  UINT16                    Instance;
+  UINT16                    NumInstances;
+  BOOLEAN                   Present;
+  PCI_CAP_LIST              *CapList;
+  PCI_CAP                   *Found;
+  PCI_CAP_INFO              Info;
+  RETURN_STATUS             Status;
+
+  for (ImageIndex = 0; ImageIndex < ARRAY_SIZE (mImages); ImageIndex++) {
+    Image = &mImages[ImageIndex];
+    UT_LOG_INFO ("%a\n", Image->Description);
+
+    BuildConfigSpace (Image->Caps, Image->NumCaps, Image->ConfigSpaceSize);
+    Status = PciCapListInitFromSnapshot (mConfigSpace, Image->ConfigSpaceSize, &CapList);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    for (Index = 0; Index < Image->NumCaps; Index++) {
+      Cap     = &Image->Caps[Index];
+      Present = (BOOLEAN)(Cap->Domain == PciCapNormal || Cap->Offset < Image->ConfigSpaceSize);
+
+      Instance     = 0;
+      NumInstances = 0;
+      for (Other = 0; Other < Image->NumCaps; Other++) {
+        if ((Image->Caps[Other].Domain == Cap->Domain) && (Image->Caps[Other].CapId == Cap->CapId)) {
+          if (Other < Index) {
+            Instance++;
+          }
+
+          NumInstances++;
+        }
+      }
+
+      Status = PciCapListFindCap (CapList, Cap->Domain, Cap->CapId, Instance, &Found);
+      if (!Present) {
+        UT_ASSERT_STATUS_EQUAL (Status, RETURN_NOT_FOUND);
+        UT_ASSERT_STATUS_EQUAL (
+          PciCapListFindCapVersion (CapList, Cap->Domain, Cap->CapId, 0, NULL),
+          RETURN_NOT_FOUND
+          );
+        continue;
+      }
+
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_NOT_EFI_ERROR (PciCapGetInfo (Found, &Info));
+      UT_ASSERT_EQUAL (Info.Domain, Cap->Domain);
+      UT_ASSERT_EQUAL (Info.CapId, Cap->CapId);
+      UT_ASSERT_EQUAL (Info.Offset, Cap->Offset);
+      UT_ASSERT_EQUAL (Info.Version, Cap->Version);
+      UT_ASSERT_EQUAL (Info.Instance, Instance);
+      UT_ASSERT_EQUAL (Info.NumInstances, NumInstances);
+
+      UT_ASSERT_STATUS_EQUAL (
+        PciCapListFindCap (CapList, Cap->Domain, Cap->CapId, NumInstances, NULL),
+        RETURN_NOT_FOUND
+        );
+
+      //
+      // The images hold a single instance of every versioned capability, so
+      // the instance is the first one with at least its own version, and no
+      // instance has a higher version.
+      //
+      Status = PciCapListFindCapVersion (CapList, Cap->Domain, Cap->CapId, Cap->Version, &Found);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_NOT_EFI_ERROR (PciCapGetInfo (Found, &Info));
+      if (Instance == 0) {
+        UT_ASSERT_EQUAL (Info.Offset, Cap->Offset);
+      }
+
+      UT_ASSERT_STATUS_EQUAL (
+        PciCapListFindCapVersion (CapList, Cap->Domain, Cap->CapId, Cap->Version + 1, NULL),
+        RETURN_NOT_FOUND
+        );
+    }
+
+    //
+    // Capabilities that none of the images holds.
+    //
+    UT_ASSERT_STATUS_EQUAL (
+      PciCapListFindCap (CapList, PciCapNormal, EFI_PCI_CAPABILITY_ID_MSI, 0, NULL),
+      RETURN_NOT_FOUND
+      );
+    UT_ASSERT_STATUS_EQUAL (
+      PciCapListFindCapVersion (CapList, PciCapExtended, PCI_EXPRESS_EXTENDED_CAPABILITY_SERIAL_NUMBER_ID, 0, NULL),
+      RETURN_NOT_FOUND
+      );
+
+    PciCapListUninit (CapList);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Check the MaxSizeHint of capabilities, which is bounded by the next
+  capability header in config space and by the end of the capability's
+  config space.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Every size hint was as expected.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+SnapshotMaxSizeHintTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PCI_CAP_LIST   *CapList;
+  PCI_CAP        *Found;
+  PCI_CAP_INFO   Info;
+  RETURN_STATUS  Status;
+
+  BuildConfigSpace (mVirtioNetExpressCaps, ARRAY_SIZE (mVirtioNetExpressCaps), PCI_EXP_MAX_CONFIG_OFFSET);
+  Status = PciCapListInitFromSnapshot (mConfigSpace, PCI_EXP_MAX_CONFIG_OFFSET, &CapList);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  //
+  // Express at 0x40 runs up to Power Management at 0x7c.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PciCapListFindCap (CapList, PciCapNormal, EFI_PCI_CAPABILITY_ID_PCIEXP, 0, &Found));
+  UT_ASSERT_NOT_EFI_ERROR (PciCapGetInfo (Found, &Info));
+  UT_ASSERT_EQUAL (Info.MaxSizeHint, 0x7c - 0x40);
+
+  //
+  // MSI-X at 0xdc runs up to the end of normal config space.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PciCapListFindCap (CapList, PciCapNormal, EFI_PCI_CAPABILITY_ID_MSIX, 0, &Found));
+  UT_ASSERT_NOT_EFI_ERROR (PciCapGetInfo (Found, &Info));
+  UT_ASSERT_EQUAL (Info.MaxSizeHint, PCI_MAX_CONFIG_OFFSET - 0xdc);
+
+  //
+  // AER at 0x100 runs up to ATS at 0x148, and ATS to the end of extended
+  // config space.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (
+    PciCapListFindCapVersion (CapList, PciCapExtended, PCI_EXPRESS_EXTENDED_CAPABILITY_ADVANCED_ERROR_REPORTING_ID, 1, &Found)
+    );
+  UT_ASSERT_NOT_EFI_ERROR (PciCapGetInfo (Found, &Info));
+  UT_ASSERT_EQUAL (Info.MaxSizeHint, 0x148 - 0x100);
+
+  UT_ASSERT_NOT_EFI_ERROR (PciCapListFindCap (CapList, PciCapExtended, PCI_EXPRESS_EXTENDED_CAPABILITY_ATS_ID, 0, &Found));
+  UT_ASSERT_NOT_EFI_ERROR (PciCapGetInfo (Found, &Info));
+  UT_ASSERT_EQUAL (Info.MaxSizeHint, PCI_EXP_MAX_CONFIG_OFFSET - 0x148);
+
+  PciCapListUninit (CapList);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Check that malformed images and out of range sizes are rejected.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Every image was rejected as expected.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+SnapshotInvalidTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PCI_CAP_LIST  *CapList;
+
+  //
+  // The image has to cover normal config space, and cannot exceed extended
+  // config space.
+  //
+  ZeroMem (mConfigSpace, sizeof (mConfigSpace));
+  UT_ASSERT_STATUS_EQUAL (
+    PciCapListInitFromSnapshot (mConfigSpace, PCI_MAX_CONFIG_OFFSET - 1, &CapList),
+    RETURN_INVALID_PARAMETER
+    );
+  UT_ASSERT_STATUS_EQUAL (
+    PciCapListInitFromSnapshot (mConfigSpace, PCI_EXP_MAX_CONFIG_OFFSET + 1, &CapList),
+    RETURN_INVALID_PARAMETER
+    );
+
+  //
+  // A normal capability that points back at itself.
+  //
+  BuildConfigSpace (mVirtioNetCaps, ARRAY_SIZE (mVirtioNetCaps), PCI_MAX_CONFIG_OFFSET);
+  mConfigSpace[0x40 + 1] = 0x98;
+  UT_ASSERT_STATUS_EQUAL (
+    PciCapListInitFromSnapshot (mConfigSpace, PCI_MAX_CONFIG_OFFSET, &CapList),
+    RETURN_DEVICE_ERROR
+    );
+
+  //
+  // An extended capability that points into normal config space.
+  //
+  BuildConfigSpace (mRootPortCaps, ARRAY_SIZE (mRootPortCaps), PCI_EXP_MAX_CONFIG_OFFSET);
+  mConfigSpace[0x148 + 3] = 0x08;
+  UT_ASSERT_STATUS_EQUAL (
+    PciCapListInitFromSnapshot (mConfigSpace, PCI_EXP_MAX_CONFIG_OFFSET, &CapList),
+    RETURN_DEVICE_ERROR
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Parse each image in mFullImages, and look up every capability in it, many
+  times over, and log the average cost of a parse and of a lookup in
+  processor cycles.
+
+  The parse is timed together with PciCapListUninit(), which frees what it
+  allocated.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Every image parsed, and every capability was
+                            found at its offset.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+SnapshotBenchmarkTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST PCI_CAP_TEST_FULL_IMAGE  *Image;
+  CONST PCI_CAP_TEST_CAP         *Cap;
+  UINTN                          ImageIndex;
+  UINTN                          Index;
+  UINTN                          Iteration;
+  UINT16                         Instances[16];
+  UINT64                         Start;
+  UINT64                         ParseCycles;
+  UINT64                         LookupCycles;
+  PCI_CAP_LIST                   *CapList;
+  PCI_CAP                        *Found;
+  PCI_CAP_INFO                   Info;
+  RETURN_STATUS                  Status;
+
+  for (ImageIndex = 0; ImageIndex < ARRAY_SIZE (mFullImages); ImageIndex++) {
+    Image = &mFullImages[ImageIndex];
+    UT_ASSERT_TRUE (Image->NumCaps <= ARRAY_SIZE (Instances));
+    ExpandConfigSpace (Image);
+
+    //
+    // Check the image once before timing it.
+    //
+    Status = PciCapListInitFromSnapshot (mConfigSpace, PCI_EXP_MAX_CONFIG_OFFSET, &CapList);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    for (Index = 0; Index < Image->NumCaps; Index++) {
+      Cap              = &Image->Caps[Index];
+      Instances[Index] = CapInstance (Image->Caps, Index);
+      Status           = PciCapListFindCap (CapList, Cap->Domain, Cap->CapId, Instances[Index], &Found);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_NOT_EFI_ERROR (PciCapGetInfo (Found, &Info));
+      UT_ASSERT_EQUAL (Info.Offset, Cap->Offset);
+      UT_ASSERT_EQUAL (Info.Version, Cap->Version);
+    }
+
+    Start = __rdtsc ();
+    for (Iteration = 0; Iteration < PCI_CAP_BENCHMARK_ITERATIONS; Iteration++) {
+      for (Index = 0; Index < Image->NumCaps; Index++) {
+        Cap = &Image->Caps[Index];
+        PciCapListFindCap (CapList, Cap->Domain, Cap->CapId, Instances[Index], &Found);
+      }
+    }
+
+    LookupCycles = __rdtsc () - Start;
+    PciCapListUninit (CapList);
+
+    Start = __rdtsc ();
+    for (Iteration = 0; Iteration < PCI_CAP_BENCHMARK_ITERATIONS; Iteration++) {
+      Status = PciCapListInitFromSnapshot (mConfigSpace, PCI_EXP_MAX_CONFIG_OFFSET, &CapList);
+      if (RETURN_ERROR (Status)) {
+        break;
+      }
+
+      PciCapListUninit (CapList);
+    }
+
+    ParseCycles = __rdtsc () - Start;
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    UT_LOG_INFO (
+      "%a, %Lu capabilities: parse %Lu cycles, lookup %Lu cycles\n",
+      Image->Description,
+      (UINT64)Image->NumCaps,
+      DivU64x32 (ParseCycles, PCI_CAP_BENCHMARK_ITERATIONS),
+      DivU64x64Remainder (LookupCycles, MultU64x32 (PCI_CAP_BENCHMARK_ITERATIONS, (UINT32)Image->NumCaps), NULL)
+      );
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for
+  BasePciCapLib, and run them.
+
+  @retval EFI_SUCCESS           All test cases were dispatched.
+  @retval EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                initialize the unit tests.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      SnapshotTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&SnapshotTests, Framework, "Config Space Snapshot Tests", "PciCapLib.Snapshot", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for Config Space Snapshot Tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (SnapshotTests, "Capabilities of QEMU devices are found", "FindCap", SnapshotFindCapTest, NULL, NULL, NULL);
+  AddTestCase (SnapshotTests, "Size hints stop at the next capability", "MaxSizeHint", SnapshotMaxSizeHintTest, NULL, NULL, NULL);
+  AddTestCase (SnapshotTests, "Malformed images are rejected", "Invalid", SnapshotInvalidTest, NULL, NULL, NULL);
+  AddTestCase (SnapshotTests, "Parse and lookup cost of 4 KiB images", "Benchmark", SnapshotBenchmarkTest, NULL, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
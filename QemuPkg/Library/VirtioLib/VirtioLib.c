@@ -349,6 +349,129 @@ VirtioFlush (
   return EFI_SUCCESS;
 }
 
+/**
+
+  Notify the host about several descriptor chains just built, and wait until
+  the host processes all of them.
+
+  The chains must have been built after a single VirtioPrepare() call, by
+  appending their descriptors back to back with VirtioAppendDesc(). The head
+  descriptor index of each chain is the value of Indices->NextDescIdx right
+  before the first VirtioAppendDesc() call for that chain. The caller is
+  responsible for ensuring that the ring has enough descriptors for all
+  chains.
+
+  The host may complete the chains in any order.
+
+  @param[in] VirtIo       The target virtio device to notify.
+
+  @param[in] VirtQueueId  Identifies the queue for the target device.
+
+  @param[in,out] Ring     The virtio ring with descriptors to submit.
+
+  @param[in] HeadDescIdx  Array of ChainCount elements, identifying the head
+                          descriptor of each descriptor chain.
+
+  @param[in] ChainCount   The number of descriptor chains to submit. Must be
+                          between 1 and Ring->QueueSize, inclusive.
+
+  @param[out] UsedLen     On success, array of ChainCount elements; each
+                          element receives the total number of bytes that the
+                          host wrote, consecutively across the buffers linked
+                          by the corresponding descriptor chain. May be NULL
+                          if the caller doesn't care, or can compute the same
+                          information from device-specific request structures
+                          linked by the descriptor chains.
+
+  @return              Error code from VirtIo->SetQueueNotify() if it fails.
+
+  @retval EFI_SUCCESS  Otherwise, the host processed all descriptors.
+
+**/
+EFI_STATUS
+EFIAPI
+VirtioFlushBatch (
+  IN     VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN     UINT16                  VirtQueueId,
+  IN OUT VRING                   *Ring,
+  IN     CONST UINT16            *HeadDescIdx,
+  IN     UINT16                  ChainCount,
+  OUT    UINT32                  *UsedLen    OPTIONAL
+  )
+{
+  UINT16      NextAvailIdx;
+  UINT16      LastUsedIdx;
+  UINT16      Chain;
+  UINT16      Used;
+  EFI_STATUS  Status;
+  UINTN       PollPeriodUsecs;
+
+  ASSERT (ChainCount > 0);
+  ASSERT (ChainCount <= Ring->QueueSize);
+
+  //
+  // Publish all head descriptors in the Available Ring, then expose them to
+  // the host with a single index update and a single notification.
+  //
+  NextAvailIdx = *Ring->Avail.Idx;
+  LastUsedIdx  = NextAvailIdx;
+  for (Chain = 0; Chain < ChainCount; Chain++) {
+    Ring->Avail.Ring[NextAvailIdx++ % Ring->QueueSize] =
+      HeadDescIdx[Chain] % Ring->QueueSize;
+  }
+
+  MemoryFence ();
+  *Ring->Avail.Idx = NextAvailIdx;
+
+  MemoryFence ();
+  Status = VirtIo->SetQueueNotify (VirtIo, VirtQueueId);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Wait until the host has returned every chain in the Used Ring. As in
+  // VirtioFlush(), keep slowing down until we reach a poll period of slightly
+  // above 1 ms.
+  //
+  PollPeriodUsecs = 1;
+  MemoryFence ();
+  while (*Ring->Used.Idx != NextAvailIdx) {
+    gBS->Stall (PollPeriodUsecs);
+
+    if (PollPeriodUsecs < 1024) {
+      PollPeriodUsecs *= 2;
+    }
+
+    MemoryFence ();
+  }
+
+  MemoryFence ();
+
+  if (UsedLen != NULL) {
+    volatile CONST VRING_USED_ELEM  *UsedElem;
+
+    //
+    // The Used Ring reflects the order of completion, not of submission;
+    // match its elements to the chains by head descriptor index.
+    //
+    for (Used = 0; Used < ChainCount; Used++) {
+      UsedElem = &Ring->Used.UsedElem[(UINT16)(LastUsedIdx + Used) %
+                                      Ring->QueueSize];
+      for (Chain = 0; Chain < ChainCount; Chain++) {
+        if (UsedElem->Id == HeadDescIdx[Chain] % Ring->QueueSize) {
+          UsedLen[Chain] = UsedElem->Len;
+          break;
+        }
+      }
+
+      ASSERT (Chain < ChainCount);
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
 
   Report the feature bits to the VirtIo 1.0 device that the VirtIo 1.0 driver
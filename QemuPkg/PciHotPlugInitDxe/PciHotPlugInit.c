@@ -37,6 +37,36 @@ STATIC BOOLEAN  mPciExtConfSpaceSupported;
 //
 STATIC EFI_PCI_HOT_PLUG_INIT_PROTOCOL  mPciHotPlugInit;
 
+//
+// Outcome of looking up the Resource Reservation capability of one Hotplug
+// Controller.
+//
+typedef struct {
+  EFI_STATUS                                         Status;
+  QEMU_PCI_BRIDGE_CAPABILITY_RESOURCE_RESERVATION    Hint;
+} RESERVATION_HINT;
+
+//
+// Reservation hints of the bridges on root bus 0, indexed by device and
+// function. The addresses of these bridges do not depend on bus enumeration,
+// so they are scanned once, in DriverInitialize().
+//
+STATIC RESERVATION_HINT  mRootBusHints[PCI_MAX_DEVICE + 1][PCI_MAX_FUNC + 1];
+
+//
+// Reservation hints of all other bridges, keyed by device path, recorded the
+// first time GetResourcePadding() is called for them. The PCI bus driver asks
+// for the same bridge more than once during enumeration.
+//
+typedef struct {
+  LIST_ENTRY                  Link;
+  EFI_DEVICE_PATH_PROTOCOL    *DevicePath;
+  UINTN                       DevicePathSize;
+  RESERVATION_HINT            ReservationHint;
+} DEVICE_PATH_RESERVATION_HINT;
+
+STATIC LIST_ENTRY  mDevicePathHints = INITIALIZE_LIST_HEAD_VARIABLE (mDevicePathHints);
+
 //
 // Resource padding template for the GetResourcePadding() protocol member
 // function.
@@ -398,6 +428,139 @@ UninitPciDevice:
   return Status;
 }
 
+/**
+  Scan root bus 0 for PCI Bridges, and record the outcome of
+  QueryReservationHint() for each one in mRootBusHints.
+**/
+STATIC
+VOID
+ScanRootBusReservationHints (
+  VOID
+  )
+{
+  UINTN                                        Device;
+  UINTN                                        Function;
+  UINT16                                       VendorId;
+  UINT8                                        HeaderType;
+  RESERVATION_HINT                             *ReservationHint;
+  EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS  Address;
+
+  ZeroMem (&Address, sizeof Address);
+
+  for (Device = 0; Device <= PCI_MAX_DEVICE; ++Device) {
+    for (Function = 0; Function <= PCI_MAX_FUNC; ++Function) {
+      mRootBusHints[Device][Function].Status = EFI_NOT_FOUND;
+    }
+  }
+
+  for (Device = 0; Device <= PCI_MAX_DEVICE; ++Device) {
+    for (Function = 0; Function <= PCI_MAX_FUNC; ++Function) {
+      VendorId = PciRead16 (PCI_LIB_ADDRESS (0, Device, Function, PCI_VENDOR_ID_OFFSET));
+      if (VendorId == MAX_UINT16) {
+        if (Function == 0) {
+          //
+          // No device; the remaining functions are absent too.
+          //
+          break;
+        }
+
+        continue;
+      }
+
+      HeaderType = PciRead8 (PCI_LIB_ADDRESS (0, Device, Function, PCI_HEADER_TYPE_OFFSET));
+      if ((HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_PCI_TO_PCI_BRIDGE) {
+        ReservationHint         = &mRootBusHints[Device][Function];
+        Address.Device          = (UINT8)Device;
+        Address.Function        = (UINT8)Function;
+        ReservationHint->Status = QueryReservationHint (&Address, &ReservationHint->Hint);
+      }
+
+      if ((Function == 0) && ((HeaderType & HEADER_TYPE_MULTI_FUNCTION) == 0)) {
+        break;
+      }
+    }
+  }
+}
+
+/**
+  Look up the Resource Reservation capability of a Hotplug Controller, using
+  the outcome recorded earlier for the same controller if possible.
+
+  @param[in] HpcDevicePath  The device path to the PCI Bridge.
+
+  @param[in] HpcPciAddress  The address of the PCI Bridge -- Bus, Device,
+                            Function -- in UEFI (not PciLib) encoding.
+
+  @param[out] ReservationHint  The capability structure, on success.
+
+  @return  The outcome of QueryReservationHint() for the PCI Bridge.
+**/
+STATIC
+EFI_STATUS
+GetReservationHint (
+  IN  CONST EFI_DEVICE_PATH_PROTOCOL                     *HpcDevicePath,
+  IN  CONST EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS  *HpcPciAddress,
+  OUT QEMU_PCI_BRIDGE_CAPABILITY_RESOURCE_RESERVATION    *ReservationHint
+  )
+{
+  CONST RESERVATION_HINT        *Cached;
+  UINTN                         DevicePathSize;
+  LIST_ENTRY                    *Link;
+  DEVICE_PATH_RESERVATION_HINT  *Entry;
+
+  Cached = NULL;
+
+  if (HpcPciAddress->Bus == 0) {
+    Cached = &mRootBusHints[HpcPciAddress->Device][HpcPciAddress->Function];
+    goto Done;
+  }
+
+  DevicePathSize = GetDevicePathSize (HpcDevicePath);
+  for (Link = GetFirstNode (&mDevicePathHints);
+       !IsNull (&mDevicePathHints, Link);
+       Link = GetNextNode (&mDevicePathHints, Link))
+  {
+    Entry = BASE_CR (Link, DEVICE_PATH_RESERVATION_HINT, Link);
+    if ((Entry->DevicePathSize == DevicePathSize) &&
+        (CompareMem (Entry->DevicePath, HpcDevicePath, DevicePathSize) == 0))
+    {
+      Cached = &Entry->ReservationHint;
+      goto Done;
+    }
+  }
+
+  Entry = AllocatePool (sizeof *Entry);
+  if (Entry != NULL) {
+    Entry->DevicePath = AllocateCopyPool (DevicePathSize, HpcDevicePath);
+    if (Entry->DevicePath == NULL) {
+      FreePool (Entry);
+      Entry = NULL;
+    }
+  }
+
+  if (Entry == NULL) {
+    //
+    // Can't cache the outcome; just report it.
+    //
+    return QueryReservationHint (HpcPciAddress, ReservationHint);
+  }
+
+  Entry->DevicePathSize         = DevicePathSize;
+  Entry->ReservationHint.Status = QueryReservationHint (
+                                    HpcPciAddress,
+                                    &Entry->ReservationHint.Hint
+                                    );
+  InsertTailList (&mDevicePathHints, &Entry->Link);
+  Cached = &Entry->ReservationHint;
+
+Done:
+  if (!EFI_ERROR (Cached->Status)) {
+    CopyMem (ReservationHint, &Cached->Hint, sizeof *ReservationHint);
+  }
+
+  return Cached->Status;
+}
+
 /**
   Returns a list of root Hot Plug Controllers (HPCs) that require
   initialization during the boot process.
@@ -603,7 +766,11 @@ GetResourcePadding (
   //
   // Try to get the QEMU-specific Resource Reservation capability.
   //
-  ReservationHintStatus = QueryReservationHint (Address, &ReservationHint);
+  ReservationHintStatus = GetReservationHint (
+                            HpcDevicePath,
+                            Address,
+                            &ReservationHint
+                            );
   if (!EFI_ERROR (ReservationHintStatus)) {
     INTN  HighBit;
 
@@ -800,6 +967,8 @@ DriverInitialize (
 
   mPciExtConfSpaceSupported = (PcdGet16 (PcdOvmfHostBridgePciDevId) ==
                                INTEL_Q35_MCH_DEVICE_ID);
+  ScanRootBusReservationHints ();
+
   mPciHotPlugInit.GetRootHpcList     = GetRootHpcList;
   mPciHotPlugInit.InitializeRootHpc  = InitializeRootHpc;
   mPciHotPlugInit.GetResourcePadding = GetResourcePadding;
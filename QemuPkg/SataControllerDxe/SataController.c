@@ -20,11 +20,53 @@ EFI_DRIVER_BINDING_PROTOCOL  gSataControllerDriverBinding = {
   NULL
 };
 
+/**
+  Look up the AHCI register BAR, and if it is a memory BAR, record its host
+  address so that registers can be accessed without a PciIo call each time.
+
+  @param SataPrivateData  The controller private data, with PciIo set.
+
+**/
+STATIC
+VOID
+AhciMapRegisterBar (
+  IN OUT EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData
+  )
+{
+  EFI_STATUS                         Status;
+  EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR  *Descriptor;
+
+  SataPrivateData->AhciBarBase = 0;
+
+  Status = SataPrivateData->PciIo->GetBarAttributes (
+                                     SataPrivateData->PciIo,
+                                     AHCI_BAR_INDEX,
+                                     NULL,
+                                     (VOID **)&Descriptor
+                                     );
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  if ((Descriptor->Desc == ACPI_ADDRESS_SPACE_DESCRIPTOR) &&
+      (Descriptor->ResType == ACPI_ADDRESS_SPACE_TYPE_MEM) &&
+      (Descriptor->AddrLen != 0))
+  {
+    //
+    // Host address = device address - translation offset.
+    //
+    SataPrivateData->AhciBarBase = (UINTN)(Descriptor->AddrRangeMin -
+                                           Descriptor->AddrTranslationOffset);
+  }
+
+  FreePool (Descriptor);
+}
+
 /**
   Read AHCI Operation register.
 
-  @param PciIo      The PCI IO protocol instance.
-  @param Offset     The operation register offset.
+  @param SataPrivateData  The controller private data.
+  @param Offset           The operation register offset.
 
   @return The register content read.
 
@@ -32,24 +74,28 @@ EFI_DRIVER_BINDING_PROTOCOL  gSataControllerDriverBinding = {
 UINT32
 EFIAPI
 AhciReadReg (
-  IN EFI_PCI_IO_PROTOCOL  *PciIo,
-  IN UINT32               Offset
+  IN EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData,
+  IN UINT32                            Offset
   )
 {
   UINT32  Data;
 
-  ASSERT (PciIo != NULL);
+  ASSERT (SataPrivateData != NULL);
+
+  if (SataPrivateData->AhciBarBase != 0) {
+    return MmioRead32 (SataPrivateData->AhciBarBase + Offset);
+  }
 
   Data = 0;
 
-  PciIo->Mem.Read (
-               PciIo,
-               EfiPciIoWidthUint32,
-               AHCI_BAR_INDEX,
-               (UINT64)Offset,
-               1,
-               &Data
-               );
+  SataPrivateData->PciIo->Mem.Read (
+                                SataPrivateData->PciIo,
+                                EfiPciIoWidthUint32,
+                                AHCI_BAR_INDEX,
+                                (UINT64)Offset,
+                                1,
+                                &Data
+                                );
 
   return Data;
 }
@@ -57,29 +103,34 @@ AhciReadReg (
 /**
   Write AHCI Operation register.
 
-  @param PciIo      The PCI IO protocol instance.
-  @param Offset     The operation register offset.
-  @param Data       The data used to write down.
+  @param SataPrivateData  The controller private data.
+  @param Offset           The operation register offset.
+  @param Data             The data used to write down.
 
 **/
 VOID
 EFIAPI
 AhciWriteReg (
-  IN EFI_PCI_IO_PROTOCOL  *PciIo,
-  IN UINT32               Offset,
-  IN UINT32               Data
+  IN EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData,
+  IN UINT32                            Offset,
+  IN UINT32                            Data
   )
 {
-  ASSERT (PciIo != NULL);
+  ASSERT (SataPrivateData != NULL);
+
+  if (SataPrivateData->AhciBarBase != 0) {
+    MmioWrite32 (SataPrivateData->AhciBarBase + Offset, Data);
+    return;
+  }
 
-  PciIo->Mem.Write (
-               PciIo,
-               EfiPciIoWidthUint32,
-               AHCI_BAR_INDEX,
-               (UINT64)Offset,
-               1,
-               &Data
-               );
+  SataPrivateData->PciIo->Mem.Write (
+                                SataPrivateData->PciIo,
+                                EfiPciIoWidthUint32,
+                                AHCI_BAR_INDEX,
+                                (UINT64)Offset,
+                                1,
+                                &Data
+                                );
 
   return;
 }
@@ -385,7 +436,6 @@ SataControllerStart (
   UINT64                            OriginalPciAttributes;
   PCI_TYPE00                        PciData;
   EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData;
-  UINT32                            Data32;
   UINTN                             ChannelDeviceCount;
 
   DEBUG ((DEBUG_INFO, "SataControllerStart START\n"));
@@ -478,18 +528,32 @@ SataControllerStart (
   if (IS_PCI_IDE (&PciData)) {
     SataPrivateData->IdeInit.ChannelCount = IDE_MAX_CHANNEL;
     SataPrivateData->DeviceCount          = IDE_MAX_DEVICES;
+    SataPrivateData->ChannelEnabledMask   = (UINT32)(LShiftU64 (1, IDE_MAX_CHANNEL) - 1);
   } else if (IS_PCI_SATADPA (&PciData)) {
     //
     // Read Host Capability Register(CAP) to get Number of Ports(NPS) and Supports Port Multiplier(SPM)
     //   NPS is 0's based value indicating the maximum number of ports supported by the HBA silicon.
     //   A maximum of 32 ports can be supported. A value of '0h', indicating one port, is the minimum requirement.
     //
-    Data32                                = AhciReadReg (PciIo, R_AHCI_CAP);
-    SataPrivateData->IdeInit.ChannelCount = (UINT8)((Data32 & B_AHCI_CAP_NPS) + 1);
+    AhciMapRegisterBar (SataPrivateData);
+    SataPrivateData->AhciCapability       = AhciReadReg (SataPrivateData, R_AHCI_CAP);
+    SataPrivateData->AhciPortsImplemented = AhciReadReg (SataPrivateData, R_AHCI_PI);
+    SataPrivateData->IdeInit.ChannelCount = (UINT8)((SataPrivateData->AhciCapability & B_AHCI_CAP_NPS) + 1);
     SataPrivateData->DeviceCount          = AHCI_MAX_DEVICES;
-    if ((Data32 & B_AHCI_CAP_SPM) == B_AHCI_CAP_SPM) {
+    if ((SataPrivateData->AhciCapability & B_AHCI_CAP_SPM) == B_AHCI_CAP_SPM) {
       SataPrivateData->DeviceCount = AHCI_MULTI_MAX_DEVICES;
     }
+
+    //
+    // Only report the ports that the HBA implements as enabled channels, so
+    // that the bus driver does not probe ports that cannot have a device. An
+    // HBA that reports no implemented ports at all is taken to be misreporting
+    // PI, and gets every channel enabled.
+    //
+    SataPrivateData->ChannelEnabledMask = (UINT32)(LShiftU64 (1, SataPrivateData->IdeInit.ChannelCount) - 1);
+    if ((SataPrivateData->AhciPortsImplemented & SataPrivateData->ChannelEnabledMask) != 0) {
+      SataPrivateData->ChannelEnabledMask &= SataPrivateData->AhciPortsImplemented;
+    }
   }
 
   ChannelDeviceCount                 = (UINTN)(SataPrivateData->IdeInit.ChannelCount) * (UINTN)(SataPrivateData->DeviceCount);
@@ -747,7 +811,7 @@ IdeInitGetChannelInfo (
   ASSERT (SataPrivateData != NULL);
 
   if (Channel < This->ChannelCount) {
-    *Enabled    = TRUE;
+    *Enabled    = (BOOLEAN)((SataPrivateData->ChannelEnabledMask & (((UINT32)BIT0) << Channel)) != 0);
     *MaxDevices = SataPrivateData->DeviceCount;
     return EFI_SUCCESS;
   }
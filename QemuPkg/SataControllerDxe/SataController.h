@@ -21,7 +21,9 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/IoLib.h>
 #include <IndustryStandard/Pci.h>
+#include <IndustryStandard/Acpi.h>
 
 //
 // Global Variables definitions
@@ -34,6 +36,7 @@ extern EFI_COMPONENT_NAME2_PROTOCOL  gSataControllerComponentName2;
 #define R_AHCI_CAP        0x0
 #define   B_AHCI_CAP_NPS  (BIT4 | BIT3 | BIT2 | BIT1 | BIT0) // Number of Ports
 #define   B_AHCI_CAP_SPM  BIT17                              // Supports Port Multiplier
+#define R_AHCI_PI         0xC                                // Ports Implemented
 
 ///
 /// AHCI each channel can have up to 1 device
@@ -89,6 +92,25 @@ typedef struct _EFI_SATA_CONTROLLER_PRIVATE_DATA {
   //
   UINT8                               DeviceCount;
 
+  //
+  // Host address of the AHCI register BAR, if it is a memory BAR that can be
+  // accessed directly; zero if register accesses must go through PciIo
+  //
+  UINTN                               AhciBarBase;
+
+  //
+  // Host Capabilities (CAP) and Ports Implemented (PI) registers, read once
+  // when the controller is started. Both are read-only or write-once, so the
+  // cached values stay valid.
+  //
+  UINT32                              AhciCapability;
+  UINT32                              AhciPortsImplemented;
+
+  //
+  // Bit N set if channel N is enabled
+  //
+  UINT32                              ChannelEnabledMask;
+
   //
   // The highest disqulified mode for each attached device,
   // From ATA/ATAPI spec, if a mode is not supported,
@@ -0,0 +1,766 @@
+/** @file
+
+  This driver reports the memory that the firmware leaves free at
+  ExitBootServices() to the host, through the page reporting queue of
+  virtio-balloon devices.
+
+  The firmware touches large amounts of guest memory during boot, for example
+  decompression scratch buffers, bounce buffers and fw_cfg blob copies, and
+  releases it before handing off to the OS. The host keeps backing all of
+  those pages, even though the OS will treat them as free. Reporting the
+  EfiConventionalMemory ranges of the final UEFI memory map lets the host
+  discard their backing before the OS starts; a page that is reported reads
+  back as zeroes, or as its former contents, when the OS next touches it.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/VirtioLib.h>
+
+#include "VirtioBalloon.h"
+
+//
+// The largest number of ranges that one page reporting request carries.
+//
+#define VIRTIO_BALLOON_MAX_REPORT_RANGES  64
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioBalloonInit (
+  IN OUT VIRTIO_BALLOON_DEV  *Dev
+  )
+{
+  UINT8       NextDevStat;
+  EFI_STATUS  Status;
+  UINT16      QueueSize;
+  UINT64      Features;
+  UINT64      RingBaseShift;
+
+  //
+  // Execute virtio-0.9.5, 2.2.1 Device Initialization Sequence.
+  //
+  NextDevStat = 0;             // step 1 -- reset device
+  Status      = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_ACK;    // step 2 -- acknowledge device presence
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_DRIVER; // step 3 -- we know how to drive it
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // Set Page Size - MMIO VirtIo Specific
+  //
+  Status = Dev->VirtIo->SetPageSize (Dev->VirtIo, EFI_PAGE_SIZE);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 4a -- retrieve and validate features
+  //
+  Status = Dev->VirtIo->GetDeviceFeatures (Dev->VirtIo, &Features);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // Page reporting hands guest-physical addresses of free memory to the
+  // device. With VIRTIO_F_IOMMU_PLATFORM, those would have to be translated
+  // (and, in encrypted guests, shared) first, which is not possible from an
+  // ExitBootServices() notification function.
+  //
+  if (((Features & VIRTIO_BALLOON_F_PAGE_REPORTING) == 0) ||
+      ((Features & VIRTIO_F_IOMMU_PLATFORM) != 0))
+  {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  //
+  // The page reporting queue follows the optional queues that the device
+  // offers, whether or not we negotiate them.
+  //
+  Dev->ReportQueue = VIRTIO_BALLOON_DEFLATE_QUEUE + 1;
+  if ((Features & VIRTIO_BALLOON_F_STATS_VQ) != 0) {
+    Dev->ReportQueue++;
+  }
+
+  if ((Features & VIRTIO_BALLOON_F_FREE_PAGE_HINT) != 0) {
+    Dev->ReportQueue++;
+  }
+
+  Features &= VIRTIO_F_VERSION_1 | VIRTIO_BALLOON_F_PAGE_REPORTING;
+
+  //
+  // In virtio-1.0, feature negotiation is expected to complete before queue
+  // discovery, and the device can also reject the selected set of features.
+  //
+  if (Dev->VirtIo->Revision >= VIRTIO_SPEC_REVISION (1, 0, 0)) {
+    Status = Virtio10WriteFeatures (Dev->VirtIo, Features, &NextDevStat);
+    if (EFI_ERROR (Status)) {
+      goto Failed;
+    }
+  }
+
+  //
+  // step 4b -- allocate the page reporting virtqueue; the inflate and deflate
+  // queues are left unconfigured, as the firmware never balloons.
+  //
+  Status = Dev->VirtIo->SetQueueSel (Dev->VirtIo, Dev->ReportQueue);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = Dev->VirtIo->GetQueueNumMax (Dev->VirtIo, &QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // VirtioBalloonReport() uses at least one descriptor
+  //
+  if (QueueSize < 1) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  Status = VirtioRingInit (Dev->VirtIo, QueueSize, &Dev->Ring);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // If anything fails from here on, we must release the ring resources.
+  //
+  Status = VirtioRingMap (
+             Dev->VirtIo,
+             &Dev->Ring,
+             &RingBaseShift,
+             &Dev->RingMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto ReleaseQueue;
+  }
+
+  //
+  // Additional steps for MMIO: align the queue appropriately, and set the
+  // size. If anything fails from here on, we must unmap the ring resources.
+  //
+  Status = Dev->VirtIo->SetQueueNum (Dev->VirtIo, QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = Dev->VirtIo->SetQueueAlign (Dev->VirtIo, EFI_PAGE_SIZE);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  //
+  // step 4c -- Report GPFN (guest-physical frame number) of queue.
+  //
+  Status = Dev->VirtIo->SetQueueAddress (
+                          Dev->VirtIo,
+                          &Dev->Ring,
+                          RingBaseShift
+                          );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  //
+  // step 5 -- Report understood features and guest-tuneables.
+  //
+  if (Dev->VirtIo->Revision < VIRTIO_SPEC_REVISION (1, 0, 0)) {
+    Features &= ~(UINT64)VIRTIO_F_VERSION_1;
+    Status    = Dev->VirtIo->SetGuestFeatures (Dev->VirtIo, Features);
+    if (EFI_ERROR (Status)) {
+      goto UnmapQueue;
+    }
+  }
+
+  //
+  // step 6 -- initialization complete
+  //
+  NextDevStat |= VSTAT_DRIVER_OK;
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  return EFI_SUCCESS;
+
+UnmapQueue:
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->RingMap);
+
+ReleaseQueue:
+  VirtioRingUninit (Dev->VirtIo, &Dev->Ring);
+
+Failed:
+  //
+  // Notify the host about our failure to setup: virtio-0.9.5, 2.2.2.1 Device
+  // Status. VirtIo access failure here should not mask the original error.
+  //
+  NextDevStat |= VSTAT_FAILED;
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+
+  return Status; // reached only via Failed above
+}
+
+STATIC
+VOID
+EFIAPI
+VirtioBalloonUninit (
+  IN OUT VIRTIO_BALLOON_DEV  *Dev
+  )
+{
+  //
+  // Reset the virtual device -- see virtio-0.9.5, 2.2.2.1 Device Status. When
+  // VIRTIO_CFG_WRITE() returns, the host will have learned to stay away from
+  // the old comms area.
+  //
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->RingMap);
+  VirtioRingUninit (Dev->VirtIo, &Dev->Ring);
+}
+
+/**
+  Submit one page reporting request, and wait until the host has discarded
+  the ranges in it.
+
+  @param[in,out] Dev         The driver instance.
+
+  @param[in] RangeBase       Array of RangeCount guest-physical range bases.
+
+  @param[in] RangeSize       Array of RangeCount range sizes, in bytes.
+
+  @param[in] RangeCount      The number of ranges, between 1 and
+                             Dev->Ring.QueueSize inclusive.
+
+  @return  Status codes from VirtioFlush().
+**/
+STATIC
+EFI_STATUS
+VirtioBalloonReport (
+  IN OUT VIRTIO_BALLOON_DEV  *Dev,
+  IN     CONST UINT64        *RangeBase,
+  IN     CONST UINT32        *RangeSize,
+  IN     UINTN               RangeCount
+  )
+{
+  DESC_INDICES  Indices;
+  UINTN         Index;
+
+  VirtioPrepare (&Dev->Ring, &Indices);
+  for (Index = 0; Index < RangeCount; Index++) {
+    VirtioAppendDesc (
+      &Dev->Ring,
+      RangeBase[Index],
+      RangeSize[Index],
+      VRING_DESC_F_WRITE | (Index + 1 < RangeCount ? VRING_DESC_F_NEXT : 0),
+      &Indices
+      );
+  }
+
+  return VirtioFlush (Dev->VirtIo, Dev->ReportQueue, &Dev->Ring, &Indices, NULL);
+}
+
+//
+// Event notification function enqueued by the ReadyToBoot event group.
+//
+// Memory services cannot be used in the ExitBootServices() notification
+// function, so allocate the buffer for the final memory map here, with room
+// for the descriptors that the OS loader adds in the meantime. ReadyToBoot is
+// signaled once per boot option tried, so replace any earlier buffer.
+//
+STATIC
+VOID
+EFIAPI
+VirtioBalloonReadyToBoot (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  )
+{
+  VIRTIO_BALLOON_DEV  *Dev;
+  UINTN               MapKey;
+  UINTN               DescriptorSize;
+  UINT32              DescriptorVersion;
+  EFI_STATUS          Status;
+
+  Dev = Context;
+
+  if (Dev->MemoryMap != NULL) {
+    FreePool (Dev->MemoryMap);
+    Dev->MemoryMap = NULL;
+  }
+
+  Dev->MemoryMapSize = 0;
+  Status             = gBS->GetMemoryMap (
+                              &Dev->MemoryMapSize,
+                              NULL,
+                              &MapKey,
+                              &DescriptorSize,
+                              &DescriptorVersion
+                              );
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    Dev->MemoryMapSize = 0;
+    return;
+  }
+
+  Dev->MemoryMapSize += VIRTIO_BALLOON_MEMORY_MAP_SLACK * DescriptorSize;
+  Dev->MemoryMap      = AllocatePool (Dev->MemoryMapSize);
+  if (Dev->MemoryMap == NULL) {
+    Dev->MemoryMapSize = 0;
+  }
+}
+
+//
+// Event notification function enqueued by ExitBootServices().
+//
+// Report every EfiConventionalMemory range of the final memory map to the
+// host, then reset the device.
+//
+STATIC
+VOID
+EFIAPI
+VirtioBalloonExitBoot (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  )
+{
+  VIRTIO_BALLOON_DEV     *Dev;
+  UINTN                  MemoryMapSize;
+  UINTN                  MapKey;
+  UINTN                  DescriptorSize;
+  UINT32                 DescriptorVersion;
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+  UINT64                 Base;
+  UINT64                 End;
+  UINT64                 RangeBase[VIRTIO_BALLOON_MAX_REPORT_RANGES];
+  UINT32                 RangeSize[VIRTIO_BALLOON_MAX_REPORT_RANGES];
+  UINTN                  RangeCount;
+  UINTN                  MaxRangeCount;
+  UINT64                 ReportedBytes;
+  UINTN                  Requests;
+  EFI_STATUS             Status;
+
+  DEBUG ((DEBUG_VERBOSE, "%a: Context=0x%p\n", __FUNCTION__, Context));
+
+  Dev           = Context;
+  RangeCount    = 0;
+  MaxRangeCount = MIN (Dev->Ring.QueueSize, VIRTIO_BALLOON_MAX_REPORT_RANGES);
+  ReportedBytes = 0;
+  Requests      = 0;
+  Status        = EFI_NOT_READY;
+
+  if (Dev->MemoryMap != NULL) {
+    MemoryMapSize = Dev->MemoryMapSize;
+    Status        = gBS->GetMemoryMap (
+                           &MemoryMapSize,
+                           Dev->MemoryMap,
+                           &MapKey,
+                           &DescriptorSize,
+                           &DescriptorVersion
+                           );
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "%a: no memory map: %r\n", __FUNCTION__, Status));
+    goto ResetDevice;
+  }
+
+  for (Desc = Dev->MemoryMap;
+       (UINT8 *)Desc < (UINT8 *)Dev->MemoryMap + MemoryMapSize;
+       Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize))
+  {
+    if (Desc->Type != EfiConventionalMemory) {
+      continue;
+    }
+
+    Base = Desc->PhysicalStart;
+    End  = Base + EFI_PAGES_TO_SIZE (Desc->NumberOfPages);
+    while (Base < End) {
+      RangeBase[RangeCount] = Base;
+      RangeSize[RangeCount] = (UINT32)MIN (End - Base, VIRTIO_BALLOON_MAX_REPORT_SIZE);
+      Base                 += RangeSize[RangeCount];
+      RangeCount++;
+
+      if (RangeCount == MaxRangeCount) {
+        Status = VirtioBalloonReport (Dev, RangeBase, RangeSize, RangeCount);
+        if (EFI_ERROR (Status)) {
+          goto ReportFailed;
+        }
+
+        while (RangeCount > 0) {
+          ReportedBytes += RangeSize[--RangeCount];
+        }
+
+        Requests++;
+      }
+    }
+  }
+
+  if (RangeCount > 0) {
+    Status = VirtioBalloonReport (Dev, RangeBase, RangeSize, RangeCount);
+    if (EFI_ERROR (Status)) {
+      goto ReportFailed;
+    }
+
+    while (RangeCount > 0) {
+      ReportedBytes += RangeSize[--RangeCount];
+    }
+
+    Requests++;
+  }
+
+ReportFailed:
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: page reporting failed: %r\n", __FUNCTION__, Status));
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: returned %Lu pages (%Lu MB) to the host in %Lu requests\n",
+    __FUNCTION__,
+    (UINT64)EFI_SIZE_TO_PAGES (ReportedBytes),
+    ReportedBytes / SIZE_1MB,
+    (UINT64)Requests
+    ));
+
+ResetDevice:
+  //
+  // Reset the device. This causes the hypervisor to forget about the virtio
+  // ring.
+  //
+  // We allocated said ring in EfiBootServicesData type memory, and code
+  // executing after ExitBootServices() is permitted to overwrite it.
+  //
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+}
+
+//
+// Probe, start and stop functions of this driver, called by the DXE core for
+// specific devices.
+//
+// The following specifications document these interfaces:
+// - Driver Writer's Guide for UEFI 2.3.1 v1.01, 9 Driver Binding Protocol
+// - UEFI Spec 2.3.1 + Errata C, 10.1 EFI Driver Binding Protocol
+//
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioBalloonDriverBindingSupported (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  EFI_STATUS              Status;
+  VIRTIO_DEVICE_PROTOCOL  *VirtIo;
+
+  //
+  // Attempt to open the device with the VirtIo set of interfaces. On success,
+  // the protocol is "instantiated" for the VirtIo device. Covers duplicate
+  // open attempts (EFI_ALREADY_STARTED).
+  //
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  (VOID **)&VirtIo,
+                  This->DriverBindingHandle,
+                  DeviceHandle,
+                  EFI_OPEN_PROTOCOL_BY_DRIVER
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (VirtIo->SubSystemDeviceId != VIRTIO_SUBSYSTEM_MEMORY_BALLOONING) {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  //
+  // We needed VirtIo access only transitorily, to see whether we support the
+  // device or not.
+  //
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioBalloonDriverBindingStart (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  VIRTIO_BALLOON_DEV  *Dev;
+  EFI_STATUS          Status;
+
+  Dev = (VIRTIO_BALLOON_DEV *)AllocateZeroPool (sizeof *Dev);
+  if (Dev == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  (VOID **)&Dev->VirtIo,
+                  This->DriverBindingHandle,
+                  DeviceHandle,
+                  EFI_OPEN_PROTOCOL_BY_DRIVER
+                  );
+  if (EFI_ERROR (Status)) {
+    goto FreeVirtioBalloon;
+  }
+
+  //
+  // VirtIo access granted, configure virtio-balloon device.
+  //
+  Status = VirtioBalloonInit (Dev);
+  if (EFI_ERROR (Status)) {
+    goto CloseVirtIo;
+  }
+
+  Status = EfiCreateEventReadyToBootEx (
+             TPL_CALLBACK,
+             &VirtioBalloonReadyToBoot,
+             Dev,
+             &Dev->ReadyToBoot
+             );
+  if (EFI_ERROR (Status)) {
+    goto UninitDev;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                  TPL_CALLBACK,
+                  &VirtioBalloonExitBoot,
+                  Dev,
+                  &Dev->ExitBoot
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseReadyToBoot;
+  }
+
+  //
+  // Setup complete; remember the driver instance on the device handle, for
+  // Stop().
+  //
+  Dev->Signature = VIRTIO_BALLOON_SIG;
+  Status         = gBS->InstallProtocolInterface (
+                          &DeviceHandle,
+                          &gEfiCallerIdGuid,
+                          EFI_NATIVE_INTERFACE,
+                          Dev
+                          );
+  if (EFI_ERROR (Status)) {
+    goto CloseExitBoot;
+  }
+
+  return EFI_SUCCESS;
+
+CloseExitBoot:
+  gBS->CloseEvent (Dev->ExitBoot);
+
+CloseReadyToBoot:
+  gBS->CloseEvent (Dev->ReadyToBoot);
+
+UninitDev:
+  VirtioBalloonUninit (Dev);
+
+CloseVirtIo:
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+FreeVirtioBalloon:
+  FreePool (Dev);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioBalloonDriverBindingStop (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN UINTN                        NumberOfChildren,
+  IN EFI_HANDLE                   *ChildHandleBuffer
+  )
+{
+  EFI_STATUS          Status;
+  VIRTIO_BALLOON_DEV  *Dev;
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,                     // candidate device
+                  &gEfiCallerIdGuid,                // retrieve the instance
+                  (VOID **)&Dev,                    // target pointer
+                  This->DriverBindingHandle,        // requestor driver ident.
+                  DeviceHandle,                     // lookup req. for dev.
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL    // lookup only, no new ref.
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ASSERT (Dev->Signature == VIRTIO_BALLOON_SIG);
+
+  Status = gBS->UninstallProtocolInterface (
+                  DeviceHandle,
+                  &gEfiCallerIdGuid,
+                  Dev
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  gBS->CloseEvent (Dev->ExitBoot);
+  gBS->CloseEvent (Dev->ReadyToBoot);
+
+  if (Dev->MemoryMap != NULL) {
+    FreePool (Dev->MemoryMap);
+  }
+
+  VirtioBalloonUninit (Dev);
+
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+  FreePool (Dev);
+
+  return EFI_SUCCESS;
+}
+
+//
+// The static object that groups the Supported() (ie. probe), Start() and
+// Stop() functions of the driver together. Refer to UEFI Spec 2.3.1 + Errata
+// C, 10.1 EFI Driver Binding Protocol.
+//
+STATIC EFI_DRIVER_BINDING_PROTOCOL  gDriverBinding = {
+  &VirtioBalloonDriverBindingSupported,
+  &VirtioBalloonDriverBindingStart,
+  &VirtioBalloonDriverBindingStop,
+  0x10, // Version, must be in [0x10 .. 0xFFFFFFEF] for IHV-developed drivers
+  NULL, // ImageHandle, to be overwritten by
+        // EfiLibInstallDriverBindingComponentName2() in VirtioBalloonEntryPoint()
+  NULL  // DriverBindingHandle, ditto
+};
+
+//
+// The purpose of the following scaffolding (EFI_COMPONENT_NAME_PROTOCOL and
+// EFI_COMPONENT_NAME2_PROTOCOL implementation) is to format the driver's name
+// in English, for display on standard console devices. This is recommended for
+// UEFI drivers that follow the UEFI Driver Model. Refer to the Driver Writer's
+// Guide for UEFI 2.3.1 v1.01, 11 UEFI Driver and Controller Names.
+//
+
+STATIC
+EFI_UNICODE_STRING_TABLE  mDriverNameTable[] = {
+  { "eng;en", L"Virtio Memory Balloon Page Reporting Driver" },
+  { NULL,     NULL                                           }
+};
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName;
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioBalloonGetDriverName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **DriverName
+  )
+{
+  return LookupUnicodeString2 (
+           Language,
+           This->SupportedLanguages,
+           mDriverNameTable,
+           DriverName,
+           (BOOLEAN)(This == &gComponentName) // Iso639Language
+           );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioBalloonGetDeviceName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  EFI_HANDLE                   DeviceHandle,
+  IN  EFI_HANDLE                   ChildHandle,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **ControllerName
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName = {
+  &VirtioBalloonGetDriverName,
+  &VirtioBalloonGetDeviceName,
+  "eng" // SupportedLanguages, ISO 639-2 language codes
+};
+
+STATIC
+EFI_COMPONENT_NAME2_PROTOCOL  gComponentName2 = {
+  (EFI_COMPONENT_NAME2_GET_DRIVER_NAME)&VirtioBalloonGetDriverName,
+  (EFI_COMPONENT_NAME2_GET_CONTROLLER_NAME)&VirtioBalloonGetDeviceName,
+  "en" // SupportedLanguages, RFC 4646 language codes
+};
+
+//
+// Entry point of this driver.
+//
+EFI_STATUS
+EFIAPI
+VirtioBalloonEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  return EfiLibInstallDriverBindingComponentName2 (
+           ImageHandle,
+           SystemTable,
+           &gDriverBinding,
+           ImageHandle,
+           &gComponentName,
+           &gComponentName2
+           );
+}
@@ -0,0 +1,52 @@
+/** @file
+
+  Private definitions of the VirtioBalloon free page reporting driver
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VIRTIO_BALLOON_DXE_H_
+#define _VIRTIO_BALLOON_DXE_H_
+
+#include <Protocol/ComponentName.h>
+#include <Protocol/DriverBinding.h>
+
+#include <IndustryStandard/VirtioBalloon.h>
+
+#define VIRTIO_BALLOON_SIG  SIGNATURE_32 ('V', 'B', 'L', 'N')
+
+//
+// The number of memory descriptors that the memory map buffer has room for,
+// on top of those present at ReadyToBoot. The OS loader allocates and frees
+// memory between ReadyToBoot and ExitBootServices().
+//
+#define VIRTIO_BALLOON_MEMORY_MAP_SLACK  128
+
+//
+// The largest range that one page reporting descriptor carries.
+//
+#define VIRTIO_BALLOON_MAX_REPORT_SIZE  SIZE_1GB
+
+typedef struct {
+  //
+  // Parts of this structure are initialized / torn down in various functions
+  // at various call depths. The table to the right should make it easier to
+  // track them.
+  //
+  //                        field              init function       init depth
+  //                        ----------------   ------------------  ----------
+  UINT32                    Signature;      // DriverBindingStart   0
+  VIRTIO_DEVICE_PROTOCOL    *VirtIo;        // DriverBindingStart   0
+  EFI_EVENT                 ReadyToBoot;    // DriverBindingStart   0
+  EFI_EVENT                 ExitBoot;       // DriverBindingStart   0
+  UINT16                    ReportQueue;    // VirtioBalloonInit    1
+  VRING                     Ring;           // VirtioRingInit       2
+  VOID                      *RingMap;       // VirtioRingMap        2
+  EFI_MEMORY_DESCRIPTOR     *MemoryMap;     // ReadyToBoot event    0
+  UINTN                     MemoryMapSize;  // ReadyToBoot event    0
+} VIRTIO_BALLOON_DEV;
+
+#endif
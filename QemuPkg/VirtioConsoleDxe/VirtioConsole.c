@@ -0,0 +1,942 @@
+/** @file
+
+  This driver produces QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL instances for
+  virtio-console devices.
+
+  Only the transmit queue of port 0 is used. Log data is copied into slots of
+  a staging area that is allocated and mapped for the device once, at start;
+  each slot has a fixed descriptor. A slot is handed to the host with a single
+  notification when it fills up, or from a periodic timer, so that logging
+  costs a memory copy rather than one trapped I/O port access per byte.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/VirtioLib.h>
+
+#include "VirtioConsole.h"
+
+/**
+  Take back the slots that the host has finished transmitting.
+
+  @param[in,out] Dev  The driver instance.
+**/
+STATIC
+VOID
+VirtioConsoleReclaimTx (
+  IN OUT VIRTIO_CONSOLE_DEV  *Dev
+  )
+{
+  UINT16  UsedIdx;
+  UINT32  DescIdx;
+
+  //
+  // virtio-0.9.5, 2.4.2 Receiving Used Buffers From the Device
+  //
+  MemoryFence ();
+  UsedIdx = *Dev->Ring.Used.Idx;
+  MemoryFence ();
+
+  while (Dev->LastUsed != UsedIdx) {
+    DescIdx = Dev->Ring.Used.UsedElem[Dev->LastUsed++ % Dev->Ring.QueueSize].Id;
+    if (DescIdx < VIRTIO_CONSOLE_TX_SLOTS) {
+      Dev->TxBusy[DescIdx] = FALSE;
+      Dev->Stalled         = FALSE;
+    }
+  }
+}
+
+/**
+  Hand the current slot, if it holds any data, to the host, and move on to
+  the next slot.
+
+  The host is notified once per slot. The function does not wait for the host
+  to process the slot.
+
+  @param[in,out] Dev  The driver instance.
+**/
+STATIC
+VOID
+VirtioConsoleSubmitTx (
+  IN OUT VIRTIO_CONSOLE_DEV  *Dev
+  )
+{
+  UINT16  AvailIdx;
+
+  if (Dev->TxFill == 0) {
+    return;
+  }
+
+  Dev->Ring.Desc[Dev->TxSlot].Len = Dev->TxFill;
+
+  //
+  // virtio-0.9.5, 2.4.1.2 Updating the Available Ring
+  //
+  AvailIdx                                               = *Dev->Ring.Avail.Idx;
+  Dev->Ring.Avail.Ring[AvailIdx++ % Dev->Ring.QueueSize] = Dev->TxSlot;
+
+  //
+  // virtio-0.9.5, 2.4.1.3 Updating the Index Field
+  //
+  MemoryFence ();
+  *Dev->Ring.Avail.Idx = AvailIdx;
+
+  //
+  // virtio-0.9.5, 2.4.1.4 Notifying the Device
+  //
+  MemoryFence ();
+  Dev->VirtIo->SetQueueNotify (Dev->VirtIo, VIRTIO_CONSOLE_TRANSMIT_QUEUE);
+
+  Dev->TxBusy[Dev->TxSlot] = TRUE;
+  Dev->Kicks++;
+  Dev->TxSlot = (Dev->TxSlot + 1) % VIRTIO_CONSOLE_TX_SLOTS;
+  Dev->TxFill = 0;
+}
+
+/**
+  Wait, for a bounded time, until the host returns a transmit slot.
+
+  Once a wait has timed out, the sink is considered stalled, and further calls
+  do not wait until the host returns a slot again.
+
+  @param[in,out] Dev   The driver instance.
+  @param[in]     Slot  The slot to wait for.
+
+  @retval TRUE   The slot is free.
+  @retval FALSE  The host still owns the slot.
+**/
+STATIC
+BOOLEAN
+VirtioConsoleWaitTx (
+  IN OUT VIRTIO_CONSOLE_DEV  *Dev,
+  IN     UINT16              Slot
+  )
+{
+  UINTN  Waited;
+
+  VirtioConsoleReclaimTx (Dev);
+  if (!Dev->TxBusy[Slot]) {
+    return TRUE;
+  }
+
+  if (Dev->Stalled) {
+    return FALSE;
+  }
+
+  for (Waited = 0; Waited < VIRTIO_CONSOLE_TX_TIMEOUT; Waited += 10) {
+    gBS->Stall (10);
+    VirtioConsoleReclaimTx (Dev);
+    if (!Dev->TxBusy[Slot]) {
+      return TRUE;
+    }
+  }
+
+  Dev->Stalled = TRUE;
+  return FALSE;
+}
+
+/**
+  Queue log data for the host.
+
+  @param[in] This           The protocol instance.
+  @param[in] Buffer         The data to queue.
+  @param[in] NumberOfBytes  The number of bytes in Buffer.
+
+  @return  The number of bytes queued.
+**/
+STATIC
+UINTN
+EFIAPI
+VirtioConsoleWrite (
+  IN QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL  *This,
+  IN CONST UINT8                       *Buffer,
+  IN UINTN                             NumberOfBytes
+  )
+{
+  VIRTIO_CONSOLE_DEV  *Dev;
+  EFI_TPL             OldTpl;
+  UINTN               Done;
+  UINTN               Chunk;
+
+  if ((Buffer == NULL) || (NumberOfBytes == 0)) {
+    return 0;
+  }
+
+  Dev = VIRTIO_CONSOLE_FROM_LOG (This);
+
+  //
+  // Log output may be produced at any TPL, including from timer handlers that
+  // interrupt a write in progress.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  if (!Dev->Active) {
+    gBS->RestoreTPL (OldTpl);
+    return 0;
+  }
+
+  Done = 0;
+  while (Done < NumberOfBytes) {
+    if ((Dev->TxFill == 0) && !VirtioConsoleWaitTx (Dev, Dev->TxSlot)) {
+      break;
+    }
+
+    Chunk = MIN (NumberOfBytes - Done, VIRTIO_CONSOLE_TX_SLOT_SIZE - Dev->TxFill);
+    CopyMem (
+      Dev->TxBuffer + Dev->TxSlot * VIRTIO_CONSOLE_TX_SLOT_SIZE + Dev->TxFill,
+      Buffer + Done,
+      Chunk
+      );
+    Dev->TxFill += (UINT32)Chunk;
+    Done        += Chunk;
+
+    if (Dev->TxFill == VIRTIO_CONSOLE_TX_SLOT_SIZE) {
+      VirtioConsoleSubmitTx (Dev);
+    }
+  }
+
+  Dev->BytesWritten += Done;
+  Dev->BytesDropped += NumberOfBytes - Done;
+  gBS->RestoreTPL (OldTpl);
+
+  return Done;
+}
+
+/**
+  Hand all queued log data to the host.
+
+  @param[in] This  The protocol instance.
+**/
+STATIC
+VOID
+EFIAPI
+VirtioConsoleFlush (
+  IN QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL  *This
+  )
+{
+  VIRTIO_CONSOLE_DEV  *Dev;
+  EFI_TPL             OldTpl;
+
+  Dev    = VIRTIO_CONSOLE_FROM_LOG (This);
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  if (Dev->Active) {
+    VirtioConsoleSubmitTx (Dev);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioConsoleInit (
+  IN OUT VIRTIO_CONSOLE_DEV  *Dev
+  )
+{
+  UINT8       NextDevStat;
+  EFI_STATUS  Status;
+  UINT16      QueueSize;
+  UINT16      Index;
+  UINT64      Features;
+  UINT64      RingBaseShift;
+  VOID        *TxBuffer;
+
+  //
+  // Execute virtio-0.9.5, 2.2.1 Device Initialization Sequence.
+  //
+  NextDevStat = 0;             // step 1 -- reset device
+  Status      = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_ACK;    // step 2 -- acknowledge device presence
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_DRIVER; // step 3 -- we know how to drive it
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // Set Page Size - MMIO VirtIo Specific
+  //
+  Status = Dev->VirtIo->SetPageSize (Dev->VirtIo, EFI_PAGE_SIZE);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 4a -- retrieve and validate features. None of the device-specific
+  // features is needed: without MULTIPORT, the host connects port 0 as soon
+  // as the driver is ready.
+  //
+  Status = Dev->VirtIo->GetDeviceFeatures (Dev->VirtIo, &Features);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Features &= VIRTIO_F_VERSION_1 | VIRTIO_F_IOMMU_PLATFORM;
+
+  //
+  // In virtio-1.0, feature negotiation is expected to complete before queue
+  // discovery, and the device can also reject the selected set of features.
+  //
+  if (Dev->VirtIo->Revision >= VIRTIO_SPEC_REVISION (1, 0, 0)) {
+    Status = Virtio10WriteFeatures (Dev->VirtIo, Features, &NextDevStat);
+    if (EFI_ERROR (Status)) {
+      goto Failed;
+    }
+  }
+
+  //
+  // step 4b -- allocate the transmit queue of port 0. The receive queue is
+  // left unconfigured; nothing is read from the host.
+  //
+  Status = Dev->VirtIo->SetQueueSel (Dev->VirtIo, VIRTIO_CONSOLE_TRANSMIT_QUEUE);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = Dev->VirtIo->GetQueueNumMax (Dev->VirtIo, &QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // Every slot of the staging area has its own descriptor.
+  //
+  if (QueueSize < VIRTIO_CONSOLE_TX_SLOTS) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  Status = VirtioRingInit (Dev->VirtIo, QueueSize, &Dev->Ring);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // If anything fails from here on, we must release the ring resources.
+  //
+  Status = VirtioRingMap (
+             Dev->VirtIo,
+             &Dev->Ring,
+             &RingBaseShift,
+             &Dev->RingMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto ReleaseQueue;
+  }
+
+  //
+  // Additional steps for MMIO: align the queue appropriately, and set the
+  // size. If anything fails from here on, we must unmap the ring resources.
+  //
+  Status = Dev->VirtIo->SetQueueNum (Dev->VirtIo, QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = Dev->VirtIo->SetQueueAlign (Dev->VirtIo, EFI_PAGE_SIZE);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  //
+  // step 4c -- Report GPFN (guest-physical frame number) of queue.
+  //
+  Status = Dev->VirtIo->SetQueueAddress (
+                          Dev->VirtIo,
+                          &Dev->Ring,
+                          RingBaseShift
+                          );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  //
+  // Allocate and map the staging area once; its slots are recycled in place.
+  //
+  Status = Dev->VirtIo->AllocateSharedPages (
+                          Dev->VirtIo,
+                          EFI_SIZE_TO_PAGES (VIRTIO_CONSOLE_TX_SLOTS * VIRTIO_CONSOLE_TX_SLOT_SIZE),
+                          &TxBuffer
+                          );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VirtioMapAllBytesInSharedBuffer (
+             Dev->VirtIo,
+             VirtioOperationBusMasterCommonBuffer,
+             TxBuffer,
+             VIRTIO_CONSOLE_TX_SLOTS * VIRTIO_CONSOLE_TX_SLOT_SIZE,
+             &Dev->TxAddress,
+             &Dev->TxMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto FreeTxBuffer;
+  }
+
+  Dev->TxBuffer = TxBuffer;
+
+  //
+  // step 5 -- Report understood features and guest-tuneables.
+  //
+  if (Dev->VirtIo->Revision < VIRTIO_SPEC_REVISION (1, 0, 0)) {
+    Features &= ~(UINT64)(VIRTIO_F_VERSION_1 | VIRTIO_F_IOMMU_PLATFORM);
+    Status    = Dev->VirtIo->SetGuestFeatures (Dev->VirtIo, Features);
+    if (EFI_ERROR (Status)) {
+      goto UnmapTxBuffer;
+    }
+  }
+
+  //
+  // step 6 -- initialization complete
+  //
+  NextDevStat |= VSTAT_DRIVER_OK;
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto UnmapTxBuffer;
+  }
+
+  //
+  // virtio-0.9.5, 2.4.2 Receiving Used Buffers From the Device: the host
+  // should not send interrupts, returned slots are polled for.
+  //
+  *Dev->Ring.Avail.Flags = (UINT16)VRING_AVAIL_F_NO_INTERRUPT;
+
+  //
+  // Tie each slot to a device-readable descriptor of its own; only the
+  // length changes from one submission to the next.
+  //
+  for (Index = 0; Index < VIRTIO_CONSOLE_TX_SLOTS; Index++) {
+    Dev->Ring.Desc[Index].Addr  = Dev->TxAddress +
+                                  Index * VIRTIO_CONSOLE_TX_SLOT_SIZE;
+    Dev->Ring.Desc[Index].Len   = 0;
+    Dev->Ring.Desc[Index].Flags = 0;
+    Dev->TxBusy[Index]          = FALSE;
+  }
+
+  MemoryFence ();
+  Dev->LastUsed = *Dev->Ring.Used.Idx;
+  Dev->TxSlot   = 0;
+  Dev->TxFill   = 0;
+  Dev->Stalled  = FALSE;
+
+  //
+  // populate the exported interface's attributes
+  //
+  Dev->Log.Write = VirtioConsoleWrite;
+  Dev->Log.Flush = VirtioConsoleFlush;
+  Dev->Active    = TRUE;
+
+  return EFI_SUCCESS;
+
+UnmapTxBuffer:
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->TxMap);
+  Dev->TxBuffer = NULL;
+
+FreeTxBuffer:
+  Dev->VirtIo->FreeSharedPages (
+                 Dev->VirtIo,
+                 EFI_SIZE_TO_PAGES (VIRTIO_CONSOLE_TX_SLOTS * VIRTIO_CONSOLE_TX_SLOT_SIZE),
+                 TxBuffer
+                 );
+
+UnmapQueue:
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->RingMap);
+
+ReleaseQueue:
+  VirtioRingUninit (Dev->VirtIo, &Dev->Ring);
+
+Failed:
+  //
+  // Notify the host about our failure to setup: virtio-0.9.5, 2.2.2.1 Device
+  // Status. VirtIo access failure here should not mask the original error.
+  //
+  NextDevStat |= VSTAT_FAILED;
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+
+  return Status; // reached only via Failed above
+}
+
+/**
+  Hand the remaining log data to the host, and wait, for a bounded time, until
+  the host has consumed all of it. The sink accepts no more data afterwards.
+
+  @param[in,out] Dev  The driver instance.
+**/
+STATIC
+VOID
+VirtioConsoleShutdown (
+  IN OUT VIRTIO_CONSOLE_DEV  *Dev
+  )
+{
+  EFI_TPL  OldTpl;
+  UINT16   Index;
+
+  if (!Dev->Active) {
+    return;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: %Lu bytes in %Lu notifications, %Lu bytes dropped\n",
+    __func__,
+    Dev->BytesWritten,
+    Dev->Kicks,
+    Dev->BytesDropped
+    ));
+
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  VirtioConsoleSubmitTx (Dev);
+  for (Index = 0; Index < VIRTIO_CONSOLE_TX_SLOTS; Index++) {
+    VirtioConsoleWaitTx (Dev, Index);
+  }
+
+  Dev->Active = FALSE;
+  gBS->RestoreTPL (OldTpl);
+}
+
+STATIC
+VOID
+EFIAPI
+VirtioConsoleUninit (
+  IN OUT VIRTIO_CONSOLE_DEV  *Dev
+  )
+{
+  VirtioConsoleShutdown (Dev);
+
+  //
+  // Reset the virtual device -- see virtio-0.9.5, 2.2.2.1 Device Status. When
+  // VIRTIO_CFG_WRITE() returns, the host will have learned to stay away from
+  // the old comms area.
+  //
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->TxMap);
+  Dev->VirtIo->FreeSharedPages (
+                 Dev->VirtIo,
+                 EFI_SIZE_TO_PAGES (VIRTIO_CONSOLE_TX_SLOTS * VIRTIO_CONSOLE_TX_SLOT_SIZE),
+                 Dev->TxBuffer
+                 );
+  Dev->TxBuffer = NULL;
+
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->RingMap);
+  VirtioRingUninit (Dev->VirtIo, &Dev->Ring);
+}
+
+//
+// Timer notification function that hands partially filled slots to the host.
+//
+
+STATIC
+VOID
+EFIAPI
+VirtioConsoleFlushTimer (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  )
+{
+  VIRTIO_CONSOLE_DEV  *Dev;
+
+  Dev = Context;
+  VirtioConsoleFlush (&Dev->Log);
+}
+
+//
+// Event notification function enqueued by ExitBootServices().
+//
+
+STATIC
+VOID
+EFIAPI
+VirtioConsoleExitBoot (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  )
+{
+  VIRTIO_CONSOLE_DEV  *Dev;
+
+  //
+  // Drain the staging area, then reset the device. This causes the
+  // hypervisor to forget about the virtio ring.
+  //
+  // We allocated said ring in EfiBootServicesData type memory, and code
+  // executing after ExitBootServices() is permitted to overwrite it.
+  //
+  Dev = Context;
+  VirtioConsoleShutdown (Dev);
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+}
+
+//
+// Probe, start and stop functions of this driver, called by the DXE core for
+// specific devices.
+//
+// The following specifications document these interfaces:
+// - Driver Writer's Guide for UEFI 2.3.1 v1.01, 9 Driver Binding Protocol
+// - UEFI Spec 2.3.1 + Errata C, 10.1 EFI Driver Binding Protocol
+//
+// The implementation follows:
+// - Driver Writer's Guide for UEFI 2.3.1 v1.01
+//   - 5.1.3.4 OpenProtocol() and CloseProtocol()
+// - UEFI Spec 2.3.1 + Errata C
+//   -  6.3 Protocol Handler Services
+//
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioConsoleDriverBindingSupported (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  EFI_STATUS              Status;
+  VIRTIO_DEVICE_PROTOCOL  *VirtIo;
+
+  //
+  // Attempt to open the device with the VirtIo set of interfaces. On success,
+  // the protocol is "instantiated" for the VirtIo device. Covers duplicate
+  // open attempts (EFI_ALREADY_STARTED).
+  //
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,               // candidate device
+                  &gVirtioDeviceProtocolGuid, // for generic VirtIo access
+                  (VOID **)&VirtIo,           // handle to instantiate
+                  This->DriverBindingHandle,  // requestor driver identity
+                  DeviceHandle,               // ControllerHandle, according to
+                                              // the UEFI Driver Model
+                  EFI_OPEN_PROTOCOL_BY_DRIVER // get exclusive VirtIo access to
+                                              // the device; to be released
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (VirtIo->SubSystemDeviceId != VIRTIO_SUBSYSTEM_CONSOLE) {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  //
+  // We needed VirtIo access only transitorily, to see whether we support the
+  // device or not.
+  //
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioConsoleDriverBindingStart (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  VIRTIO_CONSOLE_DEV  *Dev;
+  EFI_STATUS          Status;
+
+  Dev = (VIRTIO_CONSOLE_DEV *)AllocateZeroPool (sizeof *Dev);
+  if (Dev == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  (VOID **)&Dev->VirtIo,
+                  This->DriverBindingHandle,
+                  DeviceHandle,
+                  EFI_OPEN_PROTOCOL_BY_DRIVER
+                  );
+  if (EFI_ERROR (Status)) {
+    goto FreeVirtioConsole;
+  }
+
+  //
+  // VirtIo access granted, configure virtio-console device.
+  //
+  Dev->Signature = VIRTIO_CONSOLE_SIG;
+  Status         = VirtioConsoleInit (Dev);
+  if (EFI_ERROR (Status)) {
+    goto CloseVirtIo;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                  TPL_CALLBACK,
+                  &VirtioConsoleExitBoot,
+                  Dev,
+                  &Dev->ExitBoot
+                  );
+  if (EFI_ERROR (Status)) {
+    goto UninitDev;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  &VirtioConsoleFlushTimer,
+                  Dev,
+                  &Dev->FlushTimer
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseExitBoot;
+  }
+
+  Status = gBS->SetTimer (
+                  Dev->FlushTimer,
+                  TimerPeriodic,
+                  VIRTIO_CONSOLE_FLUSH_PERIOD
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseFlushTimer;
+  }
+
+  //
+  // Setup complete, attempt to export the driver instance's log sink
+  // interface.
+  //
+  Status = gBS->InstallProtocolInterface (
+                  &DeviceHandle,
+                  &gQemuVirtioConsoleLogProtocolGuid,
+                  EFI_NATIVE_INTERFACE,
+                  &Dev->Log
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseFlushTimer;
+  }
+
+  //
+  // Also publish the interface as a configuration table. Logging code in the
+  // DXE core runs with arbitrary locks held and at arbitrary TPLs, where it
+  // cannot look up protocols; it finds the sink by scanning the table instead.
+  //
+  Status = gBS->InstallConfigurationTable (
+                  &gQemuVirtioConsoleLogProtocolGuid,
+                  &Dev->Log
+                  );
+  if (EFI_ERROR (Status)) {
+    goto UninstallLog;
+  }
+
+  return EFI_SUCCESS;
+
+UninstallLog:
+  gBS->UninstallProtocolInterface (
+         DeviceHandle,
+         &gQemuVirtioConsoleLogProtocolGuid,
+         &Dev->Log
+         );
+
+CloseFlushTimer:
+  gBS->CloseEvent (Dev->FlushTimer);
+
+CloseExitBoot:
+  gBS->CloseEvent (Dev->ExitBoot);
+
+UninitDev:
+  VirtioConsoleUninit (Dev);
+
+CloseVirtIo:
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+FreeVirtioConsole:
+  FreePool (Dev);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioConsoleDriverBindingStop (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN UINTN                        NumberOfChildren,
+  IN EFI_HANDLE                   *ChildHandleBuffer
+  )
+{
+  EFI_STATUS                        Status;
+  QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL  *Log;
+  VIRTIO_CONSOLE_DEV                *Dev;
+  VOID                              *Table;
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,                       // candidate device
+                  &gQemuVirtioConsoleLogProtocolGuid, // retrieve the log iface
+                  (VOID **)&Log,                      // target pointer
+                  This->DriverBindingHandle,          // requestor driver ident.
+                  DeviceHandle,                       // lookup req. for dev.
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL      // lookup only, no new ref.
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Dev = VIRTIO_CONSOLE_FROM_LOG (Log);
+
+  //
+  // Handle Stop() requests for in-use driver instances gracefully.
+  //
+  Status = gBS->UninstallProtocolInterface (
+                  DeviceHandle,
+                  &gQemuVirtioConsoleLogProtocolGuid,
+                  &Dev->Log
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Withdraw the configuration table, unless another device has replaced it
+  // in the meantime.
+  //
+  if (!EFI_ERROR (EfiGetSystemConfigurationTable (&gQemuVirtioConsoleLogProtocolGuid, &Table)) &&
+      (Table == &Dev->Log))
+  {
+    gBS->InstallConfigurationTable (&gQemuVirtioConsoleLogProtocolGuid, NULL);
+  }
+
+  gBS->CloseEvent (Dev->FlushTimer);
+  gBS->CloseEvent (Dev->ExitBoot);
+
+  VirtioConsoleUninit (Dev);
+
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+  FreePool (Dev);
+
+  return EFI_SUCCESS;
+}
+
+//
+// The static object that groups the Supported() (ie. probe), Start() and
+// Stop() functions of the driver together. Refer to UEFI Spec 2.3.1 + Errata
+// C, 10.1 EFI Driver Binding Protocol.
+//
+STATIC EFI_DRIVER_BINDING_PROTOCOL  gDriverBinding = {
+  &VirtioConsoleDriverBindingSupported,
+  &VirtioConsoleDriverBindingStart,
+  &VirtioConsoleDriverBindingStop,
+  0x10, // Version, must be in [0x10 .. 0xFFFFFFEF] for IHV-developed drivers
+  NULL, // ImageHandle, to be overwritten by
+        // EfiLibInstallDriverBindingComponentName2() in VirtioConsoleEntryPoint()
+  NULL  // DriverBindingHandle, ditto
+};
+
+//
+// The purpose of the following scaffolding (EFI_COMPONENT_NAME_PROTOCOL and
+// EFI_COMPONENT_NAME2_PROTOCOL implementation) is to format the driver's name
+// in English, for display on standard console devices. This is recommended for
+// UEFI drivers that follow the UEFI Driver Model. Refer to the Driver Writer's
+// Guide for UEFI 2.3.1 v1.01, 11 UEFI Driver and Controller Names.
+//
+
+STATIC
+EFI_UNICODE_STRING_TABLE  mDriverNameTable[] = {
+  { "eng;en", L"Virtio Console Log Driver" },
+  { NULL,     NULL                         }
+};
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName;
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioConsoleGetDriverName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **DriverName
+  )
+{
+  return LookupUnicodeString2 (
+           Language,
+           This->SupportedLanguages,
+           mDriverNameTable,
+           DriverName,
+           (BOOLEAN)(This == &gComponentName) // Iso639Language
+           );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioConsoleGetDeviceName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  EFI_HANDLE                   DeviceHandle,
+  IN  EFI_HANDLE                   ChildHandle,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **ControllerName
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName = {
+  &VirtioConsoleGetDriverName,
+  &VirtioConsoleGetDeviceName,
+  "eng" // SupportedLanguages, ISO 639-2 language codes
+};
+
+STATIC
+EFI_COMPONENT_NAME2_PROTOCOL  gComponentName2 = {
+  (EFI_COMPONENT_NAME2_GET_DRIVER_NAME)&VirtioConsoleGetDriverName,
+  (EFI_COMPONENT_NAME2_GET_CONTROLLER_NAME)&VirtioConsoleGetDeviceName,
+  "en" // SupportedLanguages, RFC 4646 language codes
+};
+
+//
+// Entry point of this driver.
+//
+EFI_STATUS
+EFIAPI
+VirtioConsoleEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  return EfiLibInstallDriverBindingComponentName2 (
+           ImageHandle,
+           SystemTable,
+           &gDriverBinding,
+           ImageHandle,
+           &gComponentName,
+           &gComponentName2
+           );
+}
@@ -0,0 +1,76 @@
+/** @file
+
+  Private definitions of the VirtioConsole log sink driver
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VIRTIO_CONSOLE_DXE_H_
+#define _VIRTIO_CONSOLE_DXE_H_
+
+#include <Protocol/ComponentName.h>
+#include <Protocol/DriverBinding.h>
+#include <Protocol/VirtioConsoleLog.h>
+
+#include <IndustryStandard/VirtioConsole.h>
+
+#define VIRTIO_CONSOLE_SIG  SIGNATURE_32 ('V', 'C', 'O', 'N')
+
+//
+// The transmit staging area is split into slots of equal size. Each slot is
+// described by one descriptor that stays in place; filling a slot and handing
+// it to the host costs one notification. While the host drains one slot, the
+// next one is filled.
+//
+#define VIRTIO_CONSOLE_TX_SLOTS      4
+#define VIRTIO_CONSOLE_TX_SLOT_SIZE  SIZE_16KB
+
+//
+// Partially filled slots are handed to the host from a timer at this period,
+// in 100ns units, so that the log stays current while little is written.
+//
+#define VIRTIO_CONSOLE_FLUSH_PERIOD  EFI_TIMER_PERIOD_MILLISECONDS (100)
+
+//
+// Upper bound, in microseconds, on waiting for the host to return a slot.
+// The host reading end may be gone; the sink then drops data instead of
+// stalling the boot.
+//
+#define VIRTIO_CONSOLE_TX_TIMEOUT  1000000
+
+typedef struct {
+  //
+  // Parts of this structure are initialized / torn down in various functions
+  // at various call depths. The table to the right should make it easier to
+  // track them.
+  //
+  //                                  field              init function        init depth
+  //                                  -----------------  -------------------  ----------
+  UINT32                              Signature;      // DriverBindingStart   0
+  VIRTIO_DEVICE_PROTOCOL              *VirtIo;        // DriverBindingStart   0
+  EFI_EVENT                           ExitBoot;       // DriverBindingStart   0
+  EFI_EVENT                           FlushTimer;     // DriverBindingStart   0
+  VRING                               Ring;           // VirtioRingInit       2
+  VOID                                *RingMap;       // VirtioRingMap        2
+  UINT8                               *TxBuffer;      // VirtioConsoleInit    1
+  EFI_PHYSICAL_ADDRESS                TxAddress;      // VirtioConsoleInit    1
+  VOID                                *TxMap;         // VirtioConsoleInit    1
+  UINT16                              TxSlot;         // VirtioConsoleInit    1
+  UINT32                              TxFill;         // VirtioConsoleInit    1
+  BOOLEAN                             TxBusy[VIRTIO_CONSOLE_TX_SLOTS]; // VirtioConsoleInit 1
+  UINT16                              LastUsed;       // VirtioConsoleInit    1
+  BOOLEAN                             Active;         // VirtioConsoleInit    1
+  BOOLEAN                             Stalled;        // VirtioConsoleInit    1
+  UINT64                              BytesWritten;   // VirtioConsoleInit    1
+  UINT64                              BytesDropped;   // VirtioConsoleInit    1
+  UINT64                              Kicks;          // VirtioConsoleInit    1
+  QEMU_VIRTIO_CONSOLE_LOG_PROTOCOL    Log;            // VirtioConsoleInit    1
+} VIRTIO_CONSOLE_DEV;
+
+#define VIRTIO_CONSOLE_FROM_LOG(LogPointer) \
+          CR (LogPointer, VIRTIO_CONSOLE_DEV, Log, VIRTIO_CONSOLE_SIG)
+
+#endif
@@ -0,0 +1,965 @@
+/** @file
+  Wrapper functions for the FUSE commands (primitives) that the Virtio
+  Filesystem driver sends to the device.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/BaseLib.h>        // AsciiStrSize()
+#include <Library/BaseMemoryLib.h>  // CopyMem()
+#include <Library/VirtioLib.h>      // VirtioMapAllBytesInSharedBuffer()
+
+#include "VirtioFsDxe.h"
+
+//
+// The number of VIRTIO_FS_FUSE_FORGET_ONE elements that fit in a single
+// VirtioFsFuseOpBatchForget request.
+//
+#define VIRTIO_FS_FORGET_BATCH_SIZE                                        \
+  ((VIRTIO_FS_REQUEST_BUFFER_SIZE - sizeof (VIRTIO_FS_FUSE_REQUEST) -      \
+    sizeof (VIRTIO_FS_FUSE_BATCH_FORGET_REQUEST)) /                        \
+   sizeof (VIRTIO_FS_FUSE_FORGET_ONE))
+
+/**
+  Submit a single request from slot #0, and translate the outcome to an
+  EFI_STATUS code.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in,out] Request   The request descriptor, set up with
+                           VirtioFsPrepareRequest() for slot #0.
+
+  @retval EFI_SUCCESS  The device processed the request successfully.
+
+  @return              Error codes from VirtioFsSubmitRequests(), or the
+                       EFI_STATUS equivalent of the errno value reported by
+                       the device.
+**/
+STATIC
+EFI_STATUS
+VirtioFsSubmitOne (
+  IN OUT VIRTIO_FS          *VirtioFs,
+  IN OUT VIRTIO_FS_REQUEST  *Request
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = VirtioFsSubmitRequests (VirtioFs, Request, 1);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Request->Errno != 0) {
+    return VirtioFsErrnoToEfiStatus (Request->Errno);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Set up a request whose body is (or ends with) a NUL-terminated name.
+
+  @param[in,out] VirtioFs      The Virtio Filesystem device.
+
+  @param[in] Opcode            The FUSE opcode to send.
+
+  @param[in] NodeId            The inode number of the parent directory.
+
+  @param[in] FixedBodySize     The number of bytes in the request body that
+                               precede the name.
+
+  @param[in] Name              The NUL-terminated name to append.
+
+  @param[in] ResponseBodySize  See VirtioFsPrepareRequest().
+
+  @param[out] Request          See VirtioFsPrepareRequest().
+
+  @return  Pointer to the zeroed-out fixed part of the request body.
+**/
+STATIC
+VOID *
+VirtioFsPrepareNamedRequest (
+  IN OUT VIRTIO_FS              *VirtioFs,
+  IN     VIRTIO_FS_FUSE_OPCODE  Opcode,
+  IN     UINT64                 NodeId,
+  IN     UINT32                 FixedBodySize,
+  IN     CHAR8                  *Name,
+  IN     UINT32                 ResponseBodySize,
+  OUT    VIRTIO_FS_REQUEST      *Request
+  )
+{
+  UINT32  NameSize;
+  UINT8   *Body;
+
+  NameSize = (UINT32)AsciiStrSize (Name);
+  Body     = VirtioFsPrepareRequest (
+               VirtioFs,
+               0,
+               Opcode,
+               NodeId,
+               FixedBodySize + NameSize,
+               ResponseBodySize,
+               Request
+               );
+  CopyMem (Body + FixedBodySize, Name, NameSize);
+  return Body;
+}
+
+/**
+  Negotiate the FUSE session with the device, with VirtioFsFuseOpInit.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device. On success,
+                           VirtioFs->MaxTransfer is set.
+
+  @retval EFI_SUCCESS      The session has been established.
+
+  @retval EFI_UNSUPPORTED  The device speaks an incompatible FUSE version, or
+                           cannot transfer useful amounts of data at once.
+
+  @return                  Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseInitSession (
+  IN OUT VIRTIO_FS  *VirtioFs
+  )
+{
+  VIRTIO_FS_REQUEST             Request;
+  VIRTIO_FS_FUSE_INIT_REQUEST   *InitReq;
+  VIRTIO_FS_FUSE_INIT_RESPONSE  *InitResp;
+  EFI_STATUS                    Status;
+
+  //
+  // The unique request identifiers start at 1.
+  //
+  VirtioFs->RequestId = 1;
+
+  InitReq = VirtioFsPrepareRequest (
+              VirtioFs,
+              0,
+              VirtioFsFuseOpInit,
+              0,
+              sizeof *InitReq,
+              sizeof *InitResp,
+              &Request
+              );
+  InitReq->Major        = VIRTIO_FS_FUSE_MAJOR;
+  InitReq->Minor        = VIRTIO_FS_FUSE_MINOR;
+  InitReq->MaxReadahead = 0;
+  InitReq->Flags        = 0;
+
+  Status = VirtioFsSubmitOne (VirtioFs, &Request);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  InitResp = VirtioFsResponseBody (VirtioFs, 0);
+  if ((InitResp->Major != VIRTIO_FS_FUSE_MAJOR) ||
+      (InitResp->MaxWrite < VIRTIO_FS_MIN_TRANSFER))
+  {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: Label=\"%s\" Major=%u Minor=%u MaxWrite=%u unsupported\n",
+      __FUNCTION__,
+      VirtioFs->Label,
+      InitResp->Major,
+      InitResp->Minor,
+      InitResp->MaxWrite
+      ));
+    return EFI_UNSUPPORTED;
+  }
+
+  VirtioFs->MaxTransfer = MIN (InitResp->MaxWrite, VIRTIO_FS_MAX_TRANSFER);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: Label=\"%s\" FUSE %u.%u MaxTransfer=%u MaxPipeline=%u\n",
+    __FUNCTION__,
+    VirtioFs->Label,
+    InitResp->Major,
+    InitResp->Minor,
+    VirtioFs->MaxTransfer,
+    VirtioFs->MaxPipeline
+    ));
+  return EFI_SUCCESS;
+}
+
+/**
+  Look up a name in a directory, with VirtioFsFuseOpLookup.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] DirNodeId     The inode number of the directory to search.
+
+  @param[in] Name          The NUL-terminated name to look up.
+
+  @param[out] NodeId       The inode number of the file found. The caller is
+                           responsible for forgetting it with
+                           VirtioFsFuseForget().
+
+  @param[out] FuseAttr     The attributes of the file found.
+
+  @retval EFI_SUCCESS  The file has been found.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseLookup (
+  IN OUT VIRTIO_FS                           *VirtioFs,
+  IN     UINT64                              DirNodeId,
+  IN     CHAR8                               *Name,
+  OUT    UINT64                              *NodeId,
+  OUT    VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  *FuseAttr
+  )
+{
+  VIRTIO_FS_REQUEST              Request;
+  VIRTIO_FS_FUSE_ENTRY_RESPONSE  *EntryResp;
+  EFI_STATUS                     Status;
+
+  VirtioFsPrepareNamedRequest (
+    VirtioFs,
+    VirtioFsFuseOpLookup,
+    DirNodeId,
+    0,
+    Name,
+    sizeof *EntryResp,
+    &Request
+    );
+
+  Status = VirtioFsSubmitOne (VirtioFs, &Request);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  EntryResp = VirtioFsResponseBody (VirtioFs, 0);
+  *NodeId   = EntryResp->Node.NodeId;
+  CopyMem (FuseAttr, &EntryResp->Attr, sizeof *FuseAttr);
+  return EFI_SUCCESS;
+}
+
+/**
+  Drop one lookup reference from each of a set of inodes, with
+  VirtioFsFuseOpBatchForget. Up to VirtioFs->MaxPipeline batches are sent
+  with a single notification.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeIds       The inode numbers to forget.
+
+  @param[in] NodeIdCount   The number of elements in NodeIds.
+
+  @retval EFI_SUCCESS  The requests have been sent.
+
+  @return              Error codes from VirtioFsSubmitRequests().
+**/
+EFI_STATUS
+VirtioFsFuseForget (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     *NodeIds,
+  IN     UINTN      NodeIdCount
+  )
+{
+  VIRTIO_FS_REQUEST                    Requests[VIRTIO_FS_MAX_PIPELINE];
+  VIRTIO_FS_FUSE_BATCH_FORGET_REQUEST  *ForgetReq;
+  VIRTIO_FS_FUSE_FORGET_ONE            *ForgetOne;
+  UINT16                               Slot;
+  UINTN                                Batch;
+  UINTN                                Idx;
+  EFI_STATUS                           Status;
+
+  while (NodeIdCount > 0) {
+    for (Slot = 0; Slot < VirtioFs->MaxPipeline && NodeIdCount > 0; Slot++) {
+      Batch     = MIN (NodeIdCount, VIRTIO_FS_FORGET_BATCH_SIZE);
+      ForgetReq = VirtioFsPrepareRequest (
+                    VirtioFs,
+                    Slot,
+                    VirtioFsFuseOpBatchForget,
+                    0,
+                    (UINT32)(sizeof *ForgetReq + Batch * sizeof *ForgetOne),
+                    0,
+                    &Requests[Slot]
+                    );
+      ForgetReq->Count = (UINT32)Batch;
+      ForgetOne        = (VIRTIO_FS_FUSE_FORGET_ONE *)(ForgetReq + 1);
+      for (Idx = 0; Idx < Batch; Idx++) {
+        ForgetOne[Idx].NodeId          = NodeIds[Idx];
+        ForgetOne[Idx].NumberOfLookups = 1;
+      }
+
+      NodeIds     += Batch;
+      NodeIdCount -= Batch;
+    }
+
+    Status = VirtioFsSubmitRequests (VirtioFs, Requests, Slot);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Fetch the attributes of an inode, with VirtioFsFuseOpGetAttr.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeId        The inode number to query.
+
+  @param[out] FuseAttr     The attributes of the inode.
+
+  @retval EFI_SUCCESS  FuseAttr has been filled in.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseGetAttr (
+  IN OUT VIRTIO_FS                           *VirtioFs,
+  IN     UINT64                              NodeId,
+  OUT    VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  *FuseAttr
+  )
+{
+  VIRTIO_FS_REQUEST                Request;
+  VIRTIO_FS_FUSE_GETATTR_RESPONSE  *GetAttrResp;
+  EFI_STATUS                       Status;
+
+  VirtioFsPrepareRequest (
+    VirtioFs,
+    0,
+    VirtioFsFuseOpGetAttr,
+    NodeId,
+    sizeof (VIRTIO_FS_FUSE_GETATTR_REQUEST),
+    sizeof *GetAttrResp,
+    &Request
+    );
+
+  Status = VirtioFsSubmitOne (VirtioFs, &Request);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  GetAttrResp = VirtioFsResponseBody (VirtioFs, 0);
+  CopyMem (FuseAttr, &GetAttrResp->Attr, sizeof *FuseAttr);
+  return EFI_SUCCESS;
+}
+
+/**
+  Change the attributes of an inode, with VirtioFsFuseOpSetAttr.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeId        The inode number to modify.
+
+  @param[in] SetAttr       The request body, with the Valid field selecting
+                           the attributes to change.
+
+  @retval EFI_SUCCESS  The attributes have been changed.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseSetAttr (
+  IN OUT VIRTIO_FS                       *VirtioFs,
+  IN     UINT64                          NodeId,
+  IN     VIRTIO_FS_FUSE_SETATTR_REQUEST  *SetAttr
+  )
+{
+  VIRTIO_FS_REQUEST               Request;
+  VIRTIO_FS_FUSE_SETATTR_REQUEST  *SetAttrReq;
+
+  SetAttrReq = VirtioFsPrepareRequest (
+                 VirtioFs,
+                 0,
+                 VirtioFsFuseOpSetAttr,
+                 NodeId,
+                 sizeof *SetAttrReq,
+                 sizeof (VIRTIO_FS_FUSE_GETATTR_RESPONSE),
+                 &Request
+                 );
+  CopyMem (SetAttrReq, SetAttr, sizeof *SetAttrReq);
+
+  return VirtioFsSubmitOne (VirtioFs, &Request);
+}
+
+/**
+  Create a directory, with VirtioFsFuseOpMkDir.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] ParentNodeId  The inode number of the parent directory.
+
+  @param[in] Name          The NUL-terminated name of the new directory.
+
+  @param[out] NodeId       The inode number of the new directory. The caller
+                           is responsible for forgetting it with
+                           VirtioFsFuseForget().
+
+  @retval EFI_SUCCESS  The directory has been created.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseMkDir (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     ParentNodeId,
+  IN     CHAR8      *Name,
+  OUT    UINT64     *NodeId
+  )
+{
+  VIRTIO_FS_REQUEST              Request;
+  VIRTIO_FS_FUSE_MKDIR_REQUEST   *MkDirReq;
+  VIRTIO_FS_FUSE_ENTRY_RESPONSE  *EntryResp;
+  EFI_STATUS                     Status;
+
+  MkDirReq = VirtioFsPrepareNamedRequest (
+               VirtioFs,
+               VirtioFsFuseOpMkDir,
+               ParentNodeId,
+               sizeof *MkDirReq,
+               Name,
+               sizeof *EntryResp,
+               &Request
+               );
+  MkDirReq->Mode = VIRTIO_FS_FUSE_MODE_PERM_RWXU |
+                   VIRTIO_FS_FUSE_MODE_PERM_RGRP |
+                   VIRTIO_FS_FUSE_MODE_PERM_XGRP |
+                   VIRTIO_FS_FUSE_MODE_PERM_ROTH |
+                   VIRTIO_FS_FUSE_MODE_PERM_XOTH;
+  MkDirReq->Umask = 0;
+
+  Status = VirtioFsSubmitOne (VirtioFs, &Request);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  EntryResp = VirtioFsResponseBody (VirtioFs, 0);
+  *NodeId   = EntryResp->Node.NodeId;
+  return EFI_SUCCESS;
+}
+
+/**
+  Remove a regular file or an empty directory, with VirtioFsFuseOpUnlink or
+  VirtioFsFuseOpRmDir.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] ParentNodeId  The inode number of the parent directory.
+
+  @param[in] Name          The NUL-terminated name to remove.
+
+  @param[in] IsDir         Whether Name refers to a directory.
+
+  @retval EFI_SUCCESS  The file or directory has been removed.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseRemoveFileOrDir (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     ParentNodeId,
+  IN     CHAR8      *Name,
+  IN     BOOLEAN    IsDir
+  )
+{
+  VIRTIO_FS_REQUEST  Request;
+
+  VirtioFsPrepareNamedRequest (
+    VirtioFs,
+    IsDir ? VirtioFsFuseOpRmDir : VirtioFsFuseOpUnlink,
+    ParentNodeId,
+    0,
+    Name,
+    0,
+    &Request
+    );
+  return VirtioFsSubmitOne (VirtioFs, &Request);
+}
+
+/**
+  Open an existing regular file or directory, with VirtioFsFuseOpOpen or
+  VirtioFsFuseOpOpenDir.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeId        The inode number of the file or directory.
+
+  @param[in] IsDir         Whether NodeId refers to a directory.
+
+  @param[in] ReadWrite     Whether to open a regular file for writing too.
+                           Ignored for directories.
+
+  @param[out] FuseHandle   The FUSE file handle of the open file. The caller is
+                           responsible for releasing it with
+                           VirtioFsFuseRelease().
+
+  @retval EFI_SUCCESS  The file or directory has been opened.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseOpen (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     BOOLEAN    IsDir,
+  IN     BOOLEAN    ReadWrite,
+  OUT    UINT64     *FuseHandle
+  )
+{
+  VIRTIO_FS_REQUEST             Request;
+  VIRTIO_FS_FUSE_OPEN_REQUEST   *OpenReq;
+  VIRTIO_FS_FUSE_OPEN_RESPONSE  *OpenResp;
+  EFI_STATUS                    Status;
+
+  OpenReq = VirtioFsPrepareRequest (
+              VirtioFs,
+              0,
+              IsDir ? VirtioFsFuseOpOpenDir : VirtioFsFuseOpOpen,
+              NodeId,
+              sizeof *OpenReq,
+              sizeof *OpenResp,
+              &Request
+              );
+  OpenReq->Flags = (!IsDir && ReadWrite) ?
+                   VIRTIO_FS_FUSE_OPEN_REQ_F_RDWR :
+                   VIRTIO_FS_FUSE_OPEN_REQ_F_RDONLY;
+
+  Status = VirtioFsSubmitOne (VirtioFs, &Request);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  OpenResp    = VirtioFsResponseBody (VirtioFs, 0);
+  *FuseHandle = OpenResp->FileHandle;
+  return EFI_SUCCESS;
+}
+
+/**
+  Create and open a new regular file for reading and writing, with
+  VirtioFsFuseOpCreate.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] ParentNodeId  The inode number of the parent directory.
+
+  @param[in] Name          The NUL-terminated name of the new file.
+
+  @param[in] ReadOnly      Whether the new file should be created without
+                           write permission.
+
+  @param[out] NodeId       The inode number of the new file. The caller is
+                           responsible for forgetting it with
+                           VirtioFsFuseForget().
+
+  @param[out] FuseHandle   The FUSE file handle of the new file. The caller is
+                           responsible for releasing it with
+                           VirtioFsFuseRelease().
+
+  @retval EFI_SUCCESS  The file has been created and opened.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseCreate (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     ParentNodeId,
+  IN     CHAR8      *Name,
+  IN     BOOLEAN    ReadOnly,
+  OUT    UINT64     *NodeId,
+  OUT    UINT64     *FuseHandle
+  )
+{
+  VIRTIO_FS_REQUEST              Request;
+  VIRTIO_FS_FUSE_CREATE_REQUEST  *CreateReq;
+  VIRTIO_FS_FUSE_ENTRY_RESPONSE  *EntryResp;
+  VIRTIO_FS_FUSE_OPEN_RESPONSE   *OpenResp;
+  EFI_STATUS                     Status;
+
+  CreateReq = VirtioFsPrepareNamedRequest (
+                VirtioFs,
+                VirtioFsFuseOpCreate,
+                ParentNodeId,
+                sizeof *CreateReq,
+                Name,
+                sizeof *EntryResp + sizeof *OpenResp,
+                &Request
+                );
+  CreateReq->Flags = VIRTIO_FS_FUSE_OPEN_REQ_F_RDWR |
+                     VIRTIO_FS_FUSE_OPEN_REQ_F_CREAT |
+                     VIRTIO_FS_FUSE_OPEN_REQ_F_EXCL;
+  CreateReq->Mode = VIRTIO_FS_FUSE_MODE_TYPE_REG |
+                    VIRTIO_FS_FUSE_MODE_PERM_RUSR |
+                    VIRTIO_FS_FUSE_MODE_PERM_RGRP |
+                    VIRTIO_FS_FUSE_MODE_PERM_ROTH;
+  if (!ReadOnly) {
+    CreateReq->Mode |= VIRTIO_FS_FUSE_MODE_PERM_WUSR;
+  }
+
+  CreateReq->Umask = 0;
+
+  Status = VirtioFsSubmitOne (VirtioFs, &Request);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  EntryResp   = VirtioFsResponseBody (VirtioFs, 0);
+  OpenResp    = (VIRTIO_FS_FUSE_OPEN_RESPONSE *)(EntryResp + 1);
+  *NodeId     = EntryResp->Node.NodeId;
+  *FuseHandle = OpenResp->FileHandle;
+  return EFI_SUCCESS;
+}
+
+/**
+  Close a FUSE file handle, with VirtioFsFuseOpRelease or
+  VirtioFsFuseOpReleaseDir.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeId        The inode number of the open file.
+
+  @param[in] FuseHandle    The FUSE file handle to release.
+
+  @param[in] IsDir         Whether NodeId refers to a directory.
+
+  @retval EFI_SUCCESS  The handle has been released.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseRelease (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle,
+  IN     BOOLEAN    IsDir
+  )
+{
+  VIRTIO_FS_REQUEST               Request;
+  VIRTIO_FS_FUSE_RELEASE_REQUEST  *ReleaseReq;
+
+  ReleaseReq = VirtioFsPrepareRequest (
+                 VirtioFs,
+                 0,
+                 IsDir ? VirtioFsFuseOpReleaseDir : VirtioFsFuseOpRelease,
+                 NodeId,
+                 sizeof *ReleaseReq,
+                 0,
+                 &Request
+                 );
+  ReleaseReq->FileHandle = FuseHandle;
+
+  return VirtioFsSubmitOne (VirtioFs, &Request);
+}
+
+/**
+  Flush the data and the metadata of an open regular file to the host's
+  storage, with VirtioFsFuseOpFsync.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeId        The inode number of the open file.
+
+  @param[in] FuseHandle    The FUSE file handle of the open file.
+
+  @retval EFI_SUCCESS  The file has been flushed.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseFsync (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle
+  )
+{
+  VIRTIO_FS_REQUEST             Request;
+  VIRTIO_FS_FUSE_FSYNC_REQUEST  *FsyncReq;
+
+  FsyncReq = VirtioFsPrepareRequest (
+               VirtioFs,
+               0,
+               VirtioFsFuseOpFsync,
+               NodeId,
+               sizeof *FsyncReq,
+               0,
+               &Request
+               );
+  FsyncReq->FileHandle = FuseHandle;
+
+  return VirtioFsSubmitOne (VirtioFs, &Request);
+}
+
+/**
+  Fetch the attributes of the filesystem, with VirtioFsFuseOpStatFs.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[out] FilesysAttr  The attributes of the filesystem.
+
+  @retval EFI_SUCCESS  FilesysAttr has been filled in.
+
+  @return              Error codes from VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseStatFs (
+  IN OUT VIRTIO_FS                       *VirtioFs,
+  OUT    VIRTIO_FS_FUSE_STATFS_RESPONSE  *FilesysAttr
+  )
+{
+  VIRTIO_FS_REQUEST  Request;
+  EFI_STATUS         Status;
+
+  VirtioFsPrepareRequest (
+    VirtioFs,
+    0,
+    VirtioFsFuseOpStatFs,
+    VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID,
+    0,
+    sizeof *FilesysAttr,
+    &Request
+    );
+
+  Status = VirtioFsSubmitOne (VirtioFs, &Request);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CopyMem (FilesysAttr, VirtioFsResponseBody (VirtioFs, 0), sizeof *FilesysAttr);
+  return EFI_SUCCESS;
+}
+
+/**
+  Fetch a batch of directory entries, with VirtioFsFuseOpReadDirPlus.
+
+  The device looks up every entry it returns, other than "." and "..". The
+  caller is responsible for forgetting the non-zero inode numbers in the
+  returned entries with VirtioFsFuseForget().
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeId        The inode number of the open directory.
+
+  @param[in] FuseHandle    The FUSE file handle of the open directory.
+
+  @param[in] Cookie        Zero for the first entry of the directory,
+                           otherwise the CookieForNextEntry value of the last
+                           entry that has been consumed.
+
+  @param[out] Buffer       The buffer to receive the entries.
+
+  @param[in,out] Size      On input, the size of Buffer. On output, the number
+                           of bytes that the device produced; zero at the end
+                           of the directory.
+
+  @retval EFI_SUCCESS  Buffer and Size have been set.
+
+  @return              Error codes from VirtioMapAllBytesInSharedBuffer() and
+                       VirtioFsSubmitOne().
+**/
+EFI_STATUS
+VirtioFsFuseReadDirPlus (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle,
+  IN     UINT64     Cookie,
+  IN     VOID       *Buffer,
+  IN OUT UINT32     *Size
+  )
+{
+  VIRTIO_FS_REQUEST            Request;
+  VIRTIO_FS_FUSE_READ_REQUEST  *ReadReq;
+  EFI_PHYSICAL_ADDRESS         DeviceAddress;
+  VOID                         *Mapping;
+  EFI_STATUS                   Status;
+  EFI_STATUS                   UnmapStatus;
+
+  Status = VirtioMapAllBytesInSharedBuffer (
+             VirtioFs->Virtio,
+             VirtioOperationBusMasterWrite,
+             Buffer,
+             *Size,
+             &DeviceAddress,
+             &Mapping
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ReadReq = VirtioFsPrepareRequest (
+              VirtioFs,
+              0,
+              VirtioFsFuseOpReadDirPlus,
+              NodeId,
+              sizeof *ReadReq,
+              0,
+              &Request
+              );
+  ReadReq->FileHandle = FuseHandle;
+  ReadReq->Offset     = Cookie;
+  ReadReq->Size       = *Size;
+
+  Request.DataDeviceAddress = DeviceAddress;
+  Request.DataSize          = *Size;
+  Request.DataToDevice      = FALSE;
+
+  Status      = VirtioFsSubmitOne (VirtioFs, &Request);
+  UnmapStatus = VirtioFs->Virtio->UnmapSharedBuffer (VirtioFs->Virtio, Mapping);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (EFI_ERROR (UnmapStatus)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  *Size = Request.DataReceived;
+  return EFI_SUCCESS;
+}
+
+/**
+  Read from or write to an open regular file, with VirtioFsFuseOpRead or
+  VirtioFsFuseOpWrite.
+
+  The transfer is split into chunks of VirtioFs->MaxTransfer bytes, and up to
+  VirtioFs->MaxPipeline chunks are kept in flight at the same time. The
+  transfer stops at the first chunk that the device completes only partially,
+  such as at the end of the file.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] NodeId        The inode number of the open file.
+
+  @param[in] FuseHandle    The FUSE file handle of the open file.
+
+  @param[in] Offset        The file offset at which the transfer starts.
+
+  @param[in] Write         TRUE to write Buffer to the file, FALSE to read
+                           the file into Buffer.
+
+  @param[in,out] Buffer    The data to write, or the buffer to read into.
+
+  @param[in,out] Size      On input, the number of bytes to transfer. On
+                           output, the number of bytes transferred.
+
+  @retval EFI_SUCCESS  Size has been updated. Data may have been transferred
+                       partially.
+
+  @return              Error codes from VirtioMapAllBytesInSharedBuffer() and
+                       VirtioFsSubmitRequests(), or the EFI_STATUS equivalent
+                       of the errno value that the device reported for the
+                       first chunk.
+**/
+EFI_STATUS
+VirtioFsFuseTransfer (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle,
+  IN     UINT64     Offset,
+  IN     BOOLEAN    Write,
+  IN OUT VOID       *Buffer,
+  IN OUT UINTN      *Size
+  )
+{
+  VIRTIO_FS_REQUEST              Requests[VIRTIO_FS_MAX_PIPELINE];
+  VIRTIO_FS_FUSE_READ_REQUEST    *ReadReq;
+  VIRTIO_FS_FUSE_WRITE_RESPONSE  *WriteResp;
+  EFI_PHYSICAL_ADDRESS           DeviceAddress;
+  VOID                           *Mapping;
+  UINTN                          Queued;
+  UINTN                          Done;
+  UINT32                         Transferred;
+  UINT16                         Slot;
+  UINT16                         Count;
+  BOOLEAN                        Short;
+  EFI_STATUS                     Status;
+  EFI_STATUS                     UnmapStatus;
+
+  if (*Size == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Status = VirtioMapAllBytesInSharedBuffer (
+             VirtioFs->Virtio,
+             Write ? VirtioOperationBusMasterRead : VirtioOperationBusMasterWrite,
+             Buffer,
+             *Size,
+             &DeviceAddress,
+             &Mapping
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Queued = 0;
+  Done   = 0;
+  Short  = FALSE;
+  while (!Short && (Queued < *Size)) {
+    //
+    // The FUSE read and write request bodies share their layout.
+    //
+    for (Count = 0; Count < VirtioFs->MaxPipeline && Queued < *Size; Count++) {
+      ReadReq = VirtioFsPrepareRequest (
+                  VirtioFs,
+                  Count,
+                  Write ? VirtioFsFuseOpWrite : VirtioFsFuseOpRead,
+                  NodeId,
+                  sizeof *ReadReq,
+                  Write ? sizeof *WriteResp : 0,
+                  &Requests[Count]
+                  );
+      ReadReq->FileHandle = FuseHandle;
+      ReadReq->Offset     = Offset + Queued;
+      ReadReq->Size       = (UINT32)MIN (*Size - Queued, VirtioFs->MaxTransfer);
+
+      Requests[Count].DataDeviceAddress = DeviceAddress + Queued;
+      Requests[Count].DataSize          = ReadReq->Size;
+      Requests[Count].DataToDevice      = Write;
+      Queued                           += ReadReq->Size;
+    }
+
+    Status = VirtioFsSubmitRequests (VirtioFs, Requests, Count);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    for (Slot = 0; Slot < Count; Slot++) {
+      if (Requests[Slot].Errno != 0) {
+        if (Done == 0) {
+          Status = VirtioFsErrnoToEfiStatus (Requests[Slot].Errno);
+        }
+
+        Short = TRUE;
+        break;
+      }
+
+      if (Write) {
+        WriteResp   = VirtioFsResponseBody (VirtioFs, Slot);
+        Transferred = WriteResp->Size;
+        if (Transferred > Requests[Slot].DataSize) {
+          Status = EFI_DEVICE_ERROR;
+          Short  = TRUE;
+          break;
+        }
+      } else {
+        Transferred = Requests[Slot].DataReceived;
+      }
+
+      Done += Transferred;
+      if (Transferred < Requests[Slot].DataSize) {
+        Short = TRUE;
+        break;
+      }
+    }
+  }
+
+  UnmapStatus = VirtioFs->Virtio->UnmapSharedBuffer (VirtioFs->Virtio, Mapping);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (EFI_ERROR (UnmapStatus)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  *Size = Done;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,1236 @@
+/** @file
+  Initialization and helper routines for the Virtio Filesystem device.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/BaseLib.h>             // DivU64x32Remainder()
+#include <Library/BaseMemoryLib.h>       // CopyMem()
+#include <Library/MemoryAllocationLib.h> // AllocatePool()
+#include <Library/VirtioLib.h>           // Virtio10WriteFeatures()
+
+#include "VirtioFsDxe.h"
+
+//
+// The longest path component that the driver sends to the device, in bytes,
+// excluding the terminating NUL.
+//
+#define VIRTIO_FS_MAX_NAME_LENGTH  255
+
+#define SECONDS_PER_DAY  86400
+
+//
+// Days from 0000-03-01 to 1970-01-01 in the proleptic Gregorian calendar, and
+// days in a 400-year cycle.
+//
+#define DAYS_FROM_CIVIL_EPOCH_TO_UNIX_EPOCH  719468
+#define DAYS_PER_ERA                         146097
+
+/**
+  Read the Virtio Filesystem device configuration structure in full.
+
+  @param[in] Virtio   The Virtio protocol underlying the VIRTIO_FS object.
+
+  @param[out] Config  The fully populated VIRTIO_FS_CONFIG structure.
+
+  @retval EFI_SUCCESS  Config has been filled in.
+
+  @return              Error codes propagated from Virtio->ReadDevice(). The
+                       contents of Config are indeterminate.
+**/
+STATIC
+EFI_STATUS
+VirtioFsReadConfig (
+  IN  VIRTIO_DEVICE_PROTOCOL  *Virtio,
+  OUT VIRTIO_FS_CONFIG        *Config
+  )
+{
+  UINTN       Idx;
+  EFI_STATUS  Status;
+
+  for (Idx = 0; Idx < VIRTIO_FS_TAG_BYTES; Idx++) {
+    Status = Virtio->ReadDevice (
+                       Virtio,                                 // This
+                       OFFSET_OF (VIRTIO_FS_CONFIG, Tag[Idx]), // FieldOffset
+                       sizeof Config->Tag[Idx],                // FieldSize
+                       sizeof Config->Tag[Idx],                // BufferSize
+                       &Config->Tag[Idx]                       // Buffer
+                       );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Status = Virtio->ReadDevice (
+                     Virtio,                                    // This
+                     OFFSET_OF (VIRTIO_FS_CONFIG, NumReqQueues), // FieldOffset
+                     sizeof Config->NumReqQueues,               // FieldSize
+                     sizeof Config->NumReqQueues,               // BufferSize
+                     &Config->NumReqQueues                      // Buffer
+                     );
+  return Status;
+}
+
+/**
+  Configure the Virtio Filesystem device underlying VirtioFs, and allocate the
+  request slots that are shared with the device.
+
+  @param[in,out] VirtioFs  The VIRTIO_FS object for which Virtio communication
+                           should be set up. On input, the caller is
+                           responsible for VirtioFs->Virtio having been
+                           initialized. On output, synchronous Virtio
+                           Filesystem commands (primitives) may be submitted to
+                           the device.
+
+  @retval EFI_SUCCESS      Virtio machinery has been set up.
+
+  @retval EFI_UNSUPPORTED  The host-side configuration of the Virtio Filesystem
+                           is not supported by this driver.
+
+  @return                  Error codes from underlying functions.
+**/
+EFI_STATUS
+VirtioFsInit (
+  IN OUT VIRTIO_FS  *VirtioFs
+  )
+{
+  UINT8             NextDevStat;
+  EFI_STATUS        Status;
+  UINT64            Features;
+  VIRTIO_FS_CONFIG  Config;
+  UINTN             Idx;
+  UINT64            RingBaseShift;
+  UINTN             SlotsPages;
+
+  //
+  // Execute virtio-v1.1-cs01-87fa6b5d8155, 3.1.1 Driver Requirements: Device
+  // Initialization.
+  //
+  // 1. Reset the device.
+  //
+  NextDevStat = 0;
+  Status      = VirtioFs->Virtio->SetDeviceStatus (VirtioFs->Virtio, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // 2. Set the ACKNOWLEDGE status bit [...]
+  //
+  NextDevStat |= VSTAT_ACK;
+  Status       = VirtioFs->Virtio->SetDeviceStatus (VirtioFs->Virtio, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // 3. Set the DRIVER status bit [...]
+  //
+  NextDevStat |= VSTAT_DRIVER;
+  Status       = VirtioFs->Virtio->SetDeviceStatus (VirtioFs->Virtio, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // 4. Read device feature bits [...]
+  //
+  Status = VirtioFs->Virtio->GetDeviceFeatures (VirtioFs->Virtio, &Features);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  if ((Features & VIRTIO_F_VERSION_1) == 0) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  //
+  // No device-specific feature bits have been defined in file "virtio-fs.tex"
+  // of the virtio spec at <https://github.com/oasis-tcs/virtio-spec.git>, as
+  // of commit 87fa6b5d8155.
+  //
+  Features &= VIRTIO_F_VERSION_1 | VIRTIO_F_IOMMU_PLATFORM;
+
+  //
+  // ... and write the subset of feature bits understood by the [...] driver to
+  // the device. [...]
+  // 5. Set the FEATURES_OK status bit.
+  // 6. Re-read device status to ensure the FEATURES_OK bit is still set [...]
+  //
+  Status = Virtio10WriteFeatures (VirtioFs->Virtio, Features, &NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // 7. Perform device-specific setup, including discovery of virtqueues for
+  // the device, [...] reading [...] the device's virtio configuration space
+  //
+  Status = VirtioFsReadConfig (VirtioFs->Virtio, &Config);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // 7.a. Convert the filesystem label from UTF-8 to UCS-2. Only labels with
+  // printable ASCII code points (U+0020 through U+007E) are supported.
+  // NUL-terminate at either the terminator we find, or right after the
+  // original label.
+  //
+  for (Idx = 0; Idx < VIRTIO_FS_TAG_BYTES && Config.Tag[Idx] != '\0'; Idx++) {
+    if ((Config.Tag[Idx] < 0x20) || (Config.Tag[Idx] > 0x7E)) {
+      Status = EFI_UNSUPPORTED;
+      goto Failed;
+    }
+
+    VirtioFs->Label[Idx] = Config.Tag[Idx];
+  }
+
+  VirtioFs->Label[Idx] = L'\0';
+
+  //
+  // 7.b. We need one queue for sending normal priority requests.
+  //
+  if (Config.NumReqQueues < 1) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  //
+  // 7.c. Fetch and remember the number of descriptors we can place on the
+  // queue at once.
+  //
+  Status = VirtioFs->Virtio->SetQueueSel (
+                               VirtioFs->Virtio,
+                               VIRTIO_FS_REQUEST_QUEUE
+                               );
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = VirtioFs->Virtio->GetQueueNumMax (
+                               VirtioFs->Virtio,
+                               &VirtioFs->QueueSize
+                               );
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // 7.d. Every request takes up to VIRTIO_FS_DESCS_PER_REQUEST descriptors;
+  // keep as many requests in flight as the queue can hold, up to
+  // VIRTIO_FS_MAX_PIPELINE.
+  //
+  VirtioFs->MaxPipeline = (UINT16)MIN (
+                                    VIRTIO_FS_MAX_PIPELINE,
+                                    VirtioFs->QueueSize / VIRTIO_FS_DESCS_PER_REQUEST
+                                    );
+  if (VirtioFs->MaxPipeline < 1) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  //
+  // 7.e. [...] population of virtqueues [...]
+  //
+  Status = VirtioRingInit (
+             VirtioFs->Virtio,
+             VirtioFs->QueueSize,
+             &VirtioFs->Ring
+             );
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = VirtioRingMap (
+             VirtioFs->Virtio,
+             &VirtioFs->Ring,
+             &RingBaseShift,
+             &VirtioFs->RingMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto ReleaseQueue;
+  }
+
+  Status = VirtioFs->Virtio->SetQueueNum (VirtioFs->Virtio, VirtioFs->QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VirtioFs->Virtio->SetQueueAlign (VirtioFs->Virtio, EFI_PAGE_SIZE);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VirtioFs->Virtio->SetQueueAddress (
+                               VirtioFs->Virtio,
+                               &VirtioFs->Ring,
+                               RingBaseShift
+                               );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  //
+  // 7.f. Allocate the request slots, and map them for the lifetime of the
+  // driver instance, so that submitting a request never needs to map the
+  // fixed-size request and response structures.
+  //
+  SlotsPages = EFI_SIZE_TO_PAGES (VirtioFs->MaxPipeline * sizeof (VIRTIO_FS_SLOT));
+  Status     = VirtioFs->Virtio->AllocateSharedPages (
+                                   VirtioFs->Virtio,
+                                   SlotsPages,
+                                   (VOID **)&VirtioFs->Slots
+                                   );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VirtioMapAllBytesInSharedBuffer (
+             VirtioFs->Virtio,
+             VirtioOperationBusMasterCommonBuffer,
+             VirtioFs->Slots,
+             EFI_PAGES_TO_SIZE (SlotsPages),
+             &VirtioFs->SlotsDeviceAddress,
+             &VirtioFs->SlotsMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto FreeSlots;
+  }
+
+  //
+  // 8. Set the DRIVER_OK status bit.
+  //
+  NextDevStat |= VSTAT_DRIVER_OK;
+  Status       = VirtioFs->Virtio->SetDeviceStatus (VirtioFs->Virtio, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto UnmapSlots;
+  }
+
+  return EFI_SUCCESS;
+
+UnmapSlots:
+  VirtioFs->Virtio->UnmapSharedBuffer (VirtioFs->Virtio, VirtioFs->SlotsMap);
+
+FreeSlots:
+  VirtioFs->Virtio->FreeSharedPages (VirtioFs->Virtio, SlotsPages, VirtioFs->Slots);
+
+UnmapQueue:
+  VirtioFs->Virtio->UnmapSharedBuffer (VirtioFs->Virtio, VirtioFs->RingMap);
+
+ReleaseQueue:
+  VirtioRingUninit (VirtioFs->Virtio, &VirtioFs->Ring);
+
+Failed:
+  //
+  // If any of these steps go irrecoverably wrong, the driver SHOULD set the
+  // FAILED status bit to indicate that it has given up on the device (it can
+  // reset the device later to restart if desired). [...]
+  //
+  // Virtio access failure here should not mask the original error.
+  //
+  NextDevStat |= VSTAT_FAILED;
+  VirtioFs->Virtio->SetDeviceStatus (VirtioFs->Virtio, NextDevStat);
+
+  return Status;
+}
+
+/**
+  De-configure the Virtio Filesystem device underlying VirtioFs.
+
+  @param[in] VirtioFs  The VIRTIO_FS object for which Virtio communication
+                       should be torn down. On input, the caller is responsible
+                       for having called VirtioFsInit(). On output, Virtio
+                       Filesystem commands (primitives) must no longer be
+                       submitted to the device.
+**/
+VOID
+VirtioFsUninit (
+  IN OUT VIRTIO_FS  *VirtioFs
+  )
+{
+  //
+  // Resetting the Virtio device makes it release its resources and forget its
+  // configuration.
+  //
+  VirtioFs->Virtio->SetDeviceStatus (VirtioFs->Virtio, 0);
+  VirtioFs->Virtio->UnmapSharedBuffer (VirtioFs->Virtio, VirtioFs->SlotsMap);
+  VirtioFs->Virtio->FreeSharedPages (
+                      VirtioFs->Virtio,
+                      EFI_SIZE_TO_PAGES (VirtioFs->MaxPipeline * sizeof (VIRTIO_FS_SLOT)),
+                      VirtioFs->Slots
+                      );
+  VirtioFs->Virtio->UnmapSharedBuffer (VirtioFs->Virtio, VirtioFs->RingMap);
+  VirtioRingUninit (VirtioFs->Virtio, &VirtioFs->Ring);
+}
+
+/**
+  ExitBootServices event notification function for a Virtio Filesystem object.
+
+  This function resets the VIRTIO_FS.Virtio device, causing it to release all
+  references to guest-side resources. The function may only be called after
+  VirtioFsInit() returns successfully and before VirtioFsUninit() is called.
+
+  @param[in] ExitBootEvent   The VIRTIO_FS.ExitBoot event that has been
+                             signaled.
+
+  @param[in] VirtioFsAsVoid  Pointer to the VIRTIO_FS object, passed in as
+                             (VOID*).
+**/
+VOID
+EFIAPI
+VirtioFsExitBoot (
+  IN EFI_EVENT  ExitBootEvent,
+  IN VOID       *VirtioFsAsVoid
+  )
+{
+  VIRTIO_FS  *VirtioFs;
+
+  VirtioFs = VirtioFsAsVoid;
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "%a: VirtioFs=0x%p Label=\"%s\"\n",
+    __FUNCTION__,
+    VirtioFsAsVoid,
+    VirtioFs->Label
+    ));
+  VirtioFs->Virtio->SetDeviceStatus (VirtioFs->Virtio, 0);
+}
+
+/**
+  Set up the FUSE request header in a request slot, and describe the fixed
+  sizes of the request and the response.
+
+  @param[in,out] VirtioFs      The Virtio Filesystem device that the request is
+                               going to be sent to. VirtioFs->RequestId is
+                               consumed and incremented.
+
+  @param[in] Slot              The request slot to use; smaller than
+                               VirtioFs->MaxPipeline.
+
+  @param[in] Opcode            The FUSE opcode to send.
+
+  @param[in] NodeId            The inode number of the file that the request
+                               refers to.
+
+  @param[in] RequestBodySize   The number of bytes that the caller is going to
+                               place in the request buffer after the FUSE
+                               request header.
+
+  @param[in] ResponseBodySize  The number of bytes that the device is expected
+                               to produce in the response buffer after the
+                               FUSE response header, on success.
+
+  @param[out] Request          The request descriptor to initialize. The data
+                               buffer is reset to none.
+
+  @return  Pointer to the zeroed-out request body in the slot's request buffer.
+**/
+VOID *
+VirtioFsPrepareRequest (
+  IN OUT VIRTIO_FS              *VirtioFs,
+  IN     UINT16                 Slot,
+  IN     VIRTIO_FS_FUSE_OPCODE  Opcode,
+  IN     UINT64                 NodeId,
+  IN     UINT32                 RequestBodySize,
+  IN     UINT32                 ResponseBodySize,
+  OUT    VIRTIO_FS_REQUEST      *Request
+  )
+{
+  VIRTIO_FS_FUSE_REQUEST  *CommonReq;
+
+  ASSERT (Slot < VirtioFs->MaxPipeline);
+  ASSERT (
+    sizeof *CommonReq + RequestBodySize <= VIRTIO_FS_REQUEST_BUFFER_SIZE
+    );
+  ASSERT (
+    sizeof (VIRTIO_FS_FUSE_RESPONSE) + ResponseBodySize <=
+    VIRTIO_FS_RESPONSE_BUFFER_SIZE
+    );
+
+  CommonReq          = (VIRTIO_FS_FUSE_REQUEST *)VirtioFs->Slots[Slot].Request;
+  CommonReq->Len     = 0; // set by VirtioFsSubmitRequests()
+  CommonReq->Opcode  = Opcode;
+  CommonReq->Unique  = VirtioFs->RequestId++;
+  CommonReq->NodeId  = NodeId;
+  CommonReq->Uid     = 0;
+  CommonReq->Gid     = 0;
+  CommonReq->Pid     = 1;
+  CommonReq->Padding = 0;
+  ZeroMem (CommonReq + 1, RequestBodySize);
+
+  Request->RequestSize       = (UINT32)sizeof *CommonReq + RequestBodySize;
+  Request->ResponseSize      = 0;
+  Request->DataDeviceAddress = 0;
+  Request->DataSize          = 0;
+  Request->DataToDevice      = FALSE;
+  Request->Errno             = 0;
+  Request->DataReceived      = 0;
+
+  //
+  // FORGET-type requests elicit no response at all. Everything else receives
+  // at least the FUSE response header.
+  //
+  if ((Opcode != VirtioFsFuseOpForget) && (Opcode != VirtioFsFuseOpBatchForget)) {
+    Request->ResponseSize = (UINT32)sizeof (VIRTIO_FS_FUSE_RESPONSE) +
+                            ResponseBodySize;
+  }
+
+  return CommonReq + 1;
+}
+
+/**
+  Return a pointer to the response body in a request slot, right after the
+  FUSE response header.
+
+  @param[in] VirtioFs  The Virtio Filesystem device.
+
+  @param[in] Slot      The request slot.
+
+  @return  Pointer to the response body.
+**/
+VOID *
+VirtioFsResponseBody (
+  IN VIRTIO_FS  *VirtioFs,
+  IN UINT16     Slot
+  )
+{
+  return (VIRTIO_FS_FUSE_RESPONSE *)VirtioFs->Slots[Slot].Response + 1;
+}
+
+/**
+  Submit requests that have been set up in the request slots to the Virtio
+  Filesystem device, with a single notification, and wait for all of them to
+  complete. Then validate the responses.
+
+  @param[in,out] VirtioFs  The Virtio Filesystem device to send the requests
+                           to.
+
+  @param[in,out] Requests  Array of RequestCount request descriptors. Element
+                           #N describes the request in slot #N. On output, the
+                           Errno and DataReceived fields are set.
+
+  @param[in] RequestCount  Number of requests to submit; between 1 and
+                           VirtioFs->MaxPipeline, inclusive.
+
+  @retval EFI_SUCCESS       All requests were processed, and their responses
+                            are well-formed. Individual requests may still have
+                            failed; see their Errno fields.
+
+  @retval EFI_DEVICE_ERROR  A response was malformed, or the device could not
+                            be notified.
+**/
+EFI_STATUS
+VirtioFsSubmitRequests (
+  IN OUT VIRTIO_FS          *VirtioFs,
+  IN OUT VIRTIO_FS_REQUEST  *Requests,
+  IN     UINT16             RequestCount
+  )
+{
+  DESC_INDICES             Indices;
+  UINT16                   HeadDescIdx[VIRTIO_FS_MAX_PIPELINE];
+  UINT16                   Slot;
+  VIRTIO_FS_REQUEST        *Request;
+  VIRTIO_FS_FUSE_REQUEST   *CommonReq;
+  VIRTIO_FS_FUSE_RESPONSE  *CommonResp;
+  EFI_PHYSICAL_ADDRESS     SlotAddress;
+  BOOLEAN                  DataFromDevice;
+  EFI_STATUS               Status;
+
+  ASSERT (RequestCount > 0);
+  ASSERT (RequestCount <= VirtioFs->MaxPipeline);
+
+  //
+  // Build one descriptor chain per request. Device-readable buffers precede
+  // device-writeable ones within each chain.
+  //
+  VirtioPrepare (&VirtioFs->Ring, &Indices);
+  for (Slot = 0; Slot < RequestCount; Slot++) {
+    Request        = &Requests[Slot];
+    SlotAddress    = VirtioFs->SlotsDeviceAddress + Slot * sizeof (VIRTIO_FS_SLOT);
+    DataFromDevice = (BOOLEAN)(Request->DataSize > 0 && !Request->DataToDevice);
+
+    CommonReq      = (VIRTIO_FS_FUSE_REQUEST *)VirtioFs->Slots[Slot].Request;
+    CommonReq->Len = Request->RequestSize;
+    if (Request->DataToDevice) {
+      CommonReq->Len += Request->DataSize;
+    }
+
+    CommonResp = (VIRTIO_FS_FUSE_RESPONSE *)VirtioFs->Slots[Slot].Response;
+    ZeroMem (CommonResp, sizeof *CommonResp);
+
+    HeadDescIdx[Slot] = Indices.NextDescIdx;
+    VirtioAppendDesc (
+      &VirtioFs->Ring,
+      SlotAddress + OFFSET_OF (VIRTIO_FS_SLOT, Request),
+      Request->RequestSize,
+      (Request->DataToDevice || Request->ResponseSize > 0) ? VRING_DESC_F_NEXT : 0,
+      &Indices
+      );
+
+    if ((Request->DataSize > 0) && Request->DataToDevice) {
+      VirtioAppendDesc (
+        &VirtioFs->Ring,
+        Request->DataDeviceAddress,
+        Request->DataSize,
+        (Request->ResponseSize > 0) ? VRING_DESC_F_NEXT : 0,
+        &Indices
+        );
+    }
+
+    if (Request->ResponseSize > 0) {
+      VirtioAppendDesc (
+        &VirtioFs->Ring,
+        SlotAddress + OFFSET_OF (VIRTIO_FS_SLOT, Response),
+        Request->ResponseSize,
+        VRING_DESC_F_WRITE | (DataFromDevice ? VRING_DESC_F_NEXT : 0),
+        &Indices
+        );
+    }
+
+    if (DataFromDevice) {
+      VirtioAppendDesc (
+        &VirtioFs->Ring,
+        Request->DataDeviceAddress,
+        Request->DataSize,
+        VRING_DESC_F_WRITE,
+        &Indices
+        );
+    }
+  }
+
+  Status = VirtioFlushBatch (
+             VirtioFs->Virtio,
+             VIRTIO_FS_REQUEST_QUEUE,
+             &VirtioFs->Ring,
+             HeadDescIdx,
+             RequestCount,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Validate the responses.
+  //
+  for (Slot = 0; Slot < RequestCount; Slot++) {
+    Request = &Requests[Slot];
+    if (Request->ResponseSize == 0) {
+      continue;
+    }
+
+    CommonReq  = (VIRTIO_FS_FUSE_REQUEST *)VirtioFs->Slots[Slot].Request;
+    CommonResp = (VIRTIO_FS_FUSE_RESPONSE *)VirtioFs->Slots[Slot].Response;
+
+    if ((CommonResp->Unique != CommonReq->Unique) ||
+        (CommonResp->Len < sizeof *CommonResp))
+    {
+      DEBUG ((
+        DEBUG_ERROR,
+        "%a: Label=\"%s\" Opcode=%u malformed response\n",
+        __FUNCTION__,
+        VirtioFs->Label,
+        CommonReq->Opcode
+        ));
+      return EFI_DEVICE_ERROR;
+    }
+
+    if (CommonResp->Error != 0) {
+      //
+      // An error response consists of the header only, and carries a negated
+      // errno value.
+      //
+      if ((CommonResp->Len != sizeof *CommonResp) ||
+          (CommonResp->Error > -1) || (CommonResp->Error < -4095))
+      {
+        return EFI_DEVICE_ERROR;
+      }
+
+      Request->Errno = -CommonResp->Error;
+      continue;
+    }
+
+    if (CommonResp->Len < Request->ResponseSize) {
+      return EFI_DEVICE_ERROR;
+    }
+
+    DataFromDevice = (BOOLEAN)(Request->DataSize > 0 && !Request->DataToDevice);
+    if (DataFromDevice) {
+      if (CommonResp->Len - Request->ResponseSize > Request->DataSize) {
+        return EFI_DEVICE_ERROR;
+      }
+
+      Request->DataReceived = CommonResp->Len - Request->ResponseSize;
+    } else if (CommonResp->Len != Request->ResponseSize) {
+      return EFI_DEVICE_ERROR;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Map a Linux errno value to an EFI_STATUS code.
+
+  @param[in] Errno  The positive errno value to map.
+
+  @return  The EFI_STATUS code that best expresses Errno.
+**/
+EFI_STATUS
+VirtioFsErrnoToEfiStatus (
+  IN INT32  Errno
+  )
+{
+  switch (Errno) {
+    case VIRTIO_FS_FUSE_ERRNO_EPERM:
+    case VIRTIO_FS_FUSE_ERRNO_EACCES:
+    case VIRTIO_FS_FUSE_ERRNO_EBUSY:
+    case VIRTIO_FS_FUSE_ERRNO_EEXIST:
+    case VIRTIO_FS_FUSE_ERRNO_ENOTEMPTY:
+      return EFI_ACCESS_DENIED;
+
+    case VIRTIO_FS_FUSE_ERRNO_ENOENT:
+    case VIRTIO_FS_FUSE_ERRNO_ENOTDIR:
+      return EFI_NOT_FOUND;
+
+    case VIRTIO_FS_FUSE_ERRNO_ENOMEM:
+      return EFI_OUT_OF_RESOURCES;
+
+    case VIRTIO_FS_FUSE_ERRNO_EISDIR:
+    case VIRTIO_FS_FUSE_ERRNO_EINVAL:
+    case VIRTIO_FS_FUSE_ERRNO_ENAMETOOLONG:
+      return EFI_INVALID_PARAMETER;
+
+    case VIRTIO_FS_FUSE_ERRNO_EFBIG:
+    case VIRTIO_FS_FUSE_ERRNO_ENOSPC:
+    case VIRTIO_FS_FUSE_ERRNO_EDQUOT:
+      return EFI_VOLUME_FULL;
+
+    case VIRTIO_FS_FUSE_ERRNO_EROFS:
+      return EFI_WRITE_PROTECTED;
+
+    case VIRTIO_FS_FUSE_ERRNO_ENOSYS:
+      return EFI_UNSUPPORTED;
+
+    default:
+      return EFI_DEVICE_ERROR;
+  }
+}
+
+/**
+  Compose the canonical pathname of a file that EFI_FILE_PROTOCOL.Open() is
+  asked to open, relative to an open file or directory.
+
+  Backslashes are translated to forward slashes, and "." and ".." components
+  are resolved; ".." components never climb above the root directory. Only
+  printable ASCII characters, other than the forward slash, are accepted in
+  RhsPath16.
+
+  @param[in] LhsPath8      The canonical pathname of the directory that a
+                           relative RhsPath16 is interpreted against.
+
+  @param[in] RhsPath16     The pathname passed to EFI_FILE_PROTOCOL.Open().
+
+  @param[out] ResultPath8  The resulting canonical pathname, allocated from
+                           pool on success.
+
+  @retval EFI_SUCCESS            ResultPath8 has been set.
+
+  @retval EFI_INVALID_PARAMETER  RhsPath16 contains an unsupported character,
+                                 or a component that is too long.
+
+  @retval EFI_OUT_OF_RESOURCES   Memory allocation failed.
+**/
+EFI_STATUS
+VirtioFsComposePath (
+  IN     CHAR8   *LhsPath8,
+  IN     CHAR16  *RhsPath16,
+  OUT    CHAR8   **ResultPath8
+  )
+{
+  UINTN   LhsLen;
+  UINTN   RhsLen;
+  UINTN   Idx;
+  CHAR8   *Combined;
+  CHAR8   *Result;
+  CHAR8   *Pos;
+  CHAR8   *Component;
+  UINTN   ComponentLen;
+  UINTN   ResultLen;
+  CHAR16  Char;
+
+  //
+  // An absolute RhsPath16 resets the base to the root directory.
+  //
+  if (RhsPath16[0] == L'\\') {
+    LhsPath8 = "";
+  }
+
+  LhsLen   = AsciiStrLen (LhsPath8);
+  RhsLen   = StrLen (RhsPath16);
+  Combined = AllocatePool (LhsLen + 1 + RhsLen + 1);
+  if (Combined == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Result = AllocatePool (LhsLen + 1 + RhsLen + 2);
+  if (Result == NULL) {
+    FreePool (Combined);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  CopyMem (Combined, LhsPath8, LhsLen);
+  Combined[LhsLen] = '/';
+  for (Idx = 0; Idx < RhsLen; Idx++) {
+    Char = RhsPath16[Idx];
+    if ((Char < 0x20) || (Char > 0x7E) || (Char == L'/')) {
+      FreePool (Result);
+      FreePool (Combined);
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Combined[LhsLen + 1 + Idx] = (Char == L'\\') ? '/' : (CHAR8)Char;
+  }
+
+  Combined[LhsLen + 1 + RhsLen] = '\0';
+
+  ResultLen = 0;
+  Pos       = Combined;
+  while (*Pos != '\0') {
+    while (*Pos == '/') {
+      Pos++;
+    }
+
+    if (*Pos == '\0') {
+      break;
+    }
+
+    Component = Pos;
+    while ((*Pos != '/') && (*Pos != '\0')) {
+      Pos++;
+    }
+
+    ComponentLen = (UINTN)(Pos - Component);
+    if ((ComponentLen == 1) && (Component[0] == '.')) {
+      continue;
+    }
+
+    if ((ComponentLen == 2) && (Component[0] == '.') && (Component[1] == '.')) {
+      while ((ResultLen > 0) && (Result[ResultLen - 1] != '/')) {
+        ResultLen--;
+      }
+
+      if (ResultLen > 0) {
+        ResultLen--;
+      }
+
+      continue;
+    }
+
+    if (ComponentLen > VIRTIO_FS_MAX_NAME_LENGTH) {
+      FreePool (Result);
+      FreePool (Combined);
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Result[ResultLen++] = '/';
+    CopyMem (Result + ResultLen, Component, ComponentLen);
+    ResultLen += ComponentLen;
+  }
+
+  if (ResultLen == 0) {
+    Result[ResultLen++] = '/';
+  }
+
+  Result[ResultLen] = '\0';
+  FreePool (Combined);
+
+  *ResultPath8 = Result;
+  return EFI_SUCCESS;
+}
+
+/**
+  Return the last component of a canonical pathname.
+
+  @param[in] Path  The canonical pathname.
+
+  @return  Pointer into Path, to the last component. For the root directory,
+           the empty string.
+**/
+CHAR8 *
+VirtioFsGetBasename (
+  IN CHAR8  *Path
+  )
+{
+  CHAR8  *Basename;
+
+  Basename = Path;
+  while (*Path != '\0') {
+    if (*Path == '/') {
+      Basename = Path + 1;
+    }
+
+    Path++;
+  }
+
+  return Basename;
+}
+
+/**
+  Resolve a canonical pathname to an inode number, looking up each component
+  in turn.
+
+  @param[in,out] VirtioFs    The Virtio Filesystem device.
+
+  @param[in] Path            The canonical pathname to look up.
+
+  @param[in] StopAtParent    If TRUE, resolve the parent directory of Path,
+                             rather than Path itself.
+
+  @param[out] NodeId         The inode number of the file (or its parent
+                             directory) on success. If it differs from
+                             VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID, the caller is
+                             responsible for forgetting it with
+                             VirtioFsFuseForget().
+
+  @param[out] LastComponent  If StopAtParent is TRUE, set to point into Path,
+                             to the last component. Must be NULL otherwise.
+
+  @retval EFI_SUCCESS            NodeId (and LastComponent) have been set.
+
+  @retval EFI_INVALID_PARAMETER  StopAtParent is TRUE and Path is the root
+                                 directory.
+
+  @return                        Error codes from VirtioFsFuseLookup().
+**/
+EFI_STATUS
+VirtioFsLookupPath (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     CHAR8      *Path,
+  IN     BOOLEAN    StopAtParent,
+  OUT    UINT64     *NodeId,
+  OUT    CHAR8      **LastComponent OPTIONAL
+  )
+{
+  UINT64                              CurrentNodeId;
+  UINT64                              NextNodeId;
+  CHAR8                               Name[VIRTIO_FS_MAX_NAME_LENGTH + 1];
+  CHAR8                               *Component;
+  UINTN                               ComponentLen;
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  FuseAttr;
+  EFI_STATUS                          Status;
+
+  ASSERT (Path[0] == '/');
+  if (StopAtParent && (Path[1] == '\0')) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CurrentNodeId = VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID;
+  Component     = Path + 1;
+  while (*Component != '\0') {
+    ComponentLen = 0;
+    while ((Component[ComponentLen] != '/') &&
+           (Component[ComponentLen] != '\0'))
+    {
+      ComponentLen++;
+    }
+
+    if (StopAtParent && (Component[ComponentLen] == '\0')) {
+      *LastComponent = Component;
+      break;
+    }
+
+    ASSERT (ComponentLen <= VIRTIO_FS_MAX_NAME_LENGTH);
+    CopyMem (Name, Component, ComponentLen);
+    Name[ComponentLen] = '\0';
+
+    Status = VirtioFsFuseLookup (VirtioFs, CurrentNodeId, Name, &NextNodeId, &FuseAttr);
+    if (CurrentNodeId != VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID) {
+      VirtioFsFuseForget (VirtioFs, &CurrentNodeId, 1);
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    CurrentNodeId = NextNodeId;
+    Component    += ComponentLen;
+    if (*Component == '/') {
+      Component++;
+    }
+  }
+
+  *NodeId = CurrentNodeId;
+  return EFI_SUCCESS;
+}
+
+/**
+  Convert a number of seconds since the Unix epoch to EFI_TIME.
+
+  @param[in] Seconds   Seconds since 1970-01-01 00:00:00 UTC.
+
+  @param[out] EfiTime  The corresponding EFI_TIME, in UTC. Dates beyond the
+                       range of EFI_TIME are clamped.
+**/
+STATIC
+VOID
+VirtioFsEpochToEfiTime (
+  IN  UINT64    Seconds,
+  OUT EFI_TIME  *EfiTime
+  )
+{
+  UINT32  SecondOfDay;
+  UINT64  Days;
+  UINT32  DayOfEra;
+  UINT32  YearOfEra;
+  UINT32  DayOfYear;
+  UINT32  MonthIndex;
+  UINT32  Year;
+  UINT32  Month;
+  UINT64  Era;
+
+  ZeroMem (EfiTime, sizeof *EfiTime);
+
+  Days = DivU64x32Remainder (Seconds, SECONDS_PER_DAY, &SecondOfDay);
+  Days = Days + DAYS_FROM_CIVIL_EPOCH_TO_UNIX_EPOCH;
+  Era  = DivU64x32 (Days, DAYS_PER_ERA);
+
+  //
+  // Civil-from-days, in the proleptic Gregorian calendar, with the year
+  // starting on March 1st so that the leap day is the last day of the year.
+  //
+  DayOfEra   = (UINT32)(Days - MultU64x32 (Era, DAYS_PER_ERA));
+  YearOfEra  = (DayOfEra - DayOfEra / 1460 + DayOfEra / 36524 -
+                DayOfEra / 146096) / 365;
+  DayOfYear  = DayOfEra - (365 * YearOfEra + YearOfEra / 4 - YearOfEra / 100);
+  MonthIndex = (5 * DayOfYear + 2) / 153;
+  Month      = (MonthIndex < 10) ? MonthIndex + 3 : MonthIndex - 9;
+
+  if (Era > (9999 / 400)) {
+    Year = 9999;
+  } else {
+    Year = (UINT32)Era * 400 + YearOfEra + ((Month <= 2) ? 1 : 0);
+  }
+
+  if (Year > 9999) {
+    EfiTime->Year   = 9999;
+    EfiTime->Month  = 12;
+    EfiTime->Day    = 31;
+    EfiTime->Hour   = 23;
+    EfiTime->Minute = 59;
+    EfiTime->Second = 59;
+  } else {
+    EfiTime->Year   = (UINT16)Year;
+    EfiTime->Month  = (UINT8)Month;
+    EfiTime->Day    = (UINT8)(DayOfYear - (153 * MonthIndex + 2) / 5 + 1);
+    EfiTime->Hour   = (UINT8)(SecondOfDay / 3600);
+    EfiTime->Minute = (UINT8)(SecondOfDay % 3600 / 60);
+    EfiTime->Second = (UINT8)(SecondOfDay % 60);
+  }
+
+  EfiTime->TimeZone = EFI_UNSPECIFIED_TIMEZONE;
+}
+
+/**
+  Convert an EFI_TIME to a number of seconds since the Unix epoch.
+
+  @param[in] EfiTime   The EFI_TIME to convert. If the time zone is
+                       specified, it is taken into account; otherwise the
+                       time is interpreted as UTC.
+
+  @param[out] Seconds  Seconds since 1970-01-01 00:00:00 UTC. Times before the
+                       epoch are clamped to zero.
+**/
+VOID
+VirtioFsEfiTimeToEpoch (
+  IN  EFI_TIME  *EfiTime,
+  OUT UINT64    *Seconds
+  )
+{
+  UINT32  Year;
+  UINT32  Era;
+  UINT32  YearOfEra;
+  UINT32  DayOfYear;
+  UINT32  DayOfEra;
+  UINT32  Days;
+  INT64   Result;
+
+  Year      = EfiTime->Year - ((EfiTime->Month <= 2) ? 1 : 0);
+  Era       = Year / 400;
+  YearOfEra = Year - Era * 400;
+  DayOfYear = (153 * ((EfiTime->Month > 2) ? EfiTime->Month - 3 : EfiTime->Month + 9) + 2) / 5 +
+              EfiTime->Day - 1;
+  DayOfEra = YearOfEra * 365 + YearOfEra / 4 - YearOfEra / 100 + DayOfYear;
+  Days     = Era * DAYS_PER_ERA + DayOfEra;
+
+  if (Days < DAYS_FROM_CIVIL_EPOCH_TO_UNIX_EPOCH) {
+    *Seconds = 0;
+    return;
+  }
+
+  Result = (INT64)MultU64x32 (Days - DAYS_FROM_CIVIL_EPOCH_TO_UNIX_EPOCH, SECONDS_PER_DAY) +
+           EfiTime->Hour * 3600 + EfiTime->Minute * 60 + EfiTime->Second;
+
+  //
+  // Localtime = UTC - TimeZone
+  //
+  if (EfiTime->TimeZone != EFI_UNSPECIFIED_TIMEZONE) {
+    Result += (INT64)EfiTime->TimeZone * 60;
+  }
+
+  *Seconds = (Result < 0) ? 0 : (UINT64)Result;
+}
+
+/**
+  Convert FUSE attributes and a file name to an EFI_FILE_INFO structure.
+
+  @param[in] FuseAttr        The FUSE attributes of the file.
+
+  @param[in] Name            The name of the file (not NUL-terminated).
+
+  @param[in] NameLen         The number of characters in Name.
+
+  @param[in,out] BufferSize  On input, the size of FileInfo in bytes. On
+                             output, the size of the converted EFI_FILE_INFO
+                             structure.
+
+  @param[out] FileInfo       The converted EFI_FILE_INFO structure.
+
+  @retval EFI_SUCCESS           FileInfo has been filled in.
+
+  @retval EFI_BUFFER_TOO_SMALL  BufferSize has been updated to the size
+                                needed.
+
+  @retval EFI_UNSUPPORTED       The file is neither a regular file nor a
+                                directory, or its name contains characters
+                                other than printable ASCII.
+**/
+EFI_STATUS
+VirtioFsFuseAttrToEfiFileInfo (
+  IN     VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  *FuseAttr,
+  IN     CHAR8                               *Name,
+  IN     UINTN                               NameLen,
+  IN OUT UINTN                               *BufferSize,
+  OUT    EFI_FILE_INFO                       *FileInfo
+  )
+{
+  UINTN   InfoSize;
+  UINT32  Type;
+  UINTN   Idx;
+
+  Type = FuseAttr->Mode & VIRTIO_FS_FUSE_MODE_TYPE_MASK;
+  if ((Type != VIRTIO_FS_FUSE_MODE_TYPE_REG) &&
+      (Type != VIRTIO_FS_FUSE_MODE_TYPE_DIR))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  for (Idx = 0; Idx < NameLen; Idx++) {
+    if ((Name[Idx] < 0x20) || (Name[Idx] > 0x7E)) {
+      return EFI_UNSUPPORTED;
+    }
+  }
+
+  InfoSize = SIZE_OF_EFI_FILE_INFO + (NameLen + 1) * sizeof (CHAR16);
+  if (*BufferSize < InfoSize) {
+    *BufferSize = InfoSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  FileInfo->Size         = InfoSize;
+  FileInfo->FileSize     = FuseAttr->Size;
+  FileInfo->PhysicalSize = MultU64x32 (FuseAttr->Blocks, 512);
+  VirtioFsEpochToEfiTime (FuseAttr->Ctime, &FileInfo->CreateTime);
+  VirtioFsEpochToEfiTime (FuseAttr->Atime, &FileInfo->LastAccessTime);
+  VirtioFsEpochToEfiTime (FuseAttr->Mtime, &FileInfo->ModificationTime);
+
+  FileInfo->Attribute = (Type == VIRTIO_FS_FUSE_MODE_TYPE_DIR) ?
+                        EFI_FILE_DIRECTORY : EFI_FILE_ARCHIVE;
+  if ((FuseAttr->Mode & VIRTIO_FS_FUSE_MODE_PERM_WUSR) == 0) {
+    FileInfo->Attribute |= EFI_FILE_READ_ONLY;
+  }
+
+  for (Idx = 0; Idx < NameLen; Idx++) {
+    FileInfo->FileName[Idx] = Name[Idx];
+  }
+
+  FileInfo->FileName[NameLen] = L'\0';
+
+  *BufferSize = InfoSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Allocate an open file object, populate its EFI_FILE_PROTOCOL interface, and
+  link it into the list of open files of the Virtio Filesystem device.
+
+  @param[in,out] VirtioFs       The Virtio Filesystem device.
+
+  @param[in] CanonicalPathname  The canonical pathname of the file; ownership
+                                is transferred to the new object on success.
+
+  @param[in] NodeId             The inode number of the file; to be forgotten
+                                when the file is closed.
+
+  @param[in] FuseHandle         The FUSE file handle of the file; to be
+                                released when the file is closed.
+
+  @param[in] IsDirectory        Whether the file is a directory.
+
+  @param[in] IsOpenForWriting   Whether the file has been opened for writing.
+
+  @param[out] NewFile           The new open file object.
+
+  @retval EFI_SUCCESS           NewFile has been set.
+
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+EFI_STATUS
+VirtioFsAllocateFile (
+  IN OUT VIRTIO_FS       *VirtioFs,
+  IN     CHAR8           *CanonicalPathname,
+  IN     UINT64          NodeId,
+  IN     UINT64          FuseHandle,
+  IN     BOOLEAN         IsDirectory,
+  IN     BOOLEAN         IsOpenForWriting,
+  OUT    VIRTIO_FS_FILE  **NewFile
+  )
+{
+  VIRTIO_FS_FILE     *VirtioFsFile;
+  EFI_FILE_PROTOCOL  *SimpleFile;
+
+  VirtioFsFile = AllocateZeroPool (sizeof *VirtioFsFile);
+  if (VirtioFsFile == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  VirtioFsFile->Signature = VIRTIO_FS_FILE_SIG;
+  SimpleFile              = &VirtioFsFile->SimpleFile;
+  SimpleFile->Revision    = EFI_FILE_PROTOCOL_REVISION;
+  SimpleFile->Open        = VirtioFsSimpleFileOpen;
+  SimpleFile->Close       = VirtioFsSimpleFileClose;
+  SimpleFile->Delete      = VirtioFsSimpleFileDelete;
+  SimpleFile->Read        = VirtioFsSimpleFileRead;
+  SimpleFile->Write       = VirtioFsSimpleFileWrite;
+  SimpleFile->GetPosition = VirtioFsSimpleFileGetPosition;
+  SimpleFile->SetPosition = VirtioFsSimpleFileSetPosition;
+  SimpleFile->GetInfo     = VirtioFsSimpleFileGetInfo;
+  SimpleFile->SetInfo     = VirtioFsSimpleFileSetInfo;
+  SimpleFile->Flush       = VirtioFsSimpleFileFlush;
+
+  VirtioFsFile->IsDirectory       = IsDirectory;
+  VirtioFsFile->IsOpenForWriting  = IsOpenForWriting;
+  VirtioFsFile->OwnerFs           = VirtioFs;
+  VirtioFsFile->CanonicalPathname = CanonicalPathname;
+  VirtioFsFile->NodeId            = NodeId;
+  VirtioFsFile->FuseHandle        = FuseHandle;
+
+  InsertTailList (&VirtioFs->OpenFiles, &VirtioFsFile->OpenFilesEntry);
+
+  *NewFile = VirtioFsFile;
+  return EFI_SUCCESS;
+}
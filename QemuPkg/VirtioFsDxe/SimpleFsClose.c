@@ -0,0 +1,140 @@
+/** @file
+  EFI_FILE_PROTOCOL.Close() and EFI_FILE_PROTOCOL.Delete() member functions
+  for the Virtio Filesystem driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/BaseLib.h>             // RemoveEntryList()
+#include <Library/MemoryAllocationLib.h> // FreePool()
+
+#include "VirtioFsDxe.h"
+
+/**
+  Drop the lookup reference that an open file holds on its inode, unlink the
+  file from the list of open files, and release the file object.
+
+  The FUSE file handle must have been released already.
+
+  @param[in] VirtioFsFile  The open file object to tear down.
+**/
+STATIC
+VOID
+VirtioFsFreeFile (
+  IN VIRTIO_FS_FILE  *VirtioFsFile
+  )
+{
+  VIRTIO_FS  *VirtioFs;
+
+  VirtioFs = VirtioFsFile->OwnerFs;
+
+  //
+  // Failure to forget an inode only costs memory on the host; the device
+  // reclaims it when the session ends.
+  //
+  if (VirtioFsFile->NodeId != VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID) {
+    VirtioFsFuseForget (VirtioFs, &VirtioFsFile->NodeId, 1);
+  }
+
+  RemoveEntryList (&VirtioFsFile->OpenFilesEntry);
+  if (VirtioFsFile->DirentBuffer != NULL) {
+    FreePool (VirtioFsFile->DirentBuffer);
+  }
+
+  FreePool (VirtioFsFile->CanonicalPathname);
+  FreePool (VirtioFsFile);
+}
+
+/**
+  Close an open file.
+
+  Refer to EFI_FILE_CLOSE for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileClose (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+
+  //
+  // Close() cannot fail; a failed RELEASE leaves the handle open on the host
+  // only until the session ends.
+  //
+  VirtioFsFuseRelease (
+    VirtioFsFile->OwnerFs,
+    VirtioFsFile->NodeId,
+    VirtioFsFile->FuseHandle,
+    VirtioFsFile->IsDirectory
+    );
+  VirtioFsFreeFile (VirtioFsFile);
+  return EFI_SUCCESS;
+}
+
+/**
+  Close and delete an open file.
+
+  Refer to EFI_FILE_DELETE for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileDelete (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+  VIRTIO_FS       *VirtioFs;
+  UINT64          ParentNodeId;
+  CHAR8           *LastComponent;
+  EFI_STATUS      Status;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+  VirtioFs     = VirtioFsFile->OwnerFs;
+
+  //
+  // The handle has to be released before the file is removed, so that the
+  // host can reclaim the storage immediately.
+  //
+  VirtioFsFuseRelease (
+    VirtioFs,
+    VirtioFsFile->NodeId,
+    VirtioFsFile->FuseHandle,
+    VirtioFsFile->IsDirectory
+    );
+
+  Status = EFI_WARN_DELETE_FAILURE;
+  if (VirtioFsFile->IsOpenForWriting &&
+      (VirtioFsFile->NodeId != VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID))
+  {
+    Status = VirtioFsLookupPath (
+               VirtioFs,
+               VirtioFsFile->CanonicalPathname,
+               TRUE,
+               &ParentNodeId,
+               &LastComponent
+               );
+    if (!EFI_ERROR (Status)) {
+      Status = VirtioFsFuseRemoveFileOrDir (
+                 VirtioFs,
+                 ParentNodeId,
+                 LastComponent,
+                 VirtioFsFile->IsDirectory
+                 );
+      if (ParentNodeId != VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID) {
+        VirtioFsFuseForget (VirtioFs, &ParentNodeId, 1);
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      Status = EFI_WARN_DELETE_FAILURE;
+    }
+  }
+
+  VirtioFsFreeFile (VirtioFsFile);
+  return Status;
+}
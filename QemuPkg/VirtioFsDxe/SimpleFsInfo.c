@@ -0,0 +1,349 @@
+/** @file
+  EFI_FILE_PROTOCOL.GetInfo() and EFI_FILE_PROTOCOL.SetInfo() member functions
+  for the Virtio Filesystem driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Guid/FileSystemInfo.h>            // gEfiFileSystemInfoGuid
+#include <Guid/FileSystemVolumeLabelInfo.h> // gEfiFileSystemVolumeLabelInfo...
+#include <Library/BaseLib.h>                // StrSize()
+#include <Library/BaseMemoryLib.h>          // CompareGuid()
+
+#include "VirtioFsDxe.h"
+
+/**
+  Fill in an EFI_FILE_INFO structure for an open file.
+
+  @param[in] VirtioFsFile    The open file.
+
+  @param[in,out] BufferSize  See EFI_FILE_GET_INFO.
+
+  @param[out] Buffer         See EFI_FILE_GET_INFO.
+
+  @return  Status codes from VirtioFsFuseGetAttr() and
+           VirtioFsFuseAttrToEfiFileInfo().
+**/
+STATIC
+EFI_STATUS
+VirtioFsGetFileInfo (
+  IN     VIRTIO_FS_FILE  *VirtioFsFile,
+  IN OUT UINTN           *BufferSize,
+  OUT    VOID            *Buffer
+  )
+{
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  FuseAttr;
+  CHAR8                               *Basename;
+  EFI_STATUS                          Status;
+
+  Status = VirtioFsFuseGetAttr (
+             VirtioFsFile->OwnerFs,
+             VirtioFsFile->NodeId,
+             &FuseAttr
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Basename = VirtioFsGetBasename (VirtioFsFile->CanonicalPathname);
+  return VirtioFsFuseAttrToEfiFileInfo (
+           &FuseAttr,
+           Basename,
+           AsciiStrLen (Basename),
+           BufferSize,
+           Buffer
+           );
+}
+
+/**
+  Fill in an EFI_FILE_SYSTEM_INFO structure for the Virtio Filesystem.
+
+  @param[in,out] VirtioFs    The Virtio Filesystem device.
+
+  @param[in,out] BufferSize  See EFI_FILE_GET_INFO.
+
+  @param[out] Buffer         See EFI_FILE_GET_INFO.
+
+  @return  Status codes from VirtioFsFuseStatFs().
+**/
+STATIC
+EFI_STATUS
+VirtioFsGetFileSystemInfo (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN OUT UINTN      *BufferSize,
+  OUT    VOID       *Buffer
+  )
+{
+  UINTN                           LabelSize;
+  UINTN                           InfoSize;
+  EFI_FILE_SYSTEM_INFO            *FilesysInfo;
+  VIRTIO_FS_FUSE_STATFS_RESPONSE  FilesysAttr;
+  EFI_STATUS                      Status;
+
+  LabelSize = StrSize (VirtioFs->Label);
+  InfoSize  = SIZE_OF_EFI_FILE_SYSTEM_INFO + LabelSize;
+  if (*BufferSize < InfoSize) {
+    *BufferSize = InfoSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Status = VirtioFsFuseStatFs (VirtioFs, &FilesysAttr);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  FilesysInfo             = Buffer;
+  FilesysInfo->Size       = InfoSize;
+  FilesysInfo->ReadOnly   = FALSE;
+  FilesysInfo->VolumeSize = MultU64x32 (FilesysAttr.Blocks, FilesysAttr.Frsize);
+  FilesysInfo->FreeSpace  = MultU64x32 (FilesysAttr.Bavail, FilesysAttr.Frsize);
+  FilesysInfo->BlockSize  = FilesysAttr.Bsize;
+  CopyMem (FilesysInfo->VolumeLabel, VirtioFs->Label, LabelSize);
+
+  *BufferSize = InfoSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Fill in an EFI_FILE_SYSTEM_VOLUME_LABEL structure for the Virtio Filesystem.
+
+  @param[in] VirtioFs        The Virtio Filesystem device.
+
+  @param[in,out] BufferSize  See EFI_FILE_GET_INFO.
+
+  @param[out] Buffer         See EFI_FILE_GET_INFO.
+
+  @retval EFI_SUCCESS           The label has been copied.
+
+  @retval EFI_BUFFER_TOO_SMALL  BufferSize has been set to the size needed.
+**/
+STATIC
+EFI_STATUS
+VirtioFsGetVolumeLabel (
+  IN     VIRTIO_FS  *VirtioFs,
+  IN OUT UINTN      *BufferSize,
+  OUT    VOID       *Buffer
+  )
+{
+  UINTN                         LabelSize;
+  UINTN                         InfoSize;
+  EFI_FILE_SYSTEM_VOLUME_LABEL  *VolumeLabel;
+
+  LabelSize = StrSize (VirtioFs->Label);
+  InfoSize  = SIZE_OF_EFI_FILE_SYSTEM_VOLUME_LABEL + LabelSize;
+  if (*BufferSize < InfoSize) {
+    *BufferSize = InfoSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  VolumeLabel = Buffer;
+  CopyMem (VolumeLabel->VolumeLabel, VirtioFs->Label, LabelSize);
+
+  *BufferSize = InfoSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Return information about an open file or the Virtio Filesystem.
+
+  Refer to EFI_FILE_GET_INFO for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileGetInfo (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN     EFI_GUID           *InformationType,
+  IN OUT UINTN              *BufferSize,
+  OUT    VOID               *Buffer
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+
+  if (CompareGuid (InformationType, &gEfiFileInfoGuid)) {
+    return VirtioFsGetFileInfo (VirtioFsFile, BufferSize, Buffer);
+  }
+
+  if (CompareGuid (InformationType, &gEfiFileSystemInfoGuid)) {
+    return VirtioFsGetFileSystemInfo (VirtioFsFile->OwnerFs, BufferSize, Buffer);
+  }
+
+  if (CompareGuid (InformationType, &gEfiFileSystemVolumeLabelInfoIdGuid)) {
+    return VirtioFsGetVolumeLabel (VirtioFsFile->OwnerFs, BufferSize, Buffer);
+  }
+
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Apply an EFI_FILE_INFO structure to an open file.
+
+  The size, the read-only attribute, and the last access and modification
+  times can be changed. Renaming is not supported.
+
+  @param[in] VirtioFsFile  The open file.
+
+  @param[in] BufferSize    See EFI_FILE_SET_INFO.
+
+  @param[in] FileInfo      See EFI_FILE_SET_INFO.
+
+  @retval EFI_SUCCESS            The requested changes have been applied.
+
+  @retval EFI_BAD_BUFFER_SIZE    FileInfo is malformed.
+
+  @retval EFI_INVALID_PARAMETER  FileInfo sets unknown attributes.
+
+  @retval EFI_ACCESS_DENIED      The file is not open for writing, the
+                                 request would turn a file into a directory or
+                                 vice versa, or the request would rename the
+                                 file.
+
+  @return                        Error codes from VirtioFsFuseGetAttr() and
+                                 VirtioFsFuseSetAttr().
+**/
+STATIC
+EFI_STATUS
+VirtioFsSetFileInfo (
+  IN VIRTIO_FS_FILE  *VirtioFsFile,
+  IN UINTN           BufferSize,
+  IN EFI_FILE_INFO   *FileInfo
+  )
+{
+  UINTN                               NameChars;
+  UINTN                               Idx;
+  CHAR8                               *Basename;
+  BOOLEAN                             IsReadOnly;
+  UINT64                              Seconds;
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  FuseAttr;
+  VIRTIO_FS_FUSE_SETATTR_REQUEST      SetAttr;
+  EFI_STATUS                          Status;
+
+  if ((BufferSize < SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16)) ||
+      (FileInfo->Size != BufferSize))
+  {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  NameChars = (BufferSize - SIZE_OF_EFI_FILE_INFO) / sizeof (CHAR16);
+  if (FileInfo->FileName[NameChars - 1] != L'\0') {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  if ((FileInfo->Attribute & ~EFI_FILE_VALID_ATTR) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (VirtioFsFile->IsDirectory !=
+      ((FileInfo->Attribute & EFI_FILE_DIRECTORY) != 0))
+  {
+    return EFI_ACCESS_DENIED;
+  }
+
+  //
+  // Every file other than the root directory must keep its current name. The
+  // name passed in for the root directory is ignored.
+  //
+  Basename = VirtioFsGetBasename (VirtioFsFile->CanonicalPathname);
+  for (Idx = 0; Basename[Idx] != '\0'; Idx++) {
+    if (FileInfo->FileName[Idx] != (CHAR16)Basename[Idx]) {
+      return EFI_ACCESS_DENIED;
+    }
+  }
+
+  if ((FileInfo->FileName[Idx] != L'\0') && (Basename[0] != '\0')) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  Status = VirtioFsFuseGetAttr (
+             VirtioFsFile->OwnerFs,
+             VirtioFsFile->NodeId,
+             &FuseAttr
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ZeroMem (&SetAttr, sizeof SetAttr);
+
+  if (!VirtioFsFile->IsDirectory && (FileInfo->FileSize != FuseAttr.Size)) {
+    SetAttr.Valid     |= VIRTIO_FS_FUSE_SETATTR_REQ_F_SIZE |
+                         VIRTIO_FS_FUSE_SETATTR_REQ_F_FH;
+    SetAttr.FileHandle = VirtioFsFile->FuseHandle;
+    SetAttr.Size       = FileInfo->FileSize;
+  }
+
+  IsReadOnly = (BOOLEAN)((FuseAttr.Mode & VIRTIO_FS_FUSE_MODE_PERM_WUSR) == 0);
+  if (IsReadOnly != ((FileInfo->Attribute & EFI_FILE_READ_ONLY) != 0)) {
+    SetAttr.Valid |= VIRTIO_FS_FUSE_SETATTR_REQ_F_MODE;
+    SetAttr.Mode   = (FuseAttr.Mode & ~VIRTIO_FS_FUSE_MODE_TYPE_MASK) ^
+                     VIRTIO_FS_FUSE_MODE_PERM_WUSR;
+  }
+
+  //
+  // A zero Year means "leave the time stamp alone"; the creation time cannot
+  // be set on the host.
+  //
+  if (FileInfo->LastAccessTime.Year != 0) {
+    VirtioFsEfiTimeToEpoch (&FileInfo->LastAccessTime, &Seconds);
+    if (Seconds != FuseAttr.Atime) {
+      SetAttr.Valid |= VIRTIO_FS_FUSE_SETATTR_REQ_F_ATIME;
+      SetAttr.Atime  = Seconds;
+    }
+  }
+
+  if (FileInfo->ModificationTime.Year != 0) {
+    VirtioFsEfiTimeToEpoch (&FileInfo->ModificationTime, &Seconds);
+    if (Seconds != FuseAttr.Mtime) {
+      SetAttr.Valid |= VIRTIO_FS_FUSE_SETATTR_REQ_F_MTIME;
+      SetAttr.Mtime  = Seconds;
+    }
+  }
+
+  if (SetAttr.Valid == 0) {
+    return EFI_SUCCESS;
+  }
+
+  if (!VirtioFsFile->IsOpenForWriting) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  return VirtioFsFuseSetAttr (VirtioFsFile->OwnerFs, VirtioFsFile->NodeId, &SetAttr);
+}
+
+/**
+  Change information about an open file.
+
+  Refer to EFI_FILE_SET_INFO for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileSetInfo (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN EFI_GUID           *InformationType,
+  IN UINTN              BufferSize,
+  IN VOID               *Buffer
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+
+  if (CompareGuid (InformationType, &gEfiFileInfoGuid)) {
+    return VirtioFsSetFileInfo (VirtioFsFile, BufferSize, Buffer);
+  }
+
+  //
+  // The filesystem label is the virtio-fs tag, which is configured on the
+  // host.
+  //
+  if (CompareGuid (InformationType, &gEfiFileSystemInfoGuid) ||
+      CompareGuid (InformationType, &gEfiFileSystemVolumeLabelInfoIdGuid))
+  {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  return EFI_UNSUPPORTED;
+}
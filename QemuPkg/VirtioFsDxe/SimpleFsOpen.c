@@ -0,0 +1,203 @@
+/** @file
+  EFI_FILE_PROTOCOL.Open() member function for the Virtio Filesystem driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/BaseLib.h>             // AsciiStrCmp()
+#include <Library/MemoryAllocationLib.h> // FreePool()
+
+#include "VirtioFsDxe.h"
+
+/**
+  Open or create a file relative to an open directory (or the directory of an
+  open file).
+
+  Refer to EFI_FILE_OPEN for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileOpen (
+  IN     EFI_FILE_PROTOCOL  *This,
+  OUT    EFI_FILE_PROTOCOL  **NewHandle,
+  IN     CHAR16             *FileName,
+  IN     UINT64             OpenMode,
+  IN     UINT64             Attributes
+  )
+{
+  VIRTIO_FS_FILE                      *VirtioFsFile;
+  VIRTIO_FS                           *VirtioFs;
+  VIRTIO_FS_FILE                      *NewVirtioFsFile;
+  BOOLEAN                             OpenForWriting;
+  BOOLEAN                             PermitCreation;
+  BOOLEAN                             IsDirectory;
+  CHAR8                               *NewCanonicalPath;
+  CHAR8                               *LastComponent;
+  UINT64                              ParentNodeId;
+  UINT64                              NodeId;
+  UINT64                              FuseHandle;
+  UINT32                              Type;
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  FuseAttr;
+  EFI_STATUS                          Status;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+  VirtioFs     = VirtioFsFile->OwnerFs;
+
+  switch (OpenMode) {
+    case EFI_FILE_MODE_READ:
+      OpenForWriting = FALSE;
+      PermitCreation = FALSE;
+      break;
+    case EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE:
+      OpenForWriting = TRUE;
+      PermitCreation = FALSE;
+      break;
+    case EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE:
+      OpenForWriting = TRUE;
+      PermitCreation = TRUE;
+      break;
+    default:
+      return EFI_INVALID_PARAMETER;
+  }
+
+  if (PermitCreation && ((Attributes & ~EFI_FILE_VALID_ATTR) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = VirtioFsComposePath (
+             VirtioFsFile->CanonicalPathname,
+             FileName,
+             &NewCanonicalPath
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // The root directory is not looked up by name; its inode number is fixed,
+  // and it is never forgotten.
+  //
+  if (AsciiStrCmp (NewCanonicalPath, "/") == 0) {
+    NodeId      = VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID;
+    IsDirectory = TRUE;
+    Status      = VirtioFsFuseOpen (VirtioFs, NodeId, TRUE, FALSE, &FuseHandle);
+    if (EFI_ERROR (Status)) {
+      goto FreeNewCanonicalPath;
+    }
+
+    goto AllocateFile;
+  }
+
+  Status = VirtioFsLookupPath (
+             VirtioFs,
+             NewCanonicalPath,
+             TRUE,
+             &ParentNodeId,
+             &LastComponent
+             );
+  if (EFI_ERROR (Status)) {
+    goto FreeNewCanonicalPath;
+  }
+
+  Status = VirtioFsFuseLookup (
+             VirtioFs,
+             ParentNodeId,
+             LastComponent,
+             &NodeId,
+             &FuseAttr
+             );
+  if (!EFI_ERROR (Status)) {
+    Type = FuseAttr.Mode & VIRTIO_FS_FUSE_MODE_TYPE_MASK;
+    if ((Type != VIRTIO_FS_FUSE_MODE_TYPE_REG) &&
+        (Type != VIRTIO_FS_FUSE_MODE_TYPE_DIR))
+    {
+      Status = EFI_UNSUPPORTED;
+      goto ForgetNode;
+    }
+
+    if (OpenForWriting &&
+        ((FuseAttr.Mode & VIRTIO_FS_FUSE_MODE_PERM_WUSR) == 0))
+    {
+      Status = EFI_ACCESS_DENIED;
+      goto ForgetNode;
+    }
+
+    IsDirectory = (BOOLEAN)(Type == VIRTIO_FS_FUSE_MODE_TYPE_DIR);
+    Status      = VirtioFsFuseOpen (
+                    VirtioFs,
+                    NodeId,
+                    IsDirectory,
+                    OpenForWriting,
+                    &FuseHandle
+                    );
+  } else if ((Status == EFI_NOT_FOUND) && PermitCreation) {
+    IsDirectory = (BOOLEAN)((Attributes & EFI_FILE_DIRECTORY) != 0);
+    if (IsDirectory) {
+      Status = VirtioFsFuseMkDir (VirtioFs, ParentNodeId, LastComponent, &NodeId);
+      if (EFI_ERROR (Status)) {
+        goto ForgetParent;
+      }
+
+      Status = VirtioFsFuseOpen (VirtioFs, NodeId, TRUE, FALSE, &FuseHandle);
+    } else {
+      Status = VirtioFsFuseCreate (
+                 VirtioFs,
+                 ParentNodeId,
+                 LastComponent,
+                 (BOOLEAN)((Attributes & EFI_FILE_READ_ONLY) != 0),
+                 &NodeId,
+                 &FuseHandle
+                 );
+      if (EFI_ERROR (Status)) {
+        goto ForgetParent;
+      }
+    }
+  } else {
+    goto ForgetParent;
+  }
+
+  if (EFI_ERROR (Status)) {
+    goto ForgetNode;
+  }
+
+  if (ParentNodeId != VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID) {
+    VirtioFsFuseForget (VirtioFs, &ParentNodeId, 1);
+  }
+
+AllocateFile:
+  Status = VirtioFsAllocateFile (
+             VirtioFs,
+             NewCanonicalPath,
+             NodeId,
+             FuseHandle,
+             IsDirectory,
+             OpenForWriting,
+             &NewVirtioFsFile
+             );
+  if (EFI_ERROR (Status)) {
+    VirtioFsFuseRelease (VirtioFs, NodeId, FuseHandle, IsDirectory);
+    if (NodeId != VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID) {
+      VirtioFsFuseForget (VirtioFs, &NodeId, 1);
+    }
+
+    goto FreeNewCanonicalPath;
+  }
+
+  *NewHandle = &NewVirtioFsFile->SimpleFile;
+  return EFI_SUCCESS;
+
+ForgetNode:
+  VirtioFsFuseForget (VirtioFs, &NodeId, 1);
+
+ForgetParent:
+  if (ParentNodeId != VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID) {
+    VirtioFsFuseForget (VirtioFs, &ParentNodeId, 1);
+  }
+
+FreeNewCanonicalPath:
+  FreePool (NewCanonicalPath);
+
+  return Status;
+}
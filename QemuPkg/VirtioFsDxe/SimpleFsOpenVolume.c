@@ -0,0 +1,74 @@
+/** @file
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL.OpenVolume() member function for the Virtio
+  Filesystem driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/MemoryAllocationLib.h> // AllocateCopyPool()
+
+#include "VirtioFsDxe.h"
+
+/**
+  Open the root directory on the Virtio Filesystem.
+
+  Refer to EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_OPEN_VOLUME for the interface
+  contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsOpenVolume (
+  IN  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *This,
+  OUT EFI_FILE_PROTOCOL                **Root
+  )
+{
+  VIRTIO_FS       *VirtioFs;
+  VIRTIO_FS_FILE  *VirtioFsFile;
+  CHAR8           *CanonicalPathname;
+  UINT64          FuseHandle;
+  EFI_STATUS      Status;
+
+  VirtioFs = VIRTIO_FS_FROM_SIMPLE_FS (This);
+
+  CanonicalPathname = AllocateCopyPool (sizeof "/", "/");
+  if (CanonicalPathname == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = VirtioFsFuseOpen (
+             VirtioFs,
+             VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID,
+             TRUE,  // IsDir
+             FALSE, // ReadWrite
+             &FuseHandle
+             );
+  if (EFI_ERROR (Status)) {
+    goto FreeCanonicalPathname;
+  }
+
+  Status = VirtioFsAllocateFile (
+             VirtioFs,
+             CanonicalPathname,
+             VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID,
+             FuseHandle,
+             TRUE,  // IsDirectory
+             FALSE, // IsOpenForWriting
+             &VirtioFsFile
+             );
+  if (EFI_ERROR (Status)) {
+    goto ReleaseRootDir;
+  }
+
+  *Root = &VirtioFsFile->SimpleFile;
+  return EFI_SUCCESS;
+
+ReleaseRootDir:
+  VirtioFsFuseRelease (VirtioFs, VIRTIO_FS_FUSE_ROOT_DIR_NODE_ID, FuseHandle, TRUE);
+
+FreeCanonicalPathname:
+  FreePool (CanonicalPathname);
+
+  return Status;
+}
@@ -0,0 +1,84 @@
+/** @file
+  EFI_FILE_PROTOCOL.GetPosition() and EFI_FILE_PROTOCOL.SetPosition() member
+  functions for the Virtio Filesystem driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "VirtioFsDxe.h"
+
+/**
+  Return the current file position of an open regular file.
+
+  Refer to EFI_FILE_GET_POSITION for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileGetPosition (
+  IN     EFI_FILE_PROTOCOL  *This,
+  OUT    UINT64             *Position
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+  if (VirtioFsFile->IsDirectory) {
+    return EFI_UNSUPPORTED;
+  }
+
+  *Position = VirtioFsFile->FilePosition;
+  return EFI_SUCCESS;
+}
+
+/**
+  Set the file position of an open regular file, or rewind an open directory.
+
+  Refer to EFI_FILE_SET_POSITION for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileSetPosition (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN UINT64             Position
+  )
+{
+  VIRTIO_FS_FILE                      *VirtioFsFile;
+  VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  FuseAttr;
+  EFI_STATUS                          Status;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+
+  if (VirtioFsFile->IsDirectory) {
+    if (Position != 0) {
+      return EFI_UNSUPPORTED;
+    }
+
+    VirtioFsFile->DirentSize   = 0;
+    VirtioFsFile->DirentOffset = 0;
+    VirtioFsFile->DirentCookie = 0;
+    VirtioFsFile->DirentEnd    = FALSE;
+    return EFI_SUCCESS;
+  }
+
+  //
+  // MAX_UINT64 requests the end of the file, which the host may have changed
+  // since the file was opened.
+  //
+  if (Position == MAX_UINT64) {
+    Status = VirtioFsFuseGetAttr (
+               VirtioFsFile->OwnerFs,
+               VirtioFsFile->NodeId,
+               &FuseAttr
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Position = FuseAttr.Size;
+  }
+
+  VirtioFsFile->FilePosition = Position;
+  return EFI_SUCCESS;
+}
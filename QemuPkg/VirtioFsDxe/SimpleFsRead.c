@@ -0,0 +1,248 @@
+/** @file
+  EFI_FILE_PROTOCOL.Read() member function for the Virtio Filesystem driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/MemoryAllocationLib.h> // AllocatePool()
+
+#include "VirtioFsDxe.h"
+
+//
+// The maximum number of directory entries that a single
+// VIRTIO_FS_DIRENT_BUFFER_SIZE buffer can carry.
+//
+#define VIRTIO_FS_MAX_DIRENTS_PER_BUFFER \
+  (VIRTIO_FS_DIRENT_BUFFER_SIZE / sizeof (VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE))
+
+/**
+  Fetch the next batch of directory entries into VirtioFsFile->DirentBuffer,
+  validate their framing, and drop the lookup references that the device took
+  on the inodes of the entries, with a single batch of FORGET requests.
+
+  @param[in,out] VirtioFsFile  The open directory. On success, DirentBuffer,
+                               DirentSize, DirentOffset and DirentEnd are
+                               updated.
+
+  @retval EFI_SUCCESS           The buffer has been refilled, or the end of
+                                the directory stream has been reached.
+
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+
+  @retval EFI_DEVICE_ERROR      The device produced malformed entries.
+
+  @return                       Error codes from VirtioFsFuseReadDirPlus().
+**/
+STATIC
+EFI_STATUS
+VirtioFsRefillDirents (
+  IN OUT VIRTIO_FS_FILE  *VirtioFsFile
+  )
+{
+  VIRTIO_FS                           *VirtioFs;
+  UINT32                              Size;
+  UINT32                              Offset;
+  UINT32                              EntrySize;
+  VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE  *Dirent;
+  UINT64                              NodeIds[VIRTIO_FS_MAX_DIRENTS_PER_BUFFER];
+  UINTN                               NodeIdCount;
+  EFI_STATUS                          Status;
+
+  VirtioFs = VirtioFsFile->OwnerFs;
+
+  if (VirtioFsFile->DirentBuffer == NULL) {
+    VirtioFsFile->DirentBuffer = AllocatePool (VIRTIO_FS_DIRENT_BUFFER_SIZE);
+    if (VirtioFsFile->DirentBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  VirtioFsFile->DirentSize   = 0;
+  VirtioFsFile->DirentOffset = 0;
+
+  Size   = VIRTIO_FS_DIRENT_BUFFER_SIZE;
+  Status = VirtioFsFuseReadDirPlus (
+             VirtioFs,
+             VirtioFsFile->NodeId,
+             VirtioFsFile->FuseHandle,
+             VirtioFsFile->DirentCookie,
+             VirtioFsFile->DirentBuffer,
+             &Size
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Size == 0) {
+    VirtioFsFile->DirentEnd = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  NodeIdCount = 0;
+  Offset      = 0;
+  while (Offset < Size) {
+    if (Size - Offset < sizeof *Dirent) {
+      Status = EFI_DEVICE_ERROR;
+      break;
+    }
+
+    Dirent    = (VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE *)(VirtioFsFile->DirentBuffer + Offset);
+    EntrySize = (UINT32)VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE_SIZE (Dirent->Namelen);
+    if ((Dirent->Namelen == 0) || (Dirent->Namelen > Size) ||
+        (EntrySize > Size - Offset))
+    {
+      Status = EFI_DEVICE_ERROR;
+      break;
+    }
+
+    if (Dirent->Node.NodeId != 0) {
+      NodeIds[NodeIdCount++] = Dirent->Node.NodeId;
+    }
+
+    Offset += EntrySize;
+  }
+
+  //
+  // Every inode that the device looked up has to be forgotten, even if the
+  // batch turns out to be unusable.
+  //
+  if (NodeIdCount > 0) {
+    VirtioFsFuseForget (VirtioFs, NodeIds, NodeIdCount);
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: Label=\"%s\" malformed entry at offset %u of %u\n",
+      __FUNCTION__,
+      VirtioFs->Label,
+      Offset,
+      Size
+      ));
+    return Status;
+  }
+
+  VirtioFsFile->DirentSize = Size;
+  return EFI_SUCCESS;
+}
+
+/**
+  Return the next directory entry as an EFI_FILE_INFO structure.
+
+  Entries that EFI_FILE_INFO cannot express (such as "." and "..", special
+  files, and names with non-ASCII characters) are skipped.
+
+  @param[in,out] VirtioFsFile  The open directory.
+
+  @param[in,out] BufferSize    On input, the size of Buffer. On output, the
+                               size of the entry returned, zero at the end of
+                               the directory, or the size needed.
+
+  @param[out] Buffer           The EFI_FILE_INFO structure of the entry.
+
+  @retval EFI_SUCCESS           BufferSize and Buffer have been set.
+
+  @retval EFI_BUFFER_TOO_SMALL  BufferSize has been set to the size needed.
+                                The entry remains the next one to return.
+
+  @return                       Error codes from VirtioFsRefillDirents().
+**/
+STATIC
+EFI_STATUS
+VirtioFsReadDirectory (
+  IN OUT VIRTIO_FS_FILE  *VirtioFsFile,
+  IN OUT UINTN           *BufferSize,
+  OUT    VOID            *Buffer
+  )
+{
+  VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE  *Dirent;
+  CHAR8                               *Name;
+  EFI_STATUS                          Status;
+
+  for ( ; ;) {
+    if (VirtioFsFile->DirentOffset >= VirtioFsFile->DirentSize) {
+      if (VirtioFsFile->DirentEnd) {
+        *BufferSize = 0;
+        return EFI_SUCCESS;
+      }
+
+      Status = VirtioFsRefillDirents (VirtioFsFile);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      continue;
+    }
+
+    Dirent = (VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE *)(VirtioFsFile->DirentBuffer +
+                                                    VirtioFsFile->DirentOffset);
+    Name = (CHAR8 *)(Dirent + 1);
+
+    Status = EFI_UNSUPPORTED;
+    if ((Dirent->Node.NodeId != 0) &&
+        !((Dirent->Namelen == 1) && (Name[0] == '.')) &&
+        !((Dirent->Namelen == 2) && (Name[0] == '.') && (Name[1] == '.')))
+    {
+      Status = VirtioFsFuseAttrToEfiFileInfo (
+                 &Dirent->Attr,
+                 Name,
+                 Dirent->Namelen,
+                 BufferSize,
+                 Buffer
+                 );
+      if (Status == EFI_BUFFER_TOO_SMALL) {
+        return Status;
+      }
+    }
+
+    VirtioFsFile->DirentCookie  = Dirent->CookieForNextEntry;
+    VirtioFsFile->DirentOffset += (UINT32)VIRTIO_FS_FUSE_DIRENTPLUS_RESPONSE_SIZE (
+                                            Dirent->Namelen
+                                            );
+    if (!EFI_ERROR (Status)) {
+      return EFI_SUCCESS;
+    }
+  }
+}
+
+/**
+  Read from an open regular file, or fetch the next entry from an open
+  directory.
+
+  Refer to EFI_FILE_READ for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileRead (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT UINTN              *BufferSize,
+  OUT    VOID               *Buffer
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+  EFI_STATUS      Status;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+
+  if (VirtioFsFile->IsDirectory) {
+    return VirtioFsReadDirectory (VirtioFsFile, BufferSize, Buffer);
+  }
+
+  Status = VirtioFsFuseTransfer (
+             VirtioFsFile->OwnerFs,
+             VirtioFsFile->NodeId,
+             VirtioFsFile->FuseHandle,
+             VirtioFsFile->FilePosition,
+             FALSE,
+             Buffer,
+             BufferSize
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  VirtioFsFile->FilePosition += *BufferSize;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/** @file
+  EFI_FILE_PROTOCOL.Write() and EFI_FILE_PROTOCOL.Flush() member functions
+  for the Virtio Filesystem driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "VirtioFsDxe.h"
+
+/**
+  Write to an open regular file, at the current file position.
+
+  Refer to EFI_FILE_WRITE for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileWrite (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT UINTN              *BufferSize,
+  IN     VOID               *Buffer
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+  EFI_STATUS      Status;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+
+  if (VirtioFsFile->IsDirectory) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (!VirtioFsFile->IsOpenForWriting) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  Status = VirtioFsFuseTransfer (
+             VirtioFsFile->OwnerFs,
+             VirtioFsFile->NodeId,
+             VirtioFsFile->FuseHandle,
+             VirtioFsFile->FilePosition,
+             TRUE,
+             Buffer,
+             BufferSize
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  VirtioFsFile->FilePosition += *BufferSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Flush the data written to an open file to the host's storage.
+
+  Refer to EFI_FILE_FLUSH for the interface contract.
+**/
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileFlush (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  VIRTIO_FS_FILE  *VirtioFsFile;
+
+  VirtioFsFile = VIRTIO_FS_FILE_FROM_SIMPLE_FILE (This);
+
+  if (!VirtioFsFile->IsOpenForWriting) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  //
+  // Directory contents are not written through EFI_FILE_PROTOCOL; nothing to
+  // flush.
+  //
+  if (VirtioFsFile->IsDirectory) {
+    return EFI_SUCCESS;
+  }
+
+  return VirtioFsFuseFsync (
+           VirtioFsFile->OwnerFs,
+           VirtioFsFile->NodeId,
+           VirtioFsFile->FuseHandle
+           );
+}
@@ -0,0 +1,484 @@
+/** @file
+  Internal macro definitions, type definitions, and function declarations for
+  the Virtio Filesystem device driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _VIRTIO_FS_DXE_H_
+#define _VIRTIO_FS_DXE_H_
+
+#include <Base.h>                      // SIGNATURE_64()
+#include <Guid/FileInfo.h>             // EFI_FILE_INFO
+#include <IndustryStandard/VirtioFs.h> // VIRTIO_FS_TAG_BYTES
+#include <Library/DebugLib.h>          // CR()
+#include <Protocol/SimpleFileSystem.h> // EFI_SIMPLE_FILE_SYSTEM_PROTOCOL
+#include <Protocol/VirtioDevice.h>     // VIRTIO_DEVICE_PROTOCOL
+
+#define VIRTIO_FS_SIG  SIGNATURE_64 ('V', 'I', 'R', 'T', 'I', 'O', 'F', 'S')
+
+#define VIRTIO_FS_FILE_SIG \
+  SIGNATURE_64 ('V', 'I', 'O', 'F', 'S', 'F', 'I', 'L')
+
+//
+// The maximum number of requests that the driver keeps in flight at the same
+// time. Multi-request transfers (file reads and writes) are split into chunks
+// of VIRTIO_FS.MaxTransfer bytes, and up to this many chunks are submitted to
+// the device with a single notification.
+//
+#define VIRTIO_FS_MAX_PIPELINE  8
+
+//
+// Each request takes three descriptors: the request header and its fixed body
+// (device-readable), the response header and its fixed body (device-
+// writeable), and an optional variable-size data buffer.
+//
+#define VIRTIO_FS_DESCS_PER_REQUEST  3
+
+//
+// Sizes of the per-request buffers that carry the fixed parts of requests and
+// responses. The request buffer also accommodates a single NUL-terminated
+// path component, and a batch of VIRTIO_FS_FUSE_FORGET_ONE elements.
+//
+#define VIRTIO_FS_REQUEST_BUFFER_SIZE   512
+#define VIRTIO_FS_RESPONSE_BUFFER_SIZE  256
+
+//
+// Upper and lower bounds on the size of a single read or write request.
+//
+#define VIRTIO_FS_MIN_TRANSFER  SIZE_4KB
+#define VIRTIO_FS_MAX_TRANSFER  SIZE_1MB
+
+//
+// The size of the buffer with which directory entries are fetched from the
+// device, with VirtioFsFuseOpReadDirPlus.
+//
+#define VIRTIO_FS_DIRENT_BUFFER_SIZE  SIZE_8KB
+
+//
+// Filesystem label encoded in UCS-2, transformed from the UTF-8 representation
+// in "VIRTIO_FS_CONFIG.Tag", and NUL-terminated. Only the printable ASCII code
+// points (U+0020 through U+007E) are supported.
+//
+typedef CHAR16 VIRTIO_FS_LABEL[VIRTIO_FS_TAG_BYTES + 1];
+
+//
+// The buffers of a single request slot. The array of slots is allocated in
+// memory that is shared with the device for the lifetime of the driver
+// instance.
+//
+typedef struct {
+  UINT8    Request[VIRTIO_FS_REQUEST_BUFFER_SIZE];
+  UINT8    Response[VIRTIO_FS_RESPONSE_BUFFER_SIZE];
+} VIRTIO_FS_SLOT;
+
+//
+// Describes a request that is about to be submitted, and its outcome.
+//
+typedef struct {
+  //
+  // Set by the caller. Number of bytes in the slot's request buffer to send,
+  // and number of bytes in the slot's response buffer that the device is
+  // expected to fill in on success, including the respective FUSE headers.
+  //
+  UINT32                  RequestSize;
+  UINT32                  ResponseSize;
+  //
+  // Set by the caller. Optional data buffer, already mapped for the device.
+  // DataSize is zero if there is no data buffer. DataToDevice is TRUE for
+  // data sent with the request, FALSE for data received with the response.
+  //
+  EFI_PHYSICAL_ADDRESS    DataDeviceAddress;
+  UINT32                  DataSize;
+  BOOLEAN                 DataToDevice;
+  //
+  // Set by VirtioFsSubmitRequests(). Errno is zero on success, and a positive
+  // errno value reported by the device otherwise. DataReceived is the number
+  // of bytes that the device produced in the data buffer.
+  //
+  INT32                   Errno;
+  UINT32                  DataReceived;
+} VIRTIO_FS_REQUEST;
+
+//
+// Main context structure, expressing an EFI_SIMPLE_FILE_SYSTEM_PROTOCOL
+// interface on top of the Virtio Filesystem device.
+//
+typedef struct {
+  //
+  // Parts of this structure are initialized / torn down in various functions
+  // at various call depths. The table to the right should make it easier to
+  // track them.
+  //
+  //                                 field          init function      depth
+  //                                 -------------  -----------------  -----
+  UINT64                             Signature;  // DriverBindingStart 0
+  VIRTIO_DEVICE_PROTOCOL             *Virtio;    // DriverBindingStart 0
+  VIRTIO_FS_LABEL                    Label;      // VirtioFsInit       1
+  UINT16                             QueueSize;  // VirtioFsInit       1
+  UINT16                             MaxPipeline; // VirtioFsInit      1
+  VRING                              Ring;       // VirtioRingInit     2
+  VOID                               *RingMap;   // VirtioRingMap      2
+  VIRTIO_FS_SLOT                     *Slots;     // VirtioFsInit       1
+  EFI_PHYSICAL_ADDRESS               SlotsDeviceAddress; // VirtioFsInit 1
+  VOID                               *SlotsMap;  // VirtioFsInit       1
+  UINT64                             RequestId;  // FuseInitSession    1
+  UINT32                             MaxTransfer; // FuseInitSession   1
+  EFI_EVENT                          ExitBoot;   // DriverBindingStart 0
+  LIST_ENTRY                         OpenFiles;  // DriverBindingStart 0
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL    SimpleFs;   // DriverBindingStart 0
+} VIRTIO_FS;
+
+#define VIRTIO_FS_FROM_SIMPLE_FS(SimpleFsReference) \
+  CR (SimpleFsReference, VIRTIO_FS, SimpleFs, VIRTIO_FS_SIG)
+
+//
+// Private context structure that exposes EFI_FILE_PROTOCOL on top of an open
+// FUSE file reference.
+//
+typedef struct {
+  UINT64               Signature;
+  EFI_FILE_PROTOCOL    SimpleFile;
+  BOOLEAN              IsDirectory;
+  BOOLEAN              IsOpenForWriting;
+  VIRTIO_FS            *OwnerFs;
+  LIST_ENTRY           OpenFilesEntry;
+  //
+  // The absolute, canonical pathname of the file, with "/" as separator, and
+  // without a trailing separator (except for the root directory).
+  //
+  CHAR8                *CanonicalPathname;
+  UINT64               NodeId;
+  UINT64               FuseHandle;
+  //
+  // For regular files only.
+  //
+  UINT64               FilePosition;
+  //
+  // For directories only. The directory entries that VirtioFsFuseOpReadDirPlus
+  // produced most recently, the offset of the next entry to return from
+  // DirentBuffer, and the cookie with which to resume the directory stream
+  // once DirentBuffer is exhausted.
+  //
+  UINT8                *DirentBuffer;
+  UINT32               DirentSize;
+  UINT32               DirentOffset;
+  UINT64               DirentCookie;
+  BOOLEAN              DirentEnd;
+} VIRTIO_FS_FILE;
+
+#define VIRTIO_FS_FILE_FROM_SIMPLE_FILE(SimpleFileReference) \
+  CR (SimpleFileReference, VIRTIO_FS_FILE, SimpleFile, VIRTIO_FS_FILE_SIG)
+
+#define VIRTIO_FS_FILE_FROM_OPEN_FILES_ENTRY(OpenFilesEntryReference) \
+  CR (OpenFilesEntryReference, VIRTIO_FS_FILE, OpenFilesEntry, \
+    VIRTIO_FS_FILE_SIG)
+
+//
+// Initialization and helper routines for the Virtio Filesystem device.
+//
+
+EFI_STATUS
+VirtioFsInit (
+  IN OUT VIRTIO_FS  *VirtioFs
+  );
+
+VOID
+VirtioFsUninit (
+  IN OUT VIRTIO_FS  *VirtioFs
+  );
+
+VOID
+EFIAPI
+VirtioFsExitBoot (
+  IN EFI_EVENT  ExitBootEvent,
+  IN VOID       *VirtioFsAsVoid
+  );
+
+EFI_STATUS
+VirtioFsSubmitRequests (
+  IN OUT VIRTIO_FS          *VirtioFs,
+  IN OUT VIRTIO_FS_REQUEST  *Requests,
+  IN     UINT16             RequestCount
+  );
+
+VOID *
+VirtioFsPrepareRequest (
+  IN OUT VIRTIO_FS              *VirtioFs,
+  IN     UINT16                 Slot,
+  IN     VIRTIO_FS_FUSE_OPCODE  Opcode,
+  IN     UINT64                 NodeId,
+  IN     UINT32                 RequestBodySize,
+  IN     UINT32                 ResponseBodySize,
+  OUT    VIRTIO_FS_REQUEST      *Request
+  );
+
+VOID *
+VirtioFsResponseBody (
+  IN VIRTIO_FS  *VirtioFs,
+  IN UINT16     Slot
+  );
+
+EFI_STATUS
+VirtioFsErrnoToEfiStatus (
+  IN INT32  Errno
+  );
+
+EFI_STATUS
+VirtioFsComposePath (
+  IN     CHAR8   *LhsPath8,
+  IN     CHAR16  *RhsPath16,
+  OUT    CHAR8   **ResultPath8
+  );
+
+EFI_STATUS
+VirtioFsLookupPath (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     CHAR8      *Path,
+  IN     BOOLEAN    StopAtParent,
+  OUT    UINT64     *NodeId,
+  OUT    CHAR8      **LastComponent OPTIONAL
+  );
+
+CHAR8 *
+VirtioFsGetBasename (
+  IN CHAR8  *Path
+  );
+
+EFI_STATUS
+VirtioFsFuseAttrToEfiFileInfo (
+  IN     VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  *FuseAttr,
+  IN     CHAR8                               *Name,
+  IN     UINTN                               NameLen,
+  IN OUT UINTN                               *BufferSize,
+  OUT    EFI_FILE_INFO                       *FileInfo
+  );
+
+VOID
+VirtioFsEfiTimeToEpoch (
+  IN  EFI_TIME  *EfiTime,
+  OUT UINT64    *Seconds
+  );
+
+EFI_STATUS
+VirtioFsAllocateFile (
+  IN OUT VIRTIO_FS       *VirtioFs,
+  IN     CHAR8           *CanonicalPathname,
+  IN     UINT64          NodeId,
+  IN     UINT64          FuseHandle,
+  IN     BOOLEAN         IsDirectory,
+  IN     BOOLEAN         IsOpenForWriting,
+  OUT    VIRTIO_FS_FILE  **NewFile
+  );
+
+//
+// Wrapper functions for FUSE commands (primitives).
+//
+
+EFI_STATUS
+VirtioFsFuseInitSession (
+  IN OUT VIRTIO_FS  *VirtioFs
+  );
+
+EFI_STATUS
+VirtioFsFuseLookup (
+  IN OUT VIRTIO_FS                           *VirtioFs,
+  IN     UINT64                              DirNodeId,
+  IN     CHAR8                               *Name,
+  OUT    UINT64                              *NodeId,
+  OUT    VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  *FuseAttr
+  );
+
+EFI_STATUS
+VirtioFsFuseForget (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     *NodeIds,
+  IN     UINTN      NodeIdCount
+  );
+
+EFI_STATUS
+VirtioFsFuseGetAttr (
+  IN OUT VIRTIO_FS                           *VirtioFs,
+  IN     UINT64                              NodeId,
+  OUT    VIRTIO_FS_FUSE_ATTRIBUTES_RESPONSE  *FuseAttr
+  );
+
+EFI_STATUS
+VirtioFsFuseSetAttr (
+  IN OUT VIRTIO_FS                       *VirtioFs,
+  IN     UINT64                          NodeId,
+  IN     VIRTIO_FS_FUSE_SETATTR_REQUEST  *SetAttr
+  );
+
+EFI_STATUS
+VirtioFsFuseMkDir (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     ParentNodeId,
+  IN     CHAR8      *Name,
+  OUT    UINT64     *NodeId
+  );
+
+EFI_STATUS
+VirtioFsFuseRemoveFileOrDir (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     ParentNodeId,
+  IN     CHAR8      *Name,
+  IN     BOOLEAN    IsDir
+  );
+
+EFI_STATUS
+VirtioFsFuseOpen (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     BOOLEAN    IsDir,
+  IN     BOOLEAN    ReadWrite,
+  OUT    UINT64     *FuseHandle
+  );
+
+EFI_STATUS
+VirtioFsFuseCreate (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     ParentNodeId,
+  IN     CHAR8      *Name,
+  IN     BOOLEAN    ReadOnly,
+  OUT    UINT64     *NodeId,
+  OUT    UINT64     *FuseHandle
+  );
+
+EFI_STATUS
+VirtioFsFuseRelease (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle,
+  IN     BOOLEAN    IsDir
+  );
+
+EFI_STATUS
+VirtioFsFuseFsync (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle
+  );
+
+EFI_STATUS
+VirtioFsFuseStatFs (
+  IN OUT VIRTIO_FS                       *VirtioFs,
+  OUT    VIRTIO_FS_FUSE_STATFS_RESPONSE  *FilesysAttr
+  );
+
+EFI_STATUS
+VirtioFsFuseReadDirPlus (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle,
+  IN     UINT64     Cookie,
+  IN     VOID       *Buffer,
+  IN OUT UINT32     *Size
+  );
+
+EFI_STATUS
+VirtioFsFuseTransfer (
+  IN OUT VIRTIO_FS  *VirtioFs,
+  IN     UINT64     NodeId,
+  IN     UINT64     FuseHandle,
+  IN     UINT64     Offset,
+  IN     BOOLEAN    Write,
+  IN OUT VOID       *Buffer,
+  IN OUT UINTN      *Size
+  );
+
+//
+// EFI_SIMPLE_FILE_SYSTEM_PROTOCOL member functions for the Virtio Filesystem
+// driver.
+//
+
+EFI_STATUS
+EFIAPI
+VirtioFsOpenVolume (
+  IN  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *This,
+  OUT EFI_FILE_PROTOCOL                **Root
+  );
+
+//
+// EFI_FILE_PROTOCOL member functions for the Virtio Filesystem driver.
+//
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileClose (
+  IN EFI_FILE_PROTOCOL  *This
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileDelete (
+  IN EFI_FILE_PROTOCOL  *This
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileFlush (
+  IN EFI_FILE_PROTOCOL  *This
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileGetInfo (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN     EFI_GUID           *InformationType,
+  IN OUT UINTN              *BufferSize,
+  OUT    VOID               *Buffer
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileGetPosition (
+  IN     EFI_FILE_PROTOCOL  *This,
+  OUT    UINT64             *Position
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileOpen (
+  IN     EFI_FILE_PROTOCOL  *This,
+  OUT    EFI_FILE_PROTOCOL  **NewHandle,
+  IN     CHAR16             *FileName,
+  IN     UINT64             OpenMode,
+  IN     UINT64             Attributes
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileRead (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT UINTN              *BufferSize,
+  OUT    VOID               *Buffer
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileSetInfo (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN EFI_GUID           *InformationType,
+  IN UINTN              BufferSize,
+  IN VOID               *Buffer
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileSetPosition (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN UINT64             Position
+  );
+
+EFI_STATUS
+EFIAPI
+VirtioFsSimpleFileWrite (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT UINTN              *BufferSize,
+  IN     VOID               *Buffer
+  );
+
+#endif // _VIRTIO_FS_DXE_H_
@@ -0,0 +1,451 @@
+/** @file
+
+  Control queue setup and command submission for the VirtioGpu driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/VirtioLib.h>
+
+#include "VirtioGpu.h"
+
+/**
+  Configure the virtio-gpu device and its control queue, and map the command
+  area for the device.
+
+  @param[in,out] VgpuDev  The driver instance; VirtIo must be set.
+
+  @retval EFI_SUCCESS  The device is ready for commands.
+  @return              Error codes from the VirtIo and VirtioLib services.
+**/
+EFI_STATUS
+VirtioGpuInit (
+  IN OUT VGPU_DEV  *VgpuDev
+  )
+{
+  UINT8       NextDevStat;
+  EFI_STATUS  Status;
+  UINT64      Features;
+  UINT16      QueueSize;
+  UINT64      RingBaseShift;
+  VOID        *Commands;
+
+  //
+  // Execute virtio-v1.0-cs04, 3.1.1 Driver Requirements: Device
+  // Initialization.
+  //
+  NextDevStat = 0;             // step 1 -- reset device
+  Status      = VgpuDev->VirtIo->SetDeviceStatus (VgpuDev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_ACK;    // step 2 -- acknowledge device presence
+  Status       = VgpuDev->VirtIo->SetDeviceStatus (VgpuDev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_DRIVER; // step 3 -- we know how to drive it
+  Status       = VgpuDev->VirtIo->SetDeviceStatus (VgpuDev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 4 -- negotiate features
+  //
+  Status = VgpuDev->VirtIo->GetDeviceFeatures (VgpuDev->VirtIo, &Features);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  if ((Features & VIRTIO_F_VERSION_1) == 0) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  //
+  // We only want the most basic 2D features.
+  //
+  Features &= VIRTIO_F_VERSION_1 | VIRTIO_F_IOMMU_PLATFORM;
+
+  //
+  // ... and write the subset of feature bits understood by the [VirtIo
+  // 1.0] driver to the device (step 4 -- continued; steps 5 and 6).
+  //
+  Status = Virtio10WriteFeatures (VgpuDev->VirtIo, Features, &NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 7 -- set up the control queue; the cursor queue is not used
+  //
+  Status = VgpuDev->VirtIo->SetQueueSel (
+                              VgpuDev->VirtIo,
+                              VIRTIO_GPU_CONTROL_QUEUE
+                              );
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = VgpuDev->VirtIo->GetQueueNumMax (VgpuDev->VirtIo, &QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // Every command takes a request and a response descriptor.
+  //
+  if (QueueSize < 2) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  Status = VirtioRingInit (VgpuDev->VirtIo, QueueSize, &VgpuDev->Ring);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // If anything fails from here on, we must release the ring resources.
+  //
+  Status = VirtioRingMap (
+             VgpuDev->VirtIo,
+             &VgpuDev->Ring,
+             &RingBaseShift,
+             &VgpuDev->RingMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto ReleaseQueue;
+  }
+
+  //
+  // If anything fails from here on, we must unmap the ring resources.
+  //
+  Status = VgpuDev->VirtIo->SetQueueNum (VgpuDev->VirtIo, QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VgpuDev->VirtIo->SetQueueAlign (VgpuDev->VirtIo, EFI_PAGE_SIZE);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VgpuDev->VirtIo->SetQueueAddress (
+                              VgpuDev->VirtIo,
+                              &VgpuDev->Ring,
+                              RingBaseShift
+                              );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  //
+  // Allocate and map the command area once, so that submitting a command
+  // needs no mapping operations.
+  //
+  Status = VgpuDev->VirtIo->AllocateSharedPages (
+                              VgpuDev->VirtIo,
+                              EFI_SIZE_TO_PAGES (sizeof (VGPU_COMMAND_AREA)),
+                              &Commands
+                              );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VirtioMapAllBytesInSharedBuffer (
+             VgpuDev->VirtIo,
+             VirtioOperationBusMasterCommonBuffer,
+             Commands,
+             sizeof (VGPU_COMMAND_AREA),
+             &VgpuDev->CommandsAddress,
+             &VgpuDev->CommandsMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto FreeCommands;
+  }
+
+  VgpuDev->Commands = Commands;
+  ZeroMem (VgpuDev->Commands, sizeof (VGPU_COMMAND_AREA));
+
+  //
+  // step 8 -- initialization complete
+  //
+  NextDevStat |= VSTAT_DRIVER_OK;
+  Status       = VgpuDev->VirtIo->SetDeviceStatus (VgpuDev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto UnmapCommands;
+  }
+
+  VgpuDev->Active = TRUE;
+  return EFI_SUCCESS;
+
+UnmapCommands:
+  VgpuDev->VirtIo->UnmapSharedBuffer (VgpuDev->VirtIo, VgpuDev->CommandsMap);
+  VgpuDev->Commands = NULL;
+
+FreeCommands:
+  VgpuDev->VirtIo->FreeSharedPages (
+                     VgpuDev->VirtIo,
+                     EFI_SIZE_TO_PAGES (sizeof (VGPU_COMMAND_AREA)),
+                     Commands
+                     );
+
+UnmapQueue:
+  VgpuDev->VirtIo->UnmapSharedBuffer (VgpuDev->VirtIo, VgpuDev->RingMap);
+
+ReleaseQueue:
+  VirtioRingUninit (VgpuDev->VirtIo, &VgpuDev->Ring);
+
+Failed:
+  //
+  // If any of these steps go irrecoverably wrong, the driver SHOULD set the
+  // FAILED status bit to indicate that it has given up on the device (it can
+  // reset the device later to restart if desired). [...]
+  //
+  // VirtIo access failure here should not mask the original error.
+  //
+  NextDevStat |= VSTAT_FAILED;
+  VgpuDev->VirtIo->SetDeviceStatus (VgpuDev->VirtIo, NextDevStat);
+
+  return Status;
+}
+
+/**
+  Reset the virtio-gpu device, and release the resources of VirtioGpuInit().
+
+  @param[in,out] VgpuDev  The driver instance.
+**/
+VOID
+VirtioGpuUninit (
+  IN OUT VGPU_DEV  *VgpuDev
+  )
+{
+  //
+  // Resetting the VirtIo device makes it release its resources and forget its
+  // configuration.
+  //
+  VgpuDev->Active = FALSE;
+  VgpuDev->VirtIo->SetDeviceStatus (VgpuDev->VirtIo, 0);
+  VgpuDev->VirtIo->UnmapSharedBuffer (VgpuDev->VirtIo, VgpuDev->CommandsMap);
+  VgpuDev->VirtIo->FreeSharedPages (
+                     VgpuDev->VirtIo,
+                     EFI_SIZE_TO_PAGES (sizeof (VGPU_COMMAND_AREA)),
+                     VgpuDev->Commands
+                     );
+  VgpuDev->Commands = NULL;
+  VgpuDev->VirtIo->UnmapSharedBuffer (VgpuDev->VirtIo, VgpuDev->RingMap);
+  VirtioRingUninit (VgpuDev->VirtIo, &VgpuDev->Ring);
+}
+
+/**
+  Reset the device at ExitBootServices(), so that the host forgets about the
+  control queue, the command area and the backing store.
+
+  @param[in] Event    The ExitBootServices event.
+  @param[in] Context  The VGPU_DEV instance.
+**/
+VOID
+EFIAPI
+VirtioGpuExitBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  VGPU_DEV  *VgpuDev;
+
+  DEBUG ((DEBUG_VERBOSE, "%a: Context=0x%p\n", __FUNCTION__, Context));
+  VgpuDev         = Context;
+  VgpuDev->Active = FALSE;
+  VgpuDev->VirtIo->SetDeviceStatus (VgpuDev->VirtIo, 0);
+}
+
+/**
+  Fetch the display configuration of the host.
+
+  @param[in,out] VgpuDev  The driver instance. On success, the response is in
+                          VgpuDev->Commands->DisplayInfo.
+
+  @retval EFI_SUCCESS       The response is available.
+  @retval EFI_DEVICE_ERROR  The host rejected the request.
+  @return                   Error codes from VirtioFlush().
+**/
+EFI_STATUS
+VirtioGpuGetDisplayInfo (
+  IN OUT VGPU_DEV  *VgpuDev
+  )
+{
+  DESC_INDICES  Indices;
+  EFI_STATUS    Status;
+
+  VirtioGpuPrepareRequest (
+    VgpuDev,
+    0,
+    VirtioGpuCmdGetDisplayInfo,
+    sizeof (VIRTIO_GPU_CONTROL_HEADER)
+    );
+  ZeroMem (
+    &VgpuDev->Commands->DisplayInfo,
+    sizeof (VgpuDev->Commands->DisplayInfo)
+    );
+
+  VirtioPrepare (&VgpuDev->Ring, &Indices);
+  VirtioAppendDesc (
+    &VgpuDev->Ring,
+    VgpuDev->CommandsAddress + OFFSET_OF (VGPU_COMMAND_AREA, Request),
+    VgpuDev->RequestSize[0],
+    VRING_DESC_F_NEXT,
+    &Indices
+    );
+  VirtioAppendDesc (
+    &VgpuDev->Ring,
+    VgpuDev->CommandsAddress + OFFSET_OF (VGPU_COMMAND_AREA, DisplayInfo),
+    sizeof (VgpuDev->Commands->DisplayInfo),
+    VRING_DESC_F_WRITE,
+    &Indices
+    );
+  Status = VirtioFlush (
+             VgpuDev->VirtIo,
+             VIRTIO_GPU_CONTROL_QUEUE,
+             &VgpuDev->Ring,
+             &Indices,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (VgpuDev->Commands->DisplayInfo.Header.Type != VirtioGpuRespOkDisplayInfo) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Start building the request in a slot of the command area.
+
+  @param[in,out] VgpuDev  The driver instance.
+  @param[in] Slot         The slot, less than VGPU_MAX_BATCH.
+  @param[in] Type         The VIRTIO_GPU_CONTROL_TYPE of the request.
+  @param[in] Size         The size of the request structure.
+
+  @return  The zeroed request, with its header type set.
+**/
+VGPU_REQUEST *
+VirtioGpuPrepareRequest (
+  IN OUT VGPU_DEV  *VgpuDev,
+  IN     UINTN     Slot,
+  IN     UINT32    Type,
+  IN     UINT32    Size
+  )
+{
+  VGPU_REQUEST  *Request;
+
+  ASSERT (Slot < VGPU_MAX_BATCH);
+  ASSERT (Size <= sizeof (VGPU_REQUEST));
+
+  Request = &VgpuDev->Commands->Request[Slot];
+  ZeroMem (Request, Size);
+  ZeroMem (
+    &VgpuDev->Commands->Response[Slot],
+    sizeof (VIRTIO_GPU_CONTROL_HEADER)
+    );
+  Request->Header.Type       = Type;
+  VgpuDev->RequestSize[Slot] = Size;
+
+  return Request;
+}
+
+/**
+  Submit the requests in slots [0, Count) with a single notification, and
+  wait until the host has processed all of them.
+
+  If the control queue is too small for all the requests at once, they are
+  submitted in as few notifications as the queue permits.
+
+  @param[in,out] VgpuDev  The driver instance.
+  @param[in] Count        The number of requests, between 1 and
+                          VGPU_MAX_BATCH inclusive.
+
+  @retval EFI_SUCCESS       All requests succeeded.
+  @retval EFI_DEVICE_ERROR  The host rejected a request.
+  @return                   Error codes from VirtioFlushBatch().
+**/
+EFI_STATUS
+VirtioGpuSubmit (
+  IN OUT VGPU_DEV  *VgpuDev,
+  IN     UINTN     Count
+  )
+{
+  DESC_INDICES  Indices;
+  UINT16        HeadDescIdx[VGPU_MAX_BATCH];
+  UINTN         ChainsPerFlush;
+  UINTN         First;
+  UINTN         ChainCount;
+  UINTN         Index;
+  EFI_STATUS    Status;
+
+  ASSERT (Count > 0 && Count <= VGPU_MAX_BATCH);
+
+  ChainsPerFlush = MIN (VGPU_MAX_BATCH, VgpuDev->Ring.QueueSize / 2);
+  for (First = 0; First < Count; First += ChainCount) {
+    ChainCount = MIN (ChainsPerFlush, Count - First);
+
+    VirtioPrepare (&VgpuDev->Ring, &Indices);
+    for (Index = 0; Index < ChainCount; Index++) {
+      HeadDescIdx[Index] = Indices.NextDescIdx;
+      VirtioAppendDesc (
+        &VgpuDev->Ring,
+        VgpuDev->CommandsAddress + OFFSET_OF (VGPU_COMMAND_AREA, Request) +
+        (First + Index) * sizeof (VGPU_REQUEST),
+        VgpuDev->RequestSize[First + Index],
+        VRING_DESC_F_NEXT,
+        &Indices
+        );
+      VirtioAppendDesc (
+        &VgpuDev->Ring,
+        VgpuDev->CommandsAddress + OFFSET_OF (VGPU_COMMAND_AREA, Response) +
+        (First + Index) * sizeof (VIRTIO_GPU_CONTROL_HEADER),
+        sizeof (VIRTIO_GPU_CONTROL_HEADER),
+        VRING_DESC_F_WRITE,
+        &Indices
+        );
+    }
+
+    Status = VirtioFlushBatch (
+               VgpuDev->VirtIo,
+               VIRTIO_GPU_CONTROL_QUEUE,
+               &VgpuDev->Ring,
+               HeadDescIdx,
+               (UINT16)ChainCount,
+               NULL
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    if (VgpuDev->Commands->Response[Index].Type != VirtioGpuRespOkNodata) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "%a: request 0x%x failed: response 0x%x\n",
+        __FUNCTION__,
+        VgpuDev->Commands->Request[Index].Header.Type,
+        VgpuDev->Commands->Response[Index].Type
+        ));
+      return EFI_DEVICE_ERROR;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
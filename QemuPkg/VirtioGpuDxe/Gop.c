@@ -0,0 +1,887 @@
+/** @file
+
+  EFI_GRAPHICS_OUTPUT_PROTOCOL implementation of the VirtioGpu driver.
+
+  The framebuffer lives in a single guest memory backing store, allocated for
+  the largest mode and mapped for the device once. Every mode is a host
+  resource of the mode's size, attached to a prefix of that backing store.
+  Blt() draws into the backing store and only records the damage; the damage
+  reaches the display from a periodic timer, in batched TRANSFER_TO_HOST_2D
+  and RESOURCE_FLUSH commands.
+
+  The framebuffer cannot be accessed directly, as the host only reads it on
+  TRANSFER_TO_HOST_2D; the modes are reported as PixelBltOnly.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "VirtioGpu.h"
+
+//
+// The resolutions offered besides the preferred one of the host.
+//
+STATIC CONST struct {
+  UINT32    Width;
+  UINT32    Height;
+} mVirtioGpuResolutions[] = {
+  { 640,  480  },
+  { 800,  600  },
+  { 1024, 768  },
+  { 1280, 720  },
+  { 1280, 800  },
+  { 1280, 1024 },
+  { 1920, 1080 },
+};
+
+//
+// The largest preferred resolution of the host that is accepted.
+//
+#define VGPU_MAX_WIDTH   4096
+#define VGPU_MAX_HEIGHT  4096
+
+/**
+  Add a rectangle to the damage not yet sent to the host.
+
+  Rectangles that overlap or touch the new one are merged into it. If the
+  list is full, the new rectangle is merged into the entry whose bounding box
+  grows the least. The caller is responsible for running at TPL_NOTIFY.
+
+  @param[in,out] VgpuDev  The driver instance.
+  @param[in] X            The leftmost column of the rectangle.
+  @param[in] Y            The top scan line of the rectangle.
+  @param[in] Width        The width of the rectangle.
+  @param[in] Height       The height of the rectangle.
+**/
+STATIC
+VOID
+VirtioGpuAddDamage (
+  IN OUT VGPU_DEV  *VgpuDev,
+  IN     UINTN     X,
+  IN     UINTN     Y,
+  IN     UINTN     Width,
+  IN     UINTN     Height
+  )
+{
+  UINT32                Left;
+  UINT32                Top;
+  UINT32                Right;
+  UINT32                Bottom;
+  VIRTIO_GPU_RECTANGLE  *Rect;
+  UINTN                 Index;
+  UINTN                 Best;
+  UINT64                Growth;
+  UINT64                BestGrowth;
+
+  if ((Width == 0) || (Height == 0)) {
+    return;
+  }
+
+  Left   = (UINT32)X;
+  Top    = (UINT32)Y;
+  Right  = (UINT32)(X + Width);
+  Bottom = (UINT32)(Y + Height);
+
+  Index = 0;
+  while (Index < VgpuDev->DirtyCount) {
+    Rect = &VgpuDev->Dirty[Index];
+    if ((Rect->X > Right) || (Rect->X + Rect->Width < Left) ||
+        (Rect->Y > Bottom) || (Rect->Y + Rect->Height < Top))
+    {
+      Index++;
+      continue;
+    }
+
+    //
+    // Absorb the entry, remove it, and rescan, as the grown rectangle may now
+    // reach entries that were checked before.
+    //
+    Left   = MIN (Left, Rect->X);
+    Top    = MIN (Top, Rect->Y);
+    Right  = MAX (Right, Rect->X + Rect->Width);
+    Bottom = MAX (Bottom, Rect->Y + Rect->Height);
+    *Rect  = VgpuDev->Dirty[--VgpuDev->DirtyCount];
+    Index  = 0;
+  }
+
+  if (VgpuDev->DirtyCount == VGPU_MAX_DIRTY_RECTS) {
+    Best       = 0;
+    BestGrowth = MAX_UINT64;
+    for (Index = 0; Index < VgpuDev->DirtyCount; Index++) {
+      Rect   = &VgpuDev->Dirty[Index];
+      Growth = MultU64x32 (
+                 MAX (Right, Rect->X + Rect->Width) - MIN (Left, Rect->X),
+                 MAX (Bottom, Rect->Y + Rect->Height) - MIN (Top, Rect->Y)
+                 ) - MultU64x32 (Rect->Width, Rect->Height);
+      if (Growth < BestGrowth) {
+        Best       = Index;
+        BestGrowth = Growth;
+      }
+    }
+
+    Rect   = &VgpuDev->Dirty[Best];
+    Left   = MIN (Left, Rect->X);
+    Top    = MIN (Top, Rect->Y);
+    Right  = MAX (Right, Rect->X + Rect->Width);
+    Bottom = MAX (Bottom, Rect->Y + Rect->Height);
+    *Rect  = VgpuDev->Dirty[--VgpuDev->DirtyCount];
+  }
+
+  Rect         = &VgpuDev->Dirty[VgpuDev->DirtyCount++];
+  Rect->X      = Left;
+  Rect->Y      = Top;
+  Rect->Width  = Right - Left;
+  Rect->Height = Bottom - Top;
+}
+
+/**
+  Send the damage to the host: one TRANSFER_TO_HOST_2D command per damaged
+  rectangle, and one RESOURCE_FLUSH command for their bounding box, with a
+  single notification.
+
+  The caller is responsible for running at TPL_NOTIFY.
+
+  @param[in,out] VgpuDev  The driver instance.
+
+  @retval EFI_SUCCESS  The damage has been displayed, or there was none.
+  @return              Error codes from VirtioGpuSubmit().
+**/
+STATIC
+EFI_STATUS
+VirtioGpuFlush (
+  IN OUT VGPU_DEV  *VgpuDev
+  )
+{
+  VGPU_REQUEST          *Request;
+  VIRTIO_GPU_RECTANGLE  *Rect;
+  UINT32                Stride;
+  UINT32                Left;
+  UINT32                Top;
+  UINT32                Right;
+  UINT32                Bottom;
+  UINTN                 Index;
+  EFI_STATUS            Status;
+
+  if ((VgpuDev->DirtyCount == 0) || !VgpuDev->Active ||
+      !VgpuDev->ResourceValid)
+  {
+    return EFI_SUCCESS;
+  }
+
+  Stride = VgpuDev->GopMode.Info->HorizontalResolution * VGPU_BPP;
+  Left   = MAX_UINT32;
+  Top    = MAX_UINT32;
+  Right  = 0;
+  Bottom = 0;
+  for (Index = 0; Index < VgpuDev->DirtyCount; Index++) {
+    Rect    = &VgpuDev->Dirty[Index];
+    Request = VirtioGpuPrepareRequest (
+                VgpuDev,
+                Index,
+                VirtioGpuCmdTransferToHost2d,
+                sizeof (VIRTIO_GPU_TRANSFER_TO_HOST_2D)
+                );
+    Request->TransferToHost2d.Rectangle  = *Rect;
+    Request->TransferToHost2d.Offset     = (UINT64)Rect->Y * Stride +
+                                           (UINT64)Rect->X * VGPU_BPP;
+    Request->TransferToHost2d.ResourceId = VGPU_RESOURCE_ID;
+
+    Left   = MIN (Left, Rect->X);
+    Top    = MIN (Top, Rect->Y);
+    Right  = MAX (Right, Rect->X + Rect->Width);
+    Bottom = MAX (Bottom, Rect->Y + Rect->Height);
+  }
+
+  Request = VirtioGpuPrepareRequest (
+              VgpuDev,
+              Index,
+              VirtioGpuCmdResourceFlush,
+              sizeof (VIRTIO_GPU_RESOURCE_FLUSH)
+              );
+  Request->ResourceFlush.Rectangle.X      = Left;
+  Request->ResourceFlush.Rectangle.Y      = Top;
+  Request->ResourceFlush.Rectangle.Width  = Right - Left;
+  Request->ResourceFlush.Rectangle.Height = Bottom - Top;
+  Request->ResourceFlush.ResourceId       = VGPU_RESOURCE_ID;
+
+  VgpuDev->DirtyCount = 0;
+
+  Status = VirtioGpuSubmit (VgpuDev, Index + 1);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: %r\n", __FUNCTION__, Status));
+  }
+
+  return Status;
+}
+
+/**
+  Periodic timer callback that sends the damage to the host.
+
+  @param[in] Event    The flush timer.
+  @param[in] Context  The VGPU_DEV instance.
+**/
+STATIC
+VOID
+EFIAPI
+VirtioGpuFlushTimerNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  VirtioGpuFlush (Context);
+}
+
+/**
+  Release the host resource that backs the current mode, if any.
+
+  @param[in,out] VgpuDev  The driver instance.
+
+  @return  Error codes from VirtioGpuSubmit().
+**/
+STATIC
+EFI_STATUS
+VirtioGpuReleaseResource (
+  IN OUT VGPU_DEV  *VgpuDev
+  )
+{
+  VGPU_REQUEST  *Request;
+  EFI_STATUS    Status;
+
+  if (!VgpuDev->ResourceValid || !VgpuDev->Active) {
+    VgpuDev->ResourceValid = FALSE;
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Disable the scanout, then free the resource.
+  //
+  Request = VirtioGpuPrepareRequest (
+              VgpuDev,
+              0,
+              VirtioGpuCmdSetScanout,
+              sizeof (VIRTIO_GPU_SET_SCANOUT)
+              );
+  Request->SetScanout.ScanoutId = VGPU_SCANOUT_ID;
+
+  Request = VirtioGpuPrepareRequest (
+              VgpuDev,
+              1,
+              VirtioGpuCmdResourceDetachBacking,
+              sizeof (VIRTIO_GPU_RESOURCE_DETACH_BACKING)
+              );
+  Request->ResourceDetachBacking.ResourceId = VGPU_RESOURCE_ID;
+
+  Request = VirtioGpuPrepareRequest (
+              VgpuDev,
+              2,
+              VirtioGpuCmdResourceUnref,
+              sizeof (VIRTIO_GPU_RESOURCE_UNREF)
+              );
+  Request->ResourceUnref.ResourceId = VGPU_RESOURCE_ID;
+
+  Status                 = VirtioGpuSubmit (VgpuDev, 3);
+  VgpuDev->ResourceValid = FALSE;
+  VgpuDev->DirtyCount    = 0;
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioGpuGraphicsOutputQueryMode (
+  IN  EFI_GRAPHICS_OUTPUT_PROTOCOL          *This,
+  IN  UINT32                                ModeNumber,
+  OUT UINTN                                 *SizeOfInfo,
+  OUT EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  **Info
+  )
+{
+  VGPU_DEV  *VgpuDev;
+
+  VgpuDev = VGPU_DEV_FROM_GOP (This);
+
+  if ((Info == NULL) || (SizeOfInfo == NULL) ||
+      (ModeNumber >= VgpuDev->GopMode.MaxMode))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Info = AllocateCopyPool (
+            sizeof (EFI_GRAPHICS_OUTPUT_MODE_INFORMATION),
+            &VgpuDev->ModeInfo[ModeNumber]
+            );
+  if (*Info == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *SizeOfInfo = sizeof (EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioGpuGraphicsOutputSetMode (
+  IN  EFI_GRAPHICS_OUTPUT_PROTOCOL  *This,
+  IN  UINT32                        ModeNumber
+  )
+{
+  VGPU_DEV                              *VgpuDev;
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  BltModeInfo;
+  VGPU_REQUEST                          *Request;
+  UINT32                                Width;
+  UINT32                                Height;
+  RETURN_STATUS                         Status;
+  EFI_TPL                               OldTpl;
+
+  VgpuDev = VGPU_DEV_FROM_GOP (This);
+
+  if (ModeNumber >= VgpuDev->GopMode.MaxMode) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Width  = VgpuDev->ModeInfo[ModeNumber].HorizontalResolution;
+  Height = VgpuDev->ModeInfo[ModeNumber].VerticalResolution;
+
+  //
+  // FrameBufferBltLib does not accept PixelBltOnly; describe the backing
+  // store to it as it really is.
+  //
+  CopyMem (&BltModeInfo, &VgpuDev->ModeInfo[ModeNumber], sizeof (BltModeInfo));
+  BltModeInfo.PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+
+  Status = FrameBufferBltConfigure (
+             VgpuDev->Backing,
+             &BltModeInfo,
+             VgpuDev->BltConfigure,
+             &VgpuDev->BltConfigureSize
+             );
+  if (Status == RETURN_BUFFER_TOO_SMALL) {
+    if (VgpuDev->BltConfigure != NULL) {
+      FreePool (VgpuDev->BltConfigure);
+    }
+
+    VgpuDev->BltConfigure = AllocatePool (VgpuDev->BltConfigureSize);
+    if (VgpuDev->BltConfigure == NULL) {
+      VgpuDev->BltConfigureSize = 0;
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = FrameBufferBltConfigure (
+               VgpuDev->Backing,
+               &BltModeInfo,
+               VgpuDev->BltConfigure,
+               &VgpuDev->BltConfigureSize
+               );
+  }
+
+  if (RETURN_ERROR (Status)) {
+    ASSERT (Status == RETURN_UNSUPPORTED);
+    return Status;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  if (!VgpuDev->Active) {
+    Status = EFI_DEVICE_ERROR;
+    goto RestoreTpl;
+  }
+
+  Status = VirtioGpuReleaseResource (VgpuDev);
+  if (EFI_ERROR (Status)) {
+    goto RestoreTpl;
+  }
+
+  //
+  // Create the resource for the new mode, back it with the prefix of the
+  // backing store, and display it -- with a single notification.
+  //
+  ZeroMem (VgpuDev->Backing, (UINTN)Width * Height * VGPU_BPP);
+
+  Request = VirtioGpuPrepareRequest (
+              VgpuDev,
+              0,
+              VirtioGpuCmdResourceCreate2d,
+              sizeof (VIRTIO_GPU_RESOURCE_CREATE_2D)
+              );
+  Request->ResourceCreate2d.ResourceId = VGPU_RESOURCE_ID;
+  Request->ResourceCreate2d.Format     = VirtioGpuFormatB8G8R8X8Unorm;
+  Request->ResourceCreate2d.Width      = Width;
+  Request->ResourceCreate2d.Height     = Height;
+
+  Request = VirtioGpuPrepareRequest (
+              VgpuDev,
+              1,
+              VirtioGpuCmdResourceAttachBacking,
+              sizeof (VIRTIO_GPU_RESOURCE_ATTACH_BACKING)
+              );
+  Request->ResourceAttachBacking.ResourceId      = VGPU_RESOURCE_ID;
+  Request->ResourceAttachBacking.NumberOfEntries = 1;
+  Request->ResourceAttachBacking.Address         = VgpuDev->BackingAddress;
+  Request->ResourceAttachBacking.Length          = Width * Height * VGPU_BPP;
+
+  Request = VirtioGpuPrepareRequest (
+              VgpuDev,
+              2,
+              VirtioGpuCmdSetScanout,
+              sizeof (VIRTIO_GPU_SET_SCANOUT)
+              );
+  Request->SetScanout.Rectangle.Width  = Width;
+  Request->SetScanout.Rectangle.Height = Height;
+  Request->SetScanout.ScanoutId        = VGPU_SCANOUT_ID;
+  Request->SetScanout.ResourceId       = VGPU_RESOURCE_ID;
+
+  Status = VirtioGpuSubmit (VgpuDev, 3);
+  if (EFI_ERROR (Status)) {
+    //
+    // Leave no half-configured resource behind.
+    //
+    VgpuDev->ResourceValid = TRUE;
+    VirtioGpuReleaseResource (VgpuDev);
+    goto RestoreTpl;
+  }
+
+  VgpuDev->ResourceValid = TRUE;
+  VgpuDev->GopMode.Mode  = ModeNumber;
+  VgpuDev->GopMode.Info  = &VgpuDev->ModeInfo[ModeNumber];
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: mode %u (%ux%u)\n",
+    __FUNCTION__,
+    ModeNumber,
+    Width,
+    Height
+    ));
+
+  //
+  // Display the cleared screen.
+  //
+  VirtioGpuAddDamage (VgpuDev, 0, 0, Width, Height);
+  Status = VirtioGpuFlush (VgpuDev);
+
+RestoreTpl:
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioGpuGraphicsOutputBlt (
+  IN  EFI_GRAPHICS_OUTPUT_PROTOCOL       *This,
+  IN  EFI_GRAPHICS_OUTPUT_BLT_PIXEL      *BltBuffer  OPTIONAL,
+  IN  EFI_GRAPHICS_OUTPUT_BLT_OPERATION  BltOperation,
+  IN  UINTN                              SourceX,
+  IN  UINTN                              SourceY,
+  IN  UINTN                              DestinationX,
+  IN  UINTN                              DestinationY,
+  IN  UINTN                              Width,
+  IN  UINTN                              Height,
+  IN  UINTN                              Delta
+  )
+{
+  VGPU_DEV    *VgpuDev;
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  VgpuDev = VGPU_DEV_FROM_GOP (This);
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  if (!VgpuDev->ResourceValid) {
+    Status = EFI_DEVICE_ERROR;
+    goto RestoreTpl;
+  }
+
+  Status = FrameBufferBlt (
+             VgpuDev->BltConfigure,
+             BltBuffer,
+             BltOperation,
+             SourceX,
+             SourceY,
+             DestinationX,
+             DestinationY,
+             Width,
+             Height,
+             Delta
+             );
+  if (!EFI_ERROR (Status) && (BltOperation != EfiBltVideoToBltBuffer)) {
+    VirtioGpuAddDamage (VgpuDev, DestinationX, DestinationY, Width, Height);
+  }
+
+RestoreTpl:
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Build the mode list: the fixed resolutions, plus the preferred resolution of
+  the host's first scanout, which becomes the default mode.
+
+  @param[in,out] VgpuDev  The driver instance.
+
+  @retval EFI_SUCCESS           VgpuDev->ModeInfo, GopMode.MaxMode and
+                                PreferredMode have been set.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+STATIC
+EFI_STATUS
+VirtioGpuInitModes (
+  IN OUT VGPU_DEV  *VgpuDev
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      PreferredWidth;
+  UINT32      PreferredHeight;
+  UINT32      ModeCount;
+  UINTN       Index;
+
+  //
+  // Default to 1024x768 if the host does not express a preference.
+  //
+  PreferredWidth  = 1024;
+  PreferredHeight = 768;
+
+  Status = VirtioGpuGetDisplayInfo (VgpuDev);
+  if (!EFI_ERROR (Status) &&
+      (VgpuDev->Commands->DisplayInfo.Pmodes[VGPU_SCANOUT_ID].Enabled != 0))
+  {
+    PreferredWidth  = VgpuDev->Commands->DisplayInfo.Pmodes[VGPU_SCANOUT_ID].Rectangle.Width;
+    PreferredHeight = VgpuDev->Commands->DisplayInfo.Pmodes[VGPU_SCANOUT_ID].Rectangle.Height;
+    if ((PreferredWidth == 0) || (PreferredWidth > VGPU_MAX_WIDTH) ||
+        (PreferredHeight == 0) || (PreferredHeight > VGPU_MAX_HEIGHT))
+    {
+      PreferredWidth  = 1024;
+      PreferredHeight = 768;
+    }
+  } else {
+    DEBUG ((DEBUG_INFO, "%a: no display info: %r\n", __FUNCTION__, Status));
+  }
+
+  VgpuDev->ModeInfo = AllocateZeroPool (
+                        (ARRAY_SIZE (mVirtioGpuResolutions) + 1) *
+                        sizeof (EFI_GRAPHICS_OUTPUT_MODE_INFORMATION)
+                        );
+  if (VgpuDev->ModeInfo == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ModeCount              = 0;
+  VgpuDev->PreferredMode = MAX_UINT32;
+  for (Index = 0; Index < ARRAY_SIZE (mVirtioGpuResolutions); Index++) {
+    VgpuDev->ModeInfo[ModeCount].HorizontalResolution = mVirtioGpuResolutions[Index].Width;
+    VgpuDev->ModeInfo[ModeCount].VerticalResolution   = mVirtioGpuResolutions[Index].Height;
+    if ((mVirtioGpuResolutions[Index].Width == PreferredWidth) &&
+        (mVirtioGpuResolutions[Index].Height == PreferredHeight))
+    {
+      VgpuDev->PreferredMode = ModeCount;
+    }
+
+    ModeCount++;
+  }
+
+  if (VgpuDev->PreferredMode == MAX_UINT32) {
+    VgpuDev->ModeInfo[ModeCount].HorizontalResolution = PreferredWidth;
+    VgpuDev->ModeInfo[ModeCount].VerticalResolution   = PreferredHeight;
+    VgpuDev->PreferredMode                            = ModeCount;
+    ModeCount++;
+  }
+
+  for (Index = 0; Index < ModeCount; Index++) {
+    VgpuDev->ModeInfo[Index].PixelsPerScanLine = VgpuDev->ModeInfo[Index].HorizontalResolution;
+    VgpuDev->ModeInfo[Index].PixelFormat       = PixelBltOnly;
+  }
+
+  VgpuDev->GopMode.MaxMode = ModeCount;
+  return EFI_SUCCESS;
+}
+
+/**
+  Set up the framebuffer backing store, and produce the Graphics Output
+  Protocol on a child handle.
+
+  @param[in,out] VgpuDev       The driver instance, initialized with
+                               VirtioGpuInit().
+  @param[in] ParentDevicePath  The device path of the virtio device.
+  @param[in] DriverBindingHandle  The driver binding handle of this driver.
+  @param[in] ControllerHandle  The handle of the virtio device.
+
+  @retval EFI_SUCCESS  The Graphics Output Protocol has been installed.
+  @return              Error codes from the allocation, mapping and protocol
+                       services, and from the device.
+**/
+EFI_STATUS
+VirtioGpuGopInit (
+  IN OUT VGPU_DEV                  *VgpuDev,
+  IN     EFI_DEVICE_PATH_PROTOCOL  *ParentDevicePath,
+  IN     EFI_HANDLE                DriverBindingHandle,
+  IN     EFI_HANDLE                ControllerHandle
+  )
+{
+  ACPI_ADR_DEVICE_PATH  AcpiAdr;
+  EFI_STATUS            Status;
+  UINTN                 MaxSize;
+  UINTN                 Size;
+  UINTN                 Index;
+  VOID                  *ParentVirtIo;
+
+  Status = VirtioGpuInitModes (VgpuDev);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Allocate and map the backing store for the largest mode.
+  //
+  MaxSize = 0;
+  for (Index = 0; Index < VgpuDev->GopMode.MaxMode; Index++) {
+    Size = (UINTN)VgpuDev->ModeInfo[Index].HorizontalResolution *
+           VgpuDev->ModeInfo[Index].VerticalResolution * VGPU_BPP;
+    MaxSize = MAX (MaxSize, Size);
+  }
+
+  VgpuDev->BackingPages = EFI_SIZE_TO_PAGES (MaxSize);
+  Status                = VgpuDev->VirtIo->AllocateSharedPages (
+                                             VgpuDev->VirtIo,
+                                             VgpuDev->BackingPages,
+                                             &VgpuDev->Backing
+                                             );
+  if (EFI_ERROR (Status)) {
+    goto FreeModeInfo;
+  }
+
+  Status = VirtioMapAllBytesInSharedBuffer (
+             VgpuDev->VirtIo,
+             VirtioOperationBusMasterCommonBuffer,
+             VgpuDev->Backing,
+             EFI_PAGES_TO_SIZE (VgpuDev->BackingPages),
+             &VgpuDev->BackingAddress,
+             &VgpuDev->BackingMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto FreeBacking;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_NOTIFY,
+                  VirtioGpuFlushTimerNotify,
+                  VgpuDev,
+                  &VgpuDev->FlushTimer
+                  );
+  if (EFI_ERROR (Status)) {
+    goto UnmapBacking;
+  }
+
+  //
+  // Format the child device path: the parent's, plus an ACPI _ADR node for
+  // the display.
+  //
+  ZeroMem (&AcpiAdr, sizeof AcpiAdr);
+  AcpiAdr.Header.Type    = ACPI_DEVICE_PATH;
+  AcpiAdr.Header.SubType = ACPI_ADR_DP;
+  AcpiAdr.ADR            = ACPI_DISPLAY_ADR (
+                             1,                                      // DeviceIdScheme
+                             0,                                      // HeadId
+                             0,                                      // NonVgaOutput
+                             1,                                      // BiosCanDetect
+                             0,                                      // VendorInfo
+                             ACPI_ADR_DISPLAY_TYPE_EXTERNAL_DIGITAL, // Type
+                             0,                                      // Port
+                             0                                       // Index
+                             );
+  SetDevicePathNodeLength (&AcpiAdr.Header, sizeof AcpiAdr);
+
+  VgpuDev->GopDevicePath = AppendDevicePathNode (
+                             ParentDevicePath,
+                             &AcpiAdr.Header
+                             );
+  if (VgpuDev->GopDevicePath == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto CloseFlushTimer;
+  }
+
+  VgpuDev->Gop.QueryMode = VirtioGpuGraphicsOutputQueryMode;
+  VgpuDev->Gop.SetMode   = VirtioGpuGraphicsOutputSetMode;
+  VgpuDev->Gop.Blt       = VirtioGpuGraphicsOutputBlt;
+  VgpuDev->Gop.Mode      = &VgpuDev->GopMode;
+
+  VgpuDev->GopMode.Mode            = VgpuDev->PreferredMode;
+  VgpuDev->GopMode.Info            = &VgpuDev->ModeInfo[VgpuDev->PreferredMode];
+  VgpuDev->GopMode.SizeOfInfo      = sizeof (EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+  VgpuDev->GopMode.FrameBufferBase = 0;
+  VgpuDev->GopMode.FrameBufferSize = 0;
+
+  Status = VirtioGpuGraphicsOutputSetMode (&VgpuDev->Gop, VgpuDev->PreferredMode);
+  if (EFI_ERROR (Status)) {
+    goto FreeGopDevicePath;
+  }
+
+  VgpuDev->GopHandle = NULL;
+  Status             = gBS->InstallMultipleProtocolInterfaces (
+                              &VgpuDev->GopHandle,
+                              &gEfiDevicePathProtocolGuid,
+                              VgpuDev->GopDevicePath,
+                              &gEfiGraphicsOutputProtocolGuid,
+                              &VgpuDev->Gop,
+                              NULL
+                              );
+  if (EFI_ERROR (Status)) {
+    goto ReleaseResource;
+  }
+
+  //
+  // Make the child a real child of the virtio device.
+  //
+  Status = gBS->OpenProtocol (
+                  ControllerHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  &ParentVirtIo,
+                  DriverBindingHandle,
+                  VgpuDev->GopHandle,
+                  EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER
+                  );
+  if (EFI_ERROR (Status)) {
+    goto UninstallGop;
+  }
+
+  Status = gBS->SetTimer (VgpuDev->FlushTimer, TimerPeriodic, VGPU_FLUSH_PERIOD);
+  if (EFI_ERROR (Status)) {
+    goto CloseParentVirtIo;
+  }
+
+  return EFI_SUCCESS;
+
+CloseParentVirtIo:
+  gBS->CloseProtocol (
+         ControllerHandle,
+         &gVirtioDeviceProtocolGuid,
+         DriverBindingHandle,
+         VgpuDev->GopHandle
+         );
+
+UninstallGop:
+  gBS->UninstallMultipleProtocolInterfaces (
+         VgpuDev->GopHandle,
+         &gEfiDevicePathProtocolGuid,
+         VgpuDev->GopDevicePath,
+         &gEfiGraphicsOutputProtocolGuid,
+         &VgpuDev->Gop,
+         NULL
+         );
+
+ReleaseResource:
+  VirtioGpuReleaseResource (VgpuDev);
+  if (VgpuDev->BltConfigure != NULL) {
+    FreePool (VgpuDev->BltConfigure);
+    VgpuDev->BltConfigure = NULL;
+  }
+
+FreeGopDevicePath:
+  FreePool (VgpuDev->GopDevicePath);
+
+CloseFlushTimer:
+  gBS->CloseEvent (VgpuDev->FlushTimer);
+
+UnmapBacking:
+  VgpuDev->VirtIo->UnmapSharedBuffer (VgpuDev->VirtIo, VgpuDev->BackingMap);
+
+FreeBacking:
+  VgpuDev->VirtIo->FreeSharedPages (
+                     VgpuDev->VirtIo,
+                     VgpuDev->BackingPages,
+                     VgpuDev->Backing
+                     );
+
+FreeModeInfo:
+  FreePool (VgpuDev->ModeInfo);
+  VgpuDev->ModeInfo = NULL;
+
+  return Status;
+}
+
+/**
+  Uninstall the Graphics Output Protocol, and release the resources of
+  VirtioGpuGopInit().
+
+  @param[in,out] VgpuDev          The driver instance.
+  @param[in] DriverBindingHandle  The driver binding handle of this driver.
+  @param[in] ControllerHandle     The handle of the virtio device.
+
+  @retval EFI_SUCCESS  The child handle has been destroyed.
+  @return              Error codes from UninstallMultipleProtocolInterfaces().
+**/
+EFI_STATUS
+VirtioGpuGopUninit (
+  IN OUT VGPU_DEV    *VgpuDev,
+  IN     EFI_HANDLE  DriverBindingHandle,
+  IN     EFI_HANDLE  ControllerHandle
+  )
+{
+  EFI_STATUS  Status;
+
+  gBS->SetTimer (VgpuDev->FlushTimer, TimerCancel, 0);
+
+  gBS->CloseProtocol (
+         ControllerHandle,
+         &gVirtioDeviceProtocolGuid,
+         DriverBindingHandle,
+         VgpuDev->GopHandle
+         );
+
+  Status = gBS->UninstallMultipleProtocolInterfaces (
+                  VgpuDev->GopHandle,
+                  &gEfiDevicePathProtocolGuid,
+                  VgpuDev->GopDevicePath,
+                  &gEfiGraphicsOutputProtocolGuid,
+                  &VgpuDev->Gop,
+                  NULL
+                  );
+  if (EFI_ERROR (Status)) {
+    VOID  *ParentVirtIo;
+
+    //
+    // Restore the parent-child relationship and the flush timer.
+    //
+    gBS->OpenProtocol (
+           ControllerHandle,
+           &gVirtioDeviceProtocolGuid,
+           &ParentVirtIo,
+           DriverBindingHandle,
+           VgpuDev->GopHandle,
+           EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER
+           );
+    gBS->SetTimer (VgpuDev->FlushTimer, TimerPeriodic, VGPU_FLUSH_PERIOD);
+    return Status;
+  }
+
+  gBS->CloseEvent (VgpuDev->FlushTimer);
+  VirtioGpuReleaseResource (VgpuDev);
+  if (VgpuDev->BltConfigure != NULL) {
+    FreePool (VgpuDev->BltConfigure);
+    VgpuDev->BltConfigure = NULL;
+  }
+
+  FreePool (VgpuDev->GopDevicePath);
+  VgpuDev->VirtIo->UnmapSharedBuffer (VgpuDev->VirtIo, VgpuDev->BackingMap);
+  VgpuDev->VirtIo->FreeSharedPages (
+                     VgpuDev->VirtIo,
+                     VgpuDev->BackingPages,
+                     VgpuDev->Backing
+                     );
+  FreePool (VgpuDev->ModeInfo);
+  VgpuDev->ModeInfo  = NULL;
+  VgpuDev->GopHandle = NULL;
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,250 @@
+/** @file
+
+  Private definitions of the VirtioGpu 2D framebuffer driver
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VIRTIO_GPU_DXE_H_
+#define _VIRTIO_GPU_DXE_H_
+
+#include <Protocol/ComponentName.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/DriverBinding.h>
+#include <Protocol/GraphicsOutput.h>
+
+#include <Library/FrameBufferBltLib.h>
+#include <Library/VirtioLib.h>
+
+#include <IndustryStandard/VirtioGpu.h>
+
+#define VGPU_DEV_SIG  SIGNATURE_32 ('V', 'G', 'P', 'U')
+
+//
+// The single host resource that backs the framebuffer, and the scanout it is
+// displayed on.
+//
+#define VGPU_RESOURCE_ID  1
+#define VGPU_SCANOUT_ID   0
+
+#define VGPU_BPP  4
+
+//
+// Blt() records the damage it does as up to VGPU_MAX_DIRTY_RECTS rectangles.
+// The damage is sent to the host from a periodic timer, as one
+// TRANSFER_TO_HOST_2D command per rectangle plus a single RESOURCE_FLUSH
+// command for their bounding box, all submitted with one notification.
+//
+#define VGPU_MAX_DIRTY_RECTS  8
+#define VGPU_MAX_BATCH        (VGPU_MAX_DIRTY_RECTS + 1)
+#define VGPU_FLUSH_PERIOD     EFI_TIMER_PERIOD_MILLISECONDS (20)
+
+//
+// Requests are built in place in the command area, which is mapped for the
+// device once, at initialization.
+//
+typedef union {
+  VIRTIO_GPU_CONTROL_HEADER             Header;
+  VIRTIO_GPU_RESOURCE_CREATE_2D         ResourceCreate2d;
+  VIRTIO_GPU_RESOURCE_UNREF             ResourceUnref;
+  VIRTIO_GPU_RESOURCE_ATTACH_BACKING    ResourceAttachBacking;
+  VIRTIO_GPU_RESOURCE_DETACH_BACKING    ResourceDetachBacking;
+  VIRTIO_GPU_SET_SCANOUT                SetScanout;
+  VIRTIO_GPU_TRANSFER_TO_HOST_2D        TransferToHost2d;
+  VIRTIO_GPU_RESOURCE_FLUSH             ResourceFlush;
+} VGPU_REQUEST;
+
+typedef struct {
+  VGPU_REQUEST                    Request[VGPU_MAX_BATCH];
+  VIRTIO_GPU_CONTROL_HEADER       Response[VGPU_MAX_BATCH];
+  VIRTIO_GPU_RESP_DISPLAY_INFO    DisplayInfo;
+} VGPU_COMMAND_AREA;
+
+typedef struct {
+  //
+  // Parts of this structure are initialized / torn down in various functions
+  // at various call depths. The table to the right should make it easier to
+  // track them.
+  //
+  //                                    field                init function        init depth
+  //                                    -------------------  -------------------  ----------
+  UINT32                                Signature;        // DriverBindingStart   0
+  VIRTIO_DEVICE_PROTOCOL                *VirtIo;          // DriverBindingStart   0
+  EFI_EVENT                             ExitBoot;         // DriverBindingStart   0
+  VRING                                 Ring;             // VirtioRingInit       2
+  VOID                                  *RingMap;         // VirtioRingMap        2
+  VGPU_COMMAND_AREA                     *Commands;        // VirtioGpuInit        1
+  EFI_PHYSICAL_ADDRESS                  CommandsAddress;  // VirtioGpuInit        1
+  VOID                                  *CommandsMap;     // VirtioGpuInit        1
+  UINT32                                RequestSize[VGPU_MAX_BATCH]; // PrepareRequest
+  BOOLEAN                               Active;           // VirtioGpuInit        1
+
+  //
+  // Graphics output.
+  //
+  EFI_HANDLE                            GopHandle;        // VirtioGpuGopInit     1
+  EFI_DEVICE_PATH_PROTOCOL              *GopDevicePath;   // VirtioGpuGopInit     1
+  EFI_GRAPHICS_OUTPUT_PROTOCOL          Gop;              // VirtioGpuGopInit     1
+  EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE     GopMode;          // VirtioGpuGopInit     1
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  *ModeInfo;        // VirtioGpuGopInit     1
+  UINT32                                PreferredMode;    // VirtioGpuGopInit     1
+  VOID                                  *Backing;         // VirtioGpuGopInit     1
+  UINTN                                 BackingPages;     // VirtioGpuGopInit     1
+  EFI_PHYSICAL_ADDRESS                  BackingAddress;   // VirtioGpuGopInit     1
+  VOID                                  *BackingMap;      // VirtioGpuGopInit     1
+  BOOLEAN                               ResourceValid;    // VirtioGpuSetMode     2
+  FRAME_BUFFER_CONFIGURE                *BltConfigure;    // VirtioGpuSetMode     2
+  UINTN                                 BltConfigureSize; // VirtioGpuSetMode     2
+  EFI_EVENT                             FlushTimer;       // VirtioGpuGopInit     1
+
+  //
+  // Damage not yet sent to the host.
+  //
+  VIRTIO_GPU_RECTANGLE                  Dirty[VGPU_MAX_DIRTY_RECTS];
+  UINTN                                 DirtyCount;
+} VGPU_DEV;
+
+#define VGPU_DEV_FROM_GOP(GopPointer) \
+  CR (GopPointer, VGPU_DEV, Gop, VGPU_DEV_SIG)
+
+//
+// Control queue commands, implemented in Commands.c.
+//
+
+/**
+  Configure the virtio-gpu device and its control queue, and map the command
+  area for the device.
+
+  @param[in,out] VgpuDev  The driver instance; VirtIo must be set.
+
+  @retval EFI_SUCCESS  The device is ready for commands.
+  @return              Error codes from the VirtIo and VirtioLib services.
+**/
+EFI_STATUS
+VirtioGpuInit (
+  IN OUT VGPU_DEV  *VgpuDev
+  );
+
+/**
+  Reset the virtio-gpu device, and release the resources of VirtioGpuInit().
+
+  @param[in,out] VgpuDev  The driver instance.
+**/
+VOID
+VirtioGpuUninit (
+  IN OUT VGPU_DEV  *VgpuDev
+  );
+
+/**
+  Reset the device at ExitBootServices(), so that the host forgets about the
+  control queue, the command area and the backing store.
+
+  @param[in] Event    The ExitBootServices event.
+  @param[in] Context  The VGPU_DEV instance.
+**/
+VOID
+EFIAPI
+VirtioGpuExitBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
+/**
+  Fetch the display configuration of the host.
+
+  @param[in,out] VgpuDev  The driver instance. On success, the response is in
+                          VgpuDev->Commands->DisplayInfo.
+
+  @retval EFI_SUCCESS       The response is available.
+  @retval EFI_DEVICE_ERROR  The host rejected the request.
+  @return                   Error codes from VirtioFlush().
+**/
+EFI_STATUS
+VirtioGpuGetDisplayInfo (
+  IN OUT VGPU_DEV  *VgpuDev
+  );
+
+/**
+  Start building the request in a slot of the command area.
+
+  @param[in,out] VgpuDev  The driver instance.
+  @param[in] Slot         The slot, less than VGPU_MAX_BATCH.
+  @param[in] Type         The VIRTIO_GPU_CONTROL_TYPE of the request.
+  @param[in] Size         The size of the request structure.
+
+  @return  The zeroed request, with its header type set.
+**/
+VGPU_REQUEST *
+VirtioGpuPrepareRequest (
+  IN OUT VGPU_DEV  *VgpuDev,
+  IN     UINTN     Slot,
+  IN     UINT32    Type,
+  IN     UINT32    Size
+  );
+
+/**
+  Submit the requests in slots [0, Count) with a single notification, and
+  wait until the host has processed all of them.
+
+  @param[in,out] VgpuDev  The driver instance.
+  @param[in] Count        The number of requests, between 1 and
+                          VGPU_MAX_BATCH inclusive.
+
+  @retval EFI_SUCCESS       All requests succeeded.
+  @retval EFI_DEVICE_ERROR  The host rejected a request.
+  @return                   Error codes from VirtioFlushBatch().
+**/
+EFI_STATUS
+VirtioGpuSubmit (
+  IN OUT VGPU_DEV  *VgpuDev,
+  IN     UINTN     Count
+  );
+
+//
+// Graphics output, implemented in Gop.c.
+//
+
+/**
+  Set up the framebuffer backing store, and produce the Graphics Output
+  Protocol on a child handle.
+
+  @param[in,out] VgpuDev       The driver instance, initialized with
+                               VirtioGpuInit().
+  @param[in] ParentDevicePath  The device path of the virtio device.
+  @param[in] DriverBindingHandle  The driver binding handle of this driver.
+  @param[in] ControllerHandle  The handle of the virtio device.
+
+  @retval EFI_SUCCESS  The Graphics Output Protocol has been installed.
+  @return              Error codes from the allocation, mapping and protocol
+                       services, and from the device.
+**/
+EFI_STATUS
+VirtioGpuGopInit (
+  IN OUT VGPU_DEV                  *VgpuDev,
+  IN     EFI_DEVICE_PATH_PROTOCOL  *ParentDevicePath,
+  IN     EFI_HANDLE                DriverBindingHandle,
+  IN     EFI_HANDLE                ControllerHandle
+  );
+
+/**
+  Uninstall the Graphics Output Protocol, and release the resources of
+  VirtioGpuGopInit().
+
+  @param[in,out] VgpuDev          The driver instance.
+  @param[in] DriverBindingHandle  The driver binding handle of this driver.
+  @param[in] ControllerHandle     The handle of the virtio device.
+
+  @retval EFI_SUCCESS  The child handle has been destroyed.
+  @return              Error codes from UninstallMultipleProtocolInterfaces().
+**/
+EFI_STATUS
+VirtioGpuGopUninit (
+  IN OUT VGPU_DEV    *VgpuDev,
+  IN     EFI_HANDLE  DriverBindingHandle,
+  IN     EFI_HANDLE  ControllerHandle
+  );
+
+#endif
@@ -0,0 +1,975 @@
+/** @file
+
+  EFI_SIMPLE_TEXT_INPUT_PROTOCOL and EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL
+  implementation of the VirtioInput driver.
+
+  Key events are translated with a US layout, like UsbKbDxe does by default.
+
+  Key notification functions have to run when their key is pressed, even if
+  no one reads ConIn, for example for the BDS hot keys. While any are
+  registered, a slow timer collects the pending events from the device.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include "VirtioInput.h"
+
+//
+// How often the device is checked while key notifications are registered.
+//
+#define VIRTIO_INPUT_KEY_NOTIFY_POLL_INTERVAL  EFI_TIMER_PERIOD_MILLISECONDS (50)
+
+//
+// Translation of the key codes below VIRTIO_INPUT_KEY_MAP_SIZE. Keys that are
+// absent produce no keystroke, or a partial keystroke if the consumer asked
+// for those.
+//
+typedef struct {
+  UINT16    ScanCode;
+  CHAR16    Unicode;
+  CHAR16    ShiftedUnicode;
+} VIRTIO_INPUT_KEY_MAP;
+
+STATIC CONST VIRTIO_INPUT_KEY_MAP  mVirtioInputKeyMap[] = {
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 0   RESERVED
+  { SCAN_ESC,         CHAR_NULL,            CHAR_NULL            }, // 1   ESC
+  { SCAN_NULL,        L'1',                 L'!'                 }, // 2   1
+  { SCAN_NULL,        L'2',                 L'@'                 }, // 3   2
+  { SCAN_NULL,        L'3',                 L'#'                 }, // 4   3
+  { SCAN_NULL,        L'4',                 L'$'                 }, // 5   4
+  { SCAN_NULL,        L'5',                 L'%'                 }, // 6   5
+  { SCAN_NULL,        L'6',                 L'^'                 }, // 7   6
+  { SCAN_NULL,        L'7',                 L'&'                 }, // 8   7
+  { SCAN_NULL,        L'8',                 L'*'                 }, // 9   8
+  { SCAN_NULL,        L'9',                 L'('                 }, // 10  9
+  { SCAN_NULL,        L'0',                 L')'                 }, // 11  0
+  { SCAN_NULL,        L'-',                 L'_'                 }, // 12  MINUS
+  { SCAN_NULL,        L'=',                 L'+'                 }, // 13  EQUAL
+  { SCAN_NULL,        CHAR_BACKSPACE,       CHAR_NULL            }, // 14  BACKSPACE
+  { SCAN_NULL,        CHAR_TAB,             CHAR_NULL            }, // 15  TAB
+  { SCAN_NULL,        L'q',                 L'Q'                 }, // 16  Q
+  { SCAN_NULL,        L'w',                 L'W'                 }, // 17  W
+  { SCAN_NULL,        L'e',                 L'E'                 }, // 18  E
+  { SCAN_NULL,        L'r',                 L'R'                 }, // 19  R
+  { SCAN_NULL,        L't',                 L'T'                 }, // 20  T
+  { SCAN_NULL,        L'y',                 L'Y'                 }, // 21  Y
+  { SCAN_NULL,        L'u',                 L'U'                 }, // 22  U
+  { SCAN_NULL,        L'i',                 L'I'                 }, // 23  I
+  { SCAN_NULL,        L'o',                 L'O'                 }, // 24  O
+  { SCAN_NULL,        L'p',                 L'P'                 }, // 25  P
+  { SCAN_NULL,        L'[',                 L'{'                 }, // 26  LEFTBRACE
+  { SCAN_NULL,        L']',                 L'}'                 }, // 27  RIGHTBRACE
+  { SCAN_NULL,        CHAR_CARRIAGE_RETURN, CHAR_NULL            }, // 28  ENTER
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 29  LEFTCTRL
+  { SCAN_NULL,        L'a',                 L'A'                 }, // 30  A
+  { SCAN_NULL,        L's',                 L'S'                 }, // 31  S
+  { SCAN_NULL,        L'd',                 L'D'                 }, // 32  D
+  { SCAN_NULL,        L'f',                 L'F'                 }, // 33  F
+  { SCAN_NULL,        L'g',                 L'G'                 }, // 34  G
+  { SCAN_NULL,        L'h',                 L'H'                 }, // 35  H
+  { SCAN_NULL,        L'j',                 L'J'                 }, // 36  J
+  { SCAN_NULL,        L'k',                 L'K'                 }, // 37  K
+  { SCAN_NULL,        L'l',                 L'L'                 }, // 38  L
+  { SCAN_NULL,        L';',                 L':'                 }, // 39  SEMICOLON
+  { SCAN_NULL,        L'\'',                L'"'                 }, // 40  APOSTROPHE
+  { SCAN_NULL,        L'`',                 L'~'                 }, // 41  GRAVE
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 42  LEFTSHIFT
+  { SCAN_NULL,        L'\\',                L'|'                 }, // 43  BACKSLASH
+  { SCAN_NULL,        L'z',                 L'Z'                 }, // 44  Z
+  { SCAN_NULL,        L'x',                 L'X'                 }, // 45  X
+  { SCAN_NULL,        L'c',                 L'C'                 }, // 46  C
+  { SCAN_NULL,        L'v',                 L'V'                 }, // 47  V
+  { SCAN_NULL,        L'b',                 L'B'                 }, // 48  B
+  { SCAN_NULL,        L'n',                 L'N'                 }, // 49  N
+  { SCAN_NULL,        L'm',                 L'M'                 }, // 50  M
+  { SCAN_NULL,        L',',                 L'<'                 }, // 51  COMMA
+  { SCAN_NULL,        L'.',                 L'>'                 }, // 52  DOT
+  { SCAN_NULL,        L'/',                 L'?'                 }, // 53  SLASH
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 54  RIGHTSHIFT
+  { SCAN_NULL,        L'*',                 CHAR_NULL            }, // 55  KPASTERISK
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 56  LEFTALT
+  { SCAN_NULL,        L' ',                 CHAR_NULL            }, // 57  SPACE
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 58  CAPSLOCK
+  { SCAN_F1,          CHAR_NULL,            CHAR_NULL            }, // 59  F1
+  { SCAN_F2,          CHAR_NULL,            CHAR_NULL            }, // 60  F2
+  { SCAN_F3,          CHAR_NULL,            CHAR_NULL            }, // 61  F3
+  { SCAN_F4,          CHAR_NULL,            CHAR_NULL            }, // 62  F4
+  { SCAN_F5,          CHAR_NULL,            CHAR_NULL            }, // 63  F5
+  { SCAN_F6,          CHAR_NULL,            CHAR_NULL            }, // 64  F6
+  { SCAN_F7,          CHAR_NULL,            CHAR_NULL            }, // 65  F7
+  { SCAN_F8,          CHAR_NULL,            CHAR_NULL            }, // 66  F8
+  { SCAN_F9,          CHAR_NULL,            CHAR_NULL            }, // 67  F9
+  { SCAN_F10,         CHAR_NULL,            CHAR_NULL            }, // 68  F10
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 69  NUMLOCK
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 70  SCROLLLOCK
+  { SCAN_HOME,        L'7',                 CHAR_NULL            }, // 71  KP7
+  { SCAN_UP,          L'8',                 CHAR_NULL            }, // 72  KP8
+  { SCAN_PAGE_UP,     L'9',                 CHAR_NULL            }, // 73  KP9
+  { SCAN_NULL,        L'-',                 CHAR_NULL            }, // 74  KPMINUS
+  { SCAN_LEFT,        L'4',                 CHAR_NULL            }, // 75  KP4
+  { SCAN_NULL,        L'5',                 CHAR_NULL            }, // 76  KP5
+  { SCAN_RIGHT,       L'6',                 CHAR_NULL            }, // 77  KP6
+  { SCAN_NULL,        L'+',                 CHAR_NULL            }, // 78  KPPLUS
+  { SCAN_END,         L'1',                 CHAR_NULL            }, // 79  KP1
+  { SCAN_DOWN,        L'2',                 CHAR_NULL            }, // 80  KP2
+  { SCAN_PAGE_DOWN,   L'3',                 CHAR_NULL            }, // 81  KP3
+  { SCAN_INSERT,      L'0',                 CHAR_NULL            }, // 82  KP0
+  { SCAN_DELETE,      L'.',                 CHAR_NULL            }, // 83  KPDOT
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 84
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 85  ZENKAKUHANKAKU
+  { SCAN_NULL,        L'\\',                L'|'                 }, // 86  102ND
+  { SCAN_F11,         CHAR_NULL,            CHAR_NULL            }, // 87  F11
+  { SCAN_F12,         CHAR_NULL,            CHAR_NULL            }, // 88  F12
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 89  RO
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 90  KATAKANA
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 91  HIRAGANA
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 92  HENKAN
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 93  KATAKANAHIRAGANA
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 94  MUHENKAN
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 95  KPJPCOMMA
+  { SCAN_NULL,        CHAR_CARRIAGE_RETURN, CHAR_NULL            }, // 96  KPENTER
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 97  RIGHTCTRL
+  { SCAN_NULL,        L'/',                 CHAR_NULL            }, // 98  KPSLASH
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 99  SYSRQ
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 100 RIGHTALT
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 101 LINEFEED
+  { SCAN_HOME,        CHAR_NULL,            CHAR_NULL            }, // 102 HOME
+  { SCAN_UP,          CHAR_NULL,            CHAR_NULL            }, // 103 UP
+  { SCAN_PAGE_UP,     CHAR_NULL,            CHAR_NULL            }, // 104 PAGEUP
+  { SCAN_LEFT,        CHAR_NULL,            CHAR_NULL            }, // 105 LEFT
+  { SCAN_RIGHT,       CHAR_NULL,            CHAR_NULL            }, // 106 RIGHT
+  { SCAN_END,         CHAR_NULL,            CHAR_NULL            }, // 107 END
+  { SCAN_DOWN,        CHAR_NULL,            CHAR_NULL            }, // 108 DOWN
+  { SCAN_PAGE_DOWN,   CHAR_NULL,            CHAR_NULL            }, // 109 PAGEDOWN
+  { SCAN_INSERT,      CHAR_NULL,            CHAR_NULL            }, // 110 INSERT
+  { SCAN_DELETE,      CHAR_NULL,            CHAR_NULL            }, // 111 DELETE
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 112 MACRO
+  { SCAN_MUTE,        CHAR_NULL,            CHAR_NULL            }, // 113 MUTE
+  { SCAN_VOLUME_DOWN, CHAR_NULL,            CHAR_NULL            }, // 114 VOLUMEDOWN
+  { SCAN_VOLUME_UP,   CHAR_NULL,            CHAR_NULL            }, // 115 VOLUMEUP
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 116 POWER
+  { SCAN_NULL,        L'=',                 CHAR_NULL            }, // 117 KPEQUAL
+  { SCAN_NULL,        CHAR_NULL,            CHAR_NULL            }, // 118 KPPLUSMINUS
+  { SCAN_PAUSE,       CHAR_NULL,            CHAR_NULL            }, // 119 PAUSE
+};
+
+/**
+  Map a modifier key code to its EFI_*_PRESSED shift state bit.
+
+  @param[in] Code  The key code.
+
+  @return  The shift state bit, or zero if Code is not a modifier key.
+**/
+STATIC
+UINT32
+VirtioInputModifierBit (
+  IN UINT16  Code
+  )
+{
+  switch (Code) {
+    case VIRTIO_INPUT_KEY_LEFTCTRL:   return EFI_LEFT_CONTROL_PRESSED;
+    case VIRTIO_INPUT_KEY_RIGHTCTRL:  return EFI_RIGHT_CONTROL_PRESSED;
+    case VIRTIO_INPUT_KEY_LEFTSHIFT:  return EFI_LEFT_SHIFT_PRESSED;
+    case VIRTIO_INPUT_KEY_RIGHTSHIFT: return EFI_RIGHT_SHIFT_PRESSED;
+    case VIRTIO_INPUT_KEY_LEFTALT:    return EFI_LEFT_ALT_PRESSED;
+    case VIRTIO_INPUT_KEY_RIGHTALT:   return EFI_RIGHT_ALT_PRESSED;
+    case VIRTIO_INPUT_KEY_LEFTMETA:   return EFI_LEFT_LOGO_PRESSED;
+    case VIRTIO_INPUT_KEY_RIGHTMETA:  return EFI_RIGHT_LOGO_PRESSED;
+    case VIRTIO_INPUT_KEY_COMPOSE:    return EFI_MENU_KEY_PRESSED;
+    case VIRTIO_INPUT_KEY_SYSRQ:      return EFI_SYS_REQ_PRESSED;
+    default:                          return 0;
+  }
+}
+
+/**
+  Map a lock key code to its EFI_*_ACTIVE toggle state bit.
+
+  @param[in] Code  The key code.
+
+  @return  The toggle state bit, or zero if Code is not a lock key.
+**/
+STATIC
+EFI_KEY_TOGGLE_STATE
+VirtioInputToggleBit (
+  IN UINT16  Code
+  )
+{
+  switch (Code) {
+    case VIRTIO_INPUT_KEY_CAPSLOCK:   return EFI_CAPS_LOCK_ACTIVE;
+    case VIRTIO_INPUT_KEY_NUMLOCK:    return EFI_NUM_LOCK_ACTIVE;
+    case VIRTIO_INPUT_KEY_SCROLLLOCK: return EFI_SCROLL_LOCK_ACTIVE;
+    default:                          return 0;
+  }
+}
+
+/**
+  Append a keystroke to a queue.
+
+  @param[in,out] Queue  The queue.
+  @param[in] KeyData    The keystroke.
+
+  @retval TRUE   The keystroke has been queued.
+  @retval FALSE  The queue is full; the keystroke has been dropped.
+**/
+STATIC
+BOOLEAN
+VirtioInputEnqueue (
+  IN OUT VIRTIO_INPUT_KEY_QUEUE  *Queue,
+  IN     CONST EFI_KEY_DATA      *KeyData
+  )
+{
+  if (Queue->Count == VIRTIO_INPUT_KEY_QUEUE_SIZE) {
+    return FALSE;
+  }
+
+  CopyMem (
+    &Queue->Buffer[(Queue->Head + Queue->Count) % VIRTIO_INPUT_KEY_QUEUE_SIZE],
+    KeyData,
+    sizeof *KeyData
+    );
+  Queue->Count++;
+  return TRUE;
+}
+
+/**
+  Remove the oldest keystroke from a queue.
+
+  @param[in,out] Queue  The queue.
+  @param[out] KeyData   The keystroke; may be NULL to drop it.
+
+  @retval TRUE   A keystroke has been removed.
+  @retval FALSE  The queue is empty.
+**/
+STATIC
+BOOLEAN
+VirtioInputDequeue (
+  IN OUT VIRTIO_INPUT_KEY_QUEUE  *Queue,
+  OUT    EFI_KEY_DATA            *KeyData OPTIONAL
+  )
+{
+  if (Queue->Count == 0) {
+    return FALSE;
+  }
+
+  if (KeyData != NULL) {
+    CopyMem (KeyData, &Queue->Buffer[Queue->Head], sizeof *KeyData);
+  }
+
+  Queue->Head = (Queue->Head + 1) % VIRTIO_INPUT_KEY_QUEUE_SIZE;
+  Queue->Count--;
+  return TRUE;
+}
+
+/**
+  Check whether a keystroke matches a key registered for notification.
+
+  @param[in] RegisteredData  The key registered with RegisterKeyNotify().
+  @param[in] InputData       The keystroke.
+
+  @retval TRUE   The keystroke matches.
+  @retval FALSE  The keystroke does not match.
+**/
+STATIC
+BOOLEAN
+VirtioInputIsKeyRegistered (
+  IN CONST EFI_KEY_DATA  *RegisteredData,
+  IN CONST EFI_KEY_DATA  *InputData
+  )
+{
+  if ((RegisteredData->Key.ScanCode != InputData->Key.ScanCode) ||
+      (RegisteredData->Key.UnicodeChar != InputData->Key.UnicodeChar))
+  {
+    return FALSE;
+  }
+
+  //
+  // Assume KeyShiftState/KeyToggleState = 0 in Registered key data means
+  // these state could be ignored.
+  //
+  if ((RegisteredData->KeyState.KeyShiftState != 0) &&
+      (RegisteredData->KeyState.KeyShiftState != InputData->KeyState.KeyShiftState))
+  {
+    return FALSE;
+  }
+
+  if ((RegisteredData->KeyState.KeyToggleState != 0) &&
+      (RegisteredData->KeyState.KeyToggleState != InputData->KeyState.KeyToggleState))
+  {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+  Queue a keystroke, and the notifications registered for it.
+
+  @param[in,out] Dev  The driver instance.
+  @param[in] Key      The keystroke.
+**/
+STATIC
+VOID
+VirtioInputQueueKey (
+  IN OUT VIRTIO_INPUT_DEV     *Dev,
+  IN     CONST EFI_INPUT_KEY  *Key
+  )
+{
+  EFI_KEY_DATA             KeyData;
+  LIST_ENTRY               *Link;
+  VIRTIO_INPUT_KEY_NOTIFY  *CurrentNotify;
+
+  CopyMem (&KeyData.Key, Key, sizeof *Key);
+  KeyData.KeyState.KeyShiftState  = EFI_SHIFT_STATE_VALID | Dev->ShiftState;
+  KeyData.KeyState.KeyToggleState = EFI_TOGGLE_STATE_VALID | Dev->ToggleState;
+  if (Dev->IsSupportPartialKey) {
+    KeyData.KeyState.KeyToggleState |= EFI_KEY_STATE_EXPOSED;
+  }
+
+  //
+  // For characters that the shift keys already affect, the shift state is
+  // not reported separately.
+  //
+  if ((Key->ScanCode == SCAN_NULL) && (Key->UnicodeChar != CHAR_NULL) &&
+      ((Dev->ShiftState & (EFI_LEFT_SHIFT_PRESSED | EFI_RIGHT_SHIFT_PRESSED)) != 0))
+  {
+    KeyData.KeyState.KeyShiftState &= ~(UINT32)(EFI_LEFT_SHIFT_PRESSED | EFI_RIGHT_SHIFT_PRESSED);
+  }
+
+  if (!VirtioInputEnqueue (&Dev->KeyQueue, &KeyData)) {
+    DEBUG ((DEBUG_WARN, "%a: keystroke dropped\n", __FUNCTION__));
+  }
+
+  //
+  // The key notification functions need to run at TPL_CALLBACK, while we are
+  // at TPL_NOTIFY. They are invoked from VirtioInputKeyNotifyProcess().
+  //
+  for (Link = GetFirstNode (&Dev->NotifyList);
+       !IsNull (&Dev->NotifyList, Link);
+       Link = GetNextNode (&Dev->NotifyList, Link))
+  {
+    CurrentNotify = CR (
+                      Link,
+                      VIRTIO_INPUT_KEY_NOTIFY,
+                      NotifyEntry,
+                      VIRTIO_INPUT_KEY_NOTIFY_SIG
+                      );
+    if (VirtioInputIsKeyRegistered (&CurrentNotify->KeyData, &KeyData)) {
+      VirtioInputEnqueue (&Dev->NotifyQueue, &KeyData);
+      gBS->SignalEvent (Dev->KeyNotifyProcessEvent);
+      break;
+    }
+  }
+}
+
+/**
+  Translate a keyboard key event into keystrokes. The caller is responsible
+  for running at TPL_NOTIFY.
+
+  @param[in,out] Dev  The driver instance.
+  @param[in] Code     The key code, below VIRTIO_INPUT_BTN_MISC.
+  @param[in] Value    One of VIRTIO_INPUT_KEY_RELEASED, _PRESSED, _REPEATED.
+**/
+VOID
+VirtioInputHandleKeyEvent (
+  IN OUT VIRTIO_INPUT_DEV  *Dev,
+  IN     UINT16            Code,
+  IN     UINT32            Value
+  )
+{
+  UINT32                      ModifierBit;
+  EFI_KEY_TOGGLE_STATE        ToggleBit;
+  CONST VIRTIO_INPUT_KEY_MAP  *Map;
+  EFI_INPUT_KEY               Key;
+  BOOLEAN                     Shifted;
+
+  Key.ScanCode    = SCAN_NULL;
+  Key.UnicodeChar = CHAR_NULL;
+
+  ModifierBit = VirtioInputModifierBit (Code);
+  if (ModifierBit != 0) {
+    if (Value == VIRTIO_INPUT_KEY_RELEASED) {
+      Dev->ShiftState &= ~ModifierBit;
+    } else {
+      Dev->ShiftState |= ModifierBit;
+    }
+
+    if ((Value == VIRTIO_INPUT_KEY_PRESSED) && Dev->IsSupportPartialKey) {
+      VirtioInputQueueKey (Dev, &Key);
+    }
+
+    return;
+  }
+
+  if (Value == VIRTIO_INPUT_KEY_RELEASED) {
+    return;
+  }
+
+  ToggleBit = VirtioInputToggleBit (Code);
+  if (ToggleBit != 0) {
+    if (Value == VIRTIO_INPUT_KEY_PRESSED) {
+      Dev->ToggleState ^= ToggleBit;
+      if (Dev->IsSupportPartialKey) {
+        VirtioInputQueueKey (Dev, &Key);
+      }
+    }
+
+    return;
+  }
+
+  if (Code < ARRAY_SIZE (mVirtioInputKeyMap)) {
+    Map = &mVirtioInputKeyMap[Code];
+
+    if ((Code >= VIRTIO_INPUT_KEY_KP7) && (Code <= VIRTIO_INPUT_KEY_KPDOT) &&
+        ((Map->ScanCode != SCAN_NULL) || (Map->Unicode == L'5')))
+    {
+      //
+      // Keypad digits depend on NumLock.
+      //
+      if ((Dev->ToggleState & EFI_NUM_LOCK_ACTIVE) != 0) {
+        Key.UnicodeChar = Map->Unicode;
+      } else {
+        Key.ScanCode = Map->ScanCode;
+      }
+    } else if (Map->ScanCode != SCAN_NULL) {
+      Key.ScanCode = Map->ScanCode;
+    } else {
+      Shifted = (BOOLEAN)((Dev->ShiftState & (EFI_LEFT_SHIFT_PRESSED | EFI_RIGHT_SHIFT_PRESSED)) != 0);
+      if ((Map->Unicode >= L'a') && (Map->Unicode <= L'z') &&
+          ((Dev->ToggleState & EFI_CAPS_LOCK_ACTIVE) != 0))
+      {
+        Shifted = (BOOLEAN)!Shifted;
+      }
+
+      Key.UnicodeChar = (Shifted && (Map->ShiftedUnicode != CHAR_NULL)) ?
+                        Map->ShiftedUnicode : Map->Unicode;
+    }
+  }
+
+  if ((Key.ScanCode == SCAN_NULL) && (Key.UnicodeChar == CHAR_NULL) &&
+      !Dev->IsSupportPartialKey)
+  {
+    return;
+  }
+
+  VirtioInputQueueKey (Dev, &Key);
+}
+
+/**
+  Run the key notification functions for the keystrokes queued for them.
+
+  @param[in] Event    The key notification event.
+  @param[in] Context  The VIRTIO_INPUT_DEV instance.
+**/
+STATIC
+VOID
+EFIAPI
+VirtioInputKeyNotifyProcess (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  VIRTIO_INPUT_DEV         *Dev;
+  EFI_KEY_DATA             KeyData;
+  LIST_ENTRY               *Link;
+  VIRTIO_INPUT_KEY_NOTIFY  *CurrentNotify;
+  EFI_TPL                  OldTpl;
+  BOOLEAN                  Dequeued;
+
+  Dev = Context;
+
+  for ( ; ;) {
+    //
+    // Enter critical section
+    //
+    OldTpl   = gBS->RaiseTPL (TPL_NOTIFY);
+    Dequeued = VirtioInputDequeue (&Dev->NotifyQueue, &KeyData);
+    //
+    // Leave critical section
+    //
+    gBS->RestoreTPL (OldTpl);
+    if (!Dequeued) {
+      break;
+    }
+
+    for (Link = GetFirstNode (&Dev->NotifyList);
+         !IsNull (&Dev->NotifyList, Link);
+         Link = GetNextNode (&Dev->NotifyList, Link))
+    {
+      CurrentNotify = CR (
+                        Link,
+                        VIRTIO_INPUT_KEY_NOTIFY,
+                        NotifyEntry,
+                        VIRTIO_INPUT_KEY_NOTIFY_SIG
+                        );
+      if (VirtioInputIsKeyRegistered (&CurrentNotify->KeyData, &KeyData)) {
+        CurrentNotify->KeyNotificationFn (&KeyData);
+      }
+    }
+  }
+}
+
+/**
+  Notification function of the key notification timer: collect the pending
+  events from the device, which queues the keystrokes that have
+  notifications registered.
+
+  @param[in] Event    The key notification timer event.
+  @param[in] Context  The VIRTIO_INPUT_DEV instance.
+**/
+STATIC
+VOID
+EFIAPI
+VirtioInputKeyNotifyTimer (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  VirtioInputProcessEvents (Context);
+}
+
+/**
+  Notification function of the WaitForKey and WaitForKeyEx events: collect
+  the pending events from the device, and signal the event if a keystroke is
+  available.
+
+  @param[in] Event    The WaitForKey or WaitForKeyEx event.
+  @param[in] Context  The VIRTIO_INPUT_DEV instance.
+**/
+STATIC
+VOID
+EFIAPI
+VirtioInputWaitForKey (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+  EFI_KEY_DATA      *KeyData;
+  EFI_TPL           OldTpl;
+
+  Dev = Context;
+
+  VirtioInputProcessEvents (Dev);
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  while (Dev->KeyQueue.Count > 0) {
+    KeyData = &Dev->KeyQueue.Buffer[Dev->KeyQueue.Head];
+    if ((KeyData->Key.ScanCode == SCAN_NULL) &&
+        (KeyData->Key.UnicodeChar == CHAR_NULL))
+    {
+      //
+      // Partial keystrokes do not satisfy a wait.
+      //
+      VirtioInputDequeue (&Dev->KeyQueue, NULL);
+      continue;
+    }
+
+    gBS->SignalEvent (Event);
+    break;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Return the next keystroke, collecting the pending events from the device
+  first.
+
+  @param[in,out] Dev  The driver instance.
+  @param[out] KeyData The keystroke.
+
+  @retval EFI_SUCCESS    KeyData has been set.
+  @retval EFI_NOT_READY  No keystroke is available.
+**/
+STATIC
+EFI_STATUS
+VirtioInputReadKeyData (
+  IN OUT VIRTIO_INPUT_DEV  *Dev,
+  OUT    EFI_KEY_DATA      *KeyData
+  )
+{
+  EFI_TPL  OldTpl;
+  BOOLEAN  Dequeued;
+
+  VirtioInputProcessEvents (Dev);
+
+  OldTpl   = gBS->RaiseTPL (TPL_NOTIFY);
+  Dequeued = VirtioInputDequeue (&Dev->KeyQueue, KeyData);
+  gBS->RestoreTPL (OldTpl);
+
+  return Dequeued ? EFI_SUCCESS : EFI_NOT_READY;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputReset (
+  IN EFI_SIMPLE_TEXT_INPUT_PROTOCOL  *This,
+  IN BOOLEAN                         ExtendedVerification
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+  EFI_TPL           OldTpl;
+
+  Dev = VIRTIO_INPUT_FROM_TEXT_IN (This);
+
+  VirtioInputProcessEvents (Dev);
+
+  OldTpl              = gBS->RaiseTPL (TPL_NOTIFY);
+  Dev->KeyQueue.Head  = 0;
+  Dev->KeyQueue.Count = 0;
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputReadKeyStroke (
+  IN  EFI_SIMPLE_TEXT_INPUT_PROTOCOL  *This,
+  OUT EFI_INPUT_KEY                   *Key
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+  EFI_KEY_DATA      KeyData;
+  EFI_STATUS        Status;
+
+  if (Key == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Dev = VIRTIO_INPUT_FROM_TEXT_IN (This);
+
+  for ( ; ;) {
+    Status = VirtioInputReadKeyData (Dev, &KeyData);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    //
+    // SimpleTextIn cannot return partial keystrokes; skip them.
+    //
+    if ((KeyData.Key.ScanCode != SCAN_NULL) ||
+        (KeyData.Key.UnicodeChar != CHAR_NULL))
+    {
+      break;
+    }
+  }
+
+  //
+  // Translate Ctrl-[a-z] to the control characters 1 to 26.
+  //
+  if ((KeyData.KeyState.KeyShiftState &
+       (EFI_LEFT_CONTROL_PRESSED | EFI_RIGHT_CONTROL_PRESSED)) != 0)
+  {
+    if ((KeyData.Key.UnicodeChar >= L'a') && (KeyData.Key.UnicodeChar <= L'z')) {
+      KeyData.Key.UnicodeChar = (CHAR16)(KeyData.Key.UnicodeChar - L'a' + 1);
+    } else if ((KeyData.Key.UnicodeChar >= L'A') && (KeyData.Key.UnicodeChar <= L'Z')) {
+      KeyData.Key.UnicodeChar = (CHAR16)(KeyData.Key.UnicodeChar - L'A' + 1);
+    }
+  }
+
+  CopyMem (Key, &KeyData.Key, sizeof *Key);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputResetEx (
+  IN EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL  *This,
+  IN BOOLEAN                            ExtendedVerification
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+
+  Dev = VIRTIO_INPUT_FROM_TEXT_IN_EX (This);
+  return VirtioInputReset (&Dev->TextIn, ExtendedVerification);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputReadKeyStrokeEx (
+  IN  EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL  *This,
+  OUT EFI_KEY_DATA                       *KeyData
+  )
+{
+  if (KeyData == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return VirtioInputReadKeyData (VIRTIO_INPUT_FROM_TEXT_IN_EX (This), KeyData);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputSetState (
+  IN EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL  *This,
+  IN EFI_KEY_TOGGLE_STATE               *KeyToggleState
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+
+  if (KeyToggleState == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((*KeyToggleState & EFI_TOGGLE_STATE_VALID) != EFI_TOGGLE_STATE_VALID) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Dev = VIRTIO_INPUT_FROM_TEXT_IN_EX (This);
+
+  //
+  // The toggle state is only tracked here; the keyboard LEDs, which the
+  // device would take on the status queue, are not updated.
+  //
+  Dev->ToggleState = *KeyToggleState &
+                     (EFI_CAPS_LOCK_ACTIVE | EFI_NUM_LOCK_ACTIVE | EFI_SCROLL_LOCK_ACTIVE);
+  Dev->IsSupportPartialKey = (BOOLEAN)((*KeyToggleState & EFI_KEY_STATE_EXPOSED) != 0);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputRegisterKeyNotify (
+  IN  EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL  *This,
+  IN  EFI_KEY_DATA                       *KeyData,
+  IN  EFI_KEY_NOTIFY_FUNCTION            KeyNotificationFunction,
+  OUT VOID                               **NotifyHandle
+  )
+{
+  VIRTIO_INPUT_DEV         *Dev;
+  VIRTIO_INPUT_KEY_NOTIFY  *NewNotify;
+  LIST_ENTRY               *Link;
+  VIRTIO_INPUT_KEY_NOTIFY  *CurrentNotify;
+  EFI_STATUS               Status;
+
+  if ((KeyData == NULL) || (NotifyHandle == NULL) ||
+      (KeyNotificationFunction == NULL))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Dev = VIRTIO_INPUT_FROM_TEXT_IN_EX (This);
+
+  //
+  // Return the existing handle if the same key and function are registered.
+  //
+  for (Link = GetFirstNode (&Dev->NotifyList);
+       !IsNull (&Dev->NotifyList, Link);
+       Link = GetNextNode (&Dev->NotifyList, Link))
+  {
+    CurrentNotify = CR (
+                      Link,
+                      VIRTIO_INPUT_KEY_NOTIFY,
+                      NotifyEntry,
+                      VIRTIO_INPUT_KEY_NOTIFY_SIG
+                      );
+    if (VirtioInputIsKeyRegistered (&CurrentNotify->KeyData, KeyData) &&
+        (CurrentNotify->KeyNotificationFn == KeyNotificationFunction))
+    {
+      *NotifyHandle = CurrentNotify;
+      return EFI_SUCCESS;
+    }
+  }
+
+  NewNotify = AllocateZeroPool (sizeof *NewNotify);
+  if (NewNotify == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Start collecting events on our own with the first notification.
+  //
+  if (IsListEmpty (&Dev->NotifyList)) {
+    Status = gBS->SetTimer (
+                    Dev->KeyNotifyTimerEvent,
+                    TimerPeriodic,
+                    VIRTIO_INPUT_KEY_NOTIFY_POLL_INTERVAL
+                    );
+    if (EFI_ERROR (Status)) {
+      FreePool (NewNotify);
+      return Status;
+    }
+  }
+
+  NewNotify->Signature         = VIRTIO_INPUT_KEY_NOTIFY_SIG;
+  NewNotify->KeyNotificationFn = KeyNotificationFunction;
+  CopyMem (&NewNotify->KeyData, KeyData, sizeof *KeyData);
+  InsertTailList (&Dev->NotifyList, &NewNotify->NotifyEntry);
+
+  *NotifyHandle = NewNotify;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputUnregisterKeyNotify (
+  IN EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL  *This,
+  IN VOID                               *NotificationHandle
+  )
+{
+  VIRTIO_INPUT_DEV         *Dev;
+  LIST_ENTRY               *Link;
+  VIRTIO_INPUT_KEY_NOTIFY  *CurrentNotify;
+
+  if (NotificationHandle == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Dev = VIRTIO_INPUT_FROM_TEXT_IN_EX (This);
+
+  for (Link = GetFirstNode (&Dev->NotifyList);
+       !IsNull (&Dev->NotifyList, Link);
+       Link = GetNextNode (&Dev->NotifyList, Link))
+  {
+    CurrentNotify = CR (
+                      Link,
+                      VIRTIO_INPUT_KEY_NOTIFY,
+                      NotifyEntry,
+                      VIRTIO_INPUT_KEY_NOTIFY_SIG
+                      );
+    if (CurrentNotify == NotificationHandle) {
+      RemoveEntryList (&CurrentNotify->NotifyEntry);
+      FreePool (CurrentNotify);
+
+      if (IsListEmpty (&Dev->NotifyList)) {
+        gBS->SetTimer (Dev->KeyNotifyTimerEvent, TimerCancel, 0);
+      }
+
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_INVALID_PARAMETER;
+}
+
+/**
+  Set up the Simple Text Input and Simple Text Input Ex protocol instances.
+
+  @param[in,out] Dev  The driver instance.
+
+  @retval EFI_SUCCESS  The protocol instances are ready to be installed.
+  @return              Error codes from CreateEvent()/CreateEventEx().
+**/
+EFI_STATUS
+VirtioInputKeyboardInit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  EFI_STATUS  Status;
+
+  InitializeListHead (&Dev->NotifyList);
+
+  Dev->TextIn.Reset         = VirtioInputReset;
+  Dev->TextIn.ReadKeyStroke = VirtioInputReadKeyStroke;
+
+  Dev->TextInEx.Reset               = VirtioInputResetEx;
+  Dev->TextInEx.ReadKeyStrokeEx     = VirtioInputReadKeyStrokeEx;
+  Dev->TextInEx.SetState            = VirtioInputSetState;
+  Dev->TextInEx.RegisterKeyNotify   = VirtioInputRegisterKeyNotify;
+  Dev->TextInEx.UnregisterKeyNotify = VirtioInputUnregisterKeyNotify;
+
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_WAIT,
+                  TPL_NOTIFY,
+                  VirtioInputWaitForKey,
+                  Dev,
+                  &Dev->TextIn.WaitForKey
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_WAIT,
+                  TPL_NOTIFY,
+                  VirtioInputWaitForKey,
+                  Dev,
+                  &Dev->TextInEx.WaitForKeyEx
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseWaitForKey;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  VirtioInputKeyNotifyProcess,
+                  Dev,
+                  &Dev->KeyNotifyProcessEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseWaitForKeyEx;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  VirtioInputKeyNotifyTimer,
+                  Dev,
+                  &Dev->KeyNotifyTimerEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseKeyNotifyProcess;
+  }
+
+  return EFI_SUCCESS;
+
+CloseKeyNotifyProcess:
+  gBS->CloseEvent (Dev->KeyNotifyProcessEvent);
+
+CloseWaitForKeyEx:
+  gBS->CloseEvent (Dev->TextInEx.WaitForKeyEx);
+
+CloseWaitForKey:
+  gBS->CloseEvent (Dev->TextIn.WaitForKey);
+
+  return Status;
+}
+
+/**
+  Release the resources of VirtioInputKeyboardInit().
+
+  @param[in,out] Dev  The driver instance.
+**/
+VOID
+VirtioInputKeyboardUninit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  VIRTIO_INPUT_KEY_NOTIFY  *CurrentNotify;
+
+  gBS->CloseEvent (Dev->KeyNotifyTimerEvent);
+  gBS->CloseEvent (Dev->KeyNotifyProcessEvent);
+  gBS->CloseEvent (Dev->TextInEx.WaitForKeyEx);
+  gBS->CloseEvent (Dev->TextIn.WaitForKey);
+
+  while (!IsListEmpty (&Dev->NotifyList)) {
+    CurrentNotify = CR (
+                      GetFirstNode (&Dev->NotifyList),
+                      VIRTIO_INPUT_KEY_NOTIFY,
+                      NotifyEntry,
+                      VIRTIO_INPUT_KEY_NOTIFY_SIG
+                      );
+    RemoveEntryList (&CurrentNotify->NotifyEntry);
+    FreePool (CurrentNotify);
+  }
+}
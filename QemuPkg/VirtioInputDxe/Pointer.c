@@ -0,0 +1,309 @@
+/** @file
+
+  EFI_ABSOLUTE_POINTER_PROTOCOL implementation of the VirtioInput driver.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "VirtioInput.h"
+
+/**
+  Read the range of an absolute axis.
+
+  @param[in] VirtIo  The VirtIo device.
+  @param[in] Axis    VIRTIO_INPUT_ABS_X or VIRTIO_INPUT_ABS_Y.
+  @param[out] Min    The smallest value of the axis.
+  @param[out] Max    The largest value of the axis.
+
+  @retval EFI_SUCCESS      Min and Max have been set.
+  @retval EFI_UNSUPPORTED  The device reports no usable range.
+  @return                  Error codes from the configuration accessors.
+**/
+STATIC
+EFI_STATUS
+VirtioInputReadAbsInfo (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINT8                   Axis,
+  OUT UINT32                  *Min,
+  OUT UINT32                  *Max
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Size;
+
+  Status = VirtioInputSelectConfig (
+             VirtIo,
+             VIRTIO_INPUT_CFG_ABS_INFO,
+             Axis,
+             &Size
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Size < OFFSET_OF (VIRTIO_INPUT_ABSINFO, Fuzz)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = VirtioInputReadConfig32 (
+             VirtIo,
+             OFFSET_OF (VIRTIO_INPUT_ABSINFO, Min),
+             Min
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = VirtioInputReadConfig32 (
+             VirtIo,
+             OFFSET_OF (VIRTIO_INPUT_ABSINFO, Max),
+             Max
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return (*Max > *Min) ? EFI_SUCCESS : EFI_UNSUPPORTED;
+}
+
+/**
+  Notification function of the WaitForInput event: collect the pending events
+  from the device, and signal the event if the pointer state has changed.
+
+  @param[in] Event    The WaitForInput event.
+  @param[in] Context  The VIRTIO_INPUT_DEV instance.
+**/
+STATIC
+VOID
+EFIAPI
+VirtioInputWaitForInput (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+
+  Dev = Context;
+
+  VirtioInputProcessEvents (Dev);
+
+  if (Dev->PointerStateChanged) {
+    gBS->SignalEvent (Event);
+  }
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputAbsPointerReset (
+  IN EFI_ABSOLUTE_POINTER_PROTOCOL  *This,
+  IN BOOLEAN                        ExtendedVerification
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+  EFI_TPL           OldTpl;
+
+  Dev = VIRTIO_INPUT_FROM_ABS_POINTER (This);
+
+  VirtioInputProcessEvents (Dev);
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ZeroMem (&Dev->AbsPointerState, sizeof Dev->AbsPointerState);
+  Dev->AbsPointerState.CurrentX = Dev->AbsPointerMode.AbsoluteMinX;
+  Dev->AbsPointerState.CurrentY = Dev->AbsPointerMode.AbsoluteMinY;
+  CopyMem (&Dev->PendingState, &Dev->AbsPointerState, sizeof Dev->PendingState);
+  Dev->PointerStateChanged = FALSE;
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputAbsPointerGetState (
+  IN     EFI_ABSOLUTE_POINTER_PROTOCOL  *This,
+  IN OUT EFI_ABSOLUTE_POINTER_STATE     *State
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+  EFI_TPL           OldTpl;
+  EFI_STATUS        Status;
+
+  if (State == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Dev = VIRTIO_INPUT_FROM_ABS_POINTER (This);
+
+  VirtioInputProcessEvents (Dev);
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (Dev->PointerStateChanged) {
+    CopyMem (State, &Dev->AbsPointerState, sizeof *State);
+    Dev->PointerStateChanged = FALSE;
+    Status                   = EFI_SUCCESS;
+  } else {
+    Status = EFI_NOT_READY;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Accumulate a pointer event; the state becomes visible at the next EV_SYN
+  event. The caller is responsible for running at TPL_NOTIFY.
+
+  @param[in,out] Dev    The driver instance.
+  @param[in] Event      The event, of type EV_SYN, EV_KEY (buttons) or
+                        EV_ABS.
+**/
+VOID
+VirtioInputHandlePointerEvent (
+  IN OUT VIRTIO_INPUT_DEV          *Dev,
+  IN     CONST VIRTIO_INPUT_EVENT  *Event
+  )
+{
+  UINT32  Button;
+
+  switch (Event->Type) {
+    case VIRTIO_INPUT_EV_ABS:
+      if (Event->Code == VIRTIO_INPUT_ABS_X) {
+        Dev->PendingState.CurrentX = Event->Value;
+      } else if (Event->Code == VIRTIO_INPUT_ABS_Y) {
+        Dev->PendingState.CurrentY = Event->Value;
+      }
+
+      break;
+
+    case VIRTIO_INPUT_EV_KEY:
+      switch (Event->Code) {
+        case VIRTIO_INPUT_BTN_LEFT:
+        case VIRTIO_INPUT_BTN_TOUCH:
+          Button = EFI_ABSP_TouchActive;
+          break;
+        case VIRTIO_INPUT_BTN_RIGHT:
+          Button = EFI_ABS_AltActive;
+          break;
+        default:
+          Button = 0;
+          break;
+      }
+
+      if (Event->Value == VIRTIO_INPUT_KEY_RELEASED) {
+        Dev->PendingState.ActiveButtons &= ~Button;
+      } else {
+        Dev->PendingState.ActiveButtons |= Button;
+      }
+
+      break;
+
+    case VIRTIO_INPUT_EV_SYN:
+      //
+      // The events since the previous EV_SYN form one consistent state.
+      //
+      CopyMem (&Dev->AbsPointerState, &Dev->PendingState, sizeof Dev->AbsPointerState);
+      Dev->PointerStateChanged = TRUE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+  Set up the Absolute Pointer protocol instance, with the axis ranges that
+  the device reports.
+
+  @param[in,out] Dev  The driver instance.
+
+  @retval EFI_SUCCESS  The protocol instance is ready to be installed.
+  @return              Error codes from the VirtIo services and CreateEvent().
+**/
+EFI_STATUS
+VirtioInputPointerInit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      MinX;
+  UINT32      MaxX;
+  UINT32      MinY;
+  UINT32      MaxY;
+  BOOLEAN     HasRightButton;
+
+  Status = VirtioInputReadAbsInfo (Dev->VirtIo, VIRTIO_INPUT_ABS_X, &MinX, &MaxX);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = VirtioInputReadAbsInfo (Dev->VirtIo, VIRTIO_INPUT_ABS_Y, &MinY, &MaxY);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = VirtioInputHasEventCode (
+             Dev->VirtIo,
+             VIRTIO_INPUT_EV_KEY,
+             VIRTIO_INPUT_BTN_RIGHT,
+             &HasRightButton
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Dev->AbsPointerMode.AbsoluteMinX = MinX;
+  Dev->AbsPointerMode.AbsoluteMaxX = MaxX;
+  Dev->AbsPointerMode.AbsoluteMinY = MinY;
+  Dev->AbsPointerMode.AbsoluteMaxY = MaxY;
+  Dev->AbsPointerMode.AbsoluteMinZ = 0;
+  Dev->AbsPointerMode.AbsoluteMaxZ = 0;
+  Dev->AbsPointerMode.Attributes   = HasRightButton ? EFI_ABSP_SupportsAltActive : 0;
+
+  Dev->AbsPointerState.CurrentX = MinX;
+  Dev->AbsPointerState.CurrentY = MinY;
+  CopyMem (&Dev->PendingState, &Dev->AbsPointerState, sizeof Dev->PendingState);
+
+  Dev->AbsPointer.Reset    = VirtioInputAbsPointerReset;
+  Dev->AbsPointer.GetState = VirtioInputAbsPointerGetState;
+  Dev->AbsPointer.Mode     = &Dev->AbsPointerMode;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: X=[%u, %u] Y=[%u, %u]\n",
+    __FUNCTION__,
+    MinX,
+    MaxX,
+    MinY,
+    MaxY
+    ));
+
+  return gBS->CreateEvent (
+                EVT_NOTIFY_WAIT,
+                TPL_NOTIFY,
+                VirtioInputWaitForInput,
+                Dev,
+                &Dev->AbsPointer.WaitForInput
+                );
+}
+
+/**
+  Release the resources of VirtioInputPointerInit().
+
+  @param[in,out] Dev  The driver instance.
+**/
+VOID
+VirtioInputPointerUninit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  gBS->CloseEvent (Dev->AbsPointer.WaitForInput);
+}
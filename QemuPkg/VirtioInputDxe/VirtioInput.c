@@ -0,0 +1,1013 @@
+/** @file
+
+  This driver produces the Simple Text Input (Ex) protocols for virtio-input
+  keyboards, and the Absolute Pointer protocol for virtio-input tablets.
+
+  The driver keeps event buffers posted on the event queue of the device, and
+  checks the used ring only when a consumer waits for or reads input: from
+  the notification functions of the WaitForKey(Ex) and WaitForInput events,
+  and from ReadKeyStroke(Ex) and GetState(). The one exception is a slow
+  timer that runs only while key notifications are registered with
+  RegisterKeyNotify(), so that they fire even when no one reads ConIn.
+  Otherwise an idle firmware causes no VM exits on behalf of the device,
+  unlike with the periodic polling of PS/2 and USB HID controllers.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/VirtioLib.h>
+
+#include "VirtioInput.h"
+
+/**
+  Select a configuration item, and return its size.
+
+  @param[in] VirtIo  The VirtIo device.
+  @param[in] Select  The VIRTIO_INPUT_CFG_* item.
+  @param[in] Subsel  The sub-item, for example the event type for
+                     VIRTIO_INPUT_CFG_EV_BITS.
+  @param[out] Size   The size of the item; zero if the device does not
+                     support it.
+
+  @return  Status codes from the VirtIo WriteDevice() and ReadDevice()
+           services.
+**/
+EFI_STATUS
+VirtioInputSelectConfig (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINT8                   Select,
+  IN  UINT8                   Subsel,
+  OUT UINT8                   *Size
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = VirtIo->WriteDevice (
+                     VirtIo,
+                     OFFSET_OF (VIRTIO_INPUT_CONFIG, Select),
+                     sizeof (UINT8),
+                     Select
+                     );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = VirtIo->WriteDevice (
+                     VirtIo,
+                     OFFSET_OF (VIRTIO_INPUT_CONFIG, Subsel),
+                     sizeof (UINT8),
+                     Subsel
+                     );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return VirtIo->ReadDevice (
+                   VirtIo,
+                   OFFSET_OF (VIRTIO_INPUT_CONFIG, Size),
+                   sizeof *Size,
+                   sizeof *Size,
+                   Size
+                   );
+}
+
+/**
+  Determine whether the device can report an event.
+
+  @param[in] VirtIo    The VirtIo device.
+  @param[in] Type      The event type, for example VIRTIO_INPUT_EV_KEY.
+  @param[in] Code      The event code.
+  @param[out] Present  Whether the device can report the event.
+
+  @return  Status codes from VirtioInputSelectConfig() and the VirtIo
+           ReadDevice() service.
+**/
+EFI_STATUS
+VirtioInputHasEventCode (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINT8                   Type,
+  IN  UINT16                  Code,
+  OUT BOOLEAN                 *Present
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Size;
+  UINT8       Byte;
+
+  *Present = FALSE;
+
+  Status = VirtioInputSelectConfig (
+             VirtIo,
+             VIRTIO_INPUT_CFG_EV_BITS,
+             Type,
+             &Size
+             );
+  if (EFI_ERROR (Status) || (Code / 8 >= Size)) {
+    return Status;
+  }
+
+  Status = VirtIo->ReadDevice (
+                     VirtIo,
+                     OFFSET_OF (VIRTIO_INPUT_CONFIG, u) + Code / 8,
+                     sizeof Byte,
+                     sizeof Byte,
+                     &Byte
+                     );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Present = (BOOLEAN)((Byte & (1 << (Code % 8))) != 0);
+  return EFI_SUCCESS;
+}
+
+/**
+  Read a 32-bit word of the selected configuration item.
+
+  @param[in] VirtIo   The VirtIo device.
+  @param[in] Offset   The byte offset of the word in the item.
+  @param[out] Value   The word read.
+
+  @return  Status codes from the VirtIo ReadDevice() service.
+**/
+EFI_STATUS
+VirtioInputReadConfig32 (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINTN                   Offset,
+  OUT UINT32                  *Value
+  )
+{
+  return VirtIo->ReadDevice (
+                   VirtIo,
+                   OFFSET_OF (VIRTIO_INPUT_CONFIG, u) + Offset,
+                   sizeof *Value,
+                   sizeof *Value,
+                   Value
+                   );
+}
+
+/**
+  Determine from the event bitmaps of the device whether it is a keyboard, a
+  tablet, or both.
+
+  @param[in,out] Dev  The driver instance. On success, IsKeyboard and
+                      IsPointer are set.
+
+  @retval EFI_SUCCESS      The device is a keyboard or a tablet.
+  @retval EFI_UNSUPPORTED  The device is neither, for example a relative
+                           mouse.
+  @return                  Error codes from VirtioInputHasEventCode().
+**/
+STATIC
+EFI_STATUS
+VirtioInputDetectCapabilities (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     HasAbsX;
+  BOOLEAN     HasAbsY;
+
+  Status = VirtioInputHasEventCode (
+             Dev->VirtIo,
+             VIRTIO_INPUT_EV_KEY,
+             VIRTIO_INPUT_KEY_A,
+             &Dev->IsKeyboard
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = VirtioInputHasEventCode (
+             Dev->VirtIo,
+             VIRTIO_INPUT_EV_ABS,
+             VIRTIO_INPUT_ABS_X,
+             &HasAbsX
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = VirtioInputHasEventCode (
+             Dev->VirtIo,
+             VIRTIO_INPUT_EV_ABS,
+             VIRTIO_INPUT_ABS_Y,
+             &HasAbsY
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Dev->IsPointer = (BOOLEAN)(HasAbsX && HasAbsY);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: keyboard=%d pointer=%d\n",
+    __FUNCTION__,
+    Dev->IsKeyboard,
+    Dev->IsPointer
+    ));
+
+  if (!Dev->IsKeyboard && !Dev->IsPointer) {
+    return EFI_UNSUPPORTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputInit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  UINT8       NextDevStat;
+  EFI_STATUS  Status;
+  UINT64      Features;
+  UINT16      QueueSize;
+  UINT64      RingBaseShift;
+  VOID        *Events;
+  UINT16      Index;
+
+  //
+  // Execute virtio-v1.0-cs04, 3.1.1 Driver Requirements: Device
+  // Initialization.
+  //
+  NextDevStat = 0;             // step 1 -- reset device
+  Status      = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_ACK;    // step 2 -- acknowledge device presence
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_DRIVER; // step 3 -- we know how to drive it
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 4 -- negotiate features; virtio-input defines none of its own
+  //
+  Status = Dev->VirtIo->GetDeviceFeatures (Dev->VirtIo, &Features);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  if ((Features & VIRTIO_F_VERSION_1) == 0) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  Features &= VIRTIO_F_VERSION_1 | VIRTIO_F_IOMMU_PLATFORM;
+
+  //
+  // ... and write the subset of feature bits understood by the [VirtIo
+  // 1.0] driver to the device (step 4 -- continued; steps 5 and 6).
+  //
+  Status = Virtio10WriteFeatures (Dev->VirtIo, Features, &NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = VirtioInputDetectCapabilities (Dev);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 7 -- set up the event queue; the status queue is not used
+  //
+  Status = Dev->VirtIo->SetQueueSel (Dev->VirtIo, VIRTIO_INPUT_EVENT_QUEUE);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = Dev->VirtIo->GetQueueNumMax (Dev->VirtIo, &QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  if (QueueSize == 0) {
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  Status = VirtioRingInit (Dev->VirtIo, QueueSize, &Dev->Ring);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // If anything fails from here on, we must release the ring resources.
+  //
+  Status = VirtioRingMap (
+             Dev->VirtIo,
+             &Dev->Ring,
+             &RingBaseShift,
+             &Dev->RingMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto ReleaseQueue;
+  }
+
+  //
+  // If anything fails from here on, we must unmap the ring resources.
+  //
+  Status = Dev->VirtIo->SetQueueNum (Dev->VirtIo, QueueSize);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = Dev->VirtIo->SetQueueAlign (Dev->VirtIo, EFI_PAGE_SIZE);
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = Dev->VirtIo->SetQueueAddress (
+                          Dev->VirtIo,
+                          &Dev->Ring,
+                          RingBaseShift
+                          );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  //
+  // Allocate and map the event buffers once; they are recycled in place.
+  //
+  Dev->EventCount = MIN (QueueSize, VIRTIO_INPUT_MAX_EVENTS);
+
+  Status = Dev->VirtIo->AllocateSharedPages (
+                          Dev->VirtIo,
+                          EFI_SIZE_TO_PAGES (VIRTIO_INPUT_MAX_EVENTS * sizeof (VIRTIO_INPUT_EVENT)),
+                          &Events
+                          );
+  if (EFI_ERROR (Status)) {
+    goto UnmapQueue;
+  }
+
+  Status = VirtioMapAllBytesInSharedBuffer (
+             Dev->VirtIo,
+             VirtioOperationBusMasterCommonBuffer,
+             Events,
+             Dev->EventCount * sizeof (VIRTIO_INPUT_EVENT),
+             &Dev->EventsAddress,
+             &Dev->EventsMap
+             );
+  if (EFI_ERROR (Status)) {
+    goto FreeEvents;
+  }
+
+  Dev->Events = Events;
+  ZeroMem (Dev->Events, Dev->EventCount * sizeof (VIRTIO_INPUT_EVENT));
+
+  //
+  // step 8 -- initialization complete
+  //
+  NextDevStat |= VSTAT_DRIVER_OK;
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto UnmapEvents;
+  }
+
+  //
+  // virtio-0.9.5, 2.4.2 Receiving Used Buffers From the Device: the host
+  // should not send interrupts, we poll when input is requested.
+  //
+  *Dev->Ring.Avail.Flags = (UINT16)VRING_AVAIL_F_NO_INTERRUPT;
+
+  //
+  // Post one single-descriptor, device-writable buffer per event.
+  //
+  for (Index = 0; Index < Dev->EventCount; Index++) {
+    Dev->Ring.Desc[Index].Addr  = Dev->EventsAddress +
+                                  Index * sizeof (VIRTIO_INPUT_EVENT);
+    Dev->Ring.Desc[Index].Len   = sizeof (VIRTIO_INPUT_EVENT);
+    Dev->Ring.Desc[Index].Flags = VRING_DESC_F_WRITE;
+    Dev->Ring.Avail.Ring[Index] = Index;
+  }
+
+  MemoryFence ();
+  Dev->LastUsed = *Dev->Ring.Used.Idx;
+  ASSERT (Dev->LastUsed == 0);
+
+  //
+  // virtio-0.9.5, 2.4.1.3 Updating the Index Field
+  //
+  MemoryFence ();
+  *Dev->Ring.Avail.Idx = Dev->EventCount;
+
+  //
+  // virtio-0.9.5, 2.4.1.4 Notifying the Device
+  //
+  MemoryFence ();
+  Status = Dev->VirtIo->SetQueueNotify (Dev->VirtIo, VIRTIO_INPUT_EVENT_QUEUE);
+  if (EFI_ERROR (Status)) {
+    Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+    goto UnmapEvents;
+  }
+
+  Dev->Active = TRUE;
+  return EFI_SUCCESS;
+
+UnmapEvents:
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->EventsMap);
+  Dev->Events = NULL;
+
+FreeEvents:
+  Dev->VirtIo->FreeSharedPages (
+                 Dev->VirtIo,
+                 EFI_SIZE_TO_PAGES (VIRTIO_INPUT_MAX_EVENTS * sizeof (VIRTIO_INPUT_EVENT)),
+                 Events
+                 );
+
+UnmapQueue:
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->RingMap);
+
+ReleaseQueue:
+  VirtioRingUninit (Dev->VirtIo, &Dev->Ring);
+
+Failed:
+  //
+  // If any of these steps go irrecoverably wrong, the driver SHOULD set the
+  // FAILED status bit to indicate that it has given up on the device (it can
+  // reset the device later to restart if desired). [...]
+  //
+  // VirtIo access failure here should not mask the original error.
+  //
+  NextDevStat |= VSTAT_FAILED;
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+
+  return Status; // reached only via Failed above
+}
+
+STATIC
+VOID
+EFIAPI
+VirtioInputUninit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  //
+  // Reset the virtual device -- see virtio-0.9.5, 2.2.2.1 Device Status. When
+  // VIRTIO_CFG_WRITE() returns, the host will have learned to stay away from
+  // the old comms area.
+  //
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+  Dev->Active = FALSE;
+
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->EventsMap);
+  Dev->VirtIo->FreeSharedPages (
+                 Dev->VirtIo,
+                 EFI_SIZE_TO_PAGES (VIRTIO_INPUT_MAX_EVENTS * sizeof (VIRTIO_INPUT_EVENT)),
+                 Dev->Events
+                 );
+  Dev->Events = NULL;
+
+  Dev->VirtIo->UnmapSharedBuffer (Dev->VirtIo, Dev->RingMap);
+  VirtioRingUninit (Dev->VirtIo, &Dev->Ring);
+}
+
+/**
+  Consume the events that the device has placed in the used ring, and give
+  the buffers back to the device with a single notification.
+
+  The used ring is only checked from here, that is, when a consumer waits for
+  or reads input, and while key notifications are registered, from a slow
+  timer.
+
+  @param[in,out] Dev  The driver instance.
+**/
+VOID
+VirtioInputProcessEvents (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  )
+{
+  EFI_TPL             OldTpl;
+  UINT16              UsedIdx;
+  UINT16              AvailIdx;
+  UINT16              UsedElemIdx;
+  UINT32              DescIdx;
+  UINT32              Len;
+  VIRTIO_INPUT_EVENT  Event;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  if (!Dev->Active) {
+    goto RestoreTpl;
+  }
+
+  //
+  // virtio-0.9.5, 2.4.2 Receiving Used Buffers From the Device
+  //
+  MemoryFence ();
+  UsedIdx = *Dev->Ring.Used.Idx;
+  MemoryFence ();
+
+  if (UsedIdx == Dev->LastUsed) {
+    goto RestoreTpl;
+  }
+
+  AvailIdx = *Dev->Ring.Avail.Idx;
+  while (Dev->LastUsed != UsedIdx) {
+    UsedElemIdx = Dev->LastUsed++ % Dev->Ring.QueueSize;
+    DescIdx     = Dev->Ring.Used.UsedElem[UsedElemIdx].Id;
+    Len         = Dev->Ring.Used.UsedElem[UsedElemIdx].Len;
+    if (DescIdx >= Dev->EventCount) {
+      ASSERT (FALSE);
+      continue;
+    }
+
+    CopyMem (&Event, &Dev->Events[DescIdx], sizeof Event);
+
+    //
+    // virtio-0.9.5, 2.4.1 Supplying Buffers to The Device: give the buffer
+    // back right away, the event has been copied out.
+    //
+    Dev->Ring.Avail.Ring[AvailIdx++ % Dev->Ring.QueueSize] = (UINT16)DescIdx;
+
+    if (Len < sizeof Event) {
+      continue;
+    }
+
+    switch (Event.Type) {
+      case VIRTIO_INPUT_EV_KEY:
+        if (Event.Code < VIRTIO_INPUT_BTN_MISC) {
+          if (Dev->IsKeyboard) {
+            VirtioInputHandleKeyEvent (Dev, Event.Code, Event.Value);
+          }
+
+          break;
+        }
+
+      //
+      // Fall through: pointer buttons.
+      //
+      case VIRTIO_INPUT_EV_SYN:
+      case VIRTIO_INPUT_EV_ABS:
+        if (Dev->IsPointer) {
+          VirtioInputHandlePointerEvent (Dev, &Event);
+        }
+
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  //
+  // Publish all recycled buffers with a single index update and a single
+  // notification.
+  //
+  MemoryFence ();
+  *Dev->Ring.Avail.Idx = AvailIdx;
+
+  MemoryFence ();
+  Dev->VirtIo->SetQueueNotify (Dev->VirtIo, VIRTIO_INPUT_EVENT_QUEUE);
+
+RestoreTpl:
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Reset the device at ExitBootServices(), so that the host forgets about the
+  event queue and the event buffers.
+
+  @param[in] Event    The ExitBootServices event.
+  @param[in] Context  The VIRTIO_INPUT_DEV instance.
+**/
+STATIC
+VOID
+EFIAPI
+VirtioInputExitBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+
+  DEBUG ((DEBUG_VERBOSE, "%a: Context=0x%p\n", __FUNCTION__, Context));
+  //
+  // Reset the device. This causes the hypervisor to forget about the virtio
+  // ring.
+  //
+  // We allocated said ring in EfiBootServicesData type memory, and code
+  // executing after ExitBootServices() is permitted to overwrite it.
+  //
+  Dev         = Context;
+  Dev->Active = FALSE;
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+}
+
+//
+// Probe, start and stop functions of this driver, called by the DXE core for
+// specific devices.
+//
+// The following specifications document these interfaces:
+// - Driver Writer's Guide for UEFI 2.3.1 v1.01, 9 Driver Binding Protocol
+// - UEFI Spec 2.3.1 + Errata C, 10.1 EFI Driver Binding Protocol
+//
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputDriverBindingSupported (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  EFI_STATUS              Status;
+  VIRTIO_DEVICE_PROTOCOL  *VirtIo;
+
+  //
+  // Attempt to open the device with the VirtIo set of interfaces. On success,
+  // the protocol is "instantiated" for the VirtIo device. Covers duplicate
+  // open attempts (EFI_ALREADY_STARTED).
+  //
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  (VOID **)&VirtIo,
+                  This->DriverBindingHandle,
+                  DeviceHandle,
+                  EFI_OPEN_PROTOCOL_BY_DRIVER
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // virtio-input is a modern-only device.
+  //
+  if ((VirtIo->SubSystemDeviceId != VIRTIO_SUBSYSTEM_INPUT) ||
+      (VirtIo->Revision < VIRTIO_SPEC_REVISION (1, 0, 0)))
+  {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  //
+  // We needed VirtIo access only transitorily, to see whether we support the
+  // device or not.
+  //
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputDriverBindingStart (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  VIRTIO_INPUT_DEV  *Dev;
+  EFI_STATUS        Status;
+
+  Dev = (VIRTIO_INPUT_DEV *)AllocateZeroPool (sizeof *Dev);
+  if (Dev == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Dev->Signature = VIRTIO_INPUT_SIG;
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  (VOID **)&Dev->VirtIo,
+                  This->DriverBindingHandle,
+                  DeviceHandle,
+                  EFI_OPEN_PROTOCOL_BY_DRIVER
+                  );
+  if (EFI_ERROR (Status)) {
+    goto FreeVirtioInput;
+  }
+
+  //
+  // VirtIo access granted, configure virtio-input device.
+  //
+  Status = VirtioInputInit (Dev);
+  if (EFI_ERROR (Status)) {
+    goto CloseVirtIo;
+  }
+
+  if (Dev->IsKeyboard) {
+    Status = VirtioInputKeyboardInit (Dev);
+    if (EFI_ERROR (Status)) {
+      goto UninitDev;
+    }
+  }
+
+  if (Dev->IsPointer) {
+    Status = VirtioInputPointerInit (Dev);
+    if (EFI_ERROR (Status)) {
+      goto UninitKeyboard;
+    }
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                  TPL_CALLBACK,
+                  &VirtioInputExitBoot,
+                  Dev,
+                  &Dev->ExitBoot
+                  );
+  if (EFI_ERROR (Status)) {
+    goto UninitPointer;
+  }
+
+  //
+  // Setup complete; remember the driver instance on the device handle, for
+  // Stop().
+  //
+  Status = gBS->InstallProtocolInterface (
+                  &DeviceHandle,
+                  &gEfiCallerIdGuid,
+                  EFI_NATIVE_INTERFACE,
+                  Dev
+                  );
+  if (EFI_ERROR (Status)) {
+    goto CloseExitBoot;
+  }
+
+  if (Dev->IsKeyboard) {
+    Status = gBS->InstallMultipleProtocolInterfaces (
+                    &DeviceHandle,
+                    &gEfiSimpleTextInProtocolGuid,
+                    &Dev->TextIn,
+                    &gEfiSimpleTextInputExProtocolGuid,
+                    &Dev->TextInEx,
+                    NULL
+                    );
+    if (EFI_ERROR (Status)) {
+      goto UninstallCallerId;
+    }
+  }
+
+  if (Dev->IsPointer) {
+    Status = gBS->InstallProtocolInterface (
+                    &DeviceHandle,
+                    &gEfiAbsolutePointerProtocolGuid,
+                    EFI_NATIVE_INTERFACE,
+                    &Dev->AbsPointer
+                    );
+    if (EFI_ERROR (Status)) {
+      goto UninstallTextIn;
+    }
+  }
+
+  return EFI_SUCCESS;
+
+UninstallTextIn:
+  if (Dev->IsKeyboard) {
+    gBS->UninstallMultipleProtocolInterfaces (
+           DeviceHandle,
+           &gEfiSimpleTextInProtocolGuid,
+           &Dev->TextIn,
+           &gEfiSimpleTextInputExProtocolGuid,
+           &Dev->TextInEx,
+           NULL
+           );
+  }
+
+UninstallCallerId:
+  gBS->UninstallProtocolInterface (DeviceHandle, &gEfiCallerIdGuid, Dev);
+
+CloseExitBoot:
+  gBS->CloseEvent (Dev->ExitBoot);
+
+UninitPointer:
+  if (Dev->IsPointer) {
+    VirtioInputPointerUninit (Dev);
+  }
+
+UninitKeyboard:
+  if (Dev->IsKeyboard) {
+    VirtioInputKeyboardUninit (Dev);
+  }
+
+UninitDev:
+  VirtioInputUninit (Dev);
+
+CloseVirtIo:
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+FreeVirtioInput:
+  FreePool (Dev);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputDriverBindingStop (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN UINTN                        NumberOfChildren,
+  IN EFI_HANDLE                   *ChildHandleBuffer
+  )
+{
+  EFI_STATUS        Status;
+  VIRTIO_INPUT_DEV  *Dev;
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,                     // candidate device
+                  &gEfiCallerIdGuid,                // retrieve the instance
+                  (VOID **)&Dev,                    // target pointer
+                  This->DriverBindingHandle,        // requestor driver ident.
+                  DeviceHandle,                     // lookup req. for dev.
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL    // lookup only, no new ref.
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ASSERT (Dev->Signature == VIRTIO_INPUT_SIG);
+
+  if (Dev->IsPointer) {
+    Status = gBS->UninstallProtocolInterface (
+                    DeviceHandle,
+                    &gEfiAbsolutePointerProtocolGuid,
+                    &Dev->AbsPointer
+                    );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  if (Dev->IsKeyboard) {
+    Status = gBS->UninstallMultipleProtocolInterfaces (
+                    DeviceHandle,
+                    &gEfiSimpleTextInProtocolGuid,
+                    &Dev->TextIn,
+                    &gEfiSimpleTextInputExProtocolGuid,
+                    &Dev->TextInEx,
+                    NULL
+                    );
+    if (EFI_ERROR (Status)) {
+      if (Dev->IsPointer) {
+        gBS->InstallProtocolInterface (
+               &DeviceHandle,
+               &gEfiAbsolutePointerProtocolGuid,
+               EFI_NATIVE_INTERFACE,
+               &Dev->AbsPointer
+               );
+      }
+
+      return Status;
+    }
+  }
+
+  gBS->UninstallProtocolInterface (DeviceHandle, &gEfiCallerIdGuid, Dev);
+
+  gBS->CloseEvent (Dev->ExitBoot);
+
+  VirtioInputUninit (Dev);
+
+  if (Dev->IsPointer) {
+    VirtioInputPointerUninit (Dev);
+  }
+
+  if (Dev->IsKeyboard) {
+    VirtioInputKeyboardUninit (Dev);
+  }
+
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+  FreePool (Dev);
+
+  return EFI_SUCCESS;
+}
+
+//
+// The static object that groups the Supported() (ie. probe), Start() and
+// Stop() functions of the driver together. Refer to UEFI Spec 2.3.1 + Errata
+// C, 10.1 EFI Driver Binding Protocol.
+//
+STATIC EFI_DRIVER_BINDING_PROTOCOL  gDriverBinding = {
+  &VirtioInputDriverBindingSupported,
+  &VirtioInputDriverBindingStart,
+  &VirtioInputDriverBindingStop,
+  0x10, // Version, must be in [0x10 .. 0xFFFFFFEF] for IHV-developed drivers
+  NULL, // ImageHandle, to be overwritten by
+        // EfiLibInstallDriverBindingComponentName2() in VirtioInputEntryPoint()
+  NULL  // DriverBindingHandle, ditto
+};
+
+//
+// The purpose of the following scaffolding (EFI_COMPONENT_NAME_PROTOCOL and
+// EFI_COMPONENT_NAME2_PROTOCOL implementation) is to format the driver's name
+// in English, for display on standard console devices. This is recommended for
+// UEFI drivers that follow the UEFI Driver Model. Refer to the Driver Writer's
+// Guide for UEFI 2.3.1 v1.01, 11 UEFI Driver and Controller Names.
+//
+
+STATIC
+EFI_UNICODE_STRING_TABLE  mDriverNameTable[] = {
+  { "eng;en", L"Virtio Input Driver" },
+  { NULL,     NULL                   }
+};
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName;
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputGetDriverName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **DriverName
+  )
+{
+  return LookupUnicodeString2 (
+           Language,
+           This->SupportedLanguages,
+           mDriverNameTable,
+           DriverName,
+           (BOOLEAN)(This == &gComponentName) // Iso639Language
+           );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioInputGetDeviceName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  EFI_HANDLE                   DeviceHandle,
+  IN  EFI_HANDLE                   ChildHandle,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **ControllerName
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName = {
+  &VirtioInputGetDriverName,
+  &VirtioInputGetDeviceName,
+  "eng" // SupportedLanguages, ISO 639-2 language codes
+};
+
+STATIC
+EFI_COMPONENT_NAME2_PROTOCOL  gComponentName2 = {
+  (EFI_COMPONENT_NAME2_GET_DRIVER_NAME)&VirtioInputGetDriverName,
+  (EFI_COMPONENT_NAME2_GET_CONTROLLER_NAME)&VirtioInputGetDeviceName,
+  "en" // SupportedLanguages, RFC 4646 language codes
+};
+
+//
+// Entry point of this driver.
+//
+EFI_STATUS
+EFIAPI
+VirtioInputEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  return EfiLibInstallDriverBindingComponentName2 (
+           ImageHandle,
+           SystemTable,
+           &gDriverBinding,
+           ImageHandle,
+           &gComponentName,
+           &gComponentName2
+           );
+}
@@ -0,0 +1,272 @@
+/** @file
+
+  Private definitions of the VirtioInput keyboard and pointer driver
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VIRTIO_INPUT_DXE_H_
+#define _VIRTIO_INPUT_DXE_H_
+
+#include <Protocol/AbsolutePointer.h>
+#include <Protocol/ComponentName.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/DriverBinding.h>
+#include <Protocol/SimpleTextIn.h>
+#include <Protocol/SimpleTextInEx.h>
+
+#include <IndustryStandard/VirtioInput.h>
+
+#define VIRTIO_INPUT_SIG             SIGNATURE_32 ('V', 'I', 'N', 'P')
+#define VIRTIO_INPUT_KEY_NOTIFY_SIG  SIGNATURE_32 ('V', 'I', 'K', 'N')
+
+//
+// The number of event buffers kept posted on the event queue, at most. The
+// device drops events while the queue has no buffers; this covers a burst of
+// typing between two polls.
+//
+#define VIRTIO_INPUT_MAX_EVENTS  64
+
+//
+// The depth of the queues of translated keystrokes.
+//
+#define VIRTIO_INPUT_KEY_QUEUE_SIZE  32
+
+typedef struct {
+  EFI_KEY_DATA    Buffer[VIRTIO_INPUT_KEY_QUEUE_SIZE];
+  UINTN           Head;
+  UINTN           Count;
+} VIRTIO_INPUT_KEY_QUEUE;
+
+//
+// A key notification registered with RegisterKeyNotify().
+//
+typedef struct {
+  UINTN                      Signature;
+  EFI_KEY_DATA               KeyData;
+  EFI_KEY_NOTIFY_FUNCTION    KeyNotificationFn;
+  LIST_ENTRY                 NotifyEntry;
+} VIRTIO_INPUT_KEY_NOTIFY;
+
+typedef struct {
+  //
+  // Parts of this structure are initialized / torn down in various functions
+  // at various call depths. The table to the right should make it easier to
+  // track them.
+  //
+  //                                   field                 init function           init depth
+  //                                   --------------------  ----------------------  ----------
+  UINT32                               Signature;         // DriverBindingStart      0
+  VIRTIO_DEVICE_PROTOCOL               *VirtIo;           // DriverBindingStart      0
+  EFI_EVENT                            ExitBoot;          // DriverBindingStart      0
+  VRING                                Ring;              // VirtioRingInit          2
+  VOID                                 *RingMap;          // VirtioRingMap           2
+  VIRTIO_INPUT_EVENT                   *Events;           // VirtioInputInit         1
+  EFI_PHYSICAL_ADDRESS                 EventsAddress;     // VirtioInputInit         1
+  VOID                                 *EventsMap;        // VirtioInputInit         1
+  UINT16                               EventCount;        // VirtioInputInit         1
+  UINT16                               LastUsed;          // VirtioInputInit         1
+  BOOLEAN                              Active;            // VirtioInputInit         1
+
+  //
+  // Keyboard; present if the device reports letter keys.
+  //
+  BOOLEAN                              IsKeyboard;        // VirtioInputInit         1
+  EFI_SIMPLE_TEXT_INPUT_PROTOCOL       TextIn;            // VirtioInputKeyboardInit 1
+  EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL    TextInEx;          // VirtioInputKeyboardInit 1
+  VIRTIO_INPUT_KEY_QUEUE               KeyQueue;          // VirtioInputKeyboardInit 1
+  VIRTIO_INPUT_KEY_QUEUE               NotifyQueue;       // VirtioInputKeyboardInit 1
+  LIST_ENTRY                           NotifyList;        // VirtioInputKeyboardInit 1
+  EFI_EVENT                            KeyNotifyProcessEvent; // KeyboardInit    1
+  EFI_EVENT                            KeyNotifyTimerEvent; // KeyboardInit      1
+  UINT32                               ShiftState;        // VirtioInputKeyboardInit 1
+  EFI_KEY_TOGGLE_STATE                 ToggleState;       // VirtioInputKeyboardInit 1
+  BOOLEAN                              IsSupportPartialKey; // KeyboardInit      1
+
+  //
+  // Absolute pointer; present if the device reports ABS_X and ABS_Y.
+  //
+  BOOLEAN                              IsPointer;         // VirtioInputInit         1
+  EFI_ABSOLUTE_POINTER_PROTOCOL        AbsPointer;        // VirtioInputPointerInit  1
+  EFI_ABSOLUTE_POINTER_MODE            AbsPointerMode;    // VirtioInputPointerInit  1
+  EFI_ABSOLUTE_POINTER_STATE           AbsPointerState;   // VirtioInputPointerInit  1
+  EFI_ABSOLUTE_POINTER_STATE           PendingState;      // VirtioInputPointerInit  1
+  BOOLEAN                              PointerStateChanged; // PointerInit       1
+} VIRTIO_INPUT_DEV;
+
+#define VIRTIO_INPUT_FROM_TEXT_IN(TextInPointer) \
+  CR (TextInPointer, VIRTIO_INPUT_DEV, TextIn, VIRTIO_INPUT_SIG)
+
+#define VIRTIO_INPUT_FROM_TEXT_IN_EX(TextInExPointer) \
+  CR (TextInExPointer, VIRTIO_INPUT_DEV, TextInEx, VIRTIO_INPUT_SIG)
+
+#define VIRTIO_INPUT_FROM_ABS_POINTER(AbsPointerPointer) \
+  CR (AbsPointerPointer, VIRTIO_INPUT_DEV, AbsPointer, VIRTIO_INPUT_SIG)
+
+//
+// Event queue, implemented in VirtioInput.c.
+//
+
+/**
+  Consume the events that the device has placed in the used ring, and give
+  the buffers back to the device with a single notification.
+
+  The used ring is only checked from here, that is, when a consumer waits for
+  or reads input, and while key notifications are registered, from a slow
+  timer.
+
+  @param[in,out] Dev  The driver instance.
+**/
+VOID
+VirtioInputProcessEvents (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  );
+
+//
+// Keyboard, implemented in Keyboard.c.
+//
+
+/**
+  Set up the Simple Text Input and Simple Text Input Ex protocol instances.
+
+  @param[in,out] Dev  The driver instance.
+
+  @retval EFI_SUCCESS  The protocol instances are ready to be installed.
+  @return              Error codes from CreateEvent()/CreateEventEx().
+**/
+EFI_STATUS
+VirtioInputKeyboardInit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  );
+
+/**
+  Release the resources of VirtioInputKeyboardInit().
+
+  @param[in,out] Dev  The driver instance.
+**/
+VOID
+VirtioInputKeyboardUninit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  );
+
+/**
+  Translate a keyboard key event into keystrokes. The caller is responsible
+  for running at TPL_NOTIFY.
+
+  @param[in,out] Dev  The driver instance.
+  @param[in] Code     The key code, below VIRTIO_INPUT_BTN_MISC.
+  @param[in] Value    One of VIRTIO_INPUT_KEY_RELEASED, _PRESSED, _REPEATED.
+**/
+VOID
+VirtioInputHandleKeyEvent (
+  IN OUT VIRTIO_INPUT_DEV  *Dev,
+  IN     UINT16            Code,
+  IN     UINT32            Value
+  );
+
+//
+// Absolute pointer, implemented in Pointer.c.
+//
+
+/**
+  Set up the Absolute Pointer protocol instance, with the axis ranges that
+  the device reports.
+
+  @param[in,out] Dev  The driver instance.
+
+  @retval EFI_SUCCESS  The protocol instance is ready to be installed.
+  @return              Error codes from the VirtIo services and CreateEvent().
+**/
+EFI_STATUS
+VirtioInputPointerInit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  );
+
+/**
+  Release the resources of VirtioInputPointerInit().
+
+  @param[in,out] Dev  The driver instance.
+**/
+VOID
+VirtioInputPointerUninit (
+  IN OUT VIRTIO_INPUT_DEV  *Dev
+  );
+
+/**
+  Accumulate a pointer event; the state becomes visible at the next EV_SYN
+  event. The caller is responsible for running at TPL_NOTIFY.
+
+  @param[in,out] Dev    The driver instance.
+  @param[in] Event      The event, of type EV_SYN, EV_KEY (buttons) or
+                        EV_ABS.
+**/
+VOID
+VirtioInputHandlePointerEvent (
+  IN OUT VIRTIO_INPUT_DEV          *Dev,
+  IN     CONST VIRTIO_INPUT_EVENT  *Event
+  );
+
+//
+// Configuration space access, implemented in VirtioInput.c.
+//
+
+/**
+  Select a configuration item, and return its size.
+
+  @param[in] VirtIo  The VirtIo device.
+  @param[in] Select  The VIRTIO_INPUT_CFG_* item.
+  @param[in] Subsel  The sub-item, for example the event type for
+                     VIRTIO_INPUT_CFG_EV_BITS.
+  @param[out] Size   The size of the item; zero if the device does not
+                     support it.
+
+  @return  Status codes from the VirtIo WriteDevice() and ReadDevice()
+           services.
+**/
+EFI_STATUS
+VirtioInputSelectConfig (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINT8                   Select,
+  IN  UINT8                   Subsel,
+  OUT UINT8                   *Size
+  );
+
+/**
+  Determine whether the device can report an event.
+
+  @param[in] VirtIo    The VirtIo device.
+  @param[in] Type      The event type, for example VIRTIO_INPUT_EV_KEY.
+  @param[in] Code      The event code.
+  @param[out] Present  Whether the device can report the event.
+
+  @return  Status codes from VirtioInputSelectConfig() and the VirtIo
+           ReadDevice() service.
+**/
+EFI_STATUS
+VirtioInputHasEventCode (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINT8                   Type,
+  IN  UINT16                  Code,
+  OUT BOOLEAN                 *Present
+  );
+
+/**
+  Read a 32-bit word of the selected configuration item.
+
+  @param[in] VirtIo   The VirtIo device.
+  @param[in] Offset   The byte offset of the word in the item.
+  @param[out] Value   The word read.
+
+  @return  Status codes from the VirtIo ReadDevice() service.
+**/
+EFI_STATUS
+VirtioInputReadConfig32 (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINTN                   Offset,
+  OUT UINT32                  *Value
+  );
+
+#endif
@@ -0,0 +1,645 @@
+/** @file
+
+  This driver exposes the persistent memory regions of virtio-pmem devices as
+  RAM disks.
+
+  The region of a virtio-pmem device is mapped directly into the guest-physical
+  address space by the hypervisor. The driver adds the region to the GCD memory
+  space map as reserved memory, and registers it with EFI_RAM_DISK_PROTOCOL.
+  RamDiskDxe then produces EFI_BLOCK_IO_PROTOCOL on top of the mapping. Boot
+  media on the region is therefore accessible without any device I/O.
+
+  The region is reserved rather than persistent memory: the OS would turn an
+  EfiPersistentMemory range into a pmem region of its own (E820 type 7 on
+  Linux), and access it without the virtio-pmem flush request. A reserved
+  range is left to the OS virtio-pmem driver. RamDiskDxe also only describes
+  RAM disks in reserved memory in the NFIT; see PcdVirtioPmemPublishNfit.
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/VirtioLib.h>
+
+#include "VirtioPmem.h"
+
+/**
+  Read a 64-bit field from the device configuration.
+
+  @param[in] VirtIo       The VirtIo device.
+
+  @param[in] FieldOffset  Offset of the field in VIRTIO_PMEM_CONFIG.
+
+  @param[out] Value       The value read.
+
+  @return  Status codes from VIRTIO_DEVICE_PROTOCOL.ReadDevice().
+**/
+STATIC
+EFI_STATUS
+VirtioPmemReadConfig64 (
+  IN  VIRTIO_DEVICE_PROTOCOL  *VirtIo,
+  IN  UINTN                   FieldOffset,
+  OUT UINT64                  *Value
+  )
+{
+  return VirtIo->ReadDevice (
+                   VirtIo,
+                   FieldOffset,
+                   sizeof *Value,
+                   sizeof *Value,
+                   Value
+                   );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioPmemInit (
+  IN OUT VIRTIO_PMEM_DEV  *Dev
+  )
+{
+  UINT8       NextDevStat;
+  EFI_STATUS  Status;
+  UINT64      Features;
+
+  //
+  // virtio-pmem is a modern-only device; the 64-bit configuration fields
+  // cannot be read through a legacy transport.
+  //
+  if (Dev->VirtIo->Revision < VIRTIO_SPEC_REVISION (1, 0, 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Execute virtio-1.0, 3.1.1 Driver Requirements: Device Initialization.
+  //
+  NextDevStat = 0;             // step 1 -- reset device
+  Status      = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_ACK;    // step 2 -- acknowledge device presence
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  NextDevStat |= VSTAT_DRIVER; // step 3 -- we know how to drive it
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 4 -- retrieve, validate and acknowledge features
+  //
+  Status = Dev->VirtIo->GetDeviceFeatures (Dev->VirtIo, &Features);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Features &= VIRTIO_F_VERSION_1 | VIRTIO_F_IOMMU_PLATFORM;
+  Status    = Virtio10WriteFeatures (Dev->VirtIo, Features, &NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  //
+  // step 5 -- read the device configuration. The request queue is left
+  // unconfigured: the firmware never needs to ask the host to flush the
+  // region.
+  //
+  Status = VirtioPmemReadConfig64 (
+             Dev->VirtIo,
+             OFFSET_OF (VIRTIO_PMEM_CONFIG, Start),
+             &Dev->RegionBase
+             );
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Status = VirtioPmemReadConfig64 (
+             Dev->VirtIo,
+             OFFSET_OF (VIRTIO_PMEM_CONFIG, Size),
+             &Dev->RegionSize
+             );
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  if ((Dev->RegionSize == 0) ||
+      ((Dev->RegionBase & EFI_PAGE_MASK) != 0) ||
+      ((Dev->RegionSize & EFI_PAGE_MASK) != 0) ||
+      (Dev->RegionBase > MAX_UINT64 - Dev->RegionSize))
+  {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: invalid region Start=0x%Lx Size=0x%Lx\n",
+      __FUNCTION__,
+      Dev->RegionBase,
+      Dev->RegionSize
+      ));
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  //
+  // step 6 -- initialization complete
+  //
+  NextDevStat |= VSTAT_DRIVER_OK;
+  Status       = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  return EFI_SUCCESS;
+
+Failed:
+  //
+  // Notify the host about our failure to setup: virtio-0.9.5, 2.2.2.1 Device
+  // Status. VirtIo access failure here should not mask the original error.
+  //
+  NextDevStat |= VSTAT_FAILED;
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
+
+  return Status; // reached only via Failed above
+}
+
+/**
+  Make the persistent memory region accessible to the CPU, as write-back
+  cacheable reserved memory in the GCD memory space map.
+
+  The hypervisor places the region outside of guest RAM, so on first use the
+  range is normally non-existent in the GCD map. If the range has been added
+  as reserved memory before (for example, by an earlier Start() on the same
+  device), it is reused.
+
+  @param[in,out] Dev  The driver instance. On success, AddedMemorySpace
+                      records whether the range has been added by this call.
+
+  @retval EFI_SUCCESS      The region is mapped.
+
+  @retval EFI_UNSUPPORTED  The region overlaps memory space of another type.
+
+  @return                  Error codes from the GCD services.
+**/
+STATIC
+EFI_STATUS
+VirtioPmemMapRegion (
+  IN OUT VIRTIO_PMEM_DEV  *Dev
+  )
+{
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR  Descriptor;
+  EFI_STATUS                       Status;
+
+  Dev->AddedMemorySpace = FALSE;
+
+  Status = gDS->GetMemorySpaceDescriptor (Dev->RegionBase, &Descriptor);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Descriptor.BaseAddress + Descriptor.Length <
+      Dev->RegionBase + Dev->RegionSize)
+  {
+    Status = EFI_UNSUPPORTED;
+  } else if (Descriptor.GcdMemoryType == EfiGcdMemoryTypeNonExistent) {
+    Status = gDS->AddMemorySpace (
+                    EfiGcdMemoryTypeReserved,
+                    Dev->RegionBase,
+                    Dev->RegionSize,
+                    EFI_MEMORY_WB
+                    );
+    Dev->AddedMemorySpace = (BOOLEAN)!EFI_ERROR (Status);
+  } else if (Descriptor.GcdMemoryType != EfiGcdMemoryTypeReserved) {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: cannot add [0x%Lx, 0x%Lx) (GCD type %d): %r\n",
+      __FUNCTION__,
+      Dev->RegionBase,
+      Dev->RegionBase + Dev->RegionSize,
+      Descriptor.GcdMemoryType,
+      Status
+      ));
+    return Status;
+  }
+
+  Status = gDS->SetMemorySpaceAttributes (
+                  Dev->RegionBase,
+                  Dev->RegionSize,
+                  EFI_MEMORY_WB
+                  );
+  if (EFI_ERROR (Status)) {
+    if (Dev->AddedMemorySpace) {
+      gDS->RemoveMemorySpace (Dev->RegionBase, Dev->RegionSize);
+      Dev->AddedMemorySpace = FALSE;
+    }
+
+    return Status;
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+VirtioPmemUnmapRegion (
+  IN OUT VIRTIO_PMEM_DEV  *Dev
+  )
+{
+  if (Dev->AddedMemorySpace) {
+    gDS->RemoveMemorySpace (Dev->RegionBase, Dev->RegionSize);
+    Dev->AddedMemorySpace = FALSE;
+  }
+}
+
+/**
+  Register the mapped region with EFI_RAM_DISK_PROTOCOL.
+
+  @param[in,out] Dev       The driver instance. On success, RamDiskDevicePath
+                           is set.
+
+  @param[in] DeviceHandle  The handle of the VirtIo device, whose device path
+                           (if any) becomes the parent of the RAM disk's.
+
+  @return  Status codes from gBS->LocateProtocol() and
+           EFI_RAM_DISK_PROTOCOL.Register().
+**/
+STATIC
+EFI_STATUS
+VirtioPmemRegisterRamDisk (
+  IN OUT VIRTIO_PMEM_DEV  *Dev,
+  IN     EFI_HANDLE       DeviceHandle
+  )
+{
+  EFI_RAM_DISK_PROTOCOL     *RamDisk;
+  EFI_DEVICE_PATH_PROTOCOL  *ParentDevicePath;
+  EFI_GUID                  *RamDiskType;
+  EFI_STATUS                Status;
+
+  Status = gBS->LocateProtocol (&gEfiRamDiskProtocolGuid, NULL, (VOID **)&RamDisk);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (
+                  DeviceHandle,
+                  &gEfiDevicePathProtocolGuid,
+                  (VOID **)&ParentDevicePath
+                  );
+  if (EFI_ERROR (Status)) {
+    ParentDevicePath = NULL;
+  }
+
+  RamDiskType = FeaturePcdGet (PcdVirtioPmemPublishNfit) ?
+                &gEfiPersistentVirtualDiskGuid :
+                &gEfiVirtualDiskGuid;
+
+  Status = RamDisk->Register (
+                      Dev->RegionBase,
+                      Dev->RegionSize,
+                      RamDiskType,
+                      ParentDevicePath,
+                      &Dev->RamDiskDevicePath
+                      );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: [0x%Lx, 0x%Lx) registered as %g\n",
+    __FUNCTION__,
+    Dev->RegionBase,
+    Dev->RegionBase + Dev->RegionSize,
+    RamDiskType
+    ));
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+VirtioPmemUnregisterRamDisk (
+  IN OUT VIRTIO_PMEM_DEV  *Dev
+  )
+{
+  EFI_RAM_DISK_PROTOCOL  *RamDisk;
+  EFI_STATUS             Status;
+
+  Status = gBS->LocateProtocol (&gEfiRamDiskProtocolGuid, NULL, (VOID **)&RamDisk);
+  if (!EFI_ERROR (Status)) {
+    RamDisk->Unregister (Dev->RamDiskDevicePath);
+  }
+
+  FreePool (Dev->RamDiskDevicePath);
+  Dev->RamDiskDevicePath = NULL;
+}
+
+//
+// Probe, start and stop functions of this driver, called by the DXE core for
+// specific devices.
+//
+// The following specifications document these interfaces:
+// - Driver Writer's Guide for UEFI 2.3.1 v1.01, 9 Driver Binding Protocol
+// - UEFI Spec 2.3.1 + Errata C, 10.1 EFI Driver Binding Protocol
+//
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioPmemDriverBindingSupported (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  EFI_STATUS              Status;
+  VIRTIO_DEVICE_PROTOCOL  *VirtIo;
+
+  //
+  // Attempt to open the device with the VirtIo set of interfaces. On success,
+  // the protocol is "instantiated" for the VirtIo device. Covers duplicate
+  // open attempts (EFI_ALREADY_STARTED).
+  //
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  (VOID **)&VirtIo,
+                  This->DriverBindingHandle,
+                  DeviceHandle,
+                  EFI_OPEN_PROTOCOL_BY_DRIVER
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (VirtIo->SubSystemDeviceId != VIRTIO_SUBSYSTEM_PMEM) {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  //
+  // We needed VirtIo access only transitorily, to see whether we support the
+  // device or not.
+  //
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioPmemDriverBindingStart (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN EFI_DEVICE_PATH_PROTOCOL     *RemainingDevicePath
+  )
+{
+  VIRTIO_PMEM_DEV  *Dev;
+  EFI_STATUS       Status;
+
+  Dev = (VIRTIO_PMEM_DEV *)AllocateZeroPool (sizeof *Dev);
+  if (Dev == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,
+                  &gVirtioDeviceProtocolGuid,
+                  (VOID **)&Dev->VirtIo,
+                  This->DriverBindingHandle,
+                  DeviceHandle,
+                  EFI_OPEN_PROTOCOL_BY_DRIVER
+                  );
+  if (EFI_ERROR (Status)) {
+    goto FreeVirtioPmem;
+  }
+
+  //
+  // VirtIo access granted, configure virtio-pmem device.
+  //
+  Status = VirtioPmemInit (Dev);
+  if (EFI_ERROR (Status)) {
+    goto CloseVirtIo;
+  }
+
+  Status = VirtioPmemMapRegion (Dev);
+  if (EFI_ERROR (Status)) {
+    goto ResetDevice;
+  }
+
+  Status = VirtioPmemRegisterRamDisk (Dev, DeviceHandle);
+  if (EFI_ERROR (Status)) {
+    goto UnmapRegion;
+  }
+
+  //
+  // Setup complete; remember the driver instance on the device handle, for
+  // Stop().
+  //
+  Dev->Signature = VIRTIO_PMEM_SIG;
+  Status         = gBS->InstallProtocolInterface (
+                          &DeviceHandle,
+                          &gEfiCallerIdGuid,
+                          EFI_NATIVE_INTERFACE,
+                          Dev
+                          );
+  if (EFI_ERROR (Status)) {
+    goto UnregisterRamDisk;
+  }
+
+  return EFI_SUCCESS;
+
+UnregisterRamDisk:
+  VirtioPmemUnregisterRamDisk (Dev);
+
+UnmapRegion:
+  VirtioPmemUnmapRegion (Dev);
+
+ResetDevice:
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+
+CloseVirtIo:
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+FreeVirtioPmem:
+  FreePool (Dev);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioPmemDriverBindingStop (
+  IN EFI_DRIVER_BINDING_PROTOCOL  *This,
+  IN EFI_HANDLE                   DeviceHandle,
+  IN UINTN                        NumberOfChildren,
+  IN EFI_HANDLE                   *ChildHandleBuffer
+  )
+{
+  EFI_STATUS       Status;
+  VIRTIO_PMEM_DEV  *Dev;
+
+  Status = gBS->OpenProtocol (
+                  DeviceHandle,                     // candidate device
+                  &gEfiCallerIdGuid,                // retrieve the instance
+                  (VOID **)&Dev,                    // target pointer
+                  This->DriverBindingHandle,        // requestor driver ident.
+                  DeviceHandle,                     // lookup req. for dev.
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL    // lookup only, no new ref.
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ASSERT (Dev->Signature == VIRTIO_PMEM_SIG);
+
+  Status = gBS->UninstallProtocolInterface (
+                  DeviceHandle,
+                  &gEfiCallerIdGuid,
+                  Dev
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  VirtioPmemUnregisterRamDisk (Dev);
+  VirtioPmemUnmapRegion (Dev);
+
+  //
+  // Reset the virtual device -- see virtio-0.9.5, 2.2.2.1 Device Status.
+  //
+  Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
+
+  gBS->CloseProtocol (
+         DeviceHandle,
+         &gVirtioDeviceProtocolGuid,
+         This->DriverBindingHandle,
+         DeviceHandle
+         );
+
+  FreePool (Dev);
+
+  return EFI_SUCCESS;
+}
+
+//
+// The static object that groups the Supported() (ie. probe), Start() and
+// Stop() functions of the driver together. Refer to UEFI Spec 2.3.1 + Errata
+// C, 10.1 EFI Driver Binding Protocol.
+//
+STATIC EFI_DRIVER_BINDING_PROTOCOL  gDriverBinding = {
+  &VirtioPmemDriverBindingSupported,
+  &VirtioPmemDriverBindingStart,
+  &VirtioPmemDriverBindingStop,
+  0x10, // Version, must be in [0x10 .. 0xFFFFFFEF] for IHV-developed drivers
+  NULL, // ImageHandle, to be overwritten by
+        // EfiLibInstallDriverBindingComponentName2() in VirtioPmemEntryPoint()
+  NULL  // DriverBindingHandle, ditto
+};
+
+//
+// The purpose of the following scaffolding (EFI_COMPONENT_NAME_PROTOCOL and
+// EFI_COMPONENT_NAME2_PROTOCOL implementation) is to format the driver's name
+// in English, for display on standard console devices. This is recommended for
+// UEFI drivers that follow the UEFI Driver Model. Refer to the Driver Writer's
+// Guide for UEFI 2.3.1 v1.01, 11 UEFI Driver and Controller Names.
+//
+
+STATIC
+EFI_UNICODE_STRING_TABLE  mDriverNameTable[] = {
+  { "eng;en", L"Virtio Persistent Memory Driver" },
+  { NULL,     NULL                               }
+};
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName;
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioPmemGetDriverName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **DriverName
+  )
+{
+  return LookupUnicodeString2 (
+           Language,
+           This->SupportedLanguages,
+           mDriverNameTable,
+           DriverName,
+           (BOOLEAN)(This == &gComponentName) // Iso639Language
+           );
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VirtioPmemGetDeviceName (
+  IN  EFI_COMPONENT_NAME_PROTOCOL  *This,
+  IN  EFI_HANDLE                   DeviceHandle,
+  IN  EFI_HANDLE                   ChildHandle,
+  IN  CHAR8                        *Language,
+  OUT CHAR16                       **ControllerName
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+STATIC
+EFI_COMPONENT_NAME_PROTOCOL  gComponentName = {
+  &VirtioPmemGetDriverName,
+  &VirtioPmemGetDeviceName,
+  "eng" // SupportedLanguages, ISO 639-2 language codes
+};
+
+STATIC
+EFI_COMPONENT_NAME2_PROTOCOL  gComponentName2 = {
+  (EFI_COMPONENT_NAME2_GET_DRIVER_NAME)&VirtioPmemGetDriverName,
+  (EFI_COMPONENT_NAME2_GET_CONTROLLER_NAME)&VirtioPmemGetDeviceName,
+  "en" // SupportedLanguages, RFC 4646 language codes
+};
+
+//
+// Entry point of this driver.
+//
+EFI_STATUS
+EFIAPI
+VirtioPmemEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  return EfiLibInstallDriverBindingComponentName2 (
+           ImageHandle,
+           SystemTable,
+           &gDriverBinding,
+           ImageHandle,
+           &gComponentName,
+           &gComponentName2
+           );
+}
@@ -0,0 +1,39 @@
+/** @file
+
+  Private definitions of the VirtioPmem persistent memory driver
+
+  Copyright (c) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VIRTIO_PMEM_DXE_H_
+#define _VIRTIO_PMEM_DXE_H_
+
+#include <Protocol/ComponentName.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/DriverBinding.h>
+#include <Protocol/RamDisk.h>
+
+#include <IndustryStandard/VirtioPmem.h>
+
+#define VIRTIO_PMEM_SIG  SIGNATURE_32 ('V', 'P', 'M', 'M')
+
+typedef struct {
+  //
+  // Parts of this structure are initialized / torn down in various functions
+  // at various call depths. The table to the right should make it easier to
+  // track them.
+  //
+  //                          field                init function        init depth
+  //                          -------------------  -------------------  ----------
+  UINT32                      Signature;        // DriverBindingStart   0
+  VIRTIO_DEVICE_PROTOCOL      *VirtIo;          // DriverBindingStart   0
+  UINT64                      RegionBase;       // VirtioPmemInit       1
+  UINT64                      RegionSize;       // VirtioPmemInit       1
+  BOOLEAN                     AddedMemorySpace; // VirtioPmemMapRegion  1
+  EFI_DEVICE_PATH_PROTOCOL    *RamDiskDevicePath; // DriverBindingStart 0
+} VIRTIO_PMEM_DEV;
+
+#endif